@@ -4,10 +4,12 @@ layout(std430, binding = 0) buffer _Pos {
     vec3 Pos[];
 };
 
+uniform mat4 u_modelMatrix; // rigidbodies kept in local space
+
 out vec3 worldPos0;
 
 void main() {
-	vec3 position = Pos[gl_VertexID].xyz;
+	vec3 position = (u_modelMatrix * vec4(Pos[gl_VertexID].xyz, 1.0)).xyz;
     gl_Position = vec4(position, 1.0);
     worldPos0 = position;
 }
@@ -5,6 +5,7 @@
 // work group size injected before compilation
 #define WORK_GROUP_SIZE XX
 #define EPSILON 0.0001
+#define BVH_STACK_SIZE 32
 
 layout(std430, binding = 0) buffer _pCloth1 { // cloth positions in previous timestep
     vec4 pCloth1[];
@@ -21,21 +22,39 @@ layout(std430, binding = 3) readonly buffer _bodyTriangles {
 layout(std430, binding = 4) buffer _collisionConstraints { // vec4s of normal dir and distance 
     vec4 pClothCollisionConstraints[];
 };
-layout(std430, binding = 5) buffer _debug { // vec4s of debug data
-    vec4 debug[];
+layout(std430, binding = 5) readonly buffer _clothParams { // z: bounce, w: end vertex, see Cloth::uploadParameters
+    vec4 clothParams[];
+};
+layout(std430, binding = 6) readonly buffer _bodyBVH { // flat BVH over bodyTriangles. see bvh.hpp
+    vec4 bodyBVH[]; // two vec4s per node: min + left/first, max + triangle count
 };
 
 layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
 
-layout(location = 0) uniform int numTriangles;
+layout(location = 0) uniform int numBVHNodes;
 layout(location = 1) uniform int numPositions;
-layout(location = 2) uniform float staticConstraintBounce;
+// the body is queried in its own space (identity when it's animated in world space)
+layout(location = 3) uniform mat4 bodyToWorld;
+layout(location = 4) uniform mat4 worldToBody;
+
+// the cloth vertex v is from: the first one ending past it (see
+// ClothBatch::uploadParameters). a handful of cloths at most, so cheap.
+int clothOf(uint v) {
+    int lo = 0;
+    int hi = clothParams.length() - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (floatBitsToUint(clothParams[mid].w) > v) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
 
 vec3 nearestPointOnTriangle(vec3 P, vec3 A, vec3 B, vec3 C)
 {
     vec3 v0 = C - A;
     vec3 v1 = B - A;
-    vec3 N_v2 = cross(normalize(v1), normalize(v0));
+    vec3 N_v2 = normalize(cross(v1, v0));
 
     // case 1: it's in the triangle
     // project into triangle plane
@@ -107,8 +126,24 @@ vec3 nearestPointOnTriangle(vec3 P, vec3 A, vec3 B, vec3 C)
     return (u_t * (v1 - v0) + v0);
 }
 
+float distanceToBox(vec3 P, vec3 boxMin, vec3 boxMax) {
+    return length(max(max(boxMin - P, 0.0), P - boxMax));
+}
+
+// does the ray orig + t * dir, t >= 0 touch the box?
+bool rayHitsBox(vec3 orig, vec3 invDir, vec3 boxMin, vec3 boxMax) {
+    vec3 t0 = (boxMin - orig) * invDir;
+    vec3 t1 = (boxMax - orig) * invDir;
+    vec3 tNear = min(t0, t1);
+    vec3 tFar = max(t0, t1);
+    float enter = max(max(tNear.x, tNear.y), max(tNear.z, 0.0));
+    float exit = min(min(tFar.x, tFar.y), tFar.z);
+    return enter <= exit;
+}
+
 void generateStaticConstraint(vec3 pos) {
     uint idx = gl_GlobalInvocationID.x;
+    float staticConstraintBounce = clothParams[clothOf(idx)].z;
 
     // static constraint: generate a "point of entry" approximating the closest
     // point on the mesh to the pos from the last timestep (pos).
@@ -116,31 +151,55 @@ void generateStaticConstraint(vec3 pos) {
     // use the normal at this point to generate a constraint that will get
     // the point in this timestep out.
 
-    vec3 triangle = bodyTriangles[0].xyz;
-    vec3 v0 = pBody[int(triangle.x)].xyz;
-    vec3 v1 = pBody[int(triangle.y)].xyz;
-    vec3 v2 = pBody[int(triangle.z)].xyz;
-    vec3 nearestPoint = nearestPointOnTriangle(pos, v0, v1, v2);
-    vec3 nearestNormal = normalize(cross(v1 - v0, v2 - v0));
-    float nearestDistance = length(nearestPoint - pos);
+    vec3 nearestPoint = pos;
+    vec3 nearestNormal = vec3(0.0, 0.0, 1.0);
+    float nearestDistance = 1e30;
+    float nearestTriangle = 0.0; // ties go to the lowest original triangle index
     vec3 candidatePoint;
     float candidateDistance;
 
-    for (int i = 1; i < numTriangles; i++) {
-
-        triangle = bodyTriangles[i].xyz;
-        v0 = pBody[int(triangle.x)].xyz;
-        v1 = pBody[int(triangle.y)].xyz;
-        v2 = pBody[int(triangle.z)].xyz;
-        candidatePoint = nearestPointOnTriangle(pos, v0, v1, v2);
-        candidateDistance = length(candidatePoint - pos);
-        if (candidateDistance < nearestDistance) {
-            nearestDistance = candidateDistance;
-            nearestPoint = candidatePoint;
-            nearestNormal = normalize(cross(v1 - v0, v2 - v0));
+    // walk the BVH nearest box first, skipping boxes farther than the best so far
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    if (numBVHNodes > 0) stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        int node = stack[--stackSize];
+        vec4 boxMin = bodyBVH[2 * node];
+        vec4 boxMax = bodyBVH[2 * node + 1];
+        if (distanceToBox(pos, boxMin.xyz, boxMax.xyz) > nearestDistance) continue;
+
+        int first = int(boxMin.w);
+        int count = int(boxMax.w);
+        if (count == 0) {
+            float leftDistance = distanceToBox(pos, bodyBVH[2 * first].xyz, bodyBVH[2 * first + 1].xyz);
+            float rightDistance = distanceToBox(pos, bodyBVH[2 * first + 2].xyz, bodyBVH[2 * first + 3].xyz);
+            bool leftFirst = leftDistance <= rightDistance;
+            stack[stackSize++] = leftFirst ? first + 1 : first;
+            stack[stackSize++] = leftFirst ? first : first + 1;
+            continue;
+        }
+
+        for (int i = first; i < first + count; i++) {
+            vec4 triangle = bodyTriangles[i];
+            vec3 v0 = pBody[int(triangle.x)].xyz;
+            vec3 v1 = pBody[int(triangle.y)].xyz;
+            vec3 v2 = pBody[int(triangle.z)].xyz;
+            candidatePoint = nearestPointOnTriangle(pos, v0, v1, v2);
+            candidateDistance = length(candidatePoint - pos);
+            if (candidateDistance < nearestDistance ||
+                (candidateDistance == nearestDistance && triangle.w < nearestTriangle)) {
+                nearestTriangle = triangle.w;
+                nearestDistance = candidateDistance;
+                nearestPoint = candidatePoint;
+                nearestNormal = normalize(cross(v1 - v0, v2 - v0));
+            }
         }
     }
 
+    // back to world space. bodies only move rigidly, so normals stay unit length
+    nearestPoint = (bodyToWorld * vec4(nearestPoint, 1.0)).xyz;
+    nearestNormal = mat3(bodyToWorld) * nearestNormal;
+
     // move the position in the last timestep over to nearestPoint
     pCloth1[idx].xyz = nearestPoint + nearestNormal * staticConstraintBounce;
     pClothCollisionConstraints[idx] = vec4(nearestNormal, 1.0);
@@ -256,56 +315,76 @@ void main() {
     // inverse mass is the w in the position
     if (pCloth1[idx].w < EPSILON) return;
 
-    vec3 pos = pCloth1[idx].xyz; // prev timestep
-    vec3 lookAt = pCloth2[idx].xyz; // next timestep
+    // collision parametrics don't change under the body's transformation,
+    // so everything up to the constraint itself happens in body space
+    vec3 pos = (worldToBody * vec4(pCloth1[idx].xyz, 1.0)).xyz; // prev timestep
+    vec3 lookAt = (worldToBody * vec4(pCloth2[idx].xyz, 1.0)).xyz; // next timestep
     float dirScale = length(lookAt - pos);
     vec3 dir = normalize(lookAt - pos);
 
     vec4 collisionConstraint = vec4(-1.0); // a bogus collisionConstraint
+    float collisionTriangle = 0.0; // ties go to the lowest original triangle index
 
     // if there's an odd number of collisions, we're inside the mesh already
     int numCollisions = 0; // which means we need a static constraint (addtl handling here)
 
-    debug[idx] = vec4(-1.0);
-    vec3 debugPos;
-
-    // check against every triangle in the mesh.
-    for (int i = 0; i < numTriangles; i++) {
-
-        vec3 triangle = bodyTriangles[i].xyz;
-        vec3 v0 = pBody[int(triangle.x)].xyz;
-        vec3 v1 = pBody[int(triangle.y)].xyz;
-        vec3 v2 = pBody[int(triangle.z)].xyz;
-        vec3 norm = normalize(cross(v1 - v0, v2 - v0));
-
-        // b/c intersectTriangle gets us a distance with a normalized dir vector
-        // intersectTriangle = realLength * dirScale
-        // intersectTriangle / dirScale = realLength
-        float collisionT = mollerTrumboreIntersectTriangle(pos, dir, v0, v1, v2);
-        // collision out of bounds
-        if (collisionT > -EPSILON) {
-            numCollisions++;
-            debugPos = pos + (collisionT / dirScale) * (lookAt - pos);
-        }
-        collisionT /= dirScale;
-        if (collisionT > 1.0 || collisionT < 0.0) {
+    // check against every triangle whose BVH box the ray passes through.
+    // the parity test needs every crossing along the ray, not just within the step.
+    vec3 invDir = vec3(abs(dir.x) > 1e-12 ? 1.0 / dir.x : 1e12,
+                       abs(dir.y) > 1e-12 ? 1.0 / dir.y : 1e12,
+                       abs(dir.z) > 1e-12 ? 1.0 / dir.z : 1e12);
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    if (numBVHNodes > 0) stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        int node = stack[--stackSize];
+        vec4 boxMin = bodyBVH[2 * node];
+        vec4 boxMax = bodyBVH[2 * node + 1];
+        if (!rayHitsBox(pos, invDir, boxMin.xyz, boxMax.xyz)) continue;
+
+        int first = int(boxMin.w);
+        int count = int(boxMax.w);
+        if (count == 0) {
+            stack[stackSize++] = first;
+            stack[stackSize++] = first + 1;
             continue;
         }
-        //use the nearest collision with distance less than 1
-        if (collisionConstraint.w < 0.0 ||
-            collisionT < collisionConstraint.w) {
-            collisionConstraint.xyz = norm;
-            collisionConstraint.w = collisionT;
+
+        for (int i = first; i < first + count; i++) {
+            vec4 triangle = bodyTriangles[i];
+            vec3 v0 = pBody[int(triangle.x)].xyz;
+            vec3 v1 = pBody[int(triangle.y)].xyz;
+            vec3 v2 = pBody[int(triangle.z)].xyz;
+            vec3 norm = normalize(cross(v1 - v0, v2 - v0));
+
+            // b/c intersectTriangle gets us a distance with a normalized dir vector
+            // intersectTriangle = realLength * dirScale
+            // intersectTriangle / dirScale = realLength
+            float collisionT = mollerTrumboreIntersectTriangle(pos, dir, v0, v1, v2);
+            // collision out of bounds
+            if (collisionT > -EPSILON) {
+                numCollisions++;
+            }
+            collisionT /= dirScale;
+            if (collisionT > 1.0 || collisionT < 0.0) {
+                continue;
+            }
+            //use the nearest collision with distance less than 1
+            if (collisionConstraint.w < 0.0 ||
+                collisionT < collisionConstraint.w ||
+                (collisionT == collisionConstraint.w && triangle.w < collisionTriangle)) {
+                collisionConstraint.xyz = norm;
+                collisionConstraint.w = collisionT;
+                collisionTriangle = triangle.w;
+            }
         }
     }
-    debug[idx].xyz = debugPos;
-    debug[idx].w = numCollisions;
+    collisionConstraint.xyz = mat3(bodyToWorld) * collisionConstraint.xyz;
 
     // if the number of collisions is odd
     // and no triangle was crossed in the timestep, <- ? seems logical but leads to odd results
     // generate a static constraint instead.
     if (numCollisions % 2 != 0) {//} && collisionConstraint.w < 0.0) {
-        //pCloth2[idx].xyz = debugPos;//vec3(0.0, 0.0, -numCollisions); // debug
         generateStaticConstraint(pos);
         return;
     }
@@ -0,0 +1,452 @@
+#version 430 core
+#extension GL_ARB_compute_shader: enable
+#extension GL_ARB_shader_storage_buffer_object: enable
+
+// cloth_genCollisions with a list per vertex of the body's triangles within
+// skin of where the list was made. while the vertex and its step stay inside
+// that, only the list gets tested: parity is the parity where the list was
+// made, flipped by every crossing on the way from there. vertices that move
+// too far or too fast walk the BVH like cloth_genCollisions does.
+
+// work group size injected before compilation
+#define WORK_GROUP_SIZE XX
+#define EPSILON 0.0001
+#define BVH_STACK_SIZE 32
+// see bvh.hpp
+#define CANDIDATE_VEC4S 8
+#define CANDIDATE_CAPACITY (4 * (CANDIDATE_VEC4S - 1))
+#define CANDIDATES_COUNT 0xFFFFu
+#define CANDIDATES_INSIDE 0x10000u
+#define CANDIDATES_BUILT 0x20000u
+#define CANDIDATE_REACH 0.95
+
+layout(std430, binding = 0) buffer _pCloth1 { // cloth positions in previous timestep
+    vec4 pCloth1[];
+};
+layout(std430, binding = 1) buffer _pCloth2 { // cloth positions in new timestep
+    vec4 pCloth2[];
+};
+layout(std430, binding = 2) readonly buffer _bodyPositions { // influencee "rigidbody"
+    vec4 pBody[];
+};
+layout(std430, binding = 3) readonly buffer _bodyTriangles {
+    vec4 bodyTriangles[];
+};
+layout(std430, binding = 4) buffer _collisionConstraints { // vec4s of normal dir and distance 
+    vec4 pClothCollisionConstraints[];
+};
+layout(std430, binding = 5) readonly buffer _clothParams { // z: bounce, w: end vertex, see Cloth::uploadParameters
+    vec4 clothParams[];
+};
+layout(std430, binding = 6) readonly buffer _bodyBVH { // flat BVH over bodyTriangles. see bvh.hpp
+    vec4 bodyBVH[]; // two vec4s per node: min + left/first, max + triangle count
+};
+layout(std430, binding = 7) buffer _candidates { // CANDIDATE_VEC4S per cloth vertex, see bvh.hpp
+    vec4 candidates[];
+};
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+layout(location = 0) uniform int numBVHNodes;
+layout(location = 1) uniform int numPositions;
+layout(location = 2) uniform float skin; // how far around where a list was made it reaches
+// the body is queried in its own space (identity when it's animated in world space)
+layout(location = 3) uniform mat4 bodyToWorld;
+layout(location = 4) uniform mat4 worldToBody;
+
+// the cloth vertex v is from: the first one ending past it (see
+// ClothBatch::uploadParameters). a handful of cloths at most, so cheap.
+int clothOf(uint v) {
+    int lo = 0;
+    int hi = clothParams.length() - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (floatBitsToUint(clothParams[mid].w) > v) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+vec3 nearestPointOnTriangle(vec3 P, vec3 A, vec3 B, vec3 C)
+{
+    vec3 v0 = C - A;
+    vec3 v1 = B - A;
+    vec3 N_v2 = normalize(cross(v1, v0));
+
+    // case 1: it's in the triangle
+    // project into triangle plane
+    // (project an arbitrary vector from P to triangle onto the normal)
+    vec3 w = A - P;
+    float signedDistance_invDenom = dot(N_v2, w);
+    vec3 projP = P + signedDistance_invDenom * N_v2;
+
+    // compute u v coordinates
+    // http://www.blackpawn.com/texts/pointinpoly/
+    //u = ((v1.v1)(v2.v0) - (v1.v0)(v2.v1)) / ((v0.v0)(v1.v1) - (v0.v1)(v1.v0))
+    //v = ((v0.v0)(v2.v1) - (v0.v1)(v2.v0)) / ((v0.v0)(v1.v1) - (v0.v1)(v1.v0))
+    N_v2 = projP - A;
+    float dot00_tAB = dot(v0, v0);
+    float dot01_tBC = dot(v0, v1);
+    float dot02_tCA = dot(v0, N_v2);
+    float dot11_minDistance = dot(v1, v1);
+    float dot12_candidate = dot(v1, N_v2);
+
+    signedDistance_invDenom = 1 / (dot00_tAB * dot11_minDistance - dot01_tBC * dot01_tBC);
+    float u_t = (dot11_minDistance * dot02_tCA - dot01_tBC * dot12_candidate) * signedDistance_invDenom;
+    float v = (dot00_tAB * dot12_candidate - dot01_tBC * dot02_tCA) * signedDistance_invDenom;
+
+    // if the u v is in bounds, we can return the projected point
+    if (u_t >= 0.0 && v >= 0.0 && (u_t + v) <= 1.0) {
+      return projP;
+      }
+
+      // case 2: it's on an edge
+      // http://mathworld.wolfram.com/Point-LineDistance3-Dimensional.html
+      // t = - (x1 - x0) dot (x2 - x1) / len(x2 - x1) ^ 2
+      // x1 is the "line origin," x2 is the "towards" point, and x0 is the outlier
+      // check A->B edge
+      dot00_tAB = -dot(A - P, B - A) / pow(length(B - A), 2.0f);
+
+      // check B->C edge
+      dot01_tBC = -dot(B - P, C - B) / pow(length(C - B), 2.0f);
+
+      // check C->A edge
+      dot02_tCA = -dot(C - P, A - C) / pow(length(A - C), 2.0f);
+
+    // handle case 3: point is closest to a vertex
+    dot00_tAB = clamp(dot00_tAB, 0.0f, 1.0f);
+    dot01_tBC = clamp(dot01_tBC, 0.0f, 1.0f);
+    dot02_tCA = clamp(dot02_tCA, 0.0f, 1.0f);
+
+      // assess each edge's distance and parametrics
+    dot11_minDistance = length(cross(P - A, P - B)) / length(B - A);
+    dot12_candidate;
+      v0 = A;
+      v1 = B;
+    u_t = dot00_tAB;
+
+    dot12_candidate = length(cross(P - B, P - C)) / length(B - C);
+    if (dot12_candidate < dot11_minDistance) {
+      dot11_minDistance = dot12_candidate;
+      v0 = B;
+      v1 = C;
+      u_t = dot01_tBC;
+      }
+
+      dot12_candidate = length(cross(P - C, P - A)) / length(C - A);
+    if (dot12_candidate < dot11_minDistance) {
+      dot11_minDistance = dot12_candidate;
+      v0 = C;
+      v1 = A;
+      u_t = dot02_tCA;
+      }
+    return (u_t * (v1 - v0) + v0);
+}
+
+float distanceToBox(vec3 P, vec3 boxMin, vec3 boxMax) {
+    return length(max(max(boxMin - P, 0.0), P - boxMax));
+}
+
+// does the ray orig + t * dir, t >= 0 touch the box?
+bool rayHitsBox(vec3 orig, vec3 invDir, vec3 boxMin, vec3 boxMax) {
+    vec3 t0 = (boxMin - orig) * invDir;
+    vec3 t1 = (boxMax - orig) * invDir;
+    vec3 tNear = min(t0, t1);
+    vec3 tFar = max(t0, t1);
+    float enter = max(max(tNear.x, tNear.y), max(tNear.z, 0.0));
+    float exit = min(min(tFar.x, tFar.y), tFar.z);
+    return enter <= exit;
+}
+
+float mollerTrumboreIntersectTriangle(vec3 orig, vec3 dir, vec3 v0, vec3 v1, vec3 v2)
+{
+    
+    // adapted from Moller-Trumbore intersection algorithm pseudocode on wikipedia
+    vec3 e1, e2; // Edge1, Edge2
+    vec3 P, Q, T;
+    float det, inv_det, u, v;
+    float t;
+    
+    // vectors for edges sharing V1
+    e1 = v1 - v0;
+    e2 = v2 - v0;
+
+    // begin calculating determinant - also used to calculate u param
+    P = cross(dir, e2);
+
+    // if determinant is near zero, ray lies in plane of triangle
+    det = dot(e1, P);
+    // NOT culling
+    if (det > -EPSILON && det < EPSILON) return -1.0;
+    inv_det = 1.0 / det;
+
+    // calculate distance from v0 to ray origin
+    T = orig - v0;
+
+    // calculate u parameter and test bound
+    u = dot(T, P) * inv_det;
+    // the intersection lies outside of the triangle
+    if (u < 0.0 || u > 1.0) return -1.0;
+
+    // prepare to test v parameter
+    Q = cross(T, e1);
+
+    // calculate v param and test bound
+    v = dot(dir, Q) * inv_det;
+
+    // the intersection is outside the triangle?
+    if (v < 0.0 || (u + v) > 1.0) return -1.0;
+
+    t = dot(e2, Q) * inv_det;
+
+    if (t > 0.0) {
+        return t;
+    }
+
+    return -1.0;
+}
+
+// a triangle in leaf order, in body space
+void getTriangle(int i, out vec3 v0, out vec3 v1, out vec3 v2) {
+    vec4 triangle = bodyTriangles[i];
+    v0 = pBody[int(triangle.x)].xyz;
+    v1 = pBody[int(triangle.y)].xyz;
+    v2 = pBody[int(triangle.z)].xyz;
+}
+
+// the nearest triangle so far, ties to the lowest original triangle index
+vec3 nearestPoint;
+float nearestDistance;
+float nearestTriangle;
+int nearestSlot;
+
+void considerNearest(vec3 pos, int i) {
+    vec3 v0, v1, v2;
+    getTriangle(i, v0, v1, v2);
+    vec3 candidatePoint = nearestPointOnTriangle(pos, v0, v1, v2);
+    float candidateDistance = length(candidatePoint - pos);
+    if (candidateDistance < nearestDistance ||
+        (candidateDistance == nearestDistance && bodyTriangles[i].w < nearestTriangle)) {
+        nearestTriangle = bodyTriangles[i].w;
+        nearestDistance = candidateDistance;
+        nearestPoint = candidatePoint;
+        nearestSlot = i;
+    }
+}
+
+void resetNearest(vec3 pos) {
+    nearestPoint = pos;
+    nearestDistance = 1e30;
+    nearestTriangle = 0.0;
+    nearestSlot = -1;
+}
+
+// walk the BVH nearest box first, skipping boxes farther than the best so far
+void nearestOnBody(vec3 pos) {
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    if (numBVHNodes > 0) stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        int node = stack[--stackSize];
+        vec4 boxMin = bodyBVH[2 * node];
+        vec4 boxMax = bodyBVH[2 * node + 1];
+        if (distanceToBox(pos, boxMin.xyz, boxMax.xyz) > nearestDistance) continue;
+
+        int first = int(boxMin.w);
+        int count = int(boxMax.w);
+        if (count == 0) {
+            float leftDistance = distanceToBox(pos, bodyBVH[2 * first].xyz, bodyBVH[2 * first + 1].xyz);
+            float rightDistance = distanceToBox(pos, bodyBVH[2 * first + 2].xyz, bodyBVH[2 * first + 3].xyz);
+            bool leftFirst = leftDistance <= rightDistance;
+            stack[stackSize++] = leftFirst ? first + 1 : first;
+            stack[stackSize++] = leftFirst ? first : first + 1;
+            continue;
+        }
+        for (int i = first; i < first + count; i++) considerNearest(pos, i);
+    }
+}
+
+// static constraint: move the position in the last timestep over to the
+// nearest point, and constrain it along the normal there
+void writeStaticConstraint() {
+    uint idx = gl_GlobalInvocationID.x;
+    float staticConstraintBounce = clothParams[clothOf(idx)].z;
+
+    vec3 nearestNormal = vec3(0.0, 0.0, 1.0);
+    if (nearestSlot >= 0) {
+        vec3 v0, v1, v2;
+        getTriangle(nearestSlot, v0, v1, v2);
+        nearestNormal = normalize(cross(v1 - v0, v2 - v0));
+    }
+
+    // back to world space. bodies only move rigidly, so normals stay unit length
+    vec3 worldPoint = (bodyToWorld * vec4(nearestPoint, 1.0)).xyz;
+    nearestNormal = mat3(bodyToWorld) * nearestNormal;
+
+    pCloth1[idx].xyz = worldPoint + nearestNormal * staticConstraintBounce;
+    pClothCollisionConstraints[idx] = vec4(nearestNormal, 1.0);
+}
+
+// what the step's ray has hit so far: crossings anywhere along it, and the
+// nearest one within the step, ties to the lowest original triangle index
+int numCollisions;
+vec4 collisionConstraint;
+float collisionTriangle;
+
+void considerHit(vec3 pos, vec3 dir, float dirScale, int i) {
+    vec3 v0, v1, v2;
+    getTriangle(i, v0, v1, v2);
+    float collisionT = mollerTrumboreIntersectTriangle(pos, dir, v0, v1, v2);
+    if (collisionT > -EPSILON) {
+        numCollisions++;
+    }
+    collisionT /= dirScale;
+    if (collisionT > 1.0 || collisionT < 0.0) return;
+    if (collisionConstraint.w < 0.0 ||
+        collisionT < collisionConstraint.w ||
+        (collisionT == collisionConstraint.w && bodyTriangles[i].w < collisionTriangle)) {
+        collisionConstraint.xyz = normalize(cross(v1 - v0, v2 - v0));
+        collisionConstraint.w = collisionT;
+        collisionTriangle = bodyTriangles[i].w;
+    }
+}
+
+// every triangle whose BVH box the ray passes through
+void castRay(vec3 pos, vec3 dir, float dirScale) {
+    vec3 invDir = vec3(abs(dir.x) > 1e-12 ? 1.0 / dir.x : 1e12,
+                       abs(dir.y) > 1e-12 ? 1.0 / dir.y : 1e12,
+                       abs(dir.z) > 1e-12 ? 1.0 / dir.z : 1e12);
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    if (numBVHNodes > 0) stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        int node = stack[--stackSize];
+        vec4 boxMin = bodyBVH[2 * node];
+        vec4 boxMax = bodyBVH[2 * node + 1];
+        if (!rayHitsBox(pos, invDir, boxMin.xyz, boxMax.xyz)) continue;
+
+        int first = int(boxMin.w);
+        int count = int(boxMax.w);
+        if (count == 0) {
+            stack[stackSize++] = first;
+            stack[stackSize++] = first + 1;
+            continue;
+        }
+        for (int i = first; i < first + count; i++) considerHit(pos, dir, dirScale, i);
+    }
+}
+
+// every triangle within skin of pos becomes the vertex's list. too many to
+// keep marks the list full, and the vertex walks the BVH until it has moved
+// far enough for another try.
+void buildCandidates(int header, vec3 pos, bool inside) {
+    uint count = 0u;
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    if (numBVHNodes > 0) stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        int node = stack[--stackSize];
+        vec4 boxMin = bodyBVH[2 * node];
+        vec4 boxMax = bodyBVH[2 * node + 1];
+        if (distanceToBox(pos, boxMin.xyz, boxMax.xyz) > skin) continue;
+
+        int first = int(boxMin.w);
+        int numTriangles = int(boxMax.w);
+        if (numTriangles == 0) {
+            stack[stackSize++] = first;
+            stack[stackSize++] = first + 1;
+            continue;
+        }
+        for (int i = first; i < first + numTriangles; i++) {
+            vec3 v0, v1, v2;
+            getTriangle(i, v0, v1, v2);
+            if (!(length(nearestPointOnTriangle(pos, v0, v1, v2) - pos) <= skin)) continue;
+            if (count < CANDIDATE_CAPACITY) {
+                candidates[header + 1 + int(count >> 2)][count & 3u] = uintBitsToFloat(uint(i));
+            }
+            count++;
+        }
+    }
+    uint flags = min(count, uint(CANDIDATE_CAPACITY + 1)) | CANDIDATES_BUILT | (inside ? CANDIDATES_INSIDE : 0u);
+    candidates[header] = vec4(pos, uintBitsToFloat(flags));
+}
+
+int candidate(int header, int k) {
+    return int(floatBitsToUint(candidates[header + 1 + (k >> 2)][k & 3]));
+}
+
+void main() {
+    uint idx = gl_GlobalInvocationID.x;
+    if (idx >= numPositions) return;
+
+    // check if there's already a valid constraint. if so, do nothing
+    if (pClothCollisionConstraints[idx].w >= 0.0) return;
+
+    // also, if this is infinite weighted, do nothing
+    if (pCloth1[idx].w < EPSILON) return;
+
+    // everything up to the constraint itself happens in body space
+    vec3 pos = (worldToBody * vec4(pCloth1[idx].xyz, 1.0)).xyz; // prev timestep
+    vec3 lookAt = (worldToBody * vec4(pCloth2[idx].xyz, 1.0)).xyz; // next timestep
+    float dirScale = length(lookAt - pos);
+    vec3 dir = normalize(lookAt - pos);
+    float reach = skin * CANDIDATE_REACH;
+
+    int header = int(idx) * CANDIDATE_VEC4S;
+    vec4 list = candidates[header];
+    uint flags = floatBitsToUint(list.w);
+    int count = int(flags & CANDIDATES_COUNT);
+    float moved = length(pos - list.xyz);
+    bool near = (flags & CANDIDATES_BUILT) != 0u && moved + dirScale <= reach;
+
+    numCollisions = 0;
+    collisionConstraint = vec4(-1.0);
+    collisionTriangle = 0.0;
+
+    if (!near || count > CANDIDATE_CAPACITY) {
+        castRay(pos, dir, dirScale);
+        bool inside = numCollisions % 2 != 0;
+        // a list around here for the next steps, unless the vertex moves
+        // too fast for one to last
+        if (!near && dirScale < 0.5 * reach) buildCandidates(header, pos, inside);
+        if (inside) {
+            resetNearest(pos);
+            nearestOnBody(pos);
+            writeStaticConstraint();
+            return;
+        }
+        collisionConstraint.xyz = mat3(bodyToWorld) * collisionConstraint.xyz;
+        pClothCollisionConstraints[idx] = collisionConstraint;
+        return;
+    }
+
+    // everything the step can reach is on the list
+    for (int k = 0; k < count; k++) considerHit(pos, dir, dirScale, candidate(header, k));
+
+    // inside or not is what it was where the list was made, flipped by every
+    // crossing on the way from there
+    bool inside = (flags & CANDIDATES_INSIDE) != 0u;
+    if (moved > 0.0) {
+        vec3 path = (pos - list.xyz) / moved;
+        for (int k = 0; k < count; k++) {
+            vec3 v0, v1, v2;
+            getTriangle(candidate(header, k), v0, v1, v2);
+            float t = mollerTrumboreIntersectTriangle(list.xyz, path, v0, v1, v2);
+            if (t > 0.0 && t <= moved) inside = !inside;
+        }
+    }
+    if (!inside) {
+        collisionConstraint.xyz = mat3(bodyToWorld) * collisionConstraint.xyz;
+        pClothCollisionConstraints[idx] = collisionConstraint;
+        return;
+    }
+
+    // the nearest point is on the list too, if it's near enough
+    resetNearest(pos);
+    for (int k = 0; k < count; k++) considerNearest(pos, candidate(header, k));
+    if (nearestDistance > reach - moved) {
+        resetNearest(pos);
+        nearestOnBody(pos);
+    }
+    writeStaticConstraint();
+}
@@ -0,0 +1,169 @@
+#version 430 core
+#extension GL_ARB_compute_shader: enable
+#extension GL_ARB_shader_storage_buffer_object: enable
+
+// work group size injected before compilation
+#define WORK_GROUP_SIZE XX
+#define EPSILON 0.0001
+// see primitive.hpp
+#define PRIMITIVE_PLANE 1
+#define PRIMITIVE_SPHERE 2
+#define PRIMITIVE_CAPSULE 3
+#define PRIMITIVE_BOX 4
+#define PRIMITIVE_HEIGHTFIELD 5
+#define PRIMITIVE_HEADER_VEC4S 6
+#define PRIMITIVE_HOLE -1e30
+
+// collision constraints against an analytic shape in the body's rest space
+// (see primitive.hpp). the same as cloth_genCollisionsSDF with the field
+// lookup swapped for the shape's closed form distance. same outputs as
+// cloth_genCollisions:
+// either a crossing constraint (normal, t) or a static one (normal, 1.0)
+// with the previous position moved out onto the surface.
+
+layout(std430, binding = 0) buffer _pCloth1 { // cloth positions in previous timestep
+    vec4 pCloth1[];
+};
+layout(std430, binding = 1) buffer _pCloth2 { // cloth positions in new timestep
+    vec4 pCloth2[];
+};
+layout(std430, binding = 2) readonly buffer _bodyShape { // Primitive::pack
+    vec4 bodyShape[];
+};
+layout(std430, binding = 4) buffer _collisionConstraints { // vec4s of normal dir and distance
+    vec4 pClothCollisionConstraints[];
+};
+layout(std430, binding = 5) readonly buffer _clothParams { // z: bounce, w: end vertex, see Cloth::uploadParameters
+    vec4 clothParams[];
+};
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+layout(location = 1) uniform int numPositions;
+layout(location = 3) uniform mat4 bodyToWorld;
+layout(location = 4) uniform mat4 worldToBody;
+
+// the cloth vertex v is from: the first one ending past it (see
+// ClothBatch::uploadParameters). a handful of cloths at most, so cheap.
+int clothOf(uint v) {
+    int lo = 0;
+    int hi = clothParams.length() - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (floatBitsToUint(clothParams[mid].w) > v) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+float heightAt(int i) {
+    return bodyShape[PRIMITIVE_HEADER_VEC4S + i / 4][i % 4];
+}
+
+// outward normal and signed distance, negative inside
+vec4 samplePrimitive(vec3 p) {
+    int type = int(bodyShape[0].x);
+    float radius = bodyShape[0].y;
+    vec3 center = bodyShape[1].xyz;
+    vec3 extent = bodyShape[2].xyz;
+
+    if (type == PRIMITIVE_PLANE) {
+        return vec4(extent, dot(p - center, extent));
+    }
+    if (type == PRIMITIVE_SPHERE || type == PRIMITIVE_CAPSULE) {
+        // a sphere is a capsule whose ends meet
+        vec3 nearest = center;
+        if (type == PRIMITIVE_CAPSULE) {
+            vec3 segment = extent - center;
+            float lengthSquared = dot(segment, segment);
+            float t = lengthSquared > 0.0 ? clamp(dot(p - center, segment) / lengthSquared, 0.0, 1.0) : 0.0;
+            nearest = center + segment * t;
+        }
+        vec3 offset = p - nearest;
+        float gap = length(offset);
+        vec3 n = gap > 0.0 ? offset / gap : vec3(0.0, 0.0, 1.0);
+        return vec4(n, gap - radius);
+    }
+    if (type == PRIMITIVE_BOX) {
+        mat3 axes = mat3(bodyShape[3].xyz, bodyShape[4].xyz, bodyShape[5].xyz);
+        vec3 local = transpose(axes) * (p - center);
+        vec3 side = sign(local);
+        vec3 q = abs(local) - extent;
+        float deepest = max(max(q.x, q.y), q.z);
+        if (deepest <= 0.0) {
+            // inside: out through the nearest face
+            int face = q.x == deepest ? 0 : (q.y == deepest ? 1 : 2);
+            vec3 n = vec3(0.0);
+            n[face] = side[face] != 0.0 ? side[face] : 1.0;
+            return vec4(axes * n, deepest);
+        }
+        vec3 outside = max(q, vec3(0.0));
+        float gap = length(outside);
+        return vec4(axes * (side * outside / gap), gap);
+    }
+    if (type == PRIMITIVE_HEIGHTFIELD) {
+        ivec2 dims = ivec2(bodyShape[0].zw);
+        vec2 g = (p.xy - center.xy) / extent.xy;
+        if (any(lessThan(g, vec2(0.0))) || any(greaterThanEqual(g, vec2(dims) - 1.0))) {
+            return vec4(0.0, 0.0, 0.0, 1e30);
+        }
+        ivec2 c = ivec2(g);
+        vec2 f = g - vec2(c);
+        int i = c.y * dims.x + c.x;
+        float h00 = heightAt(i);
+        float h10 = heightAt(i + 1);
+        float h01 = heightAt(i + dims.x);
+        float h11 = heightAt(i + dims.x + 1);
+        if (min(min(h00, h10), min(h01, h11)) <= PRIMITIVE_HOLE) {
+            return vec4(0.0, 0.0, 0.0, 1e30);
+        }
+        // the cell's two triangles, split from (0, 0) to (1, 1)
+        vec2 slope = f.x >= f.y ? vec2(h10 - h00, h11 - h10) : vec2(h11 - h01, h01 - h00);
+        float height = h00 + slope.x * f.x + slope.y * f.y;
+        vec3 n = normalize(vec3(-slope / extent.xy, 1.0));
+        return vec4(n, (p.z - height) * n.z);
+    }
+    return vec4(0.0, 0.0, 0.0, 1e30);
+}
+
+void main() {
+    uint idx = gl_GlobalInvocationID.x;
+    if (idx >= numPositions) return;
+
+    // check if there's already a valid constraint. if so, do nothing
+    if (pClothCollisionConstraints[idx].w >= 0.0) return;
+
+    // also, if this is infinite weighted, do nothing
+    if (pCloth1[idx].w < EPSILON) return;
+
+    vec3 pos = (worldToBody * vec4(pCloth1[idx].xyz, 1.0)).xyz; // prev timestep
+    vec3 lookAt = (worldToBody * vec4(pCloth2[idx].xyz, 1.0)).xyz; // next timestep
+
+    vec4 sampleNew = samplePrimitive(lookAt);
+    if (sampleNew.w >= 0.0) return; // ends up outside, nothing to do
+
+    vec3 n = sampleNew.xyz;
+    vec3 worldNormal = mat3(bodyToWorld) * n;
+    vec4 sampleOld = samplePrimitive(pos);
+    float approach = dot(lookAt - pos, n);
+
+    // came in from outside during this step: crossing constraint.
+    // t puts the intersection where projectCollisions pushes lookAt by -distance
+    if (sampleOld.w >= 0.0 && approach < -EPSILON) {
+        float t = clamp(1.0 - sampleNew.w / approach, 0.0, 1.0);
+        pClothCollisionConstraints[idx] = vec4(worldNormal, t);
+        return;
+    }
+
+    // already inside: static constraint from the nearest surface point
+    vec4 inside = sampleOld.w < 0.0 ? sampleOld : sampleNew;
+    vec3 insidePos = sampleOld.w < 0.0 ? pos : lookAt;
+    if (sampleOld.w < 0.0) {
+        n = sampleOld.xyz;
+        worldNormal = mat3(bodyToWorld) * n;
+    }
+    float staticConstraintBounce = clothParams[clothOf(idx)].z;
+    vec3 nearestPoint = (bodyToWorld * vec4(insidePos - n * inside.w, 1.0)).xyz;
+    pCloth1[idx].xyz = nearestPoint + worldNormal * staticConstraintBounce;
+    pClothCollisionConstraints[idx] = vec4(worldNormal, 1.0);
+}
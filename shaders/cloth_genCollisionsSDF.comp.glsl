@@ -0,0 +1,110 @@
+#version 430 core
+#extension GL_ARB_compute_shader: enable
+#extension GL_ARB_shader_storage_buffer_object: enable
+
+// work group size injected before compilation
+#define WORK_GROUP_SIZE XX
+#define EPSILON 0.0001
+
+// collision constraints against a signed distance field baked around the
+// body's rest pose (see sdf.hpp). same outputs as cloth_genCollisions:
+// either a crossing constraint (normal, t) or a static one (normal, 1.0)
+// with the previous position moved out onto the surface.
+
+layout(std430, binding = 0) buffer _pCloth1 { // cloth positions in previous timestep
+    vec4 pCloth1[];
+};
+layout(std430, binding = 1) buffer _pCloth2 { // cloth positions in new timestep
+    vec4 pCloth2[];
+};
+layout(std430, binding = 2) readonly buffer _bodySDF { // (gradient, signed distance), x fastest
+    vec4 bodySDF[];
+};
+layout(std430, binding = 4) buffer _collisionConstraints { // vec4s of normal dir and distance
+    vec4 pClothCollisionConstraints[];
+};
+layout(std430, binding = 5) readonly buffer _clothParams { // z: bounce, w: end vertex, see Cloth::uploadParameters
+    vec4 clothParams[];
+};
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+layout(location = 1) uniform int numPositions;
+layout(location = 3) uniform mat4 bodyToWorld;
+layout(location = 4) uniform mat4 worldToBody;
+layout(location = 5) uniform vec3 sdfOrigin;
+layout(location = 6) uniform vec3 sdfCellSize;
+layout(location = 7) uniform vec3 sdfDims; // samples per axis
+
+// the cloth vertex v is from: the first one ending past it (see
+// ClothBatch::uploadParameters). a handful of cloths at most, so cheap.
+int clothOf(uint v) {
+    int lo = 0;
+    int hi = clothParams.length() - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (floatBitsToUint(clothParams[mid].w) > v) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+// trilinear lookup. anything off the grid is far outside the body.
+vec4 sampleSDF(vec3 p) {
+    vec3 g = (p - sdfOrigin) / sdfCellSize;
+    if (any(lessThan(g, vec3(0.0))) || any(greaterThanEqual(g, sdfDims - 1.0))) {
+        return vec4(0.0, 0.0, 0.0, 1e30);
+    }
+    ivec3 c = ivec3(g);
+    vec3 f = g - vec3(c);
+    int dy = int(sdfDims.x);
+    int dz = int(sdfDims.x) * int(sdfDims.y);
+    int i = c.z * dz + c.y * dy + c.x;
+    vec4 x00 = mix(bodySDF[i], bodySDF[i + 1], f.x);
+    vec4 x10 = mix(bodySDF[i + dy], bodySDF[i + dy + 1], f.x);
+    vec4 x01 = mix(bodySDF[i + dz], bodySDF[i + dz + 1], f.x);
+    vec4 x11 = mix(bodySDF[i + dz + dy], bodySDF[i + dz + dy + 1], f.x);
+    return mix(mix(x00, x10, f.y), mix(x01, x11, f.y), f.z);
+}
+
+void main() {
+    uint idx = gl_GlobalInvocationID.x;
+    if (idx >= numPositions) return;
+
+    // check if there's already a valid constraint. if so, do nothing
+    if (pClothCollisionConstraints[idx].w >= 0.0) return;
+
+    // also, if this is infinite weighted, do nothing
+    if (pCloth1[idx].w < EPSILON) return;
+
+    vec3 pos = (worldToBody * vec4(pCloth1[idx].xyz, 1.0)).xyz; // prev timestep
+    vec3 lookAt = (worldToBody * vec4(pCloth2[idx].xyz, 1.0)).xyz; // next timestep
+
+    vec4 sampleNew = sampleSDF(lookAt);
+    if (sampleNew.w >= 0.0) return; // ends up outside, nothing to do
+
+    vec3 n = sampleNew.xyz;
+    vec3 worldNormal = mat3(bodyToWorld) * n;
+    vec4 sampleOld = sampleSDF(pos);
+    float approach = dot(lookAt - pos, n);
+
+    // came in from outside during this step: crossing constraint.
+    // t puts the intersection where projectCollisions pushes lookAt by -distance
+    if (sampleOld.w >= 0.0 && approach < -EPSILON) {
+        float t = clamp(1.0 - sampleNew.w / approach, 0.0, 1.0);
+        pClothCollisionConstraints[idx] = vec4(worldNormal, t);
+        return;
+    }
+
+    // already inside: static constraint from the nearest surface point
+    vec4 inside = sampleOld.w < 0.0 ? sampleOld : sampleNew;
+    vec3 insidePos = sampleOld.w < 0.0 ? pos : lookAt;
+    if (sampleOld.w < 0.0) {
+        n = sampleOld.xyz;
+        worldNormal = mat3(bodyToWorld) * n;
+    }
+    float staticConstraintBounce = clothParams[clothOf(idx)].z;
+    vec3 nearestPoint = (bodyToWorld * vec4(insidePos - n * inside.w, 1.0)).xyz;
+    pCloth1[idx].xyz = nearestPoint + worldNormal * staticConstraintBounce;
+    pClothCollisionConstraints[idx] = vec4(worldNormal, 1.0);
+}
@@ -0,0 +1,44 @@
+#version 430 core
+#extension GL_ARB_compute_shader: enable
+#extension GL_ARB_shader_storage_buffer_object: enable
+
+// cloth_pbd1_externalForces, cloth_pbd2_dampVelocities and
+// cloth_pbd3_predictPositions in one pass: each velocity is read and
+// written once instead of three reads and two writes.
+
+// work group size injected before compilation
+#define WORK_GROUP_SIZE XX
+
+layout(std430, binding = 0) buffer _Vel {
+    vec4 Vel[];
+};
+layout(std430, binding = 1) readonly buffer _Pos {
+    vec4 Pos[];
+};
+layout(std430, binding = 2) buffer _pPos1 { // predicted position
+    vec4 pPos1[];
+};
+layout(std430, binding = 3) buffer _pPos2 { // predicted position
+    vec4 pPos2[];
+};
+
+layout(location = 0) uniform float DT;
+layout(location = 1) uniform vec3 F; // acceleration due to gravity
+layout(location = 2) uniform int numVertices;
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+void main() {
+    uint idx = gl_GlobalInvocationID.x;
+    if (idx >= numVertices) return;
+
+    vec4 vel0 = Vel[idx];
+    vel0.xyz += F * DT;
+    vel0.xyz *= 0.95;
+    Vel[idx] = vel0;
+
+    vec4 vertexData = Pos[idx];
+    vec3 prediction = vertexData.xyz + vel0.xyz * DT;
+    pPos1[idx] = vec4(prediction, vertexData.w);
+    pPos2[idx] = vec4(prediction, vertexData.w);
+}
@@ -0,0 +1,43 @@
+#version 430 core
+#extension GL_ARB_compute_shader: enable
+#extension GL_ARB_shader_storage_buffer_object: enable
+
+// work group size injected before compilation
+#define WORK_GROUP_SIZE XX
+
+// once per frame, look up where the pins to one SSBO want their vertices to
+// be. the pins are grouped by SSBO (see Cloth::uploadExternalConstraints),
+// so this only runs over that SSBO's range.
+// pin targets are vec4s: target position, index of the pinned vertex as
+// uint bits. an index of ~0 marks a target not gathered yet.
+
+layout(std430, binding = 0) readonly buffer _influencerPos { // positions of the pinned SSBO
+    vec4 pInfluencer[];
+};
+struct Pin { // Cloth's PinConstraint
+    uint vertex;
+    uint influencer;
+};
+
+layout(std430, binding = 1) readonly buffer _Pins {
+    Pin pins[];
+};
+layout(std430, binding = 2) writeonly buffer _PinTargets {
+    vec4 pinTargets[];
+};
+
+layout(location = 0) uniform int firstPin;
+layout(location = 1) uniform int numPins;
+layout(location = 2) uniform mat4 influencerTransform; // for pins to bodies kept in local space
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+void main() {
+    uint idx = gl_GlobalInvocationID.x;
+    if (idx >= numPins) return;
+
+    int pinIdx = firstPin + int(idx);
+    Pin pin = pins[pinIdx];
+    vec4 influencer = pInfluencer[pin.influencer];
+    pinTargets[pinIdx] = vec4((influencerTransform * vec4(influencer.xyz, 1.0)).xyz, uintBitsToFloat(pin.vertex));
+}
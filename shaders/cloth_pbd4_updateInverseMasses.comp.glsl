@@ -11,8 +11,13 @@ layout(std430, binding = 0) buffer _pPos1 { // predicted position
 layout(std430, binding = 1) buffer _pPos2 { // predicted position
     vec4 pPos2[];
 };
-layout(std430, binding = 2) readonly buffer _Constraints {
-    vec4 constraints[];
+struct Pin { // Cloth's PinConstraint
+    uint vertex;
+    uint influencer;
+};
+
+layout(std430, binding = 2) readonly buffer _Constraints { // every one of them a pin
+    Pin constraints[];
 };
 
 layout(location = 0) uniform int numConstraints;
@@ -22,12 +27,8 @@ layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
 void main() {
     uint idx = gl_GlobalInvocationID.x;
     if (idx >= numConstraints) return;
-    // compute force contribution from this constraint
-    vec4 constraint = constraints[idx];    
-    highp int targetIdx = int(constraint.x); // index of "target" -> the position to be modified
-
-    if (constraint.z < 0.0) { // this position will be pinned
-        pPos1[targetIdx].w = 0.0;
-        pPos2[targetIdx].w = 0.0;
-    }
+    // this position will be pinned
+    uint targetIdx = constraints[idx].vertex;
+    pPos1[targetIdx].w = 0.0;
+    pPos2[targetIdx].w = 0.0;
 }
@@ -1,8 +1,9 @@
-// cloth constraints are vec4s as follows:
-// x: index of position to be projected onto
-// y: index of position influencing x
-// z: rest length. a rest length of -1 indicates a pin constraint.
-// w: SSBO_ID of influencer
+// cloth constraints are Cloth's EdgeConstraint:
+// a: index of position to be projected onto
+// b: index of position influencing a
+// restLength
+// every constraint in a buffer reads the influencer SSBO bound for the dispatch.
+// pins are moved by cloth_pbd5_projectPins, not here.
 
 
 #version 430 core
@@ -18,8 +19,14 @@ layout(std430, binding = 0) readonly buffer _influencerPos { // influencer
 layout(std430, binding = 1) buffer _modifyPos { // influencee
     vec4 pModify[];
 };
+struct Edge {
+    uint a;
+    uint b;
+    float restLength;
+};
+
 layout(std430, binding = 2) readonly buffer _Constraints {
-    vec4 Constraints[];
+    Edge Constraints[];
 };
 
 // spring constant
@@ -29,8 +36,6 @@ layout(location = 1) uniform int numConstraints;
 
 layout(location = 2) uniform float K; // PBD spring constant
 
-layout(location = 3) uniform int SSBO_ID; // the ID of the SSBO providing pModify
-
 layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
 
 void main() {
@@ -41,16 +46,10 @@ void main() {
     if (idx >= numConstraints) return;
 
     // compute force contribution from this constraint
-    vec4 constraint = Constraints[idx];
+    Edge constraint = Constraints[idx];
     
-    highp int targetIdx = int(constraint.x); // index of "target" -> the position to be modified
-    highp int influenceIdx = int(constraint.y); // index of "influencer" -> the particle doing the pulling
-    highp int constraintSSBO = int(constraint.w); // ID of the ssbo this constraint is intended for
-    if (constraintSSBO != SSBO_ID) return; // do not evaluate, this is not the right SSBO
-
-    if (constraint.x < 0.0 || constraint.y < 0.0) { // bogus influence
-        return;
-    }
+    uint targetIdx = constraint.a; // index of "target" -> the position to be modified
+    uint influenceIdx = constraint.b; // index of "influencer" -> the particle doing the pulling
 
     // "prefetch?"
     vec4 target = pModify[targetIdx];
@@ -58,16 +57,11 @@ void main() {
 
     vec4 influencer = pInfluencer[influenceIdx];
 
-    if (constraint.z < 0.0) { // case of a stationary pin
-        pModify[targetIdx].xyz = influencer.xyz;
-        return;
-    }
-
     vec3 diff = influencer.xyz - target.xyz;
     float dist = length(diff);
     float w = target.w / (influencer.w + target.w);
 
-    vec3 dp1 = w * (dist - constraint.z) * diff / dist; // force is towards influencer
+    vec3 dp1 = w * (dist - constraint.restLength) * diff / dist; // force is towards influencer
 
     pModify[targetIdx].xyz += k_prime * dp1;
 
@@ -0,0 +1,83 @@
+// gather version of cloth_pbd5_projectClothConstraints: one thread per vertex
+// walks all of that vertex's internal constraints (see Cloth::constraintRows).
+// only this thread writes its vertex, so one dispatch covers every constraint.
+// every vertex is read from pInfluencer and fully rewritten in pModify, so the
+// two buffers can just trade places between iterations (no copy back).
+// rows and neighbors are Cloth's ConstraintRow and ConstraintNeighbor, 8 bytes each
+
+#version 430 core
+#extension GL_ARB_compute_shader: enable
+#extension GL_ARB_shader_storage_buffer_object: enable
+
+// work group size injected before compilation
+#define WORK_GROUP_SIZE XX
+
+layout(std430, binding = 0) readonly buffer _influencerPos { // influencer
+    vec4 pInfluencer[];
+};
+layout(std430, binding = 1) buffer _modifyPos { // influencee
+    vec4 pModify[];
+};
+struct Row {
+    uint first;
+    uint count;
+};
+struct Neighbor {
+    uint index; // influencer
+    float restLength;
+};
+
+layout(std430, binding = 2) readonly buffer _Rows {
+    Row Rows[];
+};
+layout(std430, binding = 3) readonly buffer _Neighbors {
+    Neighbor Neighbors[];
+};
+layout(std430, binding = 4) readonly buffer _clothParams { // x: K, w: end vertex, see Cloth::uploadParameters
+    vec4 clothParams[];
+};
+
+layout(location = 0) uniform float N; // number of times to project
+
+layout(location = 1) uniform int numVertices;
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// the cloth vertex v is from: the first one ending past it (see
+// ClothBatch::uploadParameters). a handful of cloths at most, so cheap.
+int clothOf(uint v) {
+    int lo = 0;
+    int hi = clothParams.length() - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (floatBitsToUint(clothParams[mid].w) > v) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+void main() {
+    uint idx = gl_GlobalInvocationID.x;
+    if (idx >= numVertices) return;
+
+    Row row = Rows[idx];
+
+    vec4 target = pInfluencer[idx];
+    float K = clothParams[clothOf(idx)].x; // PBD spring constant
+    float k_prime = 1.0 - pow(1.0 - K, 1.0 / N);
+
+    // same math as the buffered version, one constraint after the other
+    for (uint i = row.first; i < row.first + row.count; i++) {
+        Neighbor neighbor = Neighbors[i];
+        vec4 influencer = pInfluencer[neighbor.index];
+
+        vec3 diff = influencer.xyz - target.xyz;
+        float dist = length(diff);
+        float w = target.w / (influencer.w + target.w);
+
+        vec3 dp1 = w * (dist - neighbor.restLength) * diff / dist; // force is towards influencer
+        target.xyz += k_prime * dp1;
+    }
+
+    pModify[idx] = target;
+}
@@ -0,0 +1,73 @@
+// in place version of cloth_pbd5_projectClothConstraints for one color of
+// edges (see Cloth::colorConstraints). no two edges in a color share a
+// vertex, so each thread can move both ends of its edge without races, and
+// later colors already see the corrections of earlier ones.
+// constraints are Cloth's EdgeConstraint: vertex a, vertex b, rest length
+
+#version 430 core
+#extension GL_ARB_compute_shader: enable
+#extension GL_ARB_shader_storage_buffer_object: enable
+
+// work group size injected before compilation
+#define WORK_GROUP_SIZE XX
+
+layout(std430, binding = 1) buffer _modifyPos {
+    vec4 pModify[];
+};
+struct Edge {
+    uint a;
+    uint b;
+    float restLength;
+};
+
+layout(std430, binding = 2) readonly buffer _Constraints {
+    Edge Constraints[];
+};
+layout(std430, binding = 4) readonly buffer _clothParams { // x: K, w: end vertex, see Cloth::uploadParameters
+    vec4 clothParams[];
+};
+
+layout(location = 0) uniform float N; // number of times to project
+
+layout(location = 1) uniform int numConstraints; // in this color
+
+layout(location = 3) uniform int firstConstraint; // where this color starts
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// the cloth vertex v is from: the first one ending past it (see
+// ClothBatch::uploadParameters). a handful of cloths at most, so cheap.
+int clothOf(uint v) {
+    int lo = 0;
+    int hi = clothParams.length() - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (floatBitsToUint(clothParams[mid].w) > v) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+void main() {
+    uint idx = gl_GlobalInvocationID.x;
+    if (idx >= numConstraints) return;
+
+    Edge constraint = Constraints[firstConstraint + idx];
+    uint a = constraint.a;
+    uint b = constraint.b;
+    vec4 pA = pModify[a];
+    vec4 pB = pModify[b];
+
+    float wSum = pA.w + pB.w;
+    if (wSum <= 0.0) return; // both pinned
+
+    vec3 diff = pB.xyz - pA.xyz;
+    float dist = length(diff);
+    if (dist <= 0.0) return;
+
+    float K = clothParams[clothOf(a)].x; // PBD spring constant
+    float k_prime = 1.0 - pow(1.0 - K, 1.0 / N);
+    vec3 correction = k_prime * (dist - constraint.restLength) / wSum * diff / dist;
+    pModify[a].xyz = pA.xyz + pA.w * correction;
+    pModify[b].xyz = pB.xyz - pB.w * correction;
+}
@@ -0,0 +1,29 @@
+#version 430 core
+#extension GL_ARB_compute_shader: enable
+#extension GL_ARB_shader_storage_buffer_object: enable
+
+// work group size injected before compilation
+#define WORK_GROUP_SIZE XX
+
+// move every pinned vertex onto the target gathered for it this frame
+
+layout(std430, binding = 1) buffer _modifyPos {
+    vec4 pModify[];
+};
+layout(std430, binding = 2) readonly buffer _PinTargets { // target position, index of pinned vertex (uint bits)
+    vec4 pinTargets[];
+};
+
+layout(location = 0) uniform int numPins;
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+void main() {
+    uint idx = gl_GlobalInvocationID.x;
+    if (idx >= numPins) return;
+
+    vec4 pin = pinTargets[idx];
+    uint vertex = floatBitsToUint(pin.w);
+    if (vertex == 0xFFFFFFFFu) return; // not gathered
+    pModify[vertex].xyz = pin.xyz;
+}
@@ -0,0 +1,36 @@
+#version 430 core
+#extension GL_ARB_compute_shader: enable
+#extension GL_ARB_shader_storage_buffer_object: enable
+
+// work group size injected before compilation
+#define WORK_GROUP_SIZE XX
+
+// rigidbodies only move rigidly, so every node can be refit on its own:
+// the world space box is the bound of the transformed rest space box.
+// no bottom-up pass needed, at the cost of slightly looser boxes when rotated.
+
+layout(std430, binding = 0) readonly buffer _restNodes { // BVH around initial positions
+    vec4 restNodes[];
+};
+layout(std430, binding = 1) buffer _nodes { // BVH around animated positions
+    vec4 nodes[];
+};
+
+layout(location = 0) uniform int numNodes;
+layout(location = 1) uniform mat4 modelMatrix;
+
+layout(local_size_x = WORK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+void main() {
+    uint idx = gl_GlobalInvocationID.x;
+    if (idx >= numNodes) return;
+    vec4 restMin = restNodes[2 * idx];
+    vec4 restMax = restNodes[2 * idx + 1];
+
+    vec3 center = (modelMatrix * vec4((restMin.xyz + restMax.xyz) * 0.5, 1.0)).xyz;
+    mat3 absRotation = mat3(abs(modelMatrix[0].xyz), abs(modelMatrix[1].xyz), abs(modelMatrix[2].xyz));
+    vec3 extent = absRotation * ((restMax.xyz - restMin.xyz) * 0.5);
+
+    nodes[2 * idx] = vec4(center - extent, restMin.w);
+    nodes[2 * idx + 1] = vec4(center + extent, restMax.w);
+}
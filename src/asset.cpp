@@ -0,0 +1,230 @@
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+#include "asset.hpp"
+#include "cloth.hpp"
+#include "rbody.hpp"
+#include "tracer.hpp"
+
+struct AssetHeader {
+	char magic[4];
+	int version;
+	int numInternalConstraintBuffers;
+	int bvhMaxLeafTriangles;
+	int bvhDepth;
+	int numSections;
+	long long sourceSize;
+	unsigned long long sourceHash;
+};
+
+struct AssetSectionEntry {
+	int type;
+	int elementSize;
+	long long count;
+	long long offset;
+};
+
+static const int sectionElementSizes[NUM_ASSET_SECTIONS] = {
+	sizeof(glm::vec4), sizeof(glm::ivec4), sizeof(int), sizeof(glm::ivec3), sizeof(int),
+	sizeof(EdgeConstraint), sizeof(int), sizeof(ConstraintRow), sizeof(ConstraintNeighbor), sizeof(EdgeConstraint), sizeof(int),
+	sizeof(glm::vec4), sizeof(int), sizeof(glm::vec4)
+};
+
+MeshAsset::MeshAsset(const std::string &path) : file(path) {
+	TRACE_ZONE("open asset");
+	if (!file.isOpen()) {
+		std::cout << "could not open " << path << std::endl;
+		return;
+	}
+	AssetHeader header;
+	if (file.size < sizeof(AssetHeader)) {
+		std::cout << path << " is not a mesh asset" << std::endl;
+		return;
+	}
+	memcpy(&header, file.data, sizeof(AssetHeader));
+	if (memcmp(header.magic, "MESH", 4) != 0) {
+		std::cout << path << " is not a mesh asset" << std::endl;
+		return;
+	}
+	if (header.version != ASSET_FILE_VERSION || header.numInternalConstraintBuffers != NUM_INT_CON_BUFFERS ||
+		header.bvhMaxLeafTriangles != BVH_MAX_LEAF_TRIANGLES) {
+		std::cout << path << " was built by a different version or with different settings, convert it again" << std::endl;
+		return;
+	}
+	size_t tableEnd = sizeof(AssetHeader) + (size_t)header.numSections * sizeof(AssetSectionEntry);
+	if (header.numSections < 0 || header.numSections > NUM_ASSET_SECTIONS || tableEnd > file.size) {
+		std::cout << path << " is truncated" << std::endl;
+		return;
+	}
+
+	const AssetSectionEntry *entries = (const AssetSectionEntry *)(file.data + sizeof(AssetHeader));
+	for (int i = 0; i < header.numSections; i++) {
+		AssetSectionEntry entry;
+		memcpy(&entry, &entries[i], sizeof(AssetSectionEntry));
+		if (entry.type < 0 || entry.type >= NUM_ASSET_SECTIONS || entry.elementSize != sectionElementSizes[entry.type] ||
+			entry.count < 0 || entry.offset < (long long)tableEnd || entry.offset % ASSET_ALIGNMENT != 0 ||
+			entry.count > ((long long)file.size - entry.offset) / entry.elementSize) {
+			std::cout << path << " has a bad section table" << std::endl;
+			return;
+		}
+		sections[entry.type].count = entry.count;
+		sections[entry.type].offset = entry.offset;
+	}
+
+	// the rest of the loading code trusts these to line up
+	bool cloth = has(ASSET_CONSTRAINT_ROWS);
+	bool collider = has(ASSET_BVH_NODES);
+	if (!has(ASSET_POSITIONS) || !has(ASSET_TRIS) ||
+		(count(ASSET_VERTEX_ORDER) != 0 && count(ASSET_VERTEX_ORDER) != count(ASSET_POSITIONS)) ||
+		(cloth && (count(ASSET_CONSTRAINT_ROWS) != count(ASSET_POSITIONS) ||
+		!has(ASSET_INTERNAL_CONSTRAINTS) || count(ASSET_INTERNAL_CONSTRAINT_OFFSETS) != NUM_INT_CON_BUFFERS + 1 ||
+		!has(ASSET_CONSTRAINT_NEIGHBORS) || !has(ASSET_COLORED_CONSTRAINTS) || count(ASSET_COLOR_OFFSETS) < 1)) ||
+		(collider && (count(ASSET_BVH_TRIANGLE_ORDER) * 3 != count(ASSET_TRIS) ||
+		count(ASSET_TRIANGLES) * 3 != count(ASSET_TRIS)))) {
+		std::cout << path << " is missing sections" << std::endl;
+		return;
+	}
+	if (cloth && (!offsetsValid(ASSET_INTERNAL_CONSTRAINT_OFFSETS, ASSET_INTERNAL_CONSTRAINTS) ||
+		!offsetsValid(ASSET_COLOR_OFFSETS, ASSET_COLORED_CONSTRAINTS))) {
+		std::cout << path << " has bad constraint offsets" << std::endl;
+		return;
+	}
+	bvhDepth = header.bvhDepth;
+	sourceSize = header.sourceSize;
+	sourceHash = header.sourceHash;
+	ok = true;
+}
+
+// offsets into another section have to start at 0, never go down and end at its size
+bool MeshAsset::offsetsValid(int offsetSection, int section) const {
+	const int *offsets = (const int *)data(offsetSection);
+	int numOffsets = count(offsetSection);
+	if (offsets[0] != 0 || offsets[numOffsets - 1] != count(section)) return false;
+	for (int i = 1; i < numOffsets; i++) {
+		if (offsets[i] < offsets[i - 1]) return false;
+	}
+	return true;
+}
+
+bool MeshAsset::isAsset(const std::string &filename) {
+	size_t length = strlen(ASSET_EXTENSION);
+	return filename.size() > length && filename.compare(filename.size() - length, length, ASSET_EXTENSION) == 0;
+}
+
+std::string MeshAsset::pathFor(const std::string &objFilename) {
+	size_t dot = objFilename.find_last_of('.');
+	size_t slash = objFilename.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return objFilename + ASSET_EXTENSION;
+	return objFilename.substr(0, dot) + ASSET_EXTENSION;
+}
+
+long long MeshAsset::fileSize(const std::string &path) {
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0) return -1;
+	return (long long)info.st_size;
+}
+
+unsigned long long MeshAsset::hashFile(const std::string &path) {
+	MappedFile source(path);
+	if (!source.isOpen()) return 0;
+	const unsigned char *bytes = (const unsigned char *)source.data;
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < source.size; i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+// the sections to write, in file order
+struct AssetOutput {
+	std::vector<AssetSectionEntry> entries;
+	std::vector<const void *> data;
+
+	void add(int type, const void *bytes, size_t count) {
+		AssetSectionEntry entry;
+		entry.type = type;
+		entry.elementSize = sectionElementSizes[type];
+		entry.count = count;
+		entry.offset = 0;
+		entries.push_back(entry);
+		data.push_back(bytes);
+	}
+	template<typename T> void add(int type, const std::vector<T> &values) {
+		add(type, values.empty() ? NULL : &values[0], values.size());
+	}
+};
+
+bool MeshAsset::write(const std::string &path, const Cloth *cloth, const Rbody *rbody, const std::string &sourcePath) {
+	const Mesh *mesh = cloth ? (const Mesh *)cloth : (const Mesh *)rbody;
+	if (mesh == NULL) return false;
+
+	// the cloth's positions carry its inverse mass in w
+	std::vector<glm::vec4> positions = mesh->initPositions;
+	for (int i = 0; i < (int)positions.size(); i++) {
+		positions[i].w = 1.0f;
+	}
+
+	AssetOutput output;
+	output.add(ASSET_POSITIONS, positions);
+	output.add(ASSET_QUADS, mesh->indicesQuads);
+	output.add(ASSET_TRIS, mesh->indicesTris);
+	output.add(ASSET_POLYGON_TRIS, mesh->indicesPolygonTris);
+	output.add(ASSET_VERTEX_ORDER, mesh->fileOrder);
+
+	std::vector<EdgeConstraint> internalConstraints;
+	std::vector<int> internalOffsets;
+	if (cloth) {
+		internalOffsets.push_back(0);
+		for (int i = 0; i < NUM_INT_CON_BUFFERS; i++) {
+			internalConstraints.insert(internalConstraints.end(), cloth->internalConstraints[i].begin(),
+				cloth->internalConstraints[i].end());
+			internalOffsets.push_back(internalConstraints.size());
+		}
+		output.add(ASSET_INTERNAL_CONSTRAINTS, internalConstraints);
+		output.add(ASSET_INTERNAL_CONSTRAINT_OFFSETS, internalOffsets);
+		output.add(ASSET_CONSTRAINT_ROWS, cloth->constraintRows);
+		output.add(ASSET_CONSTRAINT_NEIGHBORS, cloth->constraintNeighbors);
+		output.add(ASSET_COLORED_CONSTRAINTS, cloth->coloredConstraints);
+		output.add(ASSET_COLOR_OFFSETS, cloth->colorOffsets);
+	}
+
+	std::vector<glm::vec4> triangles;
+	if (rbody) {
+		rbody->leafTriangles(triangles);
+		output.add(ASSET_BVH_NODES, rbody->bvh.nodes);
+		output.add(ASSET_BVH_TRIANGLE_ORDER, rbody->bvh.triangleOrder);
+		output.add(ASSET_TRIANGLES, triangles);
+	}
+
+	int numSections = output.entries.size();
+	long long offset = sizeof(AssetHeader) + numSections * sizeof(AssetSectionEntry);
+	for (int i = 0; i < numSections; i++) {
+		offset = (offset + ASSET_ALIGNMENT - 1) / ASSET_ALIGNMENT * ASSET_ALIGNMENT;
+		output.entries[i].offset = offset;
+		offset += output.entries[i].count * output.entries[i].elementSize;
+	}
+
+	std::ofstream out(path.c_str(), std::ios::binary);
+	if (!out.is_open()) return false;
+	AssetHeader header;
+	memcpy(header.magic, "MESH", 4);
+	header.version = ASSET_FILE_VERSION;
+	header.numInternalConstraintBuffers = NUM_INT_CON_BUFFERS;
+	header.bvhMaxLeafTriangles = BVH_MAX_LEAF_TRIANGLES;
+	header.bvhDepth = rbody ? rbody->bvh.depth : 0;
+	header.numSections = numSections;
+	header.sourceSize = fileSize(sourcePath);
+	header.sourceHash = hashFile(sourcePath);
+	out.write((const char *)&header, sizeof(AssetHeader));
+	out.write((const char *)&output.entries[0], numSections * sizeof(AssetSectionEntry));
+
+	const char padding[ASSET_ALIGNMENT] = { 0 };
+	long long written = sizeof(AssetHeader) + numSections * sizeof(AssetSectionEntry);
+	for (int i = 0; i < numSections; i++) {
+		out.write(padding, output.entries[i].offset - written);
+		long long bytes = output.entries[i].count * output.entries[i].elementSize;
+		if (bytes > 0) out.write((const char *)output.data[i], bytes);
+		written = output.entries[i].offset + bytes;
+	}
+	return (bool)out;
+}
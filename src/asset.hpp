@@ -0,0 +1,96 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstring>
+#include <glm/glm.hpp>
+#include "mappedFile.hpp"
+
+// precompiled mesh: the obj's geometry plus everything Cloth and Rbody build
+// from it (constraint buffers, adjacency, colors, BVH and leaf ordered
+// triangles), already in the layout their buffers take. loading one is a
+// file map and a copy per section instead of parsing and rebuilding.
+// made by the convert tool (src/convert.cpp), used anywhere a mesh filename
+// ending in ASSET_EXTENSION goes.
+//
+// layout, little endian:
+//   header: "MESH", version, NUM_INT_CON_BUFFERS, BVH_MAX_LEAF_TRIANGLES,
+//           bvh depth, number of sections (ints), size of the obj (long long),
+//           FNV-1a hash of the obj's bytes (unsigned long long)
+//   sections: type, element size (ints), element count, byte offset (long longs)
+//   data: each section at a multiple of ASSET_ALIGNMENT
+// assets built with other constraint or leaf settings are rejected, so a
+// loaded asset always matches what the obj would have built. sizes and
+// offsets are checked, the indices themselves are trusted, like the obj's.
+
+#define ASSET_EXTENSION ".asset"
+#define ASSET_FILE_VERSION 4
+#define ASSET_ALIGNMENT 16
+
+enum AssetSection {
+	ASSET_POSITIONS, // vec4, w = 1
+	ASSET_QUADS, // ivec4
+	ASSET_TRIS, // int, 3 per triangle
+	ASSET_POLYGON_TRIS, // ivec3, see Mesh::indicesPolygonTris
+	ASSET_VERTEX_ORDER, // int, see Mesh::fileOrder. the sections above are already reordered
+	// cloth, rest lengths from the unjittered positions. see cloth.hpp for the structs
+	ASSET_INTERNAL_CONSTRAINTS, // EdgeConstraint, every constraint buffer back to back
+	ASSET_INTERNAL_CONSTRAINT_OFFSETS, // int, buffer i is [offsets[i], offsets[i + 1])
+	ASSET_CONSTRAINT_ROWS, // ConstraintRow
+	ASSET_CONSTRAINT_NEIGHBORS, // ConstraintNeighbor
+	ASSET_COLORED_CONSTRAINTS, // EdgeConstraint
+	ASSET_COLOR_OFFSETS, // int
+	// collider
+	ASSET_BVH_NODES, // vec4, two per node
+	ASSET_BVH_TRIANGLE_ORDER, // int
+	ASSET_TRIANGLES, // vec4, in BVH leaf order, see Rbody::ssbo_triangles
+	NUM_ASSET_SECTIONS
+};
+
+class Cloth;
+class Rbody;
+
+class MeshAsset
+{
+public:
+	// maps the file and checks the header and section table. if anything is
+	// off, says why and isOpen() is false.
+	MeshAsset(const std::string &path);
+
+	bool isOpen() const { return ok; }
+	int bvhDepth = 0;
+	// the obj it was made from, to notice edits. the size is checked first
+	// since it's free, the hash catches edits that keep it
+	long long sourceSize = 0;
+	unsigned long long sourceHash = 0;
+
+	bool has(int section) const { return sections[section].offset >= 0; }
+	long long count(int section) const { return sections[section].count; }
+	const void *data(int section) const { return file.data + sections[section].offset; }
+
+	// copies a section out, replacing whatever was in the vector
+	template<typename T> void read(int section, std::vector<T> &out) const {
+		out.resize(has(section) ? (size_t)count(section) : 0);
+		if (!out.empty()) memcpy((void *)&out[0], data(section), out.size() * sizeof(T));
+	}
+
+	static bool isAsset(const std::string &filename);
+	static std::string pathFor(const std::string &objFilename); // x.obj -> x.asset
+	static long long fileSize(const std::string &path); // -1 if it isn't there
+	static unsigned long long hashFile(const std::string &path); // FNV-1a of the bytes, 0 if it isn't there
+
+	// either of cloth and rbody may be NULL. if both are given they have to
+	// come from the same file, sourcePath. false if the file can't be written.
+	static bool write(const std::string &path, const Cloth *cloth, const Rbody *rbody, const std::string &sourcePath);
+
+private:
+	struct Section {
+		long long count = 0;
+		long long offset = -1; // -1: not in the file
+	};
+
+	MappedFile file;
+	Section sections[NUM_ASSET_SECTIONS];
+	bool ok = false;
+
+	bool offsetsValid(int offsetSection, int section) const;
+};
@@ -0,0 +1,86 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// the solver backend owns every simulation buffer and runs the compute stages.
+// scene classes only ever see BufferHandles, so a scene can be built and
+// stepped without a GL context by picking the CPU backend at startup.
+//
+// the interface deliberately mirrors the GL compute calls it replaces:
+//   glUseProgram       -> useKernel
+//   glUniform*         -> setUniform (same explicit locations as the shaders)
+//   glBindBufferBase   -> bindBuffer (same binding points as the shaders)
+//   glDispatchCompute  -> dispatch (number of items, not work groups)
+//   glMemoryBarrier    -> barrier
+
+// backend-neutral buffer handle. 0 is never a valid buffer.
+typedef unsigned int BufferHandle;
+
+// one entry per compute shader in shaders/
+enum ComputeKernel {
+	KERNEL_EXTERNAL_FORCES,          // cloth_pbd1_externalForces
+	KERNEL_DAMP_VELOCITIES,          // cloth_pbd2_dampVelocities
+	KERNEL_PREDICT_POSITIONS,        // cloth_pbd3_predictPositions
+	KERNEL_UPDATE_INVERSE_MASSES,    // cloth_pbd4_updateInverseMasses
+	KERNEL_PROJECT_CLOTH_CONSTRAINTS,// cloth_pbd5_projectClothConstraints
+	KERNEL_UPDATE_POSITIONS_VELOCITIES, // cloth_pbd6_updatePositionsVelocities
+	KERNEL_COPY_BUFFER,              // copy
+	KERNEL_GEN_COLLISIONS,           // cloth_genCollisions
+	KERNEL_PROJECT_COLLISIONS,       // cloth_projectCollisions
+	KERNEL_RIGIDBODY_ANIMATE,        // rigidbody_animate
+	KERNEL_RIGIDBODY_REFIT_BVH,      // rigidbody_refitBVH
+	KERNEL_GEN_COLLISIONS_SDF,       // cloth_genCollisionsSDF
+	KERNEL_PROJECT_CLOTH_CONSTRAINTS_CSR, // cloth_pbd5_projectClothConstraintsCSR
+	KERNEL_PROJECT_CLOTH_CONSTRAINTS_COLORED, // cloth_pbd5_projectClothConstraintsColored
+	KERNEL_INTEGRATE,                // cloth_pbd1to3_integrate
+	KERNEL_GATHER_PIN_TARGETS,       // cloth_pbd4_gatherPinTargets
+	KERNEL_PROJECT_PINS,             // cloth_pbd5_projectPins
+	KERNEL_GEN_COLLISIONS_CANDIDATES, // cloth_genCollisionsCandidates
+	KERNEL_GEN_COLLISIONS_PRIMITIVE, // cloth_genCollisionsPrimitive
+	NUM_KERNELS
+};
+
+class Profiler;
+
+class Backend
+{
+public:
+	virtual ~Backend() {}
+
+	virtual const char *name() = 0;
+	// true if buffer handles are GL buffer names that can be drawn directly
+	virtual bool isGL() = 0;
+
+	// buffers hold vec4s, just like the SSBOs. data may be NULL.
+	virtual BufferHandle createBuffer(int numItems, const glm::vec4 *data) = 0;
+	// replaces the buffer contents, resizing it to numItems
+	virtual void uploadBuffer(BufferHandle buffer, int numItems, const glm::vec4 *data) = 0;
+	virtual void readBuffer(BufferHandle buffer, int numItems, glm::vec4 *data) = 0;
+	// numItems items starting at item first
+	virtual void readBufferRange(BufferHandle buffer, int first, int numItems, glm::vec4 *data) = 0;
+	virtual void deleteBuffer(BufferHandle buffer) = 0;
+
+	// dispatch state
+	virtual void useKernel(ComputeKernel kernel) = 0;
+	virtual void setUniform(int location, int value) = 0;
+	virtual void setUniform(int location, float value) = 0;
+	virtual void setUniform(int location, const glm::vec3 &value) = 0;
+	virtual void setUniform(int location, const glm::mat4 &value) = 0;
+	virtual void bindBuffer(int binding, BufferHandle buffer) = 0;
+	virtual void dispatch(int numItems) = 0;
+	virtual void barrier() = 0;
+
+	// timestamps for the profiler, in nanoseconds. writing one records when
+	// everything queued before it has finished. reading never waits, it
+	// returns false while the timestamp isn't available yet.
+	virtual void writeTimestamp(int query) = 0;
+	virtual bool readTimestamp(int query, unsigned long long &ns) = 0;
+	virtual unsigned long long currentTimestamp() = 0; // same clock, right now
+
+	// while set, every dispatch is timed and labeled with its kernel
+	Profiler *profiler = NULL;
+};
+
+// requires a current GL 4.3 context
+Backend *createGLBackend(int workGroupSize);
+// numThreads 0 -> one per hardware thread
+Backend *createCPUBackend(int numThreads);
@@ -0,0 +1,454 @@
+/**
+ * @file      benchmark.cpp
+ * @brief     scaling sweep over the meshes/perf scenes (or generated ones):
+ *            every combination of cloth, collider, work group size (or thread count) and
+ *            solver iterations, stepped headless for a fixed number of
+ *            frames. writes csv/json and checks against a stored baseline.
+ */
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include "scenes.hpp"
+
+#if HEADLESS_GL
+#include "hiddenContext.hpp"
+#endif
+
+using namespace std;
+
+// one point of the sweep
+struct BenchConfig
+{
+	string backend;
+	string cloth; // see scenes::loadPerformanceTest
+	string collider;
+	int workGroupSize; // gl only, 0 on the cpu
+	int threads; // cpu only, 0 on gl
+	int iterations;
+};
+
+struct BenchResult
+{
+	BenchConfig config;
+	long long clothVertices;
+	long long colliderTriangles;
+	int frames;
+	double seconds;
+	double framesPerSecond;
+	double vertexIterationsPerSecond; // cloth vertices * solver iterations * frames / s
+	map<string, ProfileStats> stages;
+};
+
+static void printUsage(const char *exe) {
+	cout << "usage: " << exe << " [options]" << endl;
+	cout << "lists are comma separated, ex: --iterations 5,10,20" << endl;
+	cout << "cloths and colliders are meshes/perf sizes (256 for cloth_256.obj) or generator" << endl;
+	cout << "specs, ex: --cloths gen:grid:1000,gen:grid:3163 --colliders gen:icosphere:8" << endl;
+	cout << "  --cloths LIST       cloths, default all of meshes/perf" << endl;
+	cout << "  --colliders LIST    colliders, default all the balls in meshes/perf" << endl;
+	cout << "  --iterations LIST   solver iterations per frame, default 5,10,20" << endl;
+#if HEADLESS_GL
+	cout << "  --gl                run on the GL compute backend (hidden window)" << endl;
+	cout << "  --work-groups LIST  GL work group sizes, default 32,64,128,256" << endl;
+#endif
+	cout << "  --threads LIST      cpu backend worker threads, 0 = all cores, default 0" << endl;
+	cout << "  --frames N          timed frames per configuration, default 200" << endl;
+	cout << "  --warmup N          untimed frames before that, default 20" << endl;
+	cout << "  --repeats N         runs per configuration, the median one is kept, default 3" << endl;
+	cout << "  --meshes DIR        directory containing meshes/, default ./" << endl;
+	cout << "  --csv PATH          write one row per configuration (also the baseline format)" << endl;
+	cout << "  --json PATH         write every configuration with full stage statistics" << endl;
+	cout << "  --baseline PATH     compare against an earlier --csv file" << endl;
+	cout << "  --tolerance PCT     slowdown that counts as a regression, default 10" << endl;
+}
+
+static bool parseList(const char *text, vector<int> &values) {
+	values.clear();
+	stringstream stream(text);
+	string item;
+	while (getline(stream, item, ',')) {
+		if (item.empty()) return false;
+		values.push_back(atoi(item.c_str()));
+	}
+	return !values.empty();
+}
+
+// a bare number is short for the meshes/perf mesh of that size
+static bool parseMeshList(const char *text, const string &perfPrefix, vector<string> &names) {
+	names.clear();
+	stringstream stream(text);
+	string item;
+	while (getline(stream, item, ',')) {
+		if (item.empty()) return false;
+		bool number = item.find_first_not_of("0123456789") == string::npos;
+		names.push_back(number ? perfPrefix + item : item);
+	}
+	return !names.empty();
+}
+
+// identifies a configuration across runs, for the baseline
+static string configKey(const BenchConfig &config) {
+	stringstream key;
+	key << config.backend << " " << config.cloth << " " << config.collider;
+	if (config.workGroupSize > 0) key << " wg " << config.workGroupSize;
+	if (config.threads > 0) key << " threads " << config.threads;
+	key << " iterations " << config.iterations;
+	return key.str();
+}
+
+static bool runConfig(const BenchConfig &config, int warmupFrames, int numFrames, BenchResult &result) {
+#if HEADLESS_GL
+	Backend *backend = config.backend == "gl" ?
+		createGLBackend(config.workGroupSize) : createCPUBackend(config.threads);
+#else
+	Backend *backend = createCPUBackend(config.threads);
+#endif
+	Simulation *sim = scenes::loadPerformanceTest(backend, config.cloth, config.collider);
+	if (sim == NULL) {
+		cout << "skipping " << configKey(config) << endl;
+		delete backend;
+		return false;
+	}
+	sim->projectTimes = config.iterations;
+	sim->initComputeProgs(); // the kernels bake the iteration count into K
+
+	long long numClothVertices = 0;
+	for (int i = 0; i < sim->numCloths; i++) {
+		numClothVertices += sim->cloths.at(i)->initPositions.size();
+	}
+	long long numColliderTriangles = 0;
+	for (int i = 0; i < sim->numRigids; i++) {
+		numColliderTriangles += sim->rigids.at(i)->indicesTris.size() / 3;
+	}
+
+	// reading back forces the backend to finish everything that was queued
+	vector<glm::vec4> positions;
+	sim->stepSimulation(warmupFrames);
+	for (int i = 0; i < sim->numCloths; i++) {
+		sim->readClothPositions(i, positions);
+	}
+
+	// profiling only adds timestamps around dispatches, so the stage timings
+	// come from the same frames as the throughput
+	sim->setProfiling(true);
+	auto start = chrono::high_resolution_clock::now();
+	sim->stepSimulation(numFrames);
+	for (int i = 0; i < sim->numCloths; i++) {
+		sim->readClothPositions(i, positions);
+	}
+	auto end = chrono::high_resolution_clock::now();
+	sim->setProfiling(false);
+
+	result.config = config;
+	result.clothVertices = numClothVertices;
+	result.colliderTriangles = numColliderTriangles;
+	result.frames = numFrames;
+	result.seconds = chrono::duration<double>(end - start).count();
+	result.framesPerSecond = result.seconds > 0.0 ? numFrames / result.seconds : 0.0;
+	result.vertexIterationsPerSecond = result.seconds > 0.0 ?
+		(double)numClothVertices * config.iterations * numFrames / result.seconds : 0.0;
+	result.stages = sim->profiler.stats();
+
+	delete sim;
+	delete backend;
+	return true;
+}
+
+static bool slowerThan(const BenchResult &a, const BenchResult &b) {
+	return a.vertexIterationsPerSecond < b.vertexIterationsPerSecond;
+}
+
+/******************************************************************************
+ output
+******************************************************************************/
+
+// every stage label seen in any configuration, so all rows share columns
+static vector<string> stageLabels(const vector<BenchResult> &results) {
+	map<string, bool> seen;
+	for (int i = 0; i < (int)results.size(); i++) {
+		map<string, ProfileStats>::const_iterator it;
+		for (it = results[i].stages.begin(); it != results[i].stages.end(); it++) seen[it->first] = true;
+	}
+	vector<string> labels;
+	map<string, bool>::iterator it;
+	for (it = seen.begin(); it != seen.end(); it++) labels.push_back(it->first);
+	return labels;
+}
+
+static bool writeCSV(const string &path, const vector<BenchResult> &results) {
+	ofstream out(path.c_str());
+	if (!out.is_open()) return false;
+	vector<string> labels = stageLabels(results);
+
+	out << "backend,cloth,collider,work_group_size,threads,iterations,cloth_vertices,collider_triangles,frames,seconds," <<
+		"frames_per_s,vertex_iterations_per_s";
+	for (int i = 0; i < (int)labels.size(); i++) out << "," << labels[i] << " mean us";
+	out << "\n";
+
+	out << fixed;
+	for (int r = 0; r < (int)results.size(); r++) {
+		const BenchResult &result = results[r];
+		const BenchConfig &config = result.config;
+		out << config.backend << "," << config.cloth << "," << config.collider << "," <<
+			config.workGroupSize << "," << config.threads << "," << config.iterations << "," <<
+			result.clothVertices << "," << result.colliderTriangles << "," << result.frames << "," << setprecision(6) << result.seconds << "," <<
+			setprecision(2) << result.framesPerSecond << "," << setprecision(0) << result.vertexIterationsPerSecond;
+		out << setprecision(2);
+		for (int i = 0; i < (int)labels.size(); i++) {
+			map<string, ProfileStats>::const_iterator stage = result.stages.find(labels[i]);
+			out << ",";
+			if (stage != result.stages.end()) out << stage->second.mean;
+		}
+		out << "\n";
+	}
+	return (bool)out;
+}
+
+static bool writeJSON(const string &path, const vector<BenchResult> &results, int warmupFrames) {
+	ofstream out(path.c_str());
+	if (!out.is_open()) return false;
+	out << fixed;
+	out << "{\"warmup_frames\":" << warmupFrames << ",\"results\":[";
+	for (int r = 0; r < (int)results.size(); r++) {
+		const BenchResult &result = results[r];
+		const BenchConfig &config = result.config;
+		out << (r ? "," : "") << "\n{\"backend\":\"" << config.backend << "\",\"cloth\":\"" << config.cloth <<
+			"\",\"collider\":\"" << config.collider << "\",\"work_group_size\":" << config.workGroupSize <<
+			",\"threads\":" << config.threads << ",\"iterations\":" << config.iterations <<
+			",\"cloth_vertices\":" << result.clothVertices << ",\"collider_triangles\":" << result.colliderTriangles <<
+			",\"frames\":" << result.frames <<
+			",\"seconds\":" << setprecision(6) << result.seconds <<
+			",\"frames_per_s\":" << setprecision(2) << result.framesPerSecond <<
+			",\"vertex_iterations_per_s\":" << setprecision(0) << result.vertexIterationsPerSecond <<
+			",\"stages\":{" << setprecision(2);
+		map<string, ProfileStats>::const_iterator it;
+		for (it = result.stages.begin(); it != result.stages.end(); it++) {
+			const ProfileStats &stat = it->second;
+			out << (it == result.stages.begin() ? "" : ",") << "\"" << it->first << "\":{\"count\":" << stat.count <<
+				",\"mean_us\":" << stat.mean << ",\"p50_us\":" << stat.p50 << ",\"p95_us\":" << stat.p95 <<
+				",\"p99_us\":" << stat.p99 << "}";
+		}
+		out << "}}";
+	}
+	out << "\n]}\n";
+	return (bool)out;
+}
+
+/******************************************************************************
+ baseline
+******************************************************************************/
+
+static vector<string> splitCSV(const string &line) {
+	vector<string> fields;
+	stringstream stream(line);
+	string field;
+	while (getline(stream, field, ',')) fields.push_back(field);
+	if (!line.empty() && line[line.size() - 1] == ',') fields.push_back("");
+	return fields;
+}
+
+// config key -> column -> value, from a file written by writeCSV
+static bool readBaseline(const string &path, map<string, map<string, double> > &rows) {
+	ifstream in(path.c_str());
+	if (!in.is_open()) return false;
+	string line;
+	if (!getline(in, line)) return false;
+	vector<string> header = splitCSV(line);
+	while (getline(in, line)) {
+		if (line.empty()) continue;
+		vector<string> fields = splitCSV(line);
+		if (fields.size() != header.size()) continue;
+		BenchConfig config;
+		config.backend = fields[0];
+		config.cloth = fields[1];
+		config.collider = fields[2];
+		config.workGroupSize = atoi(fields[3].c_str());
+		config.threads = atoi(fields[4].c_str());
+		config.iterations = atoi(fields[5].c_str());
+		map<string, double> &row = rows[configKey(config)];
+		for (int i = 6; i < (int)fields.size(); i++) {
+			if (!fields[i].empty()) row[header[i]] = atof(fields[i].c_str());
+		}
+	}
+	return true;
+}
+
+// stages this short are mostly noise, ex: a single tiny dispatch
+#define MIN_STAGE_DELTA_US 20.0
+
+// prints a line per change beyond the tolerance. returns the number of regressions.
+static int compareBaseline(const vector<BenchResult> &results, map<string, map<string, double> > &baseline,
+	double tolerance) {
+	int numRegressions = 0;
+	int numCompared = 0;
+	cout << fixed << setprecision(1);
+	for (int r = 0; r < (int)results.size(); r++) {
+		const BenchResult &result = results[r];
+		string key = configKey(result.config);
+		if (baseline.count(key) == 0) {
+			cout << "  " << key << ": not in the baseline" << endl;
+			continue;
+		}
+		map<string, double> &row = baseline[key];
+		numCompared++;
+
+		double before = row["vertex_iterations_per_s"];
+		double after = result.vertexIterationsPerSecond;
+		double change = before > 0.0 ? (after - before) / before * 100.0 : 0.0;
+		bool regressed = change < -tolerance;
+		if (regressed) numRegressions++;
+		cout << "  " << (regressed ? "REGRESSION " : change > tolerance ? "improved   " : "           ") << key <<
+			": " << setprecision(0) << before << " -> " << after << " vertex iterations/s (" <<
+			setprecision(1) << showpos << change << noshowpos << "%)" << endl;
+
+		map<string, ProfileStats>::const_iterator it;
+		for (it = result.stages.begin(); it != result.stages.end(); it++) {
+			string column = it->first + " mean us";
+			if (row.count(column) == 0) continue;
+			double stageBefore = row[column];
+			double stageAfter = it->second.mean;
+			if (stageBefore <= 0.0 || fabs(stageAfter - stageBefore) < MIN_STAGE_DELTA_US) continue;
+			double stageChange = (stageAfter - stageBefore) / stageBefore * 100.0;
+			if (stageChange > tolerance) {
+				numRegressions++;
+				cout << "  REGRESSION   " << it->first << ": " << stageBefore << " -> " << stageAfter << " us (" <<
+					showpos << stageChange << noshowpos << "%)" << endl;
+			}
+		}
+	}
+	cout << numCompared << " configurations compared, " << numRegressions << " regressions beyond " <<
+		tolerance << "%" << endl;
+	cout.unsetf(ios::fixed);
+	return numRegressions;
+}
+
+int main(int argc, char* argv[]) {
+	vector<string> cloths = scenes::perfCloths();
+	vector<string> colliders = scenes::perfBalls();
+	vector<int> iterations;
+	parseList("5,10,20", iterations);
+	vector<int> workGroupSizes;
+	parseList("32,64,128,256", workGroupSizes);
+	vector<int> threadCounts(1, 0);
+	bool useGL = false;
+	int numFrames = 200;
+	int warmupFrames = 20;
+	int numRepeats = 3;
+	string csvPath;
+	string jsonPath;
+	string baselinePath;
+	double tolerance = 10.0;
+
+	for (int i = 1; i < argc; i++) {
+		bool hasValue = i + 1 < argc;
+		bool ok = true;
+		if (strcmp(argv[i], "--cloths") == 0 && hasValue) ok = parseMeshList(argv[++i], "cloth_", cloths);
+		else if (strcmp(argv[i], "--colliders") == 0 && hasValue) ok = parseMeshList(argv[++i], "ball_", colliders);
+		else if (strcmp(argv[i], "--iterations") == 0 && hasValue) ok = parseList(argv[++i], iterations);
+		else if (strcmp(argv[i], "--work-groups") == 0 && hasValue) ok = parseList(argv[++i], workGroupSizes);
+		else if (strcmp(argv[i], "--threads") == 0 && hasValue) ok = parseList(argv[++i], threadCounts);
+		else if (strcmp(argv[i], "--frames") == 0 && hasValue) numFrames = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--warmup") == 0 && hasValue) warmupFrames = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--repeats") == 0 && hasValue) numRepeats = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--meshes") == 0 && hasValue) scenes::meshRoot = string(argv[++i]) + "/";
+		else if (strcmp(argv[i], "--csv") == 0 && hasValue) csvPath = argv[++i];
+		else if (strcmp(argv[i], "--json") == 0 && hasValue) jsonPath = argv[++i];
+		else if (strcmp(argv[i], "--baseline") == 0 && hasValue) baselinePath = argv[++i];
+		else if (strcmp(argv[i], "--tolerance") == 0 && hasValue) tolerance = atof(argv[++i]);
+		else if (strcmp(argv[i], "--cpu") == 0) useGL = false;
+#if HEADLESS_GL
+		else if (strcmp(argv[i], "--gl") == 0) useGL = true;
+#endif
+		else ok = false;
+		if (!ok || numFrames < 1 || warmupFrames < 0 || numRepeats < 1) {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	// read it first, so a bad path doesn't cost a whole sweep
+	map<string, map<string, double> > baseline;
+	if (!baselinePath.empty() && !readBaseline(baselinePath, baseline)) {
+		cout << "could not read the baseline " << baselinePath << endl;
+		return 1;
+	}
+
+	// work group size is a GL knob, thread count a cpu one
+	vector<BenchConfig> configs;
+	vector<int> backendSizes = useGL ? workGroupSizes : threadCounts;
+	for (int c = 0; c < (int)cloths.size(); c++) {
+		for (int b = 0; b < (int)colliders.size(); b++) {
+			for (int s = 0; s < (int)backendSizes.size(); s++) {
+				for (int it = 0; it < (int)iterations.size(); it++) {
+					BenchConfig config;
+					config.backend = useGL ? "gl" : "cpu";
+					config.cloth = cloths[c];
+					config.collider = colliders[b];
+					config.workGroupSize = useGL ? backendSizes[s] : 0;
+					config.threads = 0;
+					if (!useGL) {
+						// record what 0 means on this machine, so baselines from
+						// other machines don't silently match
+						config.threads = backendSizes[s] > 0 ? backendSizes[s] : (int)thread::hardware_concurrency();
+						if (config.threads < 1) config.threads = 1;
+					}
+					config.iterations = iterations[it];
+					configs.push_back(config);
+				}
+			}
+		}
+	}
+
+#if HEADLESS_GL
+	GLFWwindow *window = NULL;
+	if (useGL) {
+		window = createHiddenContext();
+		if (!window) return 1;
+	}
+#endif
+
+	vector<BenchResult> results;
+	for (int i = 0; i < (int)configs.size(); i++) {
+		// the median run by throughput, with its own stage timings
+		vector<BenchResult> repeats;
+		for (int r = 0; r < numRepeats; r++) {
+			BenchResult repeat;
+			if (!runConfig(configs[i], warmupFrames, numFrames, repeat)) break;
+			repeats.push_back(repeat);
+		}
+		if (repeats.empty()) continue;
+		std::sort(repeats.begin(), repeats.end(), slowerThan);
+		BenchResult &result = repeats[repeats.size() / 2];
+		cout << "[" << i + 1 << "/" << configs.size() << "] " << configKey(configs[i]) << ": " <<
+			fixed << setprecision(1) << result.framesPerSecond << " frames/s, " << setprecision(0) <<
+			result.vertexIterationsPerSecond << " vertex iterations/s" << endl;
+		cout.unsetf(ios::fixed);
+		results.push_back(result);
+	}
+
+#if HEADLESS_GL
+	destroyHiddenContext(window);
+#endif
+
+	if (!csvPath.empty()) {
+		if (writeCSV(csvPath, results)) cout << "csv written to " << csvPath << endl;
+		else cout << "could not write " << csvPath << endl;
+	}
+	if (!jsonPath.empty()) {
+		if (writeJSON(jsonPath, results, warmupFrames)) cout << "json written to " << jsonPath << endl;
+		else cout << "could not write " << jsonPath << endl;
+	}
+
+	if (!baselinePath.empty()) {
+		cout << "against " << baselinePath << ":" << endl;
+		if (compareBaseline(results, baseline, tolerance) > 0) return 2;
+	}
+	return 0;
+}
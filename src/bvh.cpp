@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <iostream>
+#include "bvh.hpp"
+#include "tracer.hpp"
+
+void BVH::build(const std::vector<glm::vec4> &positions, const std::vector<int> &indicesTris) {
+	TRACE_ZONE("build bvh");
+	int numTriangles = indicesTris.size() / 3;
+	nodes.clear();
+	depth = 0;
+	triangleOrder.resize(numTriangles);
+	if (numTriangles == 0) return;
+
+	triMin.resize(numTriangles);
+	triMax.resize(numTriangles);
+	centroids.resize(numTriangles);
+	for (int i = 0; i < numTriangles; i++) {
+		glm::vec3 v0 = glm::vec3(positions.at(indicesTris[i * 3 + 0]));
+		glm::vec3 v1 = glm::vec3(positions.at(indicesTris[i * 3 + 1]));
+		glm::vec3 v2 = glm::vec3(positions.at(indicesTris[i * 3 + 2]));
+		triMin[i] = glm::min(v0, glm::min(v1, v2));
+		triMax[i] = glm::max(v0, glm::max(v1, v2));
+		centroids[i] = (v0 + v1 + v2) / 3.0f;
+		triangleOrder[i] = i;
+	}
+
+	// a median split keeps the tree balanced, so the depth (and the shader's
+	// traversal stack) stays around log2(numTriangles / leaf size)
+	nodes.reserve(4 * numTriangles / BVH_MAX_LEAF_TRIANGLES + 2);
+	nodes.resize(2);
+	subdivide(0, 0, numTriangles, 1);
+
+	if (depth >= BVH_STACK_SIZE) {
+		std::cout << "BVH too deep for the traversal stack: " << depth << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	triMin.clear();
+	triMax.clear();
+	centroids.clear();
+}
+
+void BVH::subdivide(int node, int first, int count, int level) {
+	depth = std::max(depth, level);
+
+	glm::vec3 boundsMin = triMin[triangleOrder[first]];
+	glm::vec3 boundsMax = triMax[triangleOrder[first]];
+	glm::vec3 centroidMin = centroids[triangleOrder[first]];
+	glm::vec3 centroidMax = centroidMin;
+	for (int i = first + 1; i < first + count; i++) {
+		int tri = triangleOrder[i];
+		boundsMin = glm::min(boundsMin, triMin[tri]);
+		boundsMax = glm::max(boundsMax, triMax[tri]);
+		centroidMin = glm::min(centroidMin, centroids[tri]);
+		centroidMax = glm::max(centroidMax, centroids[tri]);
+	}
+	boundsMin -= glm::vec3(BVH_PADDING);
+	boundsMax += glm::vec3(BVH_PADDING);
+
+	if (count <= BVH_MAX_LEAF_TRIANGLES) {
+		nodes[2 * node + 0] = glm::vec4(boundsMin, (float)first);
+		nodes[2 * node + 1] = glm::vec4(boundsMax, (float)count);
+		return;
+	}
+
+	// split at the median centroid along the longest axis
+	glm::vec3 extent = centroidMax - centroidMin;
+	int axis = 0;
+	if (extent.y > extent[axis]) axis = 1;
+	if (extent.z > extent[axis]) axis = 2;
+	int mid = first + count / 2;
+	std::nth_element(triangleOrder.begin() + first, triangleOrder.begin() + mid,
+		triangleOrder.begin() + first + count, [&](int a, int b) {
+		return centroids[a][axis] < centroids[b][axis];
+	});
+
+	int left = numNodes();
+	nodes.resize(nodes.size() + 4);
+	nodes[2 * node + 0] = glm::vec4(boundsMin, (float)left);
+	nodes[2 * node + 1] = glm::vec4(boundsMax, 0.0f);
+	subdivide(left, first, mid - first, level + 1);
+	subdivide(left + 1, mid, first + count - mid, level + 1);
+}
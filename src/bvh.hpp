@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+// bounding volume hierarchy over a triangle mesh, flattened so it can go
+// straight into a buffer and be walked with a small stack in a shader.
+// every node is two vec4s:
+//   nodes[2 * i + 0] = (min x, min y, min z, left child or first triangle)
+//   nodes[2 * i + 1] = (max x, max y, max z, triangle count)
+// a triangle count of 0 marks an inner node with children left and left + 1.
+// triangles get reordered so that every leaf covers a contiguous range.
+
+#define BVH_MAX_LEAF_TRIANGLES 4
+#define BVH_STACK_SIZE 32 // traversal stack in cloth_genCollisions.comp.glsl
+#define BVH_PADDING 0.0001f // keeps flat triangles (floors!) inside their boxes
+
+// per vertex lists of the collider triangles near it, so the collision pass
+// only walks the BVH again once a vertex has moved away from where its list
+// was made (cloth_genCollisionsCandidates.comp.glsl). each list is
+// CANDIDATE_VEC4S vec4s: (where it was made, in body space, and the flags
+// below as uint bits), then triangle indices in leaf order as uint bits,
+// four to a vec4.
+#define CANDIDATE_VEC4S 8
+#define CANDIDATE_CAPACITY (4 * (CANDIDATE_VEC4S - 1))
+#define CANDIDATES_COUNT 0xFFFF // triangles on the list, CANDIDATE_CAPACITY + 1 if there were too many
+#define CANDIDATES_INSIDE 0x10000 // inside the body where the list was made
+#define CANDIDATES_BUILT 0x20000
+#define CANDIDATE_REACH 0.95f // part of the skin a list covers, leaving room for rounding
+
+class BVH
+{
+public:
+	std::vector<glm::vec4> nodes;
+	std::vector<int> triangleOrder; // original index of each reordered triangle
+	int depth = 0;
+
+	void build(const std::vector<glm::vec4> &positions, const std::vector<int> &indicesTris);
+	int numNodes() const { return nodes.size() / 2; }
+
+private:
+	std::vector<glm::vec3> triMin;
+	std::vector<glm::vec3> triMax;
+	std::vector<glm::vec3> centroids;
+
+	void subdivide(int node, int first, int count, int level);
+};
@@ -1,106 +1,69 @@
+#include <algorithm>
 #include "cloth.hpp"
-#include "checkGLError.hpp"
+#include "asset.hpp"
+#include "topology.hpp"
+#include "threadPool.hpp"
+#include "tracer.hpp"
 
-Cloth::Cloth(string filename, glm::vec3 jitter) : Mesh(filename, jitter) {
+Cloth::Cloth(Backend *backend, string filename, glm::vec3 jitter) :
+  Mesh(backend, filename, jitter) {
 	
-  GLint bufMask = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
   int positionCount = initPositions.size();
 
-  glGenBuffers(1, &ssbo_vel);
-  glGenBuffers(1, &ssbo_pos_pred1);
-  glGenBuffers(1, &ssbo_pos_pred2);
-  glGenBuffers(1, &ssbo_debug);
-
-  glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo_debug);
-  glBufferData(GL_SHADER_STORAGE_BUFFER, positionCount * sizeof(glm::vec4),
-	  NULL, GL_STREAM_COPY);
-
-
   // redo the positions buffer with masses
-
-  glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo_pos);
-  glBufferData(GL_SHADER_STORAGE_BUFFER, positionCount * sizeof(glm::vec4),
-	  NULL, GL_STREAM_COPY);
-  glm::vec4 *pos = (glm::vec4 *) glMapBufferRange(GL_SHADER_STORAGE_BUFFER,
-	  0, positionCount * sizeof(glm::vec4), bufMask);
   for (int i = 0; i < positionCount; i++) {
 	  initPositions[i].w = default_inv_mass;
-	  pos[i] = initPositions[i];
   }
-  glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+  backend->uploadBuffer(ssbo_pos, positionCount, &initPositions[0]);
 
   // set up ssbo for velocities
-  glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo_vel);
-  glBufferData(GL_SHADER_STORAGE_BUFFER, positionCount * sizeof(glm::vec4),
-	  NULL, GL_STREAM_COPY);
-  glm::vec4 *velocity = (glm::vec4 *) glMapBufferRange(GL_SHADER_STORAGE_BUFFER,
-	  0, positionCount * sizeof(glm::vec4), bufMask);
-  for (int i = 0; i < positionCount; i++) {
-	  velocity[i] = glm::vec4(0.0f);
-  }
-  glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+  std::vector<glm::vec4> velocity(positionCount, glm::vec4(0.0f));
+  ssbo_vel = backend->createBuffer(positionCount, &velocity[0]);
 
   // set up ssbo for predicted positions
-  glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo_pos_pred1);
-  glBufferData(GL_SHADER_STORAGE_BUFFER, positionCount * sizeof(glm::vec4),
-	  NULL, GL_STREAM_COPY);
-  glm::vec4 *ppos1 = (glm::vec4 *) glMapBufferRange(GL_SHADER_STORAGE_BUFFER,
-	  0, positionCount * sizeof(glm::vec4), bufMask);
-  for (int i = 0; i < positionCount; i++) {
-	  ppos1[i] = initPositions[i];
-  }
-  glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+  ssbo_pos_pred1 = backend->createBuffer(positionCount, &initPositions[0]);
 
   // set up another ssbo for predicted positions. ping-pong
-  glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo_pos_pred2);
-  glBufferData(GL_SHADER_STORAGE_BUFFER, positionCount * sizeof(glm::vec4),
-	  NULL, GL_STREAM_COPY);
-  glm::vec4 *ppos2 = (glm::vec4 *) glMapBufferRange(GL_SHADER_STORAGE_BUFFER,
-	  0, positionCount * sizeof(glm::vec4), bufMask);
-  for (int i = 0; i < positionCount; i++) {
-	  ppos2[i] = initPositions[i];
+  ssbo_pos_pred2 = backend->createBuffer(positionCount, &initPositions[0]);
+
+  // set up constraints, straight from the asset if it has them
+  if (asset && asset->has(ASSET_CONSTRAINT_ROWS)) {
+    loadConstraints();
+  } else {
+    generateConstraints();
+    colorConstraints();
   }
-  glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+  createConstraintBuffers();
+  closeAsset();
 
-  // set up constraints
-  generateConstraints();
+  ssbo_clothParams = backend->createBuffer(1, NULL);
+  uploadParameters();
 
   color = glm::vec3(0.0f, 0.5f, 1.0f);
 }
 
-Cloth::~Cloth() {
-
+Cloth::Cloth(Backend *backend) : Mesh(backend) {
+  ssbo_pos_pred1 = 0;
+  ssbo_pos_pred2 = 0;
+  ssbo_vel = 0;
+  ssbo_externalConstraints = 0;
+  ssbo_pinTargets = 0;
+  ssbo_collisionConstraints = 0;
+  ssbo_constraintRows = 0;
+  ssbo_constraintNeighbors = 0;
+  ssbo_coloredConstraints = 0;
+  ssbo_clothParams = 0;
+  for (int i = 0; i < NUM_INT_CON_BUFFERS; i++) {
+    ssbo_internalConstraints[i] = 0;
+  }
 }
 
-struct constraintVertexIndices {
-  int thisIndex = -1;
-  int numConstraints = 0;
-  int indices[NUM_INT_CON_BUFFERS];
-};
-
-void addConstraint(constraintVertexIndices &vert1, constraintVertexIndices &vert2) {
-  // assess whether the constraints given already exist here or not
-	for (int i = 0; i < NUM_INT_CON_BUFFERS; i++) {
-    if (vert1.indices[i] == vert2.thisIndex) {
-      return;
-    }
-    if (vert2.indices[i] == vert1.thisIndex) {
-      return;
-    }
-  }
+Cloth::~Cloth() {
 
-  // set up constraints on vert and influencer based on each other
-	if (vert1.numConstraints < NUM_INT_CON_BUFFERS) {
-    vert1.indices[vert1.numConstraints] = vert2.thisIndex;
-    vert1.numConstraints++;
-  }
-	if (vert2.numConstraints < NUM_INT_CON_BUFFERS) {
-    vert2.indices[vert2.numConstraints] = vert1.thisIndex;
-    vert2.numConstraints++;
-  }
 }
 
 void Cloth::generateConstraints() {
+  TRACE_ZONE("generate constraints");
 
   /*****************************************************************************
    The standard mass-spring system constraint requires:
@@ -130,82 +93,241 @@ void Cloth::generateConstraints() {
    We don't actually NEED the N,S,E,W constraints to be uniform like this if
    we have a predicted position lag (one buffer stays "one projection behind"
    and has to be ffwded on the next step)
+
+   The edges come from topology::buildAdjacency now, see topology.hpp.
   *****************************************************************************/
   int numVertices = initPositions.size();
-  std::vector<constraintVertexIndices> constraintsPerVertex;
-  for (int i = 0; i < numVertices; i++) {
-    constraintVertexIndices emptyVert;
-    emptyVert.thisIndex = i;
-	for (int j = 0; j < NUM_INT_CON_BUFFERS; j++) {
-		emptyVert.indices[j] = -1;
-	}
-    constraintsPerVertex.push_back(emptyVert);
+  ThreadPool *pool = NULL;
+  if (6 * indicesQuads.size() + 3 * indicesPolygonTris.size() >= TOPOLOGY_PARALLEL_MIN_EDGES) {
+    pool = new ThreadPool();
+    pool->minParallelCount = 1;
   }
-  // Check every face and input the constraints per vertex.
-  int numFaces = indicesQuads.size();
-  for (int i = 0; i < numFaces; i++) {    // each face generates 4 constraints
-    glm::ivec4 face = indicesQuads.at(i);
-    addConstraint(constraintsPerVertex[face[0]], constraintsPerVertex[face[1]]);
-    addConstraint(constraintsPerVertex[face[1]], constraintsPerVertex[face[2]]);
-    addConstraint(constraintsPerVertex[face[2]], constraintsPerVertex[face[3]]);
-    addConstraint(constraintsPerVertex[face[3]], constraintsPerVertex[face[0]]);
-	if (NUM_INT_CON_BUFFERS > 4) {
-		// diagonal constraints
-		addConstraint(constraintsPerVertex[face[0]], constraintsPerVertex[face[2]]);
-		addConstraint(constraintsPerVertex[face[1]], constraintsPerVertex[face[3]]);
-	}
+
+  // every vertex's neighbors, each edge once, in the order the faces give
+  // them. quads get their diagonals too when there are buffers to spare.
+  std::vector<int> rowStart;
+  std::vector<int> neighbors;
+  topology::buildAdjacency(numVertices, indicesQuads, NUM_INT_CON_BUFFERS > 4, indicesPolygonTris,
+    rowStart, neighbors, pool);
+
+  // compressed sparse rows for the gather solver
+  constraintRows.resize(numVertices);
+  constraintNeighbors.resize(neighbors.size());
+  topology::forChunks(pool, numVertices, [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      int first = rowStart[i];
+      int count = rowStart[i + 1] - first;
+      constraintRows[i].first = first;
+      constraintRows[i].count = count;
+      for (int j = first; j < first + count; j++) {
+        constraintNeighbors[j].index = neighbors[j];
+        constraintNeighbors[j].restLength = restLength(i, neighbors[j]);
+      }
+    }
+  });
+
+  // the constraint buffers: a vertex's jth neighbor goes in buffer j, those
+  // past the last buffer don't go anywhere. vertices in order in each buffer,
+  // so every chunk of vertices needs to know how many came before it.
+  int numChunks = (numVertices + TOPOLOGY_CHUNK_ITEMS - 1) / TOPOLOGY_CHUNK_ITEMS;
+  std::vector<int> chunkStart((numChunks + 1) * NUM_INT_CON_BUFFERS, 0);
+  topology::forChunks(pool, numVertices, [&](int begin, int end) {
+    int *counts = &chunkStart[(begin / TOPOLOGY_CHUNK_ITEMS + 1) * NUM_INT_CON_BUFFERS];
+    for (int i = begin; i < end; i++) {
+      int count = std::min(rowStart[i + 1] - rowStart[i], NUM_INT_CON_BUFFERS);
+      for (int j = 0; j < count; j++) counts[j]++;
+    }
+  });
+  for (int c = 0; c < numChunks; c++) {
+    for (int j = 0; j < NUM_INT_CON_BUFFERS; j++) {
+      chunkStart[(c + 1) * NUM_INT_CON_BUFFERS + j] += chunkStart[c * NUM_INT_CON_BUFFERS + j];
+    }
   }
+  for (int j = 0; j < NUM_INT_CON_BUFFERS; j++) {
+    internalConstraints[j].resize(chunkStart[numChunks * NUM_INT_CON_BUFFERS + j]);
+  }
+  topology::forChunks(pool, numVertices, [&](int begin, int end) {
+    int next[NUM_INT_CON_BUFFERS];
+    for (int j = 0; j < NUM_INT_CON_BUFFERS; j++) {
+      next[j] = chunkStart[begin / TOPOLOGY_CHUNK_ITEMS * NUM_INT_CON_BUFFERS + j];
+    }
+    for (int i = begin; i < end; i++) {
+      int count = std::min(rowStart[i + 1] - rowStart[i], NUM_INT_CON_BUFFERS);
+      for (int j = 0; j < count; j++) {
+        const ConstraintNeighbor &neighbor = constraintNeighbors[rowStart[i] + j];
+        EdgeConstraint &constraint = internalConstraints[j][next[j]++];
+        constraint.a = i;
+        constraint.b = neighbor.index;
+        constraint.restLength = neighbor.restLength;
+      }
+    }
+  });
+  delete pool;
+}
 
-  // deploy internal constraints and buffers
+// a vertex's colors sit in the slots of its row in constraintNeighbors (it
+// can't have more colors than neighbors), with the ones under 64 also kept
+// as bits, which is nearly always all of them
+struct VertexColors {
+  std::vector<int> slots;
+  std::vector<int> rowStart;
+  std::vector<int> count;
+  std::vector<unsigned long long> mask;
+
+  bool has(int v, int color) const {
+    if (color < 64) return (mask[v] >> color) & 1;
+    const int *first = &slots[rowStart[v]];
+    return std::find(first, first + count[v], color) != first + count[v];
+  }
+  void add(int v, int color) {
+    slots[rowStart[v] + count[v]++] = color;
+    if (color < 64) mask[v] |= 1ULL << color;
+  }
+  void replace(int v, int from, int to) {
+    int *first = &slots[rowStart[v]];
+    *std::find(first, first + count[v], from) = to;
+    if (from < 64) mask[v] &= ~(1ULL << from);
+    if (to < 64) mask[v] |= 1ULL << to;
+  }
+};
 
+void Cloth::colorConstraints() {
+  TRACE_ZONE("color constraints");
+  // every edge once, from the rows
+  int numVertices = constraintRows.size();
+  std::vector<EdgeConstraint> edges;
+  edges.reserve(constraintNeighbors.size() / 2);
+  VertexColors colors;
+  colors.slots.resize(constraintNeighbors.size());
+  colors.rowStart.resize(numVertices);
+  colors.count.assign(numVertices, 0);
+  colors.mask.assign(numVertices, 0);
   for (int i = 0; i < numVertices; i++) {
-    constraintVertexIndices currSet = constraintsPerVertex.at(i);
-	for (int j = 0; j < NUM_INT_CON_BUFFERS; j++) {
-      if (currSet.indices[j] != -1) {
-        glm::vec4 shaderConstraint;
-        shaderConstraint[0] = currSet.thisIndex;
-        shaderConstraint[1] = currSet.indices[j];
-		glm::vec4 p1 = initPositions.at(currSet.thisIndex);
-		glm::vec4 p2 = initPositions.at(currSet.indices[j]);
-		shaderConstraint[2] = glm::length(glm::vec3(p1.x, p1.y, p1.z) - 
-			glm::vec3(p2.x, p2.y, p2.z));
-		internalConstraints[j].push_back(shaderConstraint);
-      }
+    int first = constraintRows[i].first;
+    int count = constraintRows[i].count;
+    colors.rowStart[i] = first;
+    for (int j = first; j < first + count; j++) {
+      int other = constraintNeighbors[j].index;
+      if (other <= i) continue;
+      EdgeConstraint edge = { (unsigned int)i, (unsigned int)other, constraintNeighbors[j].restLength };
+      edges.push_back(edge);
     }
   }
+  int numEdges = edges.size();
+
+  // greedy: each edge takes the lowest color neither of its vertices has yet
+  std::vector<int> edgeColors(numEdges);
+  std::vector<int> colorSizes;
+  for (int e = 0; e < numEdges; e++) {
+    int a = edges[e].a;
+    int b = edges[e].b;
+    unsigned long long taken = colors.mask[a] | colors.mask[b];
+    int color = 0;
+    while (color < 64 && ((taken >> color) & 1)) color++;
+    while (colors.has(a, color) || colors.has(b, color)) color++;
+    edgeColors[e] = color;
+    colors.add(a, color);
+    colors.add(b, color);
+    if (color >= (int)colorSizes.size()) colorSizes.resize(color + 1, 0);
+    colorSizes[color]++;
+  }
+  int numColors = colorSizes.size();
+
+  // greedy coloring piles most edges into the first few colors and leaves
+  // the last ones nearly empty, which is a waste of a dispatch. move edges
+  // out of big colors into small ones wherever both vertices allow it.
+  int targetSize = numColors > 0 ? (numEdges + numColors - 1) / numColors : 0;
+  for (int e = 0; e < numEdges; e++) {
+    int color = edgeColors[e];
+    if (colorSizes[color] <= targetSize) continue;
+    int a = edges[e].a;
+    int b = edges[e].b;
+    for (int c = 0; c < numColors; c++) {
+      if (colorSizes[c] >= targetSize) continue;
+      if (colors.has(a, c) || colors.has(b, c)) continue;
+      colors.replace(a, color, c);
+      colors.replace(b, color, c);
+      colorSizes[color]--;
+      colorSizes[c]++;
+      edgeColors[e] = c;
+      break;
+    }
+  }
+
+  // sort by color, keeping the original order inside each one
+  colorOffsets.assign(numColors + 1, 0);
+  for (int c = 0; c < numColors; c++) {
+    colorOffsets[c + 1] = colorOffsets[c] + colorSizes[c];
+  }
+  std::vector<int> next(colorOffsets.begin(), colorOffsets.end() - 1);
+  coloredConstraints.resize(numEdges);
+  for (int e = 0; e < numEdges; e++) {
+    coloredConstraints[next[edgeColors[e]]++] = edges[e];
+  }
+}
 
-  GLint bufMask = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+// copies everything generateConstraints and colorConstraints would have
+// built out of the asset. its rest lengths are for the unjittered positions,
+// so they're measured again if this cloth got moved.
+void Cloth::loadConstraints() {
+  TRACE_ZONE("load constraints");
+  const EdgeConstraint *packed = (const EdgeConstraint *)asset->data(ASSET_INTERNAL_CONSTRAINTS);
+  const int *offsets = (const int *)asset->data(ASSET_INTERNAL_CONSTRAINT_OFFSETS);
+  for (int i = 0; i < NUM_INT_CON_BUFFERS; i++) {
+    internalConstraints[i].assign(packed + offsets[i], packed + offsets[i + 1]);
+  }
+  asset->read(ASSET_CONSTRAINT_ROWS, constraintRows);
+  asset->read(ASSET_CONSTRAINT_NEIGHBORS, constraintNeighbors);
+  asset->read(ASSET_COLORED_CONSTRAINTS, coloredConstraints);
+  asset->read(ASSET_COLOR_OFFSETS, colorOffsets);
+  if (jitter == glm::vec3(0.0f)) return;
 
   for (int i = 0; i < NUM_INT_CON_BUFFERS; i++) {
-    // gen buffer
-	glGenBuffers(1, &ssbo_internalConstraints[i]);
-
-    // allocate space for internal constraints on GPU
-	int numConstraints = internalConstraints[i].size();
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo_internalConstraints[i]);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, numConstraints * sizeof(glm::vec4),
-      NULL, GL_STREAM_COPY);
-
-    // transfer
-    glm::vec4 *constraintsMapped = (glm::vec4 *) glMapBufferRange(GL_SHADER_STORAGE_BUFFER,
-      0, numConstraints * sizeof(glm::vec4), bufMask);
-
-    for (int j = 0; j < numConstraints; j++) {
-		// all internal constraints use ssbo_pos_pred1 as their influencer
-		internalConstraints[i].at(j).w = (float) ssbo_pos_pred1;
-		constraintsMapped[j] = internalConstraints[i].at(j);
+    for (int j = 0; j < (int)internalConstraints[i].size(); j++) {
+      EdgeConstraint &constraint = internalConstraints[i][j];
+      constraint.restLength = restLength(constraint.a, constraint.b);
     }
-    glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+  }
+  for (int i = 0; i < (int)constraintRows.size(); i++) {
+    int first = constraintRows[i].first;
+    int count = constraintRows[i].count;
+    for (int j = first; j < first + count; j++) {
+      constraintNeighbors[j].restLength = restLength(i, constraintNeighbors[j].index);
+    }
+  }
+  for (int i = 0; i < (int)coloredConstraints.size(); i++) {
+    EdgeConstraint &edge = coloredConstraints[i];
+    edge.restLength = restLength(edge.a, edge.b);
+  }
+}
+
+// same arithmetic as generateConstraints, so loaded and generated cloths match exactly
+float Cloth::restLength(int a, int b) const {
+  glm::vec4 p1 = initPositions.at(a);
+  glm::vec4 p2 = initPositions.at(b);
+  return glm::length(glm::vec3(p1.x, p1.y, p1.z) - glm::vec3(p2.x, p2.y, p2.z));
+}
+
+void Cloth::createConstraintBuffers() {
+  int numVertices = initPositions.size();
+  // all internal constraints use ssbo_pos_pred1 as their influencer, which
+  // the simulation binds for the whole dispatch
+  for (int i = 0; i < NUM_INT_CON_BUFFERS; i++) {
+	ssbo_internalConstraints[i] = createConstraintBuffer(backend, internalConstraints[i]);
   }
 
+  ssbo_constraintRows = createConstraintBuffer(backend, constraintRows);
+  ssbo_constraintNeighbors = createConstraintBuffer(backend, constraintNeighbors);
+  ssbo_coloredConstraints = createConstraintBuffer(backend, coloredConstraints);
+
   /*****************************************************************************
-  Set up the pins. These are the same format, but a negative rest length will
-  signal to the shader that "hey this is a pin constraint."
-  This is necessary for the step in which we update the inverse masses.
+  Set up the pins. Every external constraint is a pin, so the step in which we
+  update the inverse masses zeroes the mass of every vertex in here.
   *****************************************************************************/
 
   // make bufer for the external constraints (pins)
-  glGenBuffers(1, &ssbo_externalConstraints);
+  ssbo_externalConstraints = backend->createBuffer(0, NULL);
+  ssbo_pinTargets = backend->createBuffer(0, NULL);
   // these are constraints for bear_cloth to pin to its initial position
   //addPinConstraint(0, 0, ssbo_pos);
   //addPinConstraint(40, 40, ssbo_pos);
@@ -219,50 +341,45 @@ void Cloth::generateConstraints() {
   *****************************************************************************/
 
   // make space for collision constraints. these are per-vertex
-  glGenBuffers(1, &ssbo_collisionConstraints);
-  glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo_collisionConstraints);
-  glBufferData(GL_SHADER_STORAGE_BUFFER, numVertices * sizeof(glm::vec4),
-	  NULL, GL_STREAM_COPY);
-  // transfer bogus
   // collision constraints are (position vec3, bogusness)
-  glm::vec4 *constraintsMapped = (glm::vec4 *) glMapBufferRange(GL_SHADER_STORAGE_BUFFER,
-	  0, numVertices * sizeof(glm::vec4), bufMask);
-  glm::vec4 bogus = glm::vec4(-1.0f);
-  for (int j = 0; j < numVertices; j++) {
-	  constraintsMapped[j] = bogus;
-  }
-  glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+  std::vector<glm::vec4> bogus(numVertices, glm::vec4(-1.0f));
+  ssbo_collisionConstraints = backend->createBuffer(numVertices, &bogus[0]);
 }
 
-void Cloth::addPinConstraint(int thisIdx, int otherIdx, GLuint SSBO_ID) {
-	externalConstraints.push_back(glm::vec4(thisIdx, otherIdx, -1.0, (int)SSBO_ID));
+void Cloth::addPinConstraint(int thisIdx, int otherIdx, BufferHandle SSBO_ID) {
+	PinConstraint pin = { (unsigned int)thisIdx, (unsigned int)otherIdx };
+	insertPin(pin, SSBO_ID);
 	uploadExternalConstraints();
+}
+
+void Cloth::insertPin(const PinConstraint &pin, BufferHandle SSBO_ID) {
 	// search the current SSBO list to see if we need to add this one
-	int numPinnedSSBOs = pinnedSSBOs.size();
-	for (int i = 0; i < numPinnedSSBOs; i++) {
-		if (pinnedSSBOs.at(i) == SSBO_ID) return;
+	int s = std::find(pinnedSSBOs.begin(), pinnedSSBOs.end(), SSBO_ID) - pinnedSSBOs.begin();
+	if (pinOffsets.empty()) pinOffsets.push_back(0);
+	if (s == (int)pinnedSSBOs.size()) {
+		pinnedSSBOs.push_back(SSBO_ID);
+		pinOffsets.push_back(pinOffsets.back());
+	}
+	// keep the pins grouped by SSBO, so the targets of each SSBO's pins can be
+	// gathered with one dispatch over just that range
+	externalConstraints.insert(externalConstraints.begin() + pinOffsets[s + 1], pin);
+	for (int i = s + 1; i < (int)pinOffsets.size(); i++) {
+		pinOffsets[i]++;
 	}
-	pinnedSSBOs.push_back(SSBO_ID);
 }
 
-void Cloth::uploadExternalConstraints() {
-	GLint bufMask = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+void Cloth::uploadParameters() {
+  glm::vec4 params = glm::vec4(default_internal_K, default_pin_K, default_static_constraint_bounce,
+    glm::uintBitsToFloat((unsigned int)initPositions.size()));
+  backend->uploadBuffer(ssbo_clothParams, 1, &params);
+}
 
-	// allocate space for constraints on GPU
+void Cloth::uploadExternalConstraints() {
+	// allocate space for constraints on the backend and transfer
 	int numConstraints = externalConstraints.size();
 	if (numConstraints < 1) return;
-
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo_externalConstraints);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, numConstraints * sizeof(glm::vec4),
-		NULL, GL_STREAM_COPY);
-
-	// transfer
-	glm::vec4 *constraintsMapped = (glm::vec4 *) glMapBufferRange(GL_SHADER_STORAGE_BUFFER,
-		0, numConstraints * sizeof(glm::vec4), bufMask);
-
-	for (int j = 0; j < numConstraints; j++) {
-		constraintsMapped[j] = externalConstraints.at(j);
-	}
-	glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+	vector<glm::vec4> packed = packConstraints(externalConstraints);
+	backend->uploadBuffer(ssbo_externalConstraints, packed.size(), &packed[0]);
+	vector<glm::vec4> noTargets(numConstraints, glm::vec4(0.0f, 0.0f, 0.0f, glm::uintBitsToFloat(~0u)));
+	backend->uploadBuffer(ssbo_pinTargets, numConstraints, &noTargets[0]);
 }
-
@@ -1,12 +1,69 @@
 #pragma once
+#include <cstring>
 #include "mesh.hpp"
 
 #define NUM_INT_CON_BUFFERS 8 // number of internal constraint buffers
 
+// how internal constraints get projected in each solver iteration
+// - SOLVER_CONSTRAINT_BUFFERS: one dispatch per constraint buffer. anything
+//   past NUM_INT_CON_BUFFERS neighbors is dropped
+// - SOLVER_CSR: every vertex gathers all of its constraints from compressed
+//   sparse rows in a single dispatch. no cap on the number of neighbors
+// - SOLVER_COLORED: edges split into colors that share no vertices, each
+//   color projected in place (Gauss-Seidel). converges in fewer iterations
+#define SOLVER_CONSTRAINT_BUFFERS 0
+#define SOLVER_CSR 1
+#define SOLVER_COLORED 2
+#define CONSTRAINT_SOLVER SOLVER_CSR
+
+// compact constraint encodings. indices are uints, so they stay exact past
+// the 2^24 vertices a float can count to, and nothing per batch (stiffness,
+// which SSBO a constraint reads, which cloth a vertex is from) is repeated
+// per constraint: see Cloth::uploadParameters and Cloth::pinOffsets.
+// the buffers are these structs back to back (std430 packs them the same
+// way), padded out to whole vec4s, see packConstraints.
+
+// one per vertex: its neighbors are [first, first + count)
+struct ConstraintRow {
+	unsigned int first;
+	unsigned int count;
+};
+
+// one per half edge, in its vertex's row
+struct ConstraintNeighbor {
+	unsigned int index; // influencer
+	float restLength;
+};
+
+// an internal constraint moves a toward b. a colored one moves both.
+struct EdgeConstraint {
+	unsigned int a;
+	unsigned int b;
+	float restLength;
+};
+
+// vertex pinned to influencer, in the SSBO of the pin's group
+struct PinConstraint {
+	unsigned int vertex;
+	unsigned int influencer;
+};
+
+// any of the above back to back in as many vec4s as they take up
+template<typename T> std::vector<glm::vec4> packConstraints(const std::vector<T> &data) {
+	std::vector<glm::vec4> packed((data.size() * sizeof(T) + sizeof(glm::vec4) - 1) / sizeof(glm::vec4), glm::vec4(0.0f));
+	if (!data.empty()) memcpy((void *)&packed[0], &data[0], data.size() * sizeof(T));
+	return packed;
+}
+
+template<typename T> BufferHandle createConstraintBuffer(Backend *backend, const std::vector<T> &data) {
+	std::vector<glm::vec4> packed = packConstraints(data);
+	return backend->createBuffer(packed.size(), packed.empty() ? NULL : &packed[0]);
+}
+
 // holds pointers to everything for a Cloth object:
-// - (2) GL buffer for predicted positions
-// - (1) GL buffer for velocities
-// - (4) GL buffers for internal forces
+// - (2) backend buffers for predicted positions
+// - (1) backend buffer for velocities
+// - (8) backend buffers for internal forces
 
 
 class Cloth : public Mesh
@@ -17,36 +74,60 @@ public:
 	// positions will be vec4s: x, y, z, mass
 	// predicted positions will also be vec4s: x, y, z, invMass
 
-  GLuint ssbo_pos_pred1; // predicted positions buffer
-  GLuint ssbo_pos_pred2; // predicted positions buffer
+  BufferHandle ssbo_pos_pred1; // predicted positions buffer
+  BufferHandle ssbo_pos_pred2; // predicted positions buffer
 
-  GLuint ssbo_vel; // shader storage buffer object -> holds velocities
-  GLuint ssbo_debug;
+  BufferHandle ssbo_vel; // shader storage buffer object -> holds velocities
 
-  // all constraints in these buffers are vec4s:
-  // index of pos to modify, index of influencer, rest length, stiffness K
-  // a negative rest length will indicate a "pin" constraint
-  GLuint ssbo_internalConstraints[NUM_INT_CON_BUFFERS];
-  GLuint ssbo_externalConstraints;
+  // internal constraints in buffer j: every vertex's jth neighbor, see EdgeConstraint
+  BufferHandle ssbo_internalConstraints[NUM_INT_CON_BUFFERS];
+  BufferHandle ssbo_externalConstraints; // PinConstraints
+  BufferHandle ssbo_pinTargets; // per pin: target position, index of pinned vertex (uint bits). gathered every frame
 
-  GLuint ssbo_collisionConstraints;
+  BufferHandle ssbo_collisionConstraints;
+  std::vector<BufferHandle> ssbo_collisionCandidates; // per rigidbody, see Simulation::candidateLists
 
+  // the kernels read K and the bounce from ssbo_clothParams, see uploadParameters
   float default_internal_K = 0.9f;
   float default_pin_K = 1.0f;
   float default_inv_mass = 441.0f;
   float default_static_constraint_bounce = 0.1f;
+  BufferHandle ssbo_clothParams; // internal K, pin K, static constraint bounce, end vertex (uint bits)
+
+  std::vector<EdgeConstraint> internalConstraints[NUM_INT_CON_BUFFERS];
+  std::vector<PinConstraint> externalConstraints; // pin
 
-  // these vec3 constraints are index, index, rest length
-  std::vector<glm::vec4> internalConstraints[NUM_INT_CON_BUFFERS];
-  std::vector<glm::vec4> externalConstraints; // pin
+  // the same internal constraints, grouped by the vertex they move
+  std::vector<ConstraintRow> constraintRows;
+  std::vector<ConstraintNeighbor> constraintNeighbors;
+  BufferHandle ssbo_constraintRows;
+  BufferHandle ssbo_constraintNeighbors;
 
-  std::vector<GLuint> pinnedSSBOs; // SSBOs that this is pinned to
+  // the same constraints once per edge, sorted by color. no two edges in a
+  // color share a vertex.
+  std::vector<EdgeConstraint> coloredConstraints;
+  std::vector<int> colorOffsets; // color c is [colorOffsets[c], colorOffsets[c + 1])
+  BufferHandle ssbo_coloredConstraints;
 
-  Cloth(string filename, glm::vec3 jitter);
+  std::vector<BufferHandle> pinnedSSBOs; // SSBOs that this is pinned to
+  // externalConstraints are grouped by SSBO: pins to pinnedSSBOs[s] are
+  // [pinOffsets[s], pinOffsets[s + 1])
+  std::vector<int> pinOffsets;
+
+  Cloth(Backend *backend, string filename, glm::vec3 jitter);
   ~Cloth();
-  void addPinConstraint(int thisIdx, int otherIdx, GLuint SSBO_ID);
+  void addPinConstraint(int thisIdx, int otherIdx, BufferHandle SSBO_ID);
   void uploadExternalConstraints(); // upload all determined constraints.
+  virtual void uploadParameters(); // after changing any of the defaults above
+
+protected:
+  Cloth(Backend *backend); // no mesh or buffers, see ClothBatch
+  void insertPin(const PinConstraint &pin, BufferHandle SSBO_ID); // at the end of its SSBO's group
 
 private:
   void generateConstraints();
+  void colorConstraints();
+  void loadConstraints(); // from the asset instead of the two above
+  void createConstraintBuffers();
+  float restLength(int a, int b) const;
 };
\ No newline at end of file
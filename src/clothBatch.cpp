@@ -0,0 +1,150 @@
+#include <algorithm>
+#include "clothBatch.hpp"
+#include "tracer.hpp"
+
+ClothBatch::ClothBatch(Backend *backend, vector<Cloth*> &cloths) : Cloth(backend) {
+	TRACE_ZONE("pack cloths");
+	this->cloths = cloths;
+	int numCloths = cloths.size();
+
+	// vertex offsets
+	firstVertex.resize(numCloths + 1);
+	firstVertex[0] = 0;
+	for (int c = 0; c < numCloths; c++) {
+		firstVertex[c + 1] = firstVertex[c] + cloths[c]->initPositions.size();
+	}
+	int numVertices = firstVertex[numCloths];
+
+	// current state. predicted positions get overwritten before they're read.
+	vector<glm::vec4> positions(numVertices);
+	vector<glm::vec4> velocities(numVertices);
+	for (int c = 0; c < numCloths; c++) {
+		Cloth *cloth = cloths[c];
+		int count = cloth->initPositions.size();
+		if (count == 0) continue;
+		initPositions.insert(initPositions.end(), cloth->initPositions.begin(), cloth->initPositions.end());
+		backend->readBuffer(cloth->ssbo_pos, count, &positions[firstVertex[c]]);
+		backend->readBuffer(cloth->ssbo_vel, count, &velocities[firstVertex[c]]);
+	}
+	const glm::vec4 *positionData = numVertices > 0 ? &positions[0] : NULL;
+	ssbo_pos = backend->createBuffer(numVertices, positionData);
+	ssbo_vel = backend->createBuffer(numVertices, numVertices > 0 ? &velocities[0] : NULL);
+	ssbo_pos_pred1 = backend->createBuffer(numVertices, positionData);
+	ssbo_pos_pred2 = backend->createBuffer(numVertices, positionData);
+
+	vector<glm::vec4> bogus(numVertices, glm::vec4(-1.0f));
+	ssbo_collisionConstraints = backend->createBuffer(numVertices, numVertices > 0 ? &bogus[0] : NULL);
+
+	// rows and neighbors, shifted to the batch's vertex and neighbor indices
+	for (int c = 0; c < numCloths; c++) {
+		Cloth *cloth = cloths[c];
+		int firstNeighbor = constraintNeighbors.size();
+		for (int i = 0; i < (int)cloth->constraintRows.size(); i++) {
+			ConstraintRow row = cloth->constraintRows[i];
+			row.first += firstNeighbor;
+			constraintRows.push_back(row);
+		}
+		for (int i = 0; i < (int)cloth->constraintNeighbors.size(); i++) {
+			ConstraintNeighbor neighbor = cloth->constraintNeighbors[i];
+			neighbor.index += firstVertex[c];
+			constraintNeighbors.push_back(neighbor);
+		}
+	}
+	ssbo_constraintRows = createConstraintBuffer(backend, constraintRows);
+	ssbo_constraintNeighbors = createConstraintBuffer(backend, constraintNeighbors);
+
+	// the cloths don't share vertices, so color k of the batch is just
+	// color k of every cloth back to back
+	int numColors = 0;
+	for (int c = 0; c < numCloths; c++) {
+		numColors = std::max(numColors, (int)cloths[c]->colorOffsets.size() - 1);
+	}
+	colorOffsets.assign(1, 0);
+	for (int k = 0; k < numColors; k++) {
+		for (int c = 0; c < numCloths; c++) {
+			Cloth *cloth = cloths[c];
+			if (k + 1 >= (int)cloth->colorOffsets.size()) continue;
+			for (int i = cloth->colorOffsets[k]; i < cloth->colorOffsets[k + 1]; i++) {
+				EdgeConstraint edge = cloth->coloredConstraints[i];
+				edge.a += firstVertex[c];
+				edge.b += firstVertex[c];
+				coloredConstraints.push_back(edge);
+			}
+		}
+		colorOffsets.push_back(coloredConstraints.size());
+	}
+	ssbo_coloredConstraints = createConstraintBuffer(backend, coloredConstraints);
+
+	// the per-slot constraint buffers aren't packed: numInternalConstraintBuffers
+	// stays 0 and the simulation steps cloths one by one with that solver
+	numInternalConstraintBuffers = 0;
+
+	ssbo_externalConstraints = backend->createBuffer(0, NULL);
+	ssbo_pinTargets = backend->createBuffer(0, NULL);
+	packPins();
+
+	ssbo_clothParams = backend->createBuffer(numCloths, NULL);
+	uploadParameters();
+}
+
+ClothBatch::~ClothBatch() {
+	BufferHandle buffers[] = { ssbo_pos, ssbo_vel, ssbo_pos_pred1, ssbo_pos_pred2,
+		ssbo_collisionConstraints, ssbo_constraintRows, ssbo_constraintNeighbors,
+		ssbo_coloredConstraints, ssbo_externalConstraints, ssbo_pinTargets, ssbo_clothParams };
+	for (int i = 0; i < (int)(sizeof(buffers) / sizeof(buffers[0])); i++) {
+		if (buffers[i]) backend->deleteBuffer(buffers[i]);
+	}
+	for (int i = 0; i < (int)ssbo_collisionCandidates.size(); i++) {
+		if (ssbo_collisionCandidates[i]) backend->deleteBuffer(ssbo_collisionCandidates[i]);
+	}
+}
+
+void ClothBatch::unpack() {
+	vector<glm::vec4> data;
+	for (int c = 0; c < (int)cloths.size(); c++) {
+		Cloth *cloth = cloths[c];
+		int count = firstVertex[c + 1] - firstVertex[c];
+		if (count == 0) continue;
+		data.resize(count);
+		backend->readBufferRange(ssbo_pos, firstVertex[c], count, &data[0]);
+		backend->uploadBuffer(cloth->ssbo_pos, count, &data[0]);
+		backend->readBufferRange(ssbo_vel, firstVertex[c], count, &data[0]);
+		backend->uploadBuffer(cloth->ssbo_vel, count, &data[0]);
+	}
+}
+
+void ClothBatch::packPins() {
+	int numPins = 0;
+	for (int c = 0; c < (int)cloths.size(); c++) {
+		numPins += cloths[c]->externalConstraints.size();
+	}
+	if (numPins == numPackedPins) return;
+
+	externalConstraints.clear();
+	pinnedSSBOs.clear();
+	pinOffsets.clear();
+	for (int c = 0; c < (int)cloths.size(); c++) {
+		Cloth *cloth = cloths[c];
+		for (int s = 0; s < (int)cloth->pinnedSSBOs.size(); s++) {
+			for (int i = cloth->pinOffsets[s]; i < cloth->pinOffsets[s + 1]; i++) {
+				PinConstraint pin = cloth->externalConstraints[i];
+				pin.vertex += firstVertex[c];
+				insertPin(pin, cloth->pinnedSSBOs[s]);
+			}
+		}
+	}
+	uploadExternalConstraints();
+	numPackedPins = numPins;
+}
+
+void ClothBatch::uploadParameters() {
+	int numCloths = cloths.size();
+	if (numCloths == 0) return;
+	vector<glm::vec4> params(numCloths);
+	for (int c = 0; c < numCloths; c++) {
+		Cloth *cloth = cloths[c];
+		params[c] = glm::vec4(cloth->default_internal_K, cloth->default_pin_K,
+			cloth->default_static_constraint_bounce, glm::uintBitsToFloat((unsigned int)firstVertex[c + 1]));
+	}
+	backend->uploadBuffer(ssbo_clothParams, numCloths, &params[0]);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "cloth.hpp"
+
+// all cloths of a simulation packed into one big cloth, so every stage runs
+// as one dispatch over all of their vertices instead of once per cloth.
+// cloth i owns vertices [firstVertex[i], firstVertex[i + 1]) of every
+// per-vertex buffer. constraints and pins are rewritten to those indices.
+// ssbo_clothParams has one entry per cloth ending in firstVertex[i + 1], so
+// the kernels find a vertex's cloth (and its parameters) with a binary search
+// instead of every vertex and edge carrying it.
+
+class ClothBatch : public Cloth
+{
+public:
+	// copies the cloths' current positions and velocities into the batch
+	ClothBatch(Backend *backend, vector<Cloth*> &cloths);
+	~ClothBatch();
+
+	vector<Cloth*> cloths;
+	vector<int> firstVertex; // one more entry than there are cloths
+
+	// copies positions and velocities back into the cloths' own buffers
+	void unpack();
+
+	// pins can be added to the cloths at any time. repacks them if they changed.
+	void packPins();
+
+	void uploadParameters(); // every cloth's defaults
+
+private:
+	int numPackedPins = 0;
+};
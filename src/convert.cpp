@@ -0,0 +1,90 @@
+/**
+ * @file      convert.cpp
+ * @brief     precompile obj meshes into mesh assets (see asset.hpp), so
+ *            simulations over them skip parsing and constraint building,
+ *            and optionally their collision proxies (see proxy.hpp)
+ */
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include "cloth.hpp"
+#include "rbody.hpp"
+#include "asset.hpp"
+
+using namespace std;
+
+static void printUsage(const char *exe) {
+	cout << "usage: " << exe << " [options] MESH.obj..." << endl;
+	cout << "writes MESH.asset next to every MESH.obj" << endl;
+	cout << "  --cloth          only what a cloth needs (constraints, adjacency, colors)" << endl;
+	cout << "  --collider       only what a collider needs (BVH, leaf ordered triangles)" << endl;
+	cout << "                   default: both, so the asset works either way" << endl;
+	cout << "  --proxy N        also simplify colliders down to N triangles, into MESH.asset.proxy" << endl;
+	cout << "  --proxy-tolerance D  how far the proxy may stray from the mesh (default " << PROXY_TOLERANCE << ")" << endl;
+}
+
+int main(int argc, char* argv[]) {
+	bool cloth = true;
+	bool collider = true;
+	int proxyTriangles = 0;
+	float proxyTolerance = PROXY_TOLERANCE;
+	vector<string> inputs;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--cloth") == 0) collider = false;
+		else if (strcmp(argv[i], "--collider") == 0) cloth = false;
+		else if (strcmp(argv[i], "--proxy") == 0 && i + 1 < argc) proxyTriangles = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--proxy-tolerance") == 0 && i + 1 < argc) proxyTolerance = atof(argv[++i]);
+		else if (argv[i][0] == '-') {
+			printUsage(argv[0]);
+			return 1;
+		}
+		else inputs.push_back(argv[i]);
+	}
+	if (inputs.empty() || (!cloth && !collider) || proxyTriangles < 0 || (proxyTriangles > 0 && !collider)) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	int failures = 0;
+	for (int i = 0; i < (int)inputs.size(); i++) {
+		const string &input = inputs[i];
+		if (MeshAsset::isAsset(input)) {
+			cout << input << " is already an asset" << endl;
+			failures++;
+			continue;
+		}
+		auto start = chrono::high_resolution_clock::now();
+		// the constructors want somewhere to put their buffers. a fresh one
+		// per mesh, so they all go away with it.
+		Backend *backend = createCPUBackend(1);
+		Cloth *meshCloth = cloth ? new Cloth(backend, input, glm::vec3(0.0f)) : NULL;
+		Rbody *meshCollider = collider ? new Rbody(backend, input) : NULL;
+		string output = MeshAsset::pathFor(input);
+		if (MeshAsset::write(output, meshCloth, meshCollider, input)) {
+			double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+			cout << input << " -> " << output << " (" << seconds << " s)" << endl;
+		} else {
+			cout << "could not write " << output << endl;
+			failures++;
+		}
+		// the same mesh comes out of the asset, so its proxy cache works as is
+		if (proxyTriangles > 0 && (int)meshCollider->indicesTris.size() / 3 > proxyTriangles) {
+			CollisionProxy proxy;
+			proxy.build(meshCollider->initPositions, meshCollider->indicesTris, proxyTriangles, proxyTolerance);
+			string proxyOutput = Rbody::proxyPath(output);
+			unsigned long long meshHash = SDF::hashMesh(meshCollider->initPositions, meshCollider->indicesTris);
+			if (proxy.save(proxyOutput, meshHash, proxyTriangles, proxyTolerance)) {
+				cout << input << " -> " << proxyOutput << " (" << proxy.indicesTris.size() / 3 << " of " <<
+					meshCollider->indicesTris.size() / 3 << " triangles, error " << proxy.error << ")" << endl;
+			} else {
+				cout << "could not write " << proxyOutput << endl;
+				failures++;
+			}
+		}
+		delete meshCloth;
+		delete meshCollider;
+		delete backend;
+	}
+	return failures > 0 ? 1 : 0;
+}
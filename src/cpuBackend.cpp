@@ -0,0 +1,1105 @@
+#include <algorithm>
+#include <iostream>
+#include "cpuBackend.hpp"
+#include "bvh.hpp"
+#include "profiler.hpp"
+#include "triangleQueries.hpp"
+#include "primitive.hpp"
+
+// the ints in Cloth's constraint structs, in floats
+#define ROW_FLOATS 2
+#define NEIGHBOR_FLOATS 2
+#define EDGE_FLOATS 3
+#define PIN_FLOATS 2
+
+Backend *createCPUBackend(int numThreads) {
+	return new CPUBackend(numThreads);
+}
+
+void SoABuffer::resize(int n) {
+	x.resize(n);
+	y.resize(n);
+	z.resize(n);
+	w.resize(n);
+}
+
+void SoABuffer::upload(int n, const glm::vec4 *data) {
+	resize(n);
+	if (data == NULL) {
+		std::fill(x.begin(), x.end(), 0.0f);
+		std::fill(y.begin(), y.end(), 0.0f);
+		std::fill(z.begin(), z.end(), 0.0f);
+		std::fill(w.begin(), w.end(), 0.0f);
+		return;
+	}
+	for (int i = 0; i < n; i++) {
+		set(i, data[i]);
+	}
+}
+
+void SoABuffer::download(int n, glm::vec4 *data) const {
+	n = std::min(n, size());
+	for (int i = 0; i < n; i++) {
+		data[i] = get(i);
+	}
+}
+
+/******************************************************************************
+ kernels. each one is the host twin of a compute shader and reads the same
+ binding points and uniform locations.
+******************************************************************************/
+
+// cloth_pbd1_externalForces.comp.glsl
+static void externalForces(const CPUKernelArgs &args) {
+	SoABuffer &vel = *args.buffers[0];
+	float DT = args.uniforms[0].f;
+	glm::vec3 dv = args.uniforms[1].v3 * DT;
+	int numVertices = std::min(args.numItems, args.uniforms[2].i);
+
+	args.pool->parallelFor(numVertices, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			vel.x[i] += dv.x;
+			vel.y[i] += dv.y;
+			vel.z[i] += dv.z;
+		}
+	});
+}
+
+// cloth_pbd2_dampVelocities.comp.glsl
+static void dampVelocities(const CPUKernelArgs &args) {
+	SoABuffer &vel = *args.buffers[0];
+	int numVertices = std::min(args.numItems, args.uniforms[0].i);
+
+	args.pool->parallelFor(numVertices, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			vel.x[i] *= 0.95f;
+			vel.y[i] *= 0.95f;
+			vel.z[i] *= 0.95f;
+		}
+	});
+}
+
+// cloth_pbd3_predictPositions.comp.glsl
+static void predictPositions(const CPUKernelArgs &args) {
+	const SoABuffer &vel = *args.buffers[0];
+	const SoABuffer &pos = *args.buffers[1];
+	SoABuffer &pPos1 = *args.buffers[2];
+	SoABuffer &pPos2 = *args.buffers[3];
+	float DT = args.uniforms[0].f;
+	int numVertices = std::min(args.numItems, args.uniforms[1].i);
+
+	args.pool->parallelFor(numVertices, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			float px = pos.x[i] + vel.x[i] * DT;
+			float py = pos.y[i] + vel.y[i] * DT;
+			float pz = pos.z[i] + vel.z[i] * DT;
+			pPos1.x[i] = px; pPos1.y[i] = py; pPos1.z[i] = pz; pPos1.w[i] = pos.w[i];
+			pPos2.x[i] = px; pPos2.y[i] = py; pPos2.z[i] = pz; pPos2.w[i] = pos.w[i];
+		}
+	});
+}
+
+// cloth_pbd1to3_integrate.comp.glsl
+static void integrate(const CPUKernelArgs &args) {
+	SoABuffer &vel = *args.buffers[0];
+	const SoABuffer &pos = *args.buffers[1];
+	SoABuffer &pPos1 = *args.buffers[2];
+	SoABuffer &pPos2 = *args.buffers[3];
+	float DT = args.uniforms[0].f;
+	glm::vec3 dv = args.uniforms[1].v3 * DT;
+	int numVertices = std::min(args.numItems, args.uniforms[2].i);
+
+	args.pool->parallelFor(numVertices, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			float vx = (vel.x[i] + dv.x) * 0.95f;
+			float vy = (vel.y[i] + dv.y) * 0.95f;
+			float vz = (vel.z[i] + dv.z) * 0.95f;
+			vel.x[i] = vx; vel.y[i] = vy; vel.z[i] = vz;
+
+			float px = pos.x[i] + vx * DT;
+			float py = pos.y[i] + vy * DT;
+			float pz = pos.z[i] + vz * DT;
+			pPos1.x[i] = px; pPos1.y[i] = py; pPos1.z[i] = pz; pPos1.w[i] = pos.w[i];
+			pPos2.x[i] = px; pPos2.y[i] = py; pPos2.z[i] = pz; pPos2.w[i] = pos.w[i];
+		}
+	});
+}
+
+// cloth_pbd4_updateInverseMasses.comp.glsl
+static void updateInverseMasses(const CPUKernelArgs &args) {
+	SoABuffer &pPos1 = *args.buffers[0];
+	SoABuffer &pPos2 = *args.buffers[1];
+	const SoABuffer &constraints = *args.buffers[2];
+	int numConstraints = std::min(args.numItems, args.uniforms[0].i);
+
+	// few pins, and a vertex may be pinned more than once: stay on one thread
+	for (int i = 0; i < numConstraints; i++) {
+		int targetIdx = constraints.flatUint(i * PIN_FLOATS);
+		pPos1.w[targetIdx] = 0.0f;
+		pPos2.w[targetIdx] = 0.0f;
+	}
+}
+
+// cloth_pbd4_gatherPinTargets.comp.glsl
+static void gatherPinTargets(const CPUKernelArgs &args) {
+	const SoABuffer &pInfluencer = *args.buffers[0];
+	const SoABuffer &pins = *args.buffers[1];
+	SoABuffer &pinTargets = *args.buffers[2];
+	int firstPin = args.uniforms[0].i;
+	int numPins = std::min(args.numItems, args.uniforms[1].i);
+	glm::mat4 influencerTransform = args.uniforms[2].m4;
+
+	for (int pinIdx = firstPin; pinIdx < firstPin + numPins; pinIdx++) {
+		glm::vec3 influencer = pInfluencer.getXYZ(pins.flatUint(pinIdx * PIN_FLOATS + 1));
+		pinTargets.set(pinIdx, glm::vec4(glm::vec3(influencerTransform * glm::vec4(influencer, 1.0f)),
+			pins.flat(pinIdx * PIN_FLOATS)));
+	}
+}
+
+// cloth_pbd5_projectClothConstraints.comp.glsl
+// each buffer of internal constraints touches every target at most once,
+// so a buffer can be split across threads without races.
+static void projectClothConstraints(const CPUKernelArgs &args) {
+	const SoABuffer &pInfluencer = *args.buffers[0];
+	SoABuffer &pModify = *args.buffers[1];
+	const SoABuffer &constraints = *args.buffers[2];
+	float N = args.uniforms[0].f;
+	int numConstraints = std::min(args.numItems, args.uniforms[1].i);
+	float K = args.uniforms[2].f;
+	float k_prime = 1.0f - pow(1.0f - K, 1.0f / N);
+
+	args.pool->parallelFor(numConstraints, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			int targetIdx = constraints.flatUint(i * EDGE_FLOATS);
+			int influenceIdx = constraints.flatUint(i * EDGE_FLOATS + 1);
+			glm::vec3 target = pModify.getXYZ(targetIdx);
+			glm::vec3 influencer = pInfluencer.getXYZ(influenceIdx);
+
+			glm::vec3 diff = influencer - target;
+			float dist = glm::length(diff);
+			float w = pModify.w[targetIdx] / (pInfluencer.w[influenceIdx] + pModify.w[targetIdx]);
+			glm::vec3 dp1 = w * (dist - constraints.flat(i * EDGE_FLOATS + 2)) * diff / dist;
+			pModify.setXYZ(targetIdx, target + k_prime * dp1);
+		}
+	});
+}
+
+// cloth_pbd5_projectPins.comp.glsl
+// a vertex may be pinned more than once, and the last pin wins: stay on one thread
+static void projectPins(const CPUKernelArgs &args) {
+	SoABuffer &pModify = *args.buffers[1];
+	const SoABuffer &pinTargets = *args.buffers[2];
+	int numPins = std::min(args.numItems, args.uniforms[0].i);
+
+	for (int i = 0; i < numPins; i++) {
+		unsigned int vertex = glm::floatBitsToUint(pinTargets.w[i]);
+		if (vertex == ~0u) continue; // not gathered
+		pModify.setXYZ(vertex, pinTargets.getXYZ(i));
+	}
+}
+
+// clothOf in the shaders: the first cloth ending past vertex v, see
+// ClothBatch::uploadParameters
+static int clothOf(const SoABuffer &clothParams, unsigned int v) {
+	int lo = 0;
+	int hi = clothParams.size() - 1;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (glm::floatBitsToUint(clothParams.w[mid]) > v) hi = mid;
+		else lo = mid + 1;
+	}
+	return lo;
+}
+
+// cloth_pbd5_projectClothConstraintsCSR.comp.glsl
+static void projectClothConstraintsCSR(const CPUKernelArgs &args) {
+	const SoABuffer &pInfluencer = *args.buffers[0];
+	SoABuffer &pModify = *args.buffers[1];
+	const SoABuffer &rows = *args.buffers[2];
+	const SoABuffer &neighbors = *args.buffers[3];
+	const SoABuffer &clothParams = *args.buffers[4];
+	float N = args.uniforms[0].f;
+	int numVertices = std::min(args.numItems, args.uniforms[1].i);
+
+	// stiffness per cloth, see Cloth::uploadParameters
+	std::vector<float> k_prime(clothParams.size());
+	for (int i = 0; i < clothParams.size(); i++) {
+		k_prime[i] = 1.0f - pow(1.0f - clothParams.x[i], 1.0f / N);
+	}
+
+	// a vertex's constraints depend on each other, so walking one vertex's
+	// list at a time stalls on every sqrt and divide. instead step a whole
+	// chunk of vertices through their k-th constraints together, which keeps
+	// each vertex's order (and result) the same as the shader's.
+	args.pool->parallelFor(numVertices, [&](int begin, int end) {
+		// start from the influencers, pModify holds older positions
+		int maxCount = 0;
+		std::vector<int> first(end - begin);
+		std::vector<int> count(end - begin);
+		std::vector<float> vertexK(end - begin);
+		for (int idx = begin; idx < end; idx++) {
+			pModify.set(idx, pInfluencer.get(idx));
+			first[idx - begin] = rows.flatUint(idx * ROW_FLOATS);
+			count[idx - begin] = rows.flatUint(idx * ROW_FLOATS + 1);
+			vertexK[idx - begin] = k_prime[clothOf(clothParams, idx)];
+			maxCount = std::max(maxCount, count[idx - begin]);
+		}
+		for (int k = 0; k < maxCount; k++) {
+			for (int idx = begin; idx < end; idx++) {
+				if (k >= count[idx - begin]) continue;
+				int i = first[idx - begin] + k;
+				int influenceIdx = neighbors.flatUint(i * NEIGHBOR_FLOATS);
+				glm::vec3 target = pModify.getXYZ(idx);
+				glm::vec3 diff = pInfluencer.getXYZ(influenceIdx) - target;
+				float dist = glm::length(diff);
+				float w = pModify.w[idx] / (pInfluencer.w[influenceIdx] + pModify.w[idx]);
+				glm::vec3 dp1 = w * (dist - neighbors.flat(i * NEIGHBOR_FLOATS + 1)) * diff / dist;
+				pModify.setXYZ(idx, target + vertexK[idx - begin] * dp1);
+			}
+		}
+	});
+}
+
+// cloth_pbd5_projectClothConstraintsColored.comp.glsl
+static void projectClothConstraintsColored(const CPUKernelArgs &args) {
+	SoABuffer &pModify = *args.buffers[1];
+	const SoABuffer &constraints = *args.buffers[2];
+	const SoABuffer &clothParams = *args.buffers[4];
+	float N = args.uniforms[0].f;
+	int numConstraints = std::min(args.numItems, args.uniforms[1].i);
+	int firstConstraint = args.uniforms[3].i;
+
+	std::vector<float> k_prime(clothParams.size());
+	for (int i = 0; i < clothParams.size(); i++) {
+		k_prime[i] = 1.0f - pow(1.0f - clothParams.x[i], 1.0f / N);
+	}
+
+	args.pool->parallelFor(numConstraints, [&](int begin, int end) {
+		for (int i = firstConstraint + begin; i < firstConstraint + end; i++) {
+			int a = constraints.flatUint(i * EDGE_FLOATS);
+			int b = constraints.flatUint(i * EDGE_FLOATS + 1);
+			float wA = pModify.w[a];
+			float wB = pModify.w[b];
+			float wSum = wA + wB;
+			if (wSum <= 0.0f) continue; // both pinned
+
+			glm::vec3 pA = pModify.getXYZ(a);
+			glm::vec3 pB = pModify.getXYZ(b);
+			glm::vec3 diff = pB - pA;
+			float dist = glm::length(diff);
+			if (dist <= 0.0f) continue;
+
+			float restLength = constraints.flat(i * EDGE_FLOATS + 2);
+			glm::vec3 correction = k_prime[clothOf(clothParams, a)] * (dist - restLength) / wSum * diff / dist;
+			pModify.setXYZ(a, pA + wA * correction);
+			pModify.setXYZ(b, pB - wB * correction);
+		}
+	});
+}
+
+// copy.comp.glsl
+static void copyBuffer(const CPUKernelArgs &args) {
+	const SoABuffer &src = *args.buffers[0];
+	SoABuffer &dst = *args.buffers[1];
+	int numItems = std::min(args.numItems, std::min(src.size(), dst.size()));
+
+	args.pool->parallelFor(numItems, [&](int begin, int end) {
+		std::copy(src.x.begin() + begin, src.x.begin() + end, dst.x.begin() + begin);
+		std::copy(src.y.begin() + begin, src.y.begin() + end, dst.y.begin() + begin);
+		std::copy(src.z.begin() + begin, src.z.begin() + end, dst.z.begin() + begin);
+		std::copy(src.w.begin() + begin, src.w.begin() + end, dst.w.begin() + begin);
+	});
+}
+
+static void getTriangle(const SoABuffer &pBody, const SoABuffer &bodyTriangles, int i,
+	glm::vec3 &v0, glm::vec3 &v1, glm::vec3 &v2) {
+	v0 = pBody.getXYZ((int)bodyTriangles.x[i]);
+	v1 = pBody.getXYZ((int)bodyTriangles.y[i]);
+	v2 = pBody.getXYZ((int)bodyTriangles.z[i]);
+}
+
+// distanceToBox in cloth_genCollisions.comp.glsl
+static float distanceToBox(glm::vec3 P, glm::vec3 boxMin, glm::vec3 boxMax) {
+	return glm::length(glm::max(glm::max(boxMin - P, glm::vec3(0.0f)), P - boxMax));
+}
+
+// rayHitsBox in cloth_genCollisions.comp.glsl
+static bool rayHitsBox(glm::vec3 orig, glm::vec3 invDir, glm::vec3 boxMin, glm::vec3 boxMax) {
+	glm::vec3 t0 = (boxMin - orig) * invDir;
+	glm::vec3 t1 = (boxMax - orig) * invDir;
+	glm::vec3 tNear = glm::min(t0, t1);
+	glm::vec3 tFar = glm::max(t0, t1);
+	float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+	float exit = std::min(std::min(tFar.x, tFar.y), tFar.z);
+	return enter <= exit;
+}
+
+// the body's triangles, in leaf order, as the structure of arrays the batched
+// queries copy from
+static void gatherTriangles(const SoABuffer &pBody, const SoABuffer &bodyTriangles, ThreadPool *pool,
+	TriangleSoA &triangles) {
+	triangles.resize(bodyTriangles.size());
+	pool->parallelFor(triangles.size(), [&](int begin, int end) {
+		glm::vec3 v0, v1, v2;
+		for (int i = begin; i < end; i++) {
+			getTriangle(pBody, bodyTriangles, i, v0, v1, v2);
+			triangles.ax[i] = v0.x;
+			triangles.ay[i] = v0.y;
+			triangles.az[i] = v0.z;
+			triangles.bx[i] = v1.x;
+			triangles.by[i] = v1.y;
+			triangles.bz[i] = v1.z;
+			triangles.cx[i] = v2.x;
+			triangles.cy[i] = v2.y;
+			triangles.cz[i] = v2.z;
+		}
+	});
+}
+
+// what the collision kernels look a body up in, for one dispatch
+struct BodyQuery {
+	const SoABuffer &pBody;
+	const SoABuffer &bodyTriangles;
+	const SoABuffer &bodyBVH;
+	int numBVHNodes;
+	const TriangleQueries &queries;
+	TriangleSoA triangles; // see gatherTriangles
+};
+
+// the best triangle so far: the nearest, and the lowest index among equally
+// near ones. that doesn't depend on the order triangles come in, so they can
+// be tested a batch at a time.
+struct NearestTriangle {
+	float distance;
+	float triangle;
+	int slot; // in leaf order, -1 for none yet
+	glm::vec3 point;
+};
+
+static void nearestInBatch(const BodyQuery &body, TriangleBatch &batch, glm::vec3 pos, NearestTriangle &nearest) {
+	float x[TRIANGLE_BATCH_SIZE], y[TRIANGLE_BATCH_SIZE], z[TRIANGLE_BATCH_SIZE], distance[TRIANGLE_BATCH_SIZE];
+	float P[3] = { pos.x, pos.y, pos.z };
+	body.queries.nearestPoints(batch, P, x, y, z, distance);
+	for (int j = 0; j < batch.count; j++) {
+		int i = batch.slot[j];
+		if (distance[j] < nearest.distance ||
+			(distance[j] == nearest.distance && body.bodyTriangles.w[i] < nearest.triangle)) {
+			nearest.triangle = body.bodyTriangles.w[i];
+			nearest.distance = distance[j];
+			nearest.slot = i;
+			nearest.point = glm::vec3(x[j], y[j], z[j]);
+		}
+	}
+	batch.clear();
+}
+
+// walks the BVH nearest box first, skipping boxes farther than the best so
+// far. leaves get tested once there's a lane width of triangles from them,
+// so the best so far is never more than that behind.
+static void nearestOnBody(const BodyQuery &body, TriangleBatch &batch, glm::vec3 pos, NearestTriangle &nearest) {
+	const SoABuffer &bodyBVH = body.bodyBVH;
+	int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	if (body.numBVHNodes > 0) stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		int node = stack[--stackSize];
+		if (distanceToBox(pos, bodyBVH.getXYZ(2 * node), bodyBVH.getXYZ(2 * node + 1)) > nearest.distance) continue;
+
+		int first = (int)bodyBVH.w[2 * node];
+		int count = (int)bodyBVH.w[2 * node + 1];
+		if (count == 0) {
+			float leftDistance = distanceToBox(pos, bodyBVH.getXYZ(2 * first), bodyBVH.getXYZ(2 * first + 1));
+			float rightDistance = distanceToBox(pos, bodyBVH.getXYZ(2 * first + 2), bodyBVH.getXYZ(2 * first + 3));
+			bool leftFirst = leftDistance <= rightDistance;
+			stack[stackSize++] = leftFirst ? first + 1 : first;
+			stack[stackSize++] = leftFirst ? first : first + 1;
+			continue;
+		}
+
+		if (!batch.hasRoom(count)) nearestInBatch(body, batch, pos, nearest);
+		batch.add(body.triangles, first, count);
+		if (batch.count >= body.queries.width) nearestInBatch(body, batch, pos, nearest);
+	}
+	if (batch.count > 0) nearestInBatch(body, batch, pos, nearest);
+}
+
+// moves the position in the last timestep over to the nearest point, and
+// constrains it along the normal there
+static void writeStaticConstraint(int idx, const NearestTriangle &nearest, const BodyQuery &body,
+	const glm::mat4 &bodyToWorld, float staticConstraintBounce, SoABuffer &pCloth1, SoABuffer &collisionConstraints) {
+	glm::vec3 nearestPoint = nearest.point;
+	glm::vec3 nearestNormal = glm::vec3(0.0f, 0.0f, 1.0f);
+	if (nearest.slot >= 0) {
+		glm::vec3 v0, v1, v2;
+		getTriangle(body.pBody, body.bodyTriangles, nearest.slot, v0, v1, v2);
+		nearestNormal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
+	}
+
+	// back to world space. bodies only move rigidly, so normals stay unit length
+	nearestPoint = glm::vec3(bodyToWorld * glm::vec4(nearestPoint, 1.0f));
+	nearestNormal = glm::mat3(bodyToWorld) * nearestNormal;
+
+	pCloth1.setXYZ(idx, nearestPoint + nearestNormal * staticConstraintBounce);
+	collisionConstraints.set(idx, glm::vec4(nearestNormal, 1.0f));
+}
+
+// generateStaticConstraint in cloth_genCollisions.comp.glsl
+static void generateStaticConstraint(int idx, glm::vec3 pos, const BodyQuery &body, TriangleBatch &batch,
+	const glm::mat4 &bodyToWorld, float staticConstraintBounce, SoABuffer &pCloth1, SoABuffer &collisionConstraints) {
+	NearestTriangle nearest = { 1e30f, 0.0f, -1, pos };
+	nearestOnBody(body, batch, pos, nearest);
+	writeStaticConstraint(idx, nearest, body, bodyToWorld, staticConstraintBounce, pCloth1, collisionConstraints);
+}
+
+// what a ray has hit so far: how many triangles it crosses anywhere along it,
+// and the nearest crossing within the step (lowest index among equally near
+// ones). neither depends on the order triangles come in.
+struct RayHits {
+	int numCollisions;
+	float t; // along the step, < 0 for none yet
+	float triangle;
+	int slot; // in leaf order
+};
+
+// t: intersectRay's results for the batch
+static void collectHits(const BodyQuery &body, const TriangleBatch &batch, const float *t, float dirScale,
+	RayHits &hits) {
+	for (int j = 0; j < batch.count; j++) {
+		float collisionT = t[j];
+		if (collisionT > -COLLISION_EPSILON) {
+			hits.numCollisions++;
+		}
+		collisionT /= dirScale;
+		if (collisionT > 1.0f || collisionT < 0.0f) {
+			continue;
+		}
+		// use the nearest collision with distance less than 1
+		int i = batch.slot[j];
+		if (hits.t < 0.0f || collisionT < hits.t ||
+			(collisionT == hits.t && body.bodyTriangles.w[i] < hits.triangle)) {
+			hits.t = collisionT;
+			hits.triangle = body.bodyTriangles.w[i];
+			hits.slot = i;
+		}
+	}
+}
+
+static void intersectBatch(const BodyQuery &body, TriangleBatch &batch, const float orig[3], const float dir[3],
+	float dirScale, RayHits &hits) {
+	float t[TRIANGLE_BATCH_SIZE];
+	body.queries.intersectRay(batch, orig, dir, t);
+	collectHits(body, batch, t, dirScale, hits);
+	batch.clear();
+}
+
+// every triangle whose box the ray passes through. the parity test needs
+// every crossing along the ray, not just within the step.
+static void castRay(const BodyQuery &body, TriangleBatch &batch, glm::vec3 pos, glm::vec3 dir, float dirScale,
+	RayHits &hits) {
+	const SoABuffer &bodyBVH = body.bodyBVH;
+	glm::vec3 invDir = glm::vec3(
+		std::abs(dir.x) > 1e-12f ? 1.0f / dir.x : 1e12f,
+		std::abs(dir.y) > 1e-12f ? 1.0f / dir.y : 1e12f,
+		std::abs(dir.z) > 1e-12f ? 1.0f / dir.z : 1e12f);
+	float orig[3] = { pos.x, pos.y, pos.z };
+	float rayDir[3] = { dir.x, dir.y, dir.z };
+
+	int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	if (body.numBVHNodes > 0) stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		int node = stack[--stackSize];
+		if (!rayHitsBox(pos, invDir, bodyBVH.getXYZ(2 * node), bodyBVH.getXYZ(2 * node + 1))) continue;
+
+		int first = (int)bodyBVH.w[2 * node];
+		int count = (int)bodyBVH.w[2 * node + 1];
+		if (count == 0) {
+			stack[stackSize++] = first;
+			stack[stackSize++] = first + 1;
+			continue;
+		}
+
+		if (!batch.hasRoom(count)) intersectBatch(body, batch, orig, rayDir, dirScale, hits);
+		batch.add(body.triangles, first, count);
+	}
+	if (batch.count > 0) intersectBatch(body, batch, orig, rayDir, dirScale, hits);
+}
+
+// the nearest hit within the step: normal in world space, and how far along
+// the step it is. all -1 if there wasn't one.
+static glm::vec4 hitConstraint(const BodyQuery &body, const RayHits &hits, const glm::mat4 &bodyToWorld) {
+	glm::vec4 collisionConstraint = glm::vec4(-1.0f);
+	if (hits.slot >= 0) {
+		glm::vec3 v0, v1, v2;
+		getTriangle(body.pBody, body.bodyTriangles, hits.slot, v0, v1, v2);
+		collisionConstraint = glm::vec4(glm::normalize(glm::cross(v1 - v0, v2 - v0)), hits.t);
+	}
+	glm::vec3 worldNormal = glm::mat3(bodyToWorld) * glm::vec3(collisionConstraint);
+	return glm::vec4(worldNormal, collisionConstraint.w);
+}
+
+// cloth_genCollisions.comp.glsl
+static void genCollisions(const CPUKernelArgs &args) {
+	SoABuffer &pCloth1 = *args.buffers[0];
+	const SoABuffer &pCloth2 = *args.buffers[1];
+	SoABuffer &collisionConstraints = *args.buffers[4];
+	const SoABuffer &clothParams = *args.buffers[5];
+	int numPositions = std::min(args.numItems, args.uniforms[1].i);
+	glm::mat4 bodyToWorld = args.uniforms[3].m4;
+	glm::mat4 worldToBody = args.uniforms[4].m4;
+
+	BodyQuery body = { *args.buffers[2], *args.buffers[3], *args.buffers[6], args.uniforms[0].i,
+		triangleQueries::best(), TriangleSoA() };
+	gatherTriangles(body.pBody, body.bodyTriangles, args.pool, body.triangles);
+
+	args.pool->parallelFor(numPositions, [&](int begin, int end) {
+		TriangleBatch batch;
+		for (int idx = begin; idx < end; idx++) {
+			// already have a valid constraint from another body, do nothing
+			if (collisionConstraints.w[idx] >= 0.0f) continue;
+			// infinite weighted, do nothing
+			if (pCloth1.w[idx] < COLLISION_EPSILON) continue;
+
+			// everything up to the constraint itself happens in body space
+			glm::vec3 pos = glm::vec3(worldToBody * glm::vec4(pCloth1.getXYZ(idx), 1.0f));
+			glm::vec3 lookAt = glm::vec3(worldToBody * glm::vec4(pCloth2.getXYZ(idx), 1.0f));
+			float dirScale = glm::length(lookAt - pos);
+			glm::vec3 dir = glm::normalize(lookAt - pos);
+			RayHits hits = { 0, -1.0f, 0.0f, -1 };
+			castRay(body, batch, pos, dir, dirScale, hits);
+
+			// odd number of collisions: we're already inside, use a static constraint
+			if (hits.numCollisions % 2 != 0) {
+				float staticConstraintBounce = clothParams.z[clothOf(clothParams, idx)];
+				generateStaticConstraint(idx, pos, body, batch, bodyToWorld, staticConstraintBounce,
+					pCloth1, collisionConstraints);
+				continue;
+			}
+			collisionConstraints.set(idx, hitConstraint(body, hits, bodyToWorld));
+		}
+	});
+}
+
+// every triangle within skin of pos, as vertex idx's new candidate list.
+// more than fit marks the list full: the vertex walks the BVH until it has
+// moved far enough for another try.
+static void buildCandidates(const BodyQuery &body, TriangleBatch &batch, int idx, glm::vec3 pos, float skin,
+	bool inside, SoABuffer &candidates) {
+	int header = idx * CANDIDATE_VEC4S;
+	int count = 0;
+	auto keepNear = [&]() {
+		float x[TRIANGLE_BATCH_SIZE], y[TRIANGLE_BATCH_SIZE], z[TRIANGLE_BATCH_SIZE], distance[TRIANGLE_BATCH_SIZE];
+		float P[3] = { pos.x, pos.y, pos.z };
+		body.queries.nearestPoints(batch, P, x, y, z, distance);
+		for (int j = 0; j < batch.count; j++) {
+			if (!(distance[j] <= skin)) continue;
+			if (count < CANDIDATE_CAPACITY) candidates.setFlatUint(4 * (header + 1) + count, batch.slot[j]);
+			count++;
+		}
+		batch.clear();
+	};
+
+	const SoABuffer &bodyBVH = body.bodyBVH;
+	int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	if (body.numBVHNodes > 0) stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		int node = stack[--stackSize];
+		if (distanceToBox(pos, bodyBVH.getXYZ(2 * node), bodyBVH.getXYZ(2 * node + 1)) > skin) continue;
+
+		int first = (int)bodyBVH.w[2 * node];
+		int numTriangles = (int)bodyBVH.w[2 * node + 1];
+		if (numTriangles == 0) {
+			stack[stackSize++] = first;
+			stack[stackSize++] = first + 1;
+			continue;
+		}
+
+		if (!batch.hasRoom(numTriangles)) keepNear();
+		batch.add(body.triangles, first, numTriangles);
+	}
+	if (batch.count > 0) keepNear();
+
+	unsigned int flags = std::min(count, CANDIDATE_CAPACITY + 1) | CANDIDATES_BUILT | (inside ? CANDIDATES_INSIDE : 0);
+	candidates.set(header, glm::vec4(pos, glm::uintBitsToFloat(flags)));
+}
+
+// cloth_genCollisionsCandidates.comp.glsl
+static void genCollisionsCandidates(const CPUKernelArgs &args) {
+	SoABuffer &pCloth1 = *args.buffers[0];
+	const SoABuffer &pCloth2 = *args.buffers[1];
+	SoABuffer &collisionConstraints = *args.buffers[4];
+	const SoABuffer &clothParams = *args.buffers[5];
+	SoABuffer &candidates = *args.buffers[7];
+	int numPositions = std::min(args.numItems, args.uniforms[1].i);
+	float skin = args.uniforms[2].f;
+	float reach = skin * CANDIDATE_REACH;
+	glm::mat4 bodyToWorld = args.uniforms[3].m4;
+	glm::mat4 worldToBody = args.uniforms[4].m4;
+
+	BodyQuery body = { *args.buffers[2], *args.buffers[3], *args.buffers[6], args.uniforms[0].i,
+		triangleQueries::best(), TriangleSoA() };
+	gatherTriangles(body.pBody, body.bodyTriangles, args.pool, body.triangles);
+
+	args.pool->parallelFor(numPositions, [&](int begin, int end) {
+		TriangleBatch batch;
+		float t[TRIANGLE_BATCH_SIZE];
+		for (int idx = begin; idx < end; idx++) {
+			// already have a valid constraint from another body, do nothing
+			if (collisionConstraints.w[idx] >= 0.0f) continue;
+			// infinite weighted, do nothing
+			if (pCloth1.w[idx] < COLLISION_EPSILON) continue;
+
+			// everything up to the constraint itself happens in body space
+			glm::vec3 pos = glm::vec3(worldToBody * glm::vec4(pCloth1.getXYZ(idx), 1.0f));
+			glm::vec3 lookAt = glm::vec3(worldToBody * glm::vec4(pCloth2.getXYZ(idx), 1.0f));
+			float dirScale = glm::length(lookAt - pos);
+			glm::vec3 dir = glm::normalize(lookAt - pos);
+			float staticConstraintBounce = clothParams.z[clothOf(clothParams, idx)];
+
+			int header = idx * CANDIDATE_VEC4S;
+			glm::vec3 listPos = candidates.getXYZ(header);
+			unsigned int flags = candidates.flatUint(4 * header + 3);
+			int count = flags & CANDIDATES_COUNT;
+			float moved = glm::length(pos - listPos);
+			bool near = (flags & CANDIDATES_BUILT) && moved + dirScale <= reach;
+			RayHits hits = { 0, -1.0f, 0.0f, -1 };
+
+			if (!near || count > CANDIDATE_CAPACITY) {
+				castRay(body, batch, pos, dir, dirScale, hits);
+				bool inside = hits.numCollisions % 2 != 0;
+				// a list around here for the next steps, unless the vertex
+				// moves too fast for one to last
+				if (!near && dirScale < 0.5f * reach) buildCandidates(body, batch, idx, pos, skin, inside, candidates);
+				if (inside) {
+					generateStaticConstraint(idx, pos, body, batch, bodyToWorld, staticConstraintBounce,
+						pCloth1, collisionConstraints);
+					continue;
+				}
+				collisionConstraints.set(idx, hitConstraint(body, hits, bodyToWorld));
+				continue;
+			}
+
+			// everything the step can reach is on the list
+			for (int k = 0; k < count; k++) {
+				batch.add(body.triangles, candidates.flatUint(4 * (header + 1) + k), 1);
+			}
+			float orig[3] = { pos.x, pos.y, pos.z };
+			float rayDir[3] = { dir.x, dir.y, dir.z };
+			body.queries.intersectRay(batch, orig, rayDir, t);
+			collectHits(body, batch, t, dirScale, hits);
+
+			// inside or not is what it was where the list was built, flipped
+			// by every crossing on the way from there
+			bool inside = (flags & CANDIDATES_INSIDE) != 0;
+			if (moved > 0.0f) {
+				glm::vec3 path = (pos - listPos) / moved;
+				float pathOrig[3] = { listPos.x, listPos.y, listPos.z };
+				float pathDir[3] = { path.x, path.y, path.z };
+				body.queries.intersectRay(batch, pathOrig, pathDir, t);
+				for (int k = 0; k < count; k++) {
+					if (t[k] > 0.0f && t[k] <= moved) inside = !inside;
+				}
+			}
+			if (!inside) {
+				batch.clear();
+				collisionConstraints.set(idx, hitConstraint(body, hits, bodyToWorld));
+				continue;
+			}
+
+			// the nearest point is on the list too if it's near enough
+			NearestTriangle nearest = { 1e30f, 0.0f, -1, pos };
+			nearestInBatch(body, batch, pos, nearest);
+			if (nearest.distance > reach - moved) {
+				nearest.distance = 1e30f;
+				nearest.slot = -1;
+				nearest.point = pos;
+				nearestOnBody(body, batch, pos, nearest);
+			}
+			writeStaticConstraint(idx, nearest, body, bodyToWorld, staticConstraintBounce, pCloth1, collisionConstraints);
+		}
+	});
+}
+
+// cloth_projectCollisions.comp.glsl
+static void projectCollisions(const CPUKernelArgs &args) {
+	const SoABuffer &pCloth1 = *args.buffers[0];
+	SoABuffer &pCloth2 = *args.buffers[1];
+	const SoABuffer &collisionConstraints = *args.buffers[2];
+	int numPositions = std::min(args.numItems, args.uniforms[0].i);
+	float bounceFactor = args.uniforms[1].f;
+
+	args.pool->parallelFor(numPositions, [&](int begin, int end) {
+		for (int idx = begin; idx < end; idx++) {
+			glm::vec4 constraint = collisionConstraints.get(idx);
+			if (constraint.w < -0.01f) continue; // no correction
+
+			glm::vec3 posOldTimestep = pCloth1.getXYZ(idx);
+			glm::vec3 posNewTimestep = pCloth2.getXYZ(idx);
+			glm::vec3 n = glm::vec3(constraint);
+			glm::vec3 isx = (posNewTimestep - posOldTimestep) * constraint.w + posOldTimestep;
+			glm::vec3 correction = glm::dot(isx - posNewTimestep, n) * (1.0f + bounceFactor) * n;
+			pCloth2.setXYZ(idx, posNewTimestep + correction);
+		}
+	});
+}
+
+// cloth_pbd6_updatePositionsVelocities.comp.glsl
+static void updatePositionsVelocities(const CPUKernelArgs &args) {
+	SoABuffer &vel = *args.buffers[0];
+	SoABuffer &pos = *args.buffers[1];
+	const SoABuffer &pPos = *args.buffers[2];
+	SoABuffer &colConstraints = *args.buffers[3];
+	float DT = args.uniforms[0].f;
+	int numVertices = std::min(args.numItems, args.uniforms[1].i);
+
+	args.pool->parallelFor(numVertices, [&](int begin, int end) {
+		for (int idx = begin; idx < end; idx++) {
+			glm::vec3 predictedPosition = pPos.getXYZ(idx);
+			glm::vec3 predictedVelocity = (predictedPosition - pos.getXYZ(idx)) / DT;
+
+			// if there was a collision constraint, bounce baby bounce
+			glm::vec4 constraint = colConstraints.get(idx);
+			if (constraint.w >= 0.0f) {
+				glm::vec3 n = glm::vec3(constraint);
+				predictedVelocity -= 2.0f * glm::dot(predictedVelocity, n) * n;
+			}
+
+			vel.setXYZ(idx, predictedVelocity);
+			pos.setXYZ(idx, predictedPosition);
+			colConstraints.set(idx, glm::vec4(-1.0f));
+		}
+	});
+}
+
+// rigidbody_animate.comp.glsl
+static void rigidbodyAnimate(const CPUKernelArgs &args) {
+	const SoABuffer &initPos = *args.buffers[0];
+	SoABuffer &animPos = *args.buffers[1];
+	int numVertices = std::min(args.numItems, args.uniforms[0].i);
+	glm::mat4 modelMatrix = args.uniforms[1].m4;
+
+	args.pool->parallelFor(numVertices, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			animPos.set(i, modelMatrix * initPos.get(i));
+		}
+	});
+}
+
+// rigidbody_refitBVH.comp.glsl
+static void rigidbodyRefitBVH(const CPUKernelArgs &args) {
+	const SoABuffer &restNodes = *args.buffers[0];
+	SoABuffer &nodes = *args.buffers[1];
+	int numNodes = std::min(args.numItems, args.uniforms[0].i);
+	glm::mat4 modelMatrix = args.uniforms[1].m4;
+	glm::mat3 absRotation = glm::mat3(glm::abs(glm::vec3(modelMatrix[0])),
+		glm::abs(glm::vec3(modelMatrix[1])), glm::abs(glm::vec3(modelMatrix[2])));
+
+	args.pool->parallelFor(numNodes, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			glm::vec4 restMin = restNodes.get(2 * i);
+			glm::vec4 restMax = restNodes.get(2 * i + 1);
+			glm::vec3 center = glm::vec3(modelMatrix * glm::vec4((glm::vec3(restMin) + glm::vec3(restMax)) * 0.5f, 1.0f));
+			glm::vec3 extent = absRotation * ((glm::vec3(restMax) - glm::vec3(restMin)) * 0.5f);
+			nodes.set(2 * i, glm::vec4(center - extent, restMin.w));
+			nodes.set(2 * i + 1, glm::vec4(center + extent, restMax.w));
+		}
+	});
+}
+
+// sampleSDF in cloth_genCollisionsSDF.comp.glsl
+static glm::vec4 sampleSDF(const SoABuffer &bodySDF, glm::vec3 p,
+	glm::vec3 sdfOrigin, glm::vec3 sdfCellSize, glm::vec3 sdfDims) {
+	glm::vec3 g = (p - sdfOrigin) / sdfCellSize;
+	if (g.x < 0.0f || g.y < 0.0f || g.z < 0.0f ||
+		g.x >= sdfDims.x - 1.0f || g.y >= sdfDims.y - 1.0f || g.z >= sdfDims.z - 1.0f) {
+		return glm::vec4(0.0f, 0.0f, 0.0f, 1e30f);
+	}
+	glm::ivec3 c = glm::ivec3(g);
+	glm::vec3 f = g - glm::vec3(c);
+	int dy = (int)sdfDims.x;
+	int dz = (int)sdfDims.x * (int)sdfDims.y;
+	int i = c.z * dz + c.y * dy + c.x;
+	glm::vec4 x00 = glm::mix(bodySDF.get(i), bodySDF.get(i + 1), f.x);
+	glm::vec4 x10 = glm::mix(bodySDF.get(i + dy), bodySDF.get(i + dy + 1), f.x);
+	glm::vec4 x01 = glm::mix(bodySDF.get(i + dz), bodySDF.get(i + dz + 1), f.x);
+	glm::vec4 x11 = glm::mix(bodySDF.get(i + dz + dy), bodySDF.get(i + dz + dy + 1), f.x);
+	return glm::mix(glm::mix(x00, x10, f.y), glm::mix(x01, x11, f.y), f.z);
+}
+
+// the main of cloth_genCollisionsSDF.comp.glsl and
+// cloth_genCollisionsPrimitive.comp.glsl, around whichever signed distance
+// the body has: sample(p) is (outward normal, signed distance) in body space
+template<class Sample> static void genCollisionsFromDistance(const CPUKernelArgs &args, const Sample &sample) {
+	SoABuffer &pCloth1 = *args.buffers[0];
+	const SoABuffer &pCloth2 = *args.buffers[1];
+	SoABuffer &collisionConstraints = *args.buffers[4];
+	const SoABuffer &clothParams = *args.buffers[5];
+	int numPositions = std::min(args.numItems, args.uniforms[1].i);
+	glm::mat4 bodyToWorld = args.uniforms[3].m4;
+	glm::mat4 worldToBody = args.uniforms[4].m4;
+
+	args.pool->parallelFor(numPositions, [&](int begin, int end) {
+		for (int idx = begin; idx < end; idx++) {
+			if (collisionConstraints.w[idx] >= 0.0f) continue;
+			if (pCloth1.w[idx] < COLLISION_EPSILON) continue;
+
+			glm::vec3 pos = glm::vec3(worldToBody * glm::vec4(pCloth1.getXYZ(idx), 1.0f));
+			glm::vec3 lookAt = glm::vec3(worldToBody * glm::vec4(pCloth2.getXYZ(idx), 1.0f));
+
+			glm::vec4 sampleNew = sample(lookAt);
+			if (sampleNew.w >= 0.0f) continue; // ends up outside, nothing to do
+
+			glm::vec3 n = glm::vec3(sampleNew);
+			glm::vec3 worldNormal = glm::mat3(bodyToWorld) * n;
+			glm::vec4 sampleOld = sample(pos);
+			float approach = glm::dot(lookAt - pos, n);
+
+			// came in from outside during this step: crossing constraint
+			if (sampleOld.w >= 0.0f && approach < -COLLISION_EPSILON) {
+				float t = glm::clamp(1.0f - sampleNew.w / approach, 0.0f, 1.0f);
+				collisionConstraints.set(idx, glm::vec4(worldNormal, t));
+				continue;
+			}
+
+			// already inside: static constraint from the nearest surface point
+			glm::vec4 inside = sampleOld.w < 0.0f ? sampleOld : sampleNew;
+			glm::vec3 insidePos = sampleOld.w < 0.0f ? pos : lookAt;
+			if (sampleOld.w < 0.0f) {
+				n = glm::vec3(sampleOld);
+				worldNormal = glm::mat3(bodyToWorld) * n;
+			}
+			float staticConstraintBounce = clothParams.z[clothOf(clothParams, idx)];
+			glm::vec3 nearestPoint = glm::vec3(bodyToWorld * glm::vec4(insidePos - n * inside.w, 1.0f));
+			pCloth1.setXYZ(idx, nearestPoint + worldNormal * staticConstraintBounce);
+			collisionConstraints.set(idx, glm::vec4(worldNormal, 1.0f));
+		}
+	});
+}
+
+// cloth_genCollisionsSDF.comp.glsl
+static void genCollisionsSDF(const CPUKernelArgs &args) {
+	const SoABuffer &bodySDF = *args.buffers[2];
+	glm::vec3 sdfOrigin = args.uniforms[5].v3;
+	glm::vec3 sdfCellSize = args.uniforms[6].v3;
+	glm::vec3 sdfDims = args.uniforms[7].v3;
+	genCollisionsFromDistance(args, [&](glm::vec3 p) {
+		return sampleSDF(bodySDF, p, sdfOrigin, sdfCellSize, sdfDims);
+	});
+}
+
+// samplePrimitive in cloth_genCollisionsPrimitive.comp.glsl, on a buffer
+// from Primitive::pack
+static glm::vec4 samplePrimitive(const SoABuffer &shape, glm::vec3 p) {
+	int type = (int)shape.x[0];
+	float radius = shape.y[0];
+	glm::vec3 center = shape.getXYZ(1);
+	glm::vec3 extent = shape.getXYZ(2);
+
+	if (type == PRIMITIVE_PLANE) {
+		return glm::vec4(extent, glm::dot(p - center, extent));
+	}
+	if (type == PRIMITIVE_SPHERE || type == PRIMITIVE_CAPSULE) {
+		// a sphere is a capsule whose ends meet
+		glm::vec3 nearest = center;
+		if (type == PRIMITIVE_CAPSULE) {
+			glm::vec3 segment = extent - center;
+			float lengthSquared = glm::dot(segment, segment);
+			float t = lengthSquared > 0.0f ? glm::clamp(glm::dot(p - center, segment) / lengthSquared, 0.0f, 1.0f) : 0.0f;
+			nearest = center + segment * t;
+		}
+		glm::vec3 offset = p - nearest;
+		float gap = glm::length(offset);
+		glm::vec3 n = gap > 0.0f ? offset / gap : glm::vec3(0.0f, 0.0f, 1.0f);
+		return glm::vec4(n, gap - radius);
+	}
+	if (type == PRIMITIVE_BOX) {
+		glm::mat3 axes = glm::mat3(shape.getXYZ(3), shape.getXYZ(4), shape.getXYZ(5));
+		glm::vec3 local = glm::transpose(axes) * (p - center);
+		glm::vec3 side = glm::sign(local);
+		glm::vec3 q = glm::abs(local) - extent;
+		float deepest = std::max(std::max(q.x, q.y), q.z);
+		if (deepest <= 0.0f) {
+			// inside: out through the nearest face
+			int face = q.x == deepest ? 0 : (q.y == deepest ? 1 : 2);
+			glm::vec3 n = glm::vec3(0.0f);
+			n[face] = side[face] != 0.0f ? side[face] : 1.0f;
+			return glm::vec4(axes * n, deepest);
+		}
+		glm::vec3 outside = glm::max(q, glm::vec3(0.0f));
+		float gap = glm::length(outside);
+		return glm::vec4(axes * (side * outside / gap), gap);
+	}
+	if (type == PRIMITIVE_HEIGHTFIELD) {
+		glm::ivec2 dims = glm::ivec2((int)shape.z[0], (int)shape.w[0]);
+		glm::vec2 g = (glm::vec2(p) - glm::vec2(center)) / glm::vec2(extent);
+		if (g.x < 0.0f || g.y < 0.0f || g.x >= dims.x - 1.0f || g.y >= dims.y - 1.0f) {
+			return glm::vec4(0.0f, 0.0f, 0.0f, 1e30f);
+		}
+		glm::ivec2 c = glm::ivec2(g);
+		glm::vec2 f = g - glm::vec2(c);
+		int i = c.y * dims.x + c.x;
+		int heights = 4 * PRIMITIVE_HEADER_VEC4S;
+		float h00 = shape.flat(heights + i);
+		float h10 = shape.flat(heights + i + 1);
+		float h01 = shape.flat(heights + i + dims.x);
+		float h11 = shape.flat(heights + i + dims.x + 1);
+		if (std::min(std::min(h00, h10), std::min(h01, h11)) <= PRIMITIVE_HOLE) {
+			return glm::vec4(0.0f, 0.0f, 0.0f, 1e30f);
+		}
+		// the cell's two triangles, split from (0, 0) to (1, 1)
+		glm::vec2 slope = f.x >= f.y ? glm::vec2(h10 - h00, h11 - h10) : glm::vec2(h11 - h01, h01 - h00);
+		float height = h00 + slope.x * f.x + slope.y * f.y;
+		glm::vec3 n = glm::normalize(glm::vec3(-slope / glm::vec2(extent), 1.0f));
+		return glm::vec4(n, (p.z - height) * n.z);
+	}
+	return glm::vec4(0.0f, 0.0f, 0.0f, 1e30f);
+}
+
+// cloth_genCollisionsPrimitive.comp.glsl
+static void genCollisionsPrimitive(const CPUKernelArgs &args) {
+	const SoABuffer &shape = *args.buffers[2];
+	genCollisionsFromDistance(args, [&](glm::vec3 p) {
+		return samplePrimitive(shape, p);
+	});
+}
+
+typedef void(*CPUKernel)(const CPUKernelArgs &args);
+
+// host kernel for each ComputeKernel, in enum order
+static const CPUKernel kernels[NUM_KERNELS] = {
+	externalForces,
+	dampVelocities,
+	predictPositions,
+	updateInverseMasses,
+	projectClothConstraints,
+	updatePositionsVelocities,
+	copyBuffer,
+	genCollisions,
+	projectCollisions,
+	rigidbodyAnimate,
+	rigidbodyRefitBVH,
+	genCollisionsSDF,
+	projectClothConstraintsCSR,
+	projectClothConstraintsColored,
+	integrate,
+	gatherPinTargets,
+	projectPins,
+	genCollisionsCandidates,
+	genCollisionsPrimitive
+};
+
+/******************************************************************************
+ backend
+******************************************************************************/
+
+CPUBackend::CPUBackend(int numThreads) : pool(numThreads) {
+	for (int i = 0; i < CPU_MAX_BINDINGS; i++) {
+		bindings[i] = 0;
+	}
+}
+
+CPUBackend::~CPUBackend() {
+	std::map<BufferHandle, SoABuffer*>::iterator it;
+	for (it = buffers.begin(); it != buffers.end(); it++) {
+		delete it->second;
+	}
+}
+
+BufferHandle CPUBackend::createBuffer(int numItems, const glm::vec4 *data) {
+	TRACE_ZONE("create buffer");
+	BufferHandle handle = nextHandle++;
+	SoABuffer *buffer = new SoABuffer();
+	buffer->upload(numItems, data);
+	buffers[handle] = buffer;
+	return handle;
+}
+
+void CPUBackend::uploadBuffer(BufferHandle buffer, int numItems, const glm::vec4 *data) {
+	TRACE_ZONE("upload buffer");
+	getBuffer(buffer)->upload(numItems, data);
+}
+
+void CPUBackend::readBuffer(BufferHandle buffer, int numItems, glm::vec4 *data) {
+	TRACE_ZONE("read buffer");
+	getBuffer(buffer)->download(numItems, data);
+}
+
+void CPUBackend::readBufferRange(BufferHandle buffer, int first, int numItems, glm::vec4 *data) {
+	TRACE_ZONE("read buffer");
+	SoABuffer *soa = getBuffer(buffer);
+	numItems = std::min(numItems, soa->size() - first);
+	for (int i = 0; i < numItems; i++) {
+		data[i] = soa->get(first + i);
+	}
+}
+
+void CPUBackend::deleteBuffer(BufferHandle buffer) {
+	delete buffers[buffer];
+	buffers.erase(buffer);
+}
+
+SoABuffer *CPUBackend::getBuffer(BufferHandle buffer) {
+	std::map<BufferHandle, SoABuffer*>::iterator it = buffers.find(buffer);
+	if (it == buffers.end()) {
+		std::cerr << "cpu backend: no buffer with handle " << buffer << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	return it->second;
+}
+
+void CPUBackend::useKernel(ComputeKernel kernel) {
+	currentKernel = kernel;
+}
+
+void CPUBackend::setUniform(int location, int value) {
+	uniforms[currentKernel][location].i = value;
+}
+
+void CPUBackend::setUniform(int location, float value) {
+	uniforms[currentKernel][location].f = value;
+}
+
+void CPUBackend::setUniform(int location, const glm::vec3 &value) {
+	uniforms[currentKernel][location].v3 = value;
+}
+
+void CPUBackend::setUniform(int location, const glm::mat4 &value) {
+	uniforms[currentKernel][location].m4 = value;
+}
+
+void CPUBackend::bindBuffer(int binding, BufferHandle buffer) {
+	bindings[binding] = buffer;
+}
+
+void CPUBackend::dispatch(int numItems) {
+	if (numItems < 1) return;
+	CPUKernelArgs args;
+	args.pool = &pool;
+	args.uniforms = uniforms[currentKernel];
+	args.numItems = numItems;
+	for (int i = 0; i < CPU_MAX_BINDINGS; i++) {
+		args.buffers[i] = bindings[i] ? getBuffer(bindings[i]) : NULL;
+	}
+	if (profiler) profiler->beginDispatch(currentKernel);
+	{
+		TRACE_ZONE(kernelNames[currentKernel]);
+		kernels[currentKernel](args);
+	}
+	if (profiler) profiler->endDispatch();
+}
+
+void CPUBackend::writeTimestamp(int query) {
+	if (query >= (int)timestamps.size()) timestamps.resize(query + 1);
+	timestamps[query] = currentTimestamp();
+}
+
+bool CPUBackend::readTimestamp(int query, unsigned long long &ns) {
+	if (query >= (int)timestamps.size()) return false;
+	ns = timestamps[query];
+	return true;
+}
+
+unsigned long long CPUBackend::currentTimestamp() {
+	return Tracer::now();
+}
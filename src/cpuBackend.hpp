@@ -0,0 +1,119 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <chrono>
+#include "backend.hpp"
+#include "threadPool.hpp"
+
+// CPU reference version of the compute shader pipeline.
+// every kernel mirrors one of the compute shaders in shaders/ and runs over
+// host memory with a ThreadPool, so a cloth can be stepped without a GPU
+// and results can be compared against the GL backend.
+
+#define CPU_MAX_BINDINGS 8
+#define CPU_MAX_UNIFORMS 8
+
+// vec4 data stored as structure-of-arrays: each kernel only streams the
+// components it actually touches (ex: damping never reads w)
+struct SoABuffer
+{
+	std::vector<float> x, y, z, w;
+
+	int size() const { return x.size(); }
+	void resize(int n);
+	void upload(int n, const glm::vec4 *data);
+	void download(int n, glm::vec4 *data) const;
+
+	glm::vec4 get(int i) const { return glm::vec4(x[i], y[i], z[i], w[i]); }
+	glm::vec3 getXYZ(int i) const { return glm::vec3(x[i], y[i], z[i]); }
+	void set(int i, const glm::vec4 &v) { x[i] = v.x; y[i] = v.y; z[i] = v.z; w[i] = v.w; }
+	void setXYZ(int i, const glm::vec3 &v) { x[i] = v.x; y[i] = v.y; z[i] = v.z; }
+
+	// the buffer as the flat array of floats a shader sees: f is component
+	// f % 4 of item f / 4. the compact constraints (see cloth.hpp) are structs
+	// of uints and floats back to back, so they get read this way.
+	float flat(int f) const {
+		int i = f >> 2;
+		switch (f & 3) {
+		case 0: return x[i];
+		case 1: return y[i];
+		case 2: return z[i];
+		default: return w[i];
+		}
+	}
+	unsigned int flatUint(int f) const { return glm::floatBitsToUint(flat(f)); }
+	void setFlat(int f, float v) {
+		int i = f >> 2;
+		switch (f & 3) {
+		case 0: x[i] = v; break;
+		case 1: y[i] = v; break;
+		case 2: z[i] = v; break;
+		default: w[i] = v; break;
+		}
+	}
+	void setFlatUint(int f, unsigned int v) { setFlat(f, glm::uintBitsToFloat(v)); }
+};
+
+// a uniform location can hold any of the types the shaders use
+struct CPUUniform
+{
+	int i = 0;
+	float f = 0.0f;
+	glm::vec3 v3;
+	glm::mat4 m4;
+};
+
+// everything a kernel can see for one dispatch
+struct CPUKernelArgs
+{
+	ThreadPool *pool;
+	SoABuffer *buffers[CPU_MAX_BINDINGS];
+	const CPUUniform *uniforms;
+	int numItems;
+};
+
+class CPUBackend : public Backend
+{
+public:
+	CPUBackend(int numThreads);
+	~CPUBackend();
+
+	ThreadPool pool;
+
+	const char *name() { return "cpu"; }
+	bool isGL() { return false; }
+
+	BufferHandle createBuffer(int numItems, const glm::vec4 *data);
+	void uploadBuffer(BufferHandle buffer, int numItems, const glm::vec4 *data);
+	void readBuffer(BufferHandle buffer, int numItems, glm::vec4 *data);
+	void readBufferRange(BufferHandle buffer, int first, int numItems, glm::vec4 *data);
+	void deleteBuffer(BufferHandle buffer);
+
+	void useKernel(ComputeKernel kernel);
+	void setUniform(int location, int value);
+	void setUniform(int location, float value);
+	void setUniform(int location, const glm::vec3 &value);
+	void setUniform(int location, const glm::mat4 &value);
+	void bindBuffer(int binding, BufferHandle buffer);
+	void dispatch(int numItems);
+	void barrier() {} // dispatches finish before returning
+
+	// dispatches run to completion, so these are just the host clock
+	void writeTimestamp(int query);
+	bool readTimestamp(int query, unsigned long long &ns);
+	unsigned long long currentTimestamp();
+
+	// direct access for debugging and tools
+	SoABuffer *getBuffer(BufferHandle buffer);
+
+private:
+	std::map<BufferHandle, SoABuffer*> buffers;
+	BufferHandle nextHandle = 1;
+
+	// uniforms are per kernel, like per program state in GL
+	CPUUniform uniforms[NUM_KERNELS][CPU_MAX_UNIFORMS];
+	BufferHandle bindings[CPU_MAX_BINDINGS];
+	ComputeKernel currentKernel = KERNEL_EXTERNAL_FORCES;
+
+	std::vector<unsigned long long> timestamps;
+};
@@ -0,0 +1,311 @@
+#include <cmath>
+#include <cstdlib>
+#include <unordered_map>
+#include "generators.hpp"
+#include "tracer.hpp"
+
+// where things go, matching meshes/perf: cloth_*.obj is a 3 x 3 sheet at
+// z = 2.144 and ball_*.obj a ball of radius 0.8 sitting just above z = 0.1
+#define GEN_CLOTH_SIZE 3.0f
+#define GEN_CLOTH_HEIGHT 2.144f
+#define GEN_IRREGULARITY 0.35f // of the grid spacing
+#define GEN_IRREGULAR_HALVES 0.5f // irregular grid cells hashing into [-this, 0) split in two, lower in four, the rest stay quads
+#define GEN_BALL_CENTER glm::vec3(0.0f, 0.0f, 0.9f)
+#define GEN_BALL_RADIUS 0.8f
+#define GEN_CAPSULE_RADIUS 0.4f
+#define GEN_CAPSULE_HALF_LENGTH 0.6f // of the cylinder, the caps go past it
+#define GEN_TERRAIN_SIZE 4.0f
+#define GEN_TERRAIN_AMPLITUDE 0.5f
+#define GEN_TERRAIN_OCTAVES 4
+
+static const float PI_F = 3.14159265358979f;
+
+// integer hash (lowbias32), for noise and the irregular grid
+static unsigned int hash(unsigned int x) {
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return x;
+}
+
+// in [-1, 1]
+static float hashFloat(unsigned int a, unsigned int b, unsigned int seed) {
+	unsigned int h = hash(a ^ hash(b ^ hash(seed)));
+	return (h & 0xffffff) / (float)0x7fffff - 1.0f;
+}
+
+// both triangles of a quad, (0, 1, 2) and (0, 2, 3) like the obj loader
+static void addQuad(std::vector<glm::ivec4> &quads, std::vector<int> &tris, glm::ivec4 quad) {
+	quads.push_back(quad);
+	int order[6] = { 0, 1, 2, 0, 2, 3 };
+	for (int i = 0; i < 6; i++) tris.push_back(quad[order[i]]);
+}
+
+// a face with no quad: into tris, and polygonTris so cloths get its edges
+static void addTriangle(std::vector<int> &tris, std::vector<glm::ivec3> &polygonTris, int a, int b, int c) {
+	tris.push_back(a);
+	tris.push_back(b);
+	tris.push_back(c);
+	polygonTris.push_back(glm::ivec3(a, b, c));
+}
+
+bool generators::isGenerated(const std::string &filename) {
+	return filename.compare(0, sizeof(GENERATED_PREFIX) - 1, GENERATED_PREFIX) == 0;
+}
+
+bool generators::generate(const std::string &spec, std::vector<glm::vec4> &positions,
+	std::vector<glm::ivec4> &quads, std::vector<int> &tris, std::vector<glm::ivec3> &polygonTris) {
+	TRACE_ZONE("generate mesh");
+	if (!isGenerated(spec)) return false;
+	std::string rest = spec.substr(sizeof(GENERATED_PREFIX) - 1);
+	size_t colon = rest.find(':');
+	if (colon == std::string::npos) return false;
+	std::string kind = rest.substr(0, colon);
+	char *end;
+	long resolution = strtol(rest.c_str() + colon + 1, &end, 10);
+	if (*end != '\0' || end == rest.c_str() + colon + 1) return false;
+
+	if (kind == "grid" || kind == "igrid" || kind == "terrain") {
+		// the irregular grid can add a vertex in every cell
+		int perVertex = kind == "igrid" ? 2 : 1;
+		if (resolution < 2 || perVertex * resolution * resolution > GENERATED_MAX_VERTICES) return false;
+		if (kind == "terrain") terrain(resolution, positions, quads, tris);
+		else clothGrid(resolution, kind == "igrid", positions, quads, tris, polygonTris);
+		return true;
+	}
+	if (kind == "icosphere") {
+		// 10 * 4^N + 2 vertices
+		if (resolution < 0 || resolution > 12 || 10.0 * pow(4.0, resolution) > GENERATED_MAX_VERTICES) return false;
+		icosphere(resolution, positions, tris, polygonTris);
+		return true;
+	}
+	if (kind == "capsule") {
+		if (resolution < 3 || resolution * (double)resolution > GENERATED_MAX_VERTICES) return false;
+		capsule(resolution, positions, quads, tris, polygonTris);
+		return true;
+	}
+	return false;
+}
+
+void generators::clothGrid(int resolution, bool irregular, std::vector<glm::vec4> &positions,
+	std::vector<glm::ivec4> &quads, std::vector<int> &tris, std::vector<glm::ivec3> &polygonTris) {
+	int first = positions.size();
+	float spacing = GEN_CLOTH_SIZE / (resolution - 1);
+	positions.reserve(first + resolution * resolution);
+	for (int j = 0; j < resolution; j++) {
+		for (int i = 0; i < resolution; i++) {
+			glm::vec2 p = glm::vec2(i, j) * spacing - glm::vec2(GEN_CLOTH_SIZE * 0.5f);
+			// the border stays straight so the sheet keeps its outline
+			bool border = i == 0 || j == 0 || i == resolution - 1 || j == resolution - 1;
+			if (irregular && !border) {
+				p.x += hashFloat(i, j, 1) * GEN_IRREGULARITY * spacing;
+				p.y += hashFloat(i, j, 2) * GEN_IRREGULARITY * spacing;
+			}
+			positions.push_back(glm::vec4(p, GEN_CLOTH_HEIGHT, 1.0f));
+		}
+	}
+
+	// counterclockwise seen from above. the irregular grid mixes three kinds
+	// of cell, so vertices end up with anywhere from 2 to 8 neighbors:
+	// quads, two triangles split along either diagonal, and four triangles
+	// around a new vertex in the middle
+	quads.reserve(quads.size() + (resolution - 1) * (resolution - 1));
+	tris.reserve(tris.size() + 6 * (resolution - 1) * (resolution - 1));
+	for (int j = 0; j + 1 < resolution; j++) {
+		for (int i = 0; i + 1 < resolution; i++) {
+			int v = first + j * resolution + i;
+			glm::ivec4 quad(v, v + 1, v + resolution + 1, v + resolution);
+			float kind = irregular ? hashFloat(i, j, 3) : 1.0f;
+			if (kind >= 0.0f) {
+				addQuad(quads, tris, quad);
+			} else if (kind >= -GEN_IRREGULAR_HALVES) {
+				if (hashFloat(i, j, 4) > 0.0f) {
+					addTriangle(tris, polygonTris, quad[0], quad[1], quad[2]);
+					addTriangle(tris, polygonTris, quad[0], quad[2], quad[3]);
+				} else {
+					addTriangle(tris, polygonTris, quad[0], quad[1], quad[3]);
+					addTriangle(tris, polygonTris, quad[1], quad[2], quad[3]);
+				}
+			} else {
+				int center = positions.size();
+				glm::vec4 sum = positions[quad[0]] + positions[quad[1]] + positions[quad[2]] + positions[quad[3]];
+				positions.push_back(sum * 0.25f);
+				for (int c = 0; c < 4; c++) {
+					addTriangle(tris, polygonTris, quad[c], quad[(c + 1) % 4], center);
+				}
+			}
+		}
+	}
+}
+
+void generators::icosphere(int subdivisions, std::vector<glm::vec4> &positions, std::vector<int> &tris,
+	std::vector<glm::ivec3> &polygonTris) {
+	float t = (1.0f + sqrtf(5.0f)) * 0.5f;
+	glm::vec3 corners[12] = {
+		glm::vec3(-1, t, 0), glm::vec3(1, t, 0), glm::vec3(-1, -t, 0), glm::vec3(1, -t, 0),
+		glm::vec3(0, -1, t), glm::vec3(0, 1, t), glm::vec3(0, -1, -t), glm::vec3(0, 1, -t),
+		glm::vec3(t, 0, -1), glm::vec3(t, 0, 1), glm::vec3(-t, 0, -1), glm::vec3(-t, 0, 1)
+	};
+	int faces[60] = {
+		0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11,
+		1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+		3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9,
+		4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1
+	};
+
+	// unit sphere first, placed at the end
+	std::vector<glm::vec3> points;
+	points.reserve(10 * (1 << (2 * subdivisions)) + 2);
+	for (int i = 0; i < 12; i++) points.push_back(glm::normalize(corners[i]));
+	std::vector<int> current(faces, faces + 60);
+
+	// split every triangle in 4, sharing the new vertex on each edge
+	for (int s = 0; s < subdivisions; s++) {
+		std::unordered_map<unsigned long long, int> midpoints;
+		midpoints.reserve(current.size());
+		std::vector<int> next;
+		next.reserve(current.size() * 4);
+		for (int f = 0; f + 2 < (int)current.size(); f += 3) {
+			int mid[3];
+			for (int e = 0; e < 3; e++) {
+				int a = current[f + e];
+				int b = current[f + (e + 1) % 3];
+				unsigned long long key = a < b ?
+					((unsigned long long)a << 32) | (unsigned int)b : ((unsigned long long)b << 32) | (unsigned int)a;
+				std::unordered_map<unsigned long long, int>::iterator it = midpoints.find(key);
+				if (it != midpoints.end()) {
+					mid[e] = it->second;
+				} else {
+					mid[e] = points.size();
+					points.push_back(glm::normalize(points[a] + points[b]));
+					midpoints[key] = mid[e];
+				}
+			}
+			int v0 = current[f], v1 = current[f + 1], v2 = current[f + 2];
+			int split[12] = { v0, mid[0], mid[2], v1, mid[1], mid[0], v2, mid[2], mid[1], mid[0], mid[1], mid[2] };
+			next.insert(next.end(), split, split + 12);
+		}
+		current.swap(next);
+	}
+
+	int first = positions.size();
+	positions.reserve(first + points.size());
+	for (int i = 0; i < (int)points.size(); i++) {
+		positions.push_back(glm::vec4(GEN_BALL_CENTER + points[i] * GEN_BALL_RADIUS, 1.0f));
+	}
+	tris.reserve(tris.size() + current.size());
+	polygonTris.reserve(polygonTris.size() + current.size() / 3);
+	for (int f = 0; f + 2 < (int)current.size(); f += 3) {
+		addTriangle(tris, polygonTris, first + current[f], first + current[f + 1], first + current[f + 2]);
+	}
+}
+
+void generators::capsule(int segments, std::vector<glm::vec4> &positions,
+	std::vector<glm::ivec4> &quads, std::vector<int> &tris, std::vector<glm::ivec3> &polygonTris) {
+	float r = GEN_CAPSULE_RADIUS;
+	float h = GEN_CAPSULE_HALF_LENGTH;
+	glm::vec3 center = GEN_BALL_CENTER;
+
+	// rings along x: a cap's worth of latitudes, the cylinder split so its
+	// quads come out about square, then the other cap
+	int capRings = segments / 4 > 2 ? segments / 4 : 2;
+	float segmentLength = 2.0f * PI_F * r / segments;
+	int cylinderBands = (int)(2.0f * h / segmentLength + 0.5f);
+	if (cylinderBands < 1) cylinderBands = 1;
+	std::vector<glm::vec2> rings; // x, radius
+	for (int k = 1; k <= capRings; k++) {
+		float phi = 0.5f * PI_F * k / capRings;
+		rings.push_back(glm::vec2(-h - r * cosf(phi), r * sinf(phi)));
+	}
+	for (int k = 1; k < cylinderBands; k++) {
+		rings.push_back(glm::vec2(-h + 2.0f * h * k / cylinderBands, r));
+	}
+	for (int k = capRings; k >= 1; k--) {
+		float phi = 0.5f * PI_F * k / capRings;
+		rings.push_back(glm::vec2(h + r * cosf(phi), r * sinf(phi)));
+	}
+
+	int first = positions.size();
+	int numRings = rings.size();
+	positions.reserve(first + numRings * segments + 2);
+	for (int k = 0; k < numRings; k++) {
+		for (int s = 0; s < segments; s++) {
+			float theta = 2.0f * PI_F * s / segments;
+			glm::vec3 p(rings[k].x, rings[k].y * cosf(theta), rings[k].y * sinf(theta));
+			positions.push_back(glm::vec4(center + p, 1.0f));
+		}
+	}
+	int poleLeft = positions.size();
+	positions.push_back(glm::vec4(center + glm::vec3(-h - r, 0.0f, 0.0f), 1.0f));
+	int poleRight = positions.size();
+	positions.push_back(glm::vec4(center + glm::vec3(h + r, 0.0f, 0.0f), 1.0f));
+
+	// everything counterclockwise seen from outside
+	for (int k = 0; k + 1 < numRings; k++) {
+		for (int s = 0; s < segments; s++) {
+			int a0 = first + k * segments + s;
+			int a1 = first + k * segments + (s + 1) % segments;
+			int b0 = a0 + segments;
+			int b1 = a1 + segments;
+			addQuad(quads, tris, glm::ivec4(a0, a1, b1, b0));
+		}
+	}
+	// the caps' tips are triangle fans, so they don't get quads
+	int last = first + (numRings - 1) * segments;
+	for (int s = 0; s < segments; s++) {
+		int next = (s + 1) % segments;
+		addTriangle(tris, polygonTris, poleLeft, first + next, first + s);
+		addTriangle(tris, polygonTris, poleRight, last + s, last + next);
+	}
+}
+
+// smoothly interpolated value noise, about [-1, 1]
+static float valueNoise(float x, float y, unsigned int seed) {
+	int x0 = (int)floorf(x);
+	int y0 = (int)floorf(y);
+	float fx = x - x0;
+	float fy = y - y0;
+	fx = fx * fx * (3.0f - 2.0f * fx);
+	fy = fy * fy * (3.0f - 2.0f * fy);
+	float v00 = hashFloat(x0, y0, seed);
+	float v10 = hashFloat(x0 + 1, y0, seed);
+	float v01 = hashFloat(x0, y0 + 1, seed);
+	float v11 = hashFloat(x0 + 1, y0 + 1, seed);
+	float bottom = v00 + (v10 - v00) * fx;
+	float top = v01 + (v11 - v01) * fx;
+	return bottom + (top - bottom) * fy;
+}
+
+void generators::terrain(int resolution, std::vector<glm::vec4> &positions,
+	std::vector<glm::ivec4> &quads, std::vector<int> &tris) {
+	int first = positions.size();
+	float spacing = GEN_TERRAIN_SIZE / (resolution - 1);
+	positions.reserve(first + resolution * resolution);
+	for (int j = 0; j < resolution; j++) {
+		for (int i = 0; i < resolution; i++) {
+			glm::vec2 p = glm::vec2(i, j) * spacing - glm::vec2(GEN_TERRAIN_SIZE * 0.5f);
+			// a few octaves, two bumps across at the lowest one
+			float height = 0.0f;
+			float frequency = 2.0f / GEN_TERRAIN_SIZE;
+			float amplitude = 0.5f;
+			for (int o = 0; o < GEN_TERRAIN_OCTAVES; o++) {
+				height += amplitude * valueNoise(p.x * frequency, p.y * frequency, 10 + o);
+				frequency *= 2.0f;
+				amplitude *= 0.5f;
+			}
+			positions.push_back(glm::vec4(p, GEN_TERRAIN_AMPLITUDE * (height + 1.0f), 1.0f));
+		}
+	}
+
+	// counterclockwise seen from above, so the surface faces up
+	quads.reserve(quads.size() + (resolution - 1) * (resolution - 1));
+	tris.reserve(tris.size() + 6 * (resolution - 1) * (resolution - 1));
+	for (int j = 0; j + 1 < resolution; j++) {
+		for (int i = 0; i + 1 < resolution; i++) {
+			int v = first + j * resolution + i;
+			addQuad(quads, tris, glm::ivec4(v, v + 1, v + resolution + 1, v + resolution));
+		}
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <glm/glm.hpp>
+
+// meshes built in memory at any resolution, for scaling tests past what's in
+// meshes/. anywhere a mesh filename goes, a spec "gen:<kind>:<resolution>"
+// builds one of these instead:
+//   gen:grid:N       N x N vertex cloth, 3 x 3 units at the perf cloths' height
+//   gen:igrid:N      the same with the inner vertices nudged off the grid, and
+//                    mixed cells: quads, two triangles, or four around an extra
+//                    vertex, so vertices have anywhere from 2 to 8 neighbors
+//   gen:icosphere:N  ball like the perf balls, N subdivisions (20 * 4^N triangles)
+//   gen:capsule:N    capsule lying along x, N segments around
+//   gen:terrain:N    N x N vertex heightfield of value noise below the cloth
+// z is up. everything is deterministic: the same spec gives the same mesh.
+// faces come out like obj::load's: quads in quads and, as two triangles, in
+// tris; every other face in tris and polygonTris.
+
+#define GENERATED_PREFIX "gen:"
+#define GENERATED_MAX_VERTICES 200000000 // specs asking for more are rejected
+
+namespace generators {
+bool isGenerated(const std::string &filename);
+
+// false (and nothing added) for an unknown kind or a bad resolution
+bool generate(const std::string &spec, std::vector<glm::vec4> &positions,
+	std::vector<glm::ivec4> &quads, std::vector<int> &tris, std::vector<glm::ivec3> &polygonTris);
+
+void clothGrid(int resolution, bool irregular, std::vector<glm::vec4> &positions,
+	std::vector<glm::ivec4> &quads, std::vector<int> &tris, std::vector<glm::ivec3> &polygonTris);
+void icosphere(int subdivisions, std::vector<glm::vec4> &positions, std::vector<int> &tris,
+	std::vector<glm::ivec3> &polygonTris);
+void capsule(int segments, std::vector<glm::vec4> &positions,
+	std::vector<glm::ivec4> &quads, std::vector<int> &tris, std::vector<glm::ivec3> &polygonTris);
+void terrain(int resolution, std::vector<glm::vec4> &positions,
+	std::vector<glm::ivec4> &quads, std::vector<int> &tris);
+}
@@ -0,0 +1,218 @@
+#include <iostream>
+#include <string>
+#include "glBackend.hpp"
+#include "profiler.hpp"
+#include "tracer.hpp"
+#include "glslUtility.hpp"
+#include "checkGLError.hpp"
+
+using namespace std;
+
+// shader file for each ComputeKernel, in enum order
+static const char *kernelPaths[NUM_KERNELS] = {
+	"../shaders/cloth_pbd1_externalForces.comp.glsl",
+	"../shaders/cloth_pbd2_dampVelocities.comp.glsl",
+	"../shaders/cloth_pbd3_predictPositions.comp.glsl",
+	"../shaders/cloth_pbd4_updateInverseMasses.comp.glsl",
+	"../shaders/cloth_pbd5_projectClothConstraints.comp.glsl",
+	"../shaders/cloth_pbd6_updatePositionsVelocities.comp.glsl",
+	"../shaders/copy.comp.glsl",
+	"../shaders/cloth_genCollisions.comp.glsl",
+	"../shaders/cloth_projectCollisions.comp.glsl",
+	"../shaders/rigidbody_animate.comp.glsl",
+	"../shaders/rigidbody_refitBVH.comp.glsl",
+	"../shaders/cloth_genCollisionsSDF.comp.glsl",
+	"../shaders/cloth_pbd5_projectClothConstraintsCSR.comp.glsl",
+	"../shaders/cloth_pbd5_projectClothConstraintsColored.comp.glsl",
+	"../shaders/cloth_pbd1to3_integrate.comp.glsl",
+	"../shaders/cloth_pbd4_gatherPinTargets.comp.glsl",
+	"../shaders/cloth_pbd5_projectPins.comp.glsl",
+	"../shaders/cloth_genCollisionsCandidates.comp.glsl",
+	"../shaders/cloth_genCollisionsPrimitive.comp.glsl"
+};
+
+Backend *createGLBackend(int workGroupSize) {
+	return new GLBackend(workGroupSize);
+}
+
+GLBackend::GLBackend(int workGroupSize) {
+	this->workGroupSize = workGroupSize;
+	for (int i = 0; i < NUM_KERNELS; i++) {
+		programs[i] = initComputeProg(kernelPaths[i]);
+	}
+	checkGLError("init gl backend");
+}
+
+GLBackend::~GLBackend() {
+	for (int i = 0; i < NUM_KERNELS; i++) {
+		glDeleteProgram(programs[i]);
+	}
+	if (!timestampQueries.empty()) {
+		glDeleteQueries(timestampQueries.size(), &timestampQueries[0]);
+	}
+	std::set<GLuint>::iterator it;
+	for (it = buffers.begin(); it != buffers.end(); it++) {
+		glDeleteBuffers(1, &*it);
+	}
+}
+
+//http://stackoverflow.com/questions/3418231/replace-part-of-a-string-with-another-string
+static bool replace(std::string& str, const std::string& from, const std::string& to) {
+	size_t start_pos = str.find(from);
+	if (start_pos == std::string::npos)
+		return false;
+	str.replace(start_pos, from.length(), to);
+	return true;
+}
+
+GLuint GLBackend::initComputeProg(const char *path) {
+	TRACE_ZONE("compile shader");
+	GLuint prog = glCreateProgram();
+	GLuint cs = glCreateShader(GL_COMPUTE_SHADER);
+
+	int cs_len;
+	const char *cs_str;
+	cs_str = glslUtility::loadFile(path, cs_len);
+
+	// check and edit the shader so the workgroup size is correct
+	string str_shader = string(cs_str);
+	str_shader.resize(cs_len);
+	replace(str_shader, "WORK_GROUP_SIZE XX", "WORK_GROUP_SIZE " + std::to_string(workGroupSize));
+
+	cs_len = str_shader.length();
+
+	char *cs_str_edited = new char[str_shader.length() + 1];
+	strcpy(cs_str_edited, str_shader.c_str());
+
+	glShaderSource(cs, 1, &cs_str_edited, &cs_len);
+
+	GLint status;
+
+	glCompileShader(cs);
+	glGetShaderiv(cs, GL_COMPILE_STATUS, &status);
+	if (!status) {
+		printf("Error compiling compute shader: %s\n", path);
+		glslUtility::printShaderInfoLog(cs);
+		printf("%s", cs_str_edited);
+		cout << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	glAttachShader(prog, cs);
+	glLinkProgram(prog);
+	glGetProgramiv(prog, GL_LINK_STATUS, &status);
+	if (!status) {
+		printf("Error linking compute shader: %s\n", path);
+		glslUtility::printLinkInfoLog(prog);
+		printf("%s", cs_str_edited);
+		cout << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	delete[] cs_str;
+	delete[] cs_str_edited;
+
+	return prog;
+}
+
+BufferHandle GLBackend::createBuffer(int numItems, const glm::vec4 *data) {
+	TRACE_ZONE("create buffer");
+	GLuint ssbo;
+	glGenBuffers(1, &ssbo);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, numItems * sizeof(glm::vec4),
+		data, GL_STREAM_COPY);
+	buffers.insert(ssbo);
+	return ssbo;
+}
+
+void GLBackend::uploadBuffer(BufferHandle buffer, int numItems, const glm::vec4 *data) {
+	TRACE_ZONE("upload buffer");
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, numItems * sizeof(glm::vec4),
+		data, GL_STREAM_COPY);
+}
+
+void GLBackend::readBuffer(BufferHandle buffer, int numItems, glm::vec4 *data) {
+	readBufferRange(buffer, 0, numItems, data);
+}
+
+void GLBackend::readBufferRange(BufferHandle buffer, int first, int numItems, glm::vec4 *data) {
+	TRACE_ZONE("read buffer");
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	glm::vec4 *mapped = (glm::vec4 *) glMapBufferRange(GL_SHADER_STORAGE_BUFFER,
+		first * sizeof(glm::vec4), numItems * sizeof(glm::vec4), GL_MAP_READ_BIT);
+	for (int i = 0; i < numItems; i++) {
+		data[i] = mapped[i];
+	}
+	glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+	checkGLError("backcopy");
+}
+
+void GLBackend::deleteBuffer(BufferHandle buffer) {
+	buffers.erase(buffer);
+	glDeleteBuffers(1, &buffer);
+}
+
+void GLBackend::useKernel(ComputeKernel kernel) {
+	glUseProgram(programs[kernel]);
+	currentKernel = kernel;
+}
+
+void GLBackend::setUniform(int location, int value) {
+	glUniform1i(location, value);
+}
+
+void GLBackend::setUniform(int location, float value) {
+	glUniform1f(location, value);
+}
+
+void GLBackend::setUniform(int location, const glm::vec3 &value) {
+	glUniform3fv(location, 1, &value[0]);
+}
+
+void GLBackend::setUniform(int location, const glm::mat4 &value) {
+	glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
+}
+
+void GLBackend::bindBuffer(int binding, BufferHandle buffer) {
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+}
+
+void GLBackend::dispatch(int numItems) {
+	if (numItems < 1) return;
+	int workGroupCount = (numItems - 1) / workGroupSize + 1;
+	if (profiler) profiler->beginDispatch(currentKernel);
+	glDispatchCompute(workGroupCount, 1, 1);
+	if (profiler) profiler->endDispatch();
+}
+
+void GLBackend::barrier() {
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT); // emulate ssbo memory coherence
+}
+
+void GLBackend::writeTimestamp(int query) {
+	if (query >= (int)timestampQueries.size()) {
+		int numOld = timestampQueries.size();
+		timestampQueries.resize(query + 1);
+		glGenQueries(query + 1 - numOld, &timestampQueries[numOld]);
+	}
+	glQueryCounter(timestampQueries[query], GL_TIMESTAMP);
+}
+
+bool GLBackend::readTimestamp(int query, unsigned long long &ns) {
+	if (query >= (int)timestampQueries.size()) return false;
+	GLint available = 0;
+	glGetQueryObjectiv(timestampQueries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) return false;
+	GLuint64 timestamp;
+	glGetQueryObjectui64v(timestampQueries[query], GL_QUERY_RESULT, &timestamp);
+	ns = timestamp;
+	return true;
+}
+
+unsigned long long GLBackend::currentTimestamp() {
+	GLint64 timestamp;
+	glGetInteger64v(GL_TIMESTAMP, &timestamp);
+	return timestamp;
+}
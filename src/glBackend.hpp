@@ -0,0 +1,48 @@
+#pragma once
+#include <map>
+#include <set>
+#include <vector>
+#include <GL/glew.h>
+#include "backend.hpp"
+
+// runs the compute stages as GL compute shaders.
+// BufferHandles are GL buffer names, so they can be bound for drawing as-is.
+
+class GLBackend : public Backend
+{
+public:
+	GLBackend(int workGroupSize);
+	~GLBackend();
+
+	int workGroupSize;
+
+	const char *name() { return "gl"; }
+	bool isGL() { return true; }
+
+	BufferHandle createBuffer(int numItems, const glm::vec4 *data);
+	void uploadBuffer(BufferHandle buffer, int numItems, const glm::vec4 *data);
+	void readBuffer(BufferHandle buffer, int numItems, glm::vec4 *data);
+	void readBufferRange(BufferHandle buffer, int first, int numItems, glm::vec4 *data);
+	void deleteBuffer(BufferHandle buffer);
+
+	void useKernel(ComputeKernel kernel);
+	void setUniform(int location, int value);
+	void setUniform(int location, float value);
+	void setUniform(int location, const glm::vec3 &value);
+	void setUniform(int location, const glm::mat4 &value);
+	void bindBuffer(int binding, BufferHandle buffer);
+	void dispatch(int numItems);
+	void barrier();
+
+	void writeTimestamp(int query);
+	bool readTimestamp(int query, unsigned long long &ns);
+	unsigned long long currentTimestamp();
+
+private:
+	GLuint programs[NUM_KERNELS];
+	ComputeKernel currentKernel = KERNEL_EXTERNAL_FORCES;
+	std::vector<GLuint> timestampQueries; // GL_TIMESTAMP queries, made as needed
+	std::set<GLuint> buffers; // every buffer still alive, deleted with the backend
+
+	GLuint initComputeProg(const char *path);
+};
@@ -0,0 +1,276 @@
+/**
+ * @file      headless.cpp
+ * @brief     batch simulation without a window: load a scene, step it
+ *            a fixed number of frames as fast as possible, report throughput
+ */
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include "scenes.hpp"
+
+#if HEADLESS_GL
+#include "hiddenContext.hpp"
+#endif
+
+#define WORK_GROUP_SIZE 32
+
+using namespace std;
+
+// indexed by the SOLVER_ defines in cloth.hpp
+static const char *solverNames[] = { "buffers", "csr", "colored" };
+
+static void printUsage(const char *exe) {
+	cout << "usage: " << exe << " [options]" << endl;
+	cout << "  --scene NAME     scene to simulate (";
+	vector<string> names = scenes::sceneNames();
+	for (int i = 0; i < (int)names.size(); i++) {
+		cout << (i ? ", " : "") << names[i];
+	}
+	cout << "), default perf" << endl;
+	cout << "                   or CLOTH+COLLIDER, meshes/perf names or generator specs," << endl;
+	cout << "                   ex: gen:grid:1000+gen:icosphere:7 (see generators.hpp)" << endl;
+	cout << "  --frames N       number of frames to step, default 600" << endl;
+	cout << "  --threads N      worker threads for the cpu backend, 0 = all cores" << endl;
+	cout << "  --meshes DIR     directory containing meshes/, default ./" << endl;
+	cout << "  --assets         load meshes from their precompiled .asset files where there are any" << endl;
+#if HEADLESS_GL
+	cout << "  --gl             run on the GL compute backend (hidden window)" << endl;
+#endif
+	cout << "  --world-colliders  animate colliders in world space instead of querying them in local space" << endl;
+	cout << "  --solver NAME    constraint solver: buffers, csr or colored, default ";
+	cout << solverNames[CONSTRAINT_SOLVER] << endl;
+	cout << "  --iterations N   solver iterations per frame" << endl;
+	cout << "  --unfused        run external forces, damping and prediction as separate stages" << endl;
+	cout << "  --no-batch       step each cloth on its own instead of packing them into one batch" << endl;
+	cout << "  --sdf            collide against baked signed distance fields (cached as <mesh>.sdf)" << endl;
+	cout << "  --proxy N        collide against proxies simplified down to N triangles per collider (cached as <mesh>.proxy)" << endl;
+	cout << "  --proxy-tolerance D  how far a proxy may stray from its mesh (default " << PROXY_TOLERANCE << ", <= 0: no limit)" << endl;
+	cout << "  --primitives     collide floors, balls, capsules and terrain as analytic shapes (see primitive.hpp)" << endl;
+	cout << "  --primitive TYPE fit one shape to every collider: plane, sphere, capsule, box or heightfield" << endl;
+	cout << "  --no-candidates  walk every collider's BVH for every vertex, no per vertex candidate lists" << endl;
+	cout << "  --skin D         how far around a vertex its candidate list reaches, default " << COLLISION_SKIN << endl;
+	cout << "  --profile        print per stage and per kernel timings (p50, p95, p99)" << endl;
+	cout << "  --trace PATH     profile and write a chrome trace (chrome://tracing) to PATH" << endl;
+	cout << "  --host-trace     time host zones (loading, setup, uploads, cpu kernels), added to --trace" << endl;
+	cout << "  --perf-counters  also read cycles, instructions and cache misses per host zone (linux)" << endl;
+	cout << "  --obj PREFIX     write the final cloth meshes to PREFIX<i>.obj" << endl;
+}
+
+// final cloth state as an obj, for checking batch results in other tools.
+// vertices in the order of the cloth's mesh file, not the simulation's
+static void writeClothOBJ(Simulation *sim, int clothIndex, const string &filename) {
+	ofstream out(filename.c_str());
+	if (!out.is_open()) {
+		cout << "could not write " << filename << endl;
+		return;
+	}
+	Cloth *cloth = sim->cloths.at(clothIndex);
+	vector<glm::vec4> positions;
+	sim->readClothPositions(clothIndex, positions);
+	for (int i = 0; i < (int)positions.size(); i++) {
+		glm::vec4 p = positions[cloth->vertexFromFile(i)];
+		out << "v " << p.x << " " << p.y << " " << p.z << "\n";
+	}
+	vector<int> &tris = cloth->indicesTris;
+	for (int i = 0; i + 2 < (int)tris.size(); i += 3) {
+		out << "f " << cloth->fileVertex(tris[i]) + 1 << " " << cloth->fileVertex(tris[i + 1]) + 1 << " " <<
+			cloth->fileVertex(tris[i + 2]) + 1 << "\n";
+	}
+}
+
+int main(int argc, char* argv[]) {
+	string sceneName = "perf";
+	string objPrefix = "";
+	int numFrames = 600;
+	int numThreads = 0;
+#if HEADLESS_GL
+	bool useGL = false;
+#endif
+	bool localSpaceColliders = LOCAL_SPACE_COLLIDERS;
+	bool sdfColliders = false;
+	int proxyTriangles = 0; // 0: collide against the meshes themselves
+	float proxyTolerance = PROXY_TOLERANCE;
+	bool collisionCandidates = COLLISION_CANDIDATES;
+	float collisionSkin = COLLISION_SKIN;
+	int constraintSolver = CONSTRAINT_SOLVER;
+	int projectTimes = 0; // 0 keeps the scene's
+	bool fusedIntegration = FUSED_INTEGRATION;
+	bool batchCloths = BATCH_CLOTHS;
+	bool profile = false;
+	bool hostTrace = false;
+	bool perfCounters = false;
+	string tracePath;
+
+	for (int i = 1; i < argc; i++) {
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--scene") == 0 && hasValue) sceneName = argv[++i];
+		else if (strcmp(argv[i], "--frames") == 0 && hasValue) numFrames = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--threads") == 0 && hasValue) numThreads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--meshes") == 0 && hasValue) scenes::meshRoot = string(argv[++i]) + "/";
+		else if (strcmp(argv[i], "--obj") == 0 && hasValue) objPrefix = argv[++i];
+		else if (strcmp(argv[i], "--assets") == 0) scenes::useAssets = true;
+		else if (strcmp(argv[i], "--primitives") == 0) scenes::usePrimitives = true;
+		else if (strcmp(argv[i], "--primitive") == 0 && hasValue) {
+			scenes::usePrimitives = true;
+			scenes::forcedPrimitive = Primitive::typeFromName(argv[++i]);
+			if (scenes::forcedPrimitive <= PRIMITIVE_NONE) {
+				printUsage(argv[0]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--world-colliders") == 0) localSpaceColliders = false;
+		else if (strcmp(argv[i], "--solver") == 0 && hasValue) {
+			constraintSolver = -1;
+			string name = argv[++i];
+			for (int j = 0; j < 3; j++) {
+				if (name == solverNames[j]) constraintSolver = j;
+			}
+			if (constraintSolver < 0) {
+				printUsage(argv[0]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--iterations") == 0 && hasValue) projectTimes = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--unfused") == 0) fusedIntegration = false;
+		else if (strcmp(argv[i], "--no-batch") == 0) batchCloths = false;
+		else if (strcmp(argv[i], "--sdf") == 0) sdfColliders = true;
+		else if (strcmp(argv[i], "--proxy") == 0 && hasValue) {
+			proxyTriangles = atoi(argv[++i]);
+			if (proxyTriangles < 1) {
+				printUsage(argv[0]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--proxy-tolerance") == 0 && hasValue) proxyTolerance = atof(argv[++i]);
+		else if (strcmp(argv[i], "--no-candidates") == 0) collisionCandidates = false;
+		else if (strcmp(argv[i], "--skin") == 0 && hasValue) collisionSkin = atof(argv[++i]);
+		else if (strcmp(argv[i], "--profile") == 0) profile = true;
+		else if (strcmp(argv[i], "--trace") == 0 && hasValue) {
+			profile = true;
+			tracePath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--host-trace") == 0) hostTrace = true;
+		else if (strcmp(argv[i], "--perf-counters") == 0) {
+			hostTrace = true;
+			perfCounters = true;
+		}
+#if HEADLESS_GL
+		else if (strcmp(argv[i], "--cpu") == 0) useGL = false;
+		else if (strcmp(argv[i], "--gl") == 0) useGL = true;
+#else
+		else if (strcmp(argv[i], "--cpu") == 0) {} // the only backend there is
+#endif
+		else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+#if HEADLESS_GL
+	GLFWwindow *window = NULL;
+	if (useGL) {
+		window = createHiddenContext();
+		if (!window) return 1;
+	}
+	Backend *backend = useGL ? createGLBackend(WORK_GROUP_SIZE) : createCPUBackend(numThreads);
+#else
+	Backend *backend = createCPUBackend(numThreads);
+#endif
+	cout << "using " << backend->name() << " backend" << endl;
+
+	// before loading, so mesh parsing and setup show up too
+	if (hostTrace) Tracer::enable(perfCounters);
+
+	Simulation *sim = scenes::loadScene(backend, sceneName);
+	if (sim == NULL) {
+		cout << "unknown scene " << sceneName << endl;
+		printUsage(argv[0]);
+		return 1;
+	}
+	sim->localSpaceColliders = localSpaceColliders;
+	sim->collisionCandidates = collisionCandidates;
+	sim->collisionSkin = collisionSkin;
+	sim->constraintSolver = constraintSolver;
+	sim->fusedIntegration = fusedIntegration;
+	sim->batchCloths = batchCloths;
+	if (projectTimes > 0) {
+		sim->projectTimes = projectTimes;
+		sim->initComputeProgs(); // the kernels bake the iteration count into K
+	}
+	if (proxyTriangles > 0) {
+		auto proxyStart = chrono::high_resolution_clock::now();
+		sim->proxyTriangles = proxyTriangles;
+		sim->proxyTolerance = proxyTolerance;
+		sim->enableCollisionProxies();
+		double proxySeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - proxyStart).count();
+		cout << "proxy setup (s):  " << proxySeconds << endl;
+		for (int i = 0; i < sim->numRigids; i++) {
+			Rbody *body = sim->rigids.at(i);
+			if (body->proxy.empty()) continue;
+			cout << body->filename << " collides as " << body->proxy.indicesTris.size() / 3 << " of its " <<
+				body->indicesTris.size() / 3 << " triangles (error " << body->proxy.error << ")" << endl;
+		}
+	}
+	if (sdfColliders) {
+		auto bakeStart = chrono::high_resolution_clock::now();
+		sim->enableSDFColliders();
+		double bakeSeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - bakeStart).count();
+		cout << "sdf setup (s):    " << bakeSeconds << endl;
+	}
+
+	long long numClothVertices = 0;
+	for (int i = 0; i < sim->numCloths; i++) {
+		numClothVertices += sim->cloths.at(i)->initPositions.size();
+	}
+
+	sim->setProfiling(profile);
+	auto start = chrono::high_resolution_clock::now();
+	sim->stepSimulation(numFrames);
+
+	// reading back forces the backend to finish everything that was queued
+	vector<glm::vec4> positions;
+	for (int i = 0; i < sim->numCloths; i++) {
+		sim->readClothPositions(i, positions);
+	}
+	auto end = chrono::high_resolution_clock::now();
+	double seconds = chrono::duration<double>(end - start).count();
+
+	cout << "scene:            " << sceneName << endl;
+	cout << "cloth vertices:   " << numClothVertices << endl;
+	cout << "frames:           " << numFrames << endl;
+	cout << "total time (s):   " << seconds << endl;
+	if (seconds > 0.0) {
+		cout << "frames / s:       " << numFrames / seconds << endl;
+		cout << "vertex steps / s: " << (double)numClothVertices * numFrames / seconds << endl;
+	}
+
+	Tracer::disable();
+	if (profile) {
+		sim->setProfiling(false); // reads back the frames still in flight
+		sim->profiler.report(cout);
+	}
+	if (hostTrace) Tracer::report(cout);
+	if (!tracePath.empty()) {
+		// the profiler's trace already has the host zones in it
+		if (sim->profiler.writeChromeTrace(tracePath)) {
+			cout << "trace written to " << tracePath << endl;
+		} else {
+			cout << "could not write " << tracePath << endl;
+		}
+	}
+
+	if (!objPrefix.empty()) {
+		for (int i = 0; i < sim->numCloths; i++) {
+			writeClothOBJ(sim, i, objPrefix + to_string(i) + ".obj");
+		}
+	}
+
+	delete sim;
+	delete backend;
+#if HEADLESS_GL
+	destroyHiddenContext(window);
+#endif
+	return 0;
+}
@@ -0,0 +1,47 @@
+/**
+ * @file      hiddenContext.hpp
+ * @brief     a GL 4.3 context without anything on screen, for the batch tools
+ */
+#pragma once
+
+#include <iostream>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+// the GL backend still needs a context. an invisible window with vsync
+// off is the cheapest way to get one, nothing is ever presented.
+// returns NULL (and says why) if there's no GL 4.3 to be had.
+inline GLFWwindow *createHiddenContext() {
+	if (!glfwInit()) {
+		std::cout << "Error: Could not initialize GLFW!" << std::endl;
+		return NULL;
+	}
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	GLFWwindow *window = glfwCreateWindow(1, 1, "headless", NULL, NULL);
+	if (!window) {
+		std::cout << "Error: Could not create a GL 4.3 context!" << std::endl;
+		glfwTerminate();
+		return NULL;
+	}
+	glfwMakeContextCurrent(window);
+	glfwSwapInterval(0);
+	glewExperimental = GL_TRUE;
+	if (glewInit() != GLEW_OK) {
+		std::cout << "Error: Could not initialize GLEW!" << std::endl;
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return NULL;
+	}
+	glGetError();
+	return window;
+}
+
+inline void destroyHiddenContext(GLFWwindow *window) {
+	if (!window) return;
+	glfwDestroyWindow(window);
+	glfwTerminate();
+}
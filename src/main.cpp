@@ -5,8 +5,12 @@
  * @date      2013-2015
  * @copyright University of Pennsylvania
  */
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include "main.hpp"
-#include "simulation.hpp"
+#include "scenes.hpp"
+#include "triangleQueries.hpp"
 #include "checkGLError.hpp"
 
 // ================
@@ -15,9 +19,18 @@
 
 #define VISUALIZE 1
 
+// for varying shader work group size.
+// this gets injected into the shaders when they are loaded.
+#define WORK_GROUP_SIZE 32
+
+// default backend. pass --cpu or --gl on the command line to override.
+#define CPU_BACKEND 0
+
 const float DT = 0.2f;
 
 Simulation *sim = NULL;
+Backend *backend = NULL;
+bool useCPUBackend = CPU_BACKEND;
 
 int width = 1280;
 int height = 720;
@@ -28,6 +41,11 @@ int height = 720;
 int main(int argc, char* argv[]) {
     projectName = "565 Compute Shader Intro: N-Body";
 
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cpu") == 0) useCPUBackend = true;
+        if (strcmp(argv[i], "--gl") == 0) useCPUBackend = false;
+    }
+
     if (init(argc, argv)) {
         mainLoop();
         return 0;
@@ -92,6 +110,13 @@ bool init(int argc, char **argv) {
     projection = projection * view;
 
     initShaders(program);
+
+	if (useCPUBackend) {
+		backend = createCPUBackend(0);
+	} else {
+		backend = createGLBackend(WORK_GROUP_SIZE);
+	}
+	std::cout << "using " << backend->name() << " backend" << std::endl;
 	
 	//loadPerformanceTests();
 	loadDancingBear();
@@ -104,76 +129,28 @@ bool init(int argc, char **argv) {
 }
 
 void loadDancingBear() {
-	std::vector<string> colliders;
-	std::vector<string> cloths;
-	// Initialize a fun simulation
-	colliders.push_back("meshes/low_poly_bear.obj");
-	colliders.push_back("meshes/floor.obj");
-
-	cloths.push_back("meshes/cape.obj");
-	cloths.push_back("meshes/dress.obj");
-	cloths.push_back("meshes/bear_cloth.obj");
-
-	sim = new Simulation(colliders, cloths);
+	sim = scenes::loadDancingBear(backend);
 	checkGLError("init sim");
-
-	// let's generate some clothespins!
-	int bearLeftShoulder = 779;
-	int bearRightShoulder = 1578;
-	int bearSSBO = sim->rigids.at(0)->ssbo_pos;
-	sim->rigids.at(0)->color = glm::vec3(1.0f);
-	sim->rigids.at(0)->animated = true;
-
-	// SSBOs for cape
-	int capeLeftShoulder = 1;
-	int capeRightShoulder = 0;
-	sim->cloths.at(0)->addPinConstraint(capeLeftShoulder, bearLeftShoulder, bearSSBO);
-	sim->cloths.at(0)->addPinConstraint(capeRightShoulder, bearRightShoulder, bearSSBO);
-	sim->cloths.at(0)->color = glm::vec3(0.5f, 1.0f, 1.0f);
-
-	// SSBOs for dress
-	int dressLeftShoulder = 14;
-	int dressRightShoulder = 13;
-	sim->cloths.at(1)->addPinConstraint(dressLeftShoulder, bearLeftShoulder, bearSSBO);
-	sim->cloths.at(1)->addPinConstraint(dressRightShoulder, bearRightShoulder, bearSSBO);
-	sim->cloths.at(1)->color = glm::vec3(1.0f, 0.5f, 0.5f);
 }
 
 void loadPerformanceTests() {
-	std::vector<string> colliders;
-	std::vector<string> cloths;
-	cloths.push_back("meshes/perf/cloth_256.obj");
-	colliders.push_back("meshes/perf/ball_98.obj");
 	zoom = 10.0f;
 	updateCamera();
-	sim = new Simulation(colliders, cloths);
+	sim = scenes::loadPerformanceTests(backend);
 	checkGLError("init sim");
 }
 
 void loadStaticCollDetectDebug() {
-	std::vector<string> colliders;
-	std::vector<string> cloths;
-	cloths.push_back("meshes/perf/cloth_121.obj");
-	colliders.push_back("meshes/perf/ball_98.obj");
 	zoom = 10.0f;
 	updateCamera();
 	stepFrames = true;
-	sim = new Simulation(colliders, cloths);
+	sim = scenes::loadStaticCollDetectDebug(backend);
 	checkGLError("init sim");
 }
 
 void loadStaticCollResolveDebug() {
-	std::vector<string> colliders;
-	std::vector<string> cloths;
-	colliders.push_back("meshes/low_poly_bear.obj");
-	colliders.push_back("meshes/floor.obj");
-
-	cloths.push_back("meshes/bear_cloth.obj");
-
-	sim = new Simulation(colliders, cloths);
+	sim = scenes::loadStaticCollResolveDebug(backend);
 	checkGLError("init sim");
-
-	sim->rigids.at(0)->animated = false;
 }
 
 void initShaders(GLuint * program) {
@@ -240,10 +217,17 @@ void mainLoop() {
 
 		// draw all the meshes
 		for (int i = 0; i < sim->numRigids; i++) {
-			drawMesh(sim->rigids.at(i));
+			Rbody *rbody = sim->rigids.at(i);
+			if (sim->localSpaceColliders) {
+				drawMesh(rbody, rbody->ssbo_initPos, 0, rbody->modelMatrix);
+			} else {
+				drawMesh(rbody, rbody->ssbo_pos, 0, glm::mat4());
+			}
 		}
 		for (int i = 0; i < sim->numCloths; i++) {
-			drawMesh(sim->cloths.at(i));
+			int firstVertex;
+			BufferHandle positions = sim->clothPositions(i, firstVertex);
+			drawMesh(sim->cloths.at(i), positions, firstVertex, glm::mat4());
 		}
 		glfwSwapBuffers(window);
 		if (stepFrames)
@@ -254,10 +238,54 @@ void mainLoop() {
     glfwTerminate();
 }
 
-void drawMesh(Mesh *drawMe) {
+MeshDrawState &getDrawState(Mesh *drawMe) {
+  std::map<Mesh*, MeshDrawState>::iterator it = drawStates.find(drawMe);
+  if (it != drawStates.end()) return it->second;
+
+  MeshDrawState &state = drawStates[drawMe];
+  glGenVertexArrays(1, &state.drawingVAO);
+  glGenBuffers(1, &state.idxbo);
+
+  // upload indices
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, state.idxbo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, drawMe->indicesTris.size() * sizeof(GLuint),
+    &drawMe->indicesTris[0], GL_STATIC_DRAW);
+
+  // the GL backend's buffers can be drawn from directly.
+  // anything else gets copied into a buffer of our own every frame.
+  state.positions = 0;
+  if (!backend->isGL()) {
+    glGenBuffers(1, &state.positions);
+  }
+
+  // bind indices to the VAO.
+  glBindVertexArray(state.drawingVAO);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, state.idxbo);
+
+  // shut off the VAO
+  glBindVertexArray(0);
+
+  checkGLError("init mesh drawing");
+  return state;
+}
+
+void drawMesh(Mesh *drawMe, BufferHandle positions, int firstVertex, const glm::mat4 &model) {
+  MeshDrawState &state = getDrawState(drawMe);
+
+  GLuint drawPositions = positions;
+  if (!backend->isGL()) {
+    int numPositions = drawMe->initPositions.size();
+    std::vector<glm::vec4> hostPositions(numPositions);
+    backend->readBufferRange(positions, firstVertex, numPositions, &hostPositions[0]);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, state.positions);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, numPositions * sizeof(glm::vec4),
+      &hostPositions[0], GL_STREAM_DRAW);
+    drawPositions = state.positions;
+    firstVertex = 0;
+  }
 
   glUseProgram(program[PROG_CLOTH]);
-  glBindVertexArray(drawMe->drawingVAO);
+  glBindVertexArray(state.drawingVAO);
 
   // upload color uniform
   GLint location;
@@ -265,11 +293,15 @@ void drawMesh(Mesh *drawMe) {
 	  glUniform3fv(location, 1, &drawMe->color[0]);
   }
 
+  if ((location = glGetUniformLocation(program[PROG_CLOTH], "u_modelMatrix")) != -1) {
+	  glUniformMatrix4fv(location, 1, GL_FALSE, &model[0][0]);
+  }
+
   // Tell the GPU where the positions are. haven't figured out how to bind to the VAO yet
-  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, drawMe->ssbo_pos);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, drawPositions);
 
-  // Draw the elements.
-  glDrawElements(GL_TRIANGLES, drawMe->indicesTris.size(), GL_UNSIGNED_INT, 0);
+  // Draw the elements. batched cloths start partway into the buffer
+  glDrawElementsBaseVertex(GL_TRIANGLES, drawMe->indicesTris.size(), GL_UNSIGNED_INT, 0, firstVertex);
 
   //checkGLError("visualize");
 }
@@ -337,6 +369,21 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 	if (key == GLFW_KEY_F && action == GLFW_PRESS) {
 		stepFrames = !stepFrames;
 	}
+	if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+		// toggle profiling. turning it off prints the results and writes a trace
+		bool profiling = !sim->profiler.enabled;
+		sim->setProfiling(profiling);
+		if (profiling) {
+			Tracer::enable();
+		} else {
+			Tracer::disable();
+			sim->profiler.report(cout);
+			Tracer::report(cout);
+			sim->profiler.writeChromeTrace("profile.json");
+			sim->profiler.clear();
+			Tracer::clear();
+		}
+	}
 	updateCamera();
 	//drawRaycast();
 }
@@ -417,7 +464,7 @@ void drawRaycast() {
 glm::vec3 closestPointOnTriangle(glm::vec3 A, glm::vec3 B, glm::vec3 C, glm::vec3 P) {
 	glm::vec3 v0 = C - A;
 	glm::vec3 v1 = B - A;
-	glm::vec3 N_v2 = glm::cross(glm::normalize(v1), glm::normalize(v0));
+	glm::vec3 N_v2 = glm::normalize(glm::cross(v1, v0));
 
 	// case 1: it's in the triangle
 	// project into triangle plane
@@ -489,6 +536,236 @@ glm::vec3 closestPointOnTriangle(glm::vec3 A, glm::vec3 B, glm::vec3 C, glm::vec
   return (u_t * (v1 - v0) + v0);
 }
 
+// the constraint builder as it was before topology.hpp: per vertex searches
+// over a capped and an uncapped neighbor list, then greedy coloring with
+// per vertex color lists. quadratic, but obviously right.
+struct ReferenceConstraints {
+  vector<glm::vec4> internalConstraints[NUM_INT_CON_BUFFERS];
+  vector<glm::vec4> rows;
+  vector<glm::vec4> neighbors;
+  vector<glm::vec4> colored;
+  vector<int> colorOffsets;
+};
+
+static void referenceAddEdge(vector<vector<int>> &capped, vector<vector<int>> &all, int a, int b) {
+  if (find(capped[a].begin(), capped[a].end(), b) == capped[a].end() &&
+    find(capped[b].begin(), capped[b].end(), a) == capped[b].end()) {
+    if (capped[a].size() < NUM_INT_CON_BUFFERS) capped[a].push_back(b);
+    if (capped[b].size() < NUM_INT_CON_BUFFERS) capped[b].push_back(a);
+  }
+  if (find(all[a].begin(), all[a].end(), b) == all[a].end() &&
+    find(all[b].begin(), all[b].end(), a) == all[b].end()) {
+    all[a].push_back(b);
+    all[b].push_back(a);
+  }
+}
+
+static float referenceLength(const vector<glm::vec4> &positions, int a, int b) {
+  glm::vec4 p1 = positions[a];
+  glm::vec4 p2 = positions[b];
+  return glm::length(glm::vec3(p1.x, p1.y, p1.z) - glm::vec3(p2.x, p2.y, p2.z));
+}
+
+static void referenceConstraints(Mesh *mesh, ReferenceConstraints &out) {
+  int numVertices = mesh->initPositions.size();
+  vector<vector<int>> capped(numVertices);
+  vector<vector<int>> all(numVertices);
+  for (int i = 0; i < (int)mesh->indicesQuads.size(); i++) {
+    glm::ivec4 face = mesh->indicesQuads[i];
+    for (int e = 0; e < 4; e++) referenceAddEdge(capped, all, face[e], face[(e + 1) % 4]);
+    if (NUM_INT_CON_BUFFERS > 4) {
+      referenceAddEdge(capped, all, face[0], face[2]);
+      referenceAddEdge(capped, all, face[1], face[3]);
+    }
+  }
+  for (int i = 0; i < (int)mesh->indicesPolygonTris.size(); i++) {
+    glm::ivec3 tri = mesh->indicesPolygonTris[i];
+    for (int e = 0; e < 3; e++) referenceAddEdge(capped, all, tri[e], tri[(e + 1) % 3]);
+  }
+
+  for (int i = 0; i < numVertices; i++) {
+    for (int j = 0; j < (int)capped[i].size(); j++) {
+      out.internalConstraints[j].push_back(glm::vec4(i, capped[i][j],
+        referenceLength(mesh->initPositions, i, capped[i][j]), 0.0f));
+    }
+    out.rows.push_back(glm::vec4(out.neighbors.size(), all[i].size(), 0.0f, 0.0f));
+    for (int j = 0; j < (int)all[i].size(); j++) {
+      out.neighbors.push_back(glm::vec4(all[i][j], referenceLength(mesh->initPositions, i, all[i][j]), 0.0f, 0.0f));
+    }
+  }
+
+  vector<glm::vec4> edges;
+  for (int i = 0; i < numVertices; i++) {
+    for (int j = 0; j < (int)all[i].size(); j++) {
+      if (all[i][j] > i) edges.push_back(glm::vec4(i, all[i][j], referenceLength(mesh->initPositions, i, all[i][j]), 0.0f));
+    }
+  }
+  int numEdges = edges.size();
+  vector<vector<int>> vertexColors(numVertices);
+  vector<int> edgeColors(numEdges);
+  vector<int> colorSizes;
+  for (int e = 0; e < numEdges; e++) {
+    vector<int> &colorsA = vertexColors[(int)edges[e].x];
+    vector<int> &colorsB = vertexColors[(int)edges[e].y];
+    int color = 0;
+    while (find(colorsA.begin(), colorsA.end(), color) != colorsA.end() ||
+      find(colorsB.begin(), colorsB.end(), color) != colorsB.end()) color++;
+    edgeColors[e] = color;
+    colorsA.push_back(color);
+    colorsB.push_back(color);
+    if (color >= (int)colorSizes.size()) colorSizes.resize(color + 1, 0);
+    colorSizes[color]++;
+  }
+  int numColors = colorSizes.size();
+  int targetSize = numColors > 0 ? (numEdges + numColors - 1) / numColors : 0;
+  for (int e = 0; e < numEdges; e++) {
+    int color = edgeColors[e];
+    if (colorSizes[color] <= targetSize) continue;
+    vector<int> &colorsA = vertexColors[(int)edges[e].x];
+    vector<int> &colorsB = vertexColors[(int)edges[e].y];
+    for (int c = 0; c < numColors; c++) {
+      if (colorSizes[c] >= targetSize) continue;
+      if (find(colorsA.begin(), colorsA.end(), c) != colorsA.end()) continue;
+      if (find(colorsB.begin(), colorsB.end(), c) != colorsB.end()) continue;
+      *find(colorsA.begin(), colorsA.end(), color) = c;
+      *find(colorsB.begin(), colorsB.end(), color) = c;
+      colorSizes[color]--;
+      colorSizes[c]++;
+      edgeColors[e] = c;
+      break;
+    }
+  }
+  out.colorOffsets.assign(numColors + 1, 0);
+  for (int c = 0; c < numColors; c++) out.colorOffsets[c + 1] = out.colorOffsets[c] + colorSizes[c];
+  vector<int> next(out.colorOffsets.begin(), out.colorOffsets.end() - 1);
+  out.colored.resize(numEdges);
+  for (int e = 0; e < numEdges; e++) out.colored[next[edgeColors[e]]++] = edges[e];
+}
+
+// the cloth's compact constraints in the reference's vec4s
+static glm::vec4 asVec4(const ConstraintRow &row) { return glm::vec4(row.first, row.count, 0.0f, 0.0f); }
+static glm::vec4 asVec4(const ConstraintNeighbor &neighbor) { return glm::vec4(neighbor.index, neighbor.restLength, 0.0f, 0.0f); }
+static glm::vec4 asVec4(const EdgeConstraint &edge) { return glm::vec4(edge.a, edge.b, edge.restLength, 0.0f); }
+
+template<typename T> static bool sameConstraints(const vector<T> &a, const vector<glm::vec4> &b) {
+  if (a.size() != b.size()) return false;
+  for (int i = 0; i < (int)a.size(); i++) {
+    if (asVec4(a[i]) != b[i]) return false;
+  }
+  return true;
+}
+
+// every mesh we ship, as a cloth, against the reference builder above
+void testConstraintTopology() {
+  cout << "testing constraint topology against the reference builder" << endl;
+  const char *names[] = { "meshes/20x20cloth.obj", "meshes/2x2cloth.obj", "meshes/3x3cloth.obj",
+    "meshes/4x4cloth.obj", "meshes/bear_cloth.obj", "meshes/cape.obj", "meshes/cube.obj", "meshes/dress.obj",
+    "meshes/floor.obj", "meshes/low_poly_bear.obj", "meshes/semi_smooth_cube.obj", "meshes/small_bear_cloth.obj",
+    "meshes/perf/cloth_121.obj", "meshes/perf/cloth_1296.obj", "meshes/perf/ball_98.obj", "meshes/perf/ball_6156.obj" };
+  Backend *cpu = createCPUBackend(1);
+  for (int m = 0; m < (int)(sizeof(names) / sizeof(names[0])); m++) {
+    string filename = scenes::meshRoot + names[m];
+    ifstream exists(filename.c_str());
+    if (!exists.is_open()) {
+      cout << "skipping " << filename << ", not found" << endl;
+      continue;
+    }
+    Cloth cloth(cpu, filename, glm::vec3(0.0f));
+    ReferenceConstraints expected;
+    referenceConstraints(&cloth, expected);
+    bool same = sameConstraints(cloth.constraintRows, expected.rows) &&
+      sameConstraints(cloth.constraintNeighbors, expected.neighbors) &&
+      sameConstraints(cloth.coloredConstraints, expected.colored) &&
+      cloth.colorOffsets == expected.colorOffsets;
+    for (int j = 0; j < NUM_INT_CON_BUFFERS; j++) {
+      same = same && sameConstraints(cloth.internalConstraints[j], expected.internalConstraints[j]);
+    }
+    cout << filename << ": expected: identical actual: " << (same ? "identical" : "DIFFERENT") << endl;
+  }
+  delete cpu;
+}
+
+// the batched triangle queries against the scalar path, on random
+// triangles (some of them degenerate), then how long each path takes
+static float randomUnit(unsigned int &state) {
+  state = state * 1664525u + 1013904223u;
+  return (state >> 8) / 8388608.0f - 1.0f; // [-1, 1)
+}
+
+static bool sameFloats(const float *a, const float *b, int n) {
+  for (int i = 0; i < n; i++) {
+    bool bothNaN = a[i] != a[i] && b[i] != b[i];
+    if (!bothNaN && memcmp(&a[i], &b[i], sizeof(float)) != 0) return false;
+  }
+  return true;
+}
+
+void testTriangleQueries() {
+  cout << "testing batched triangle queries against the scalar path" << endl;
+  const int numPoints = 256;
+  const int repeats = 100;
+  unsigned int state = 1;
+  TriangleBatch batch;
+  TriangleSoA triangles;
+  triangles.resize(TRIANGLE_BATCH_SIZE);
+  for (int i = 0; i < TRIANGLE_BATCH_SIZE; i++) {
+    triangles.ax[i] = randomUnit(state); triangles.ay[i] = randomUnit(state); triangles.az[i] = randomUnit(state);
+    triangles.bx[i] = randomUnit(state); triangles.by[i] = randomUnit(state); triangles.bz[i] = randomUnit(state);
+    triangles.cx[i] = randomUnit(state); triangles.cy[i] = randomUnit(state); triangles.cz[i] = randomUnit(state);
+    if (i % 16 == 15) { // a corner twice
+      triangles.cx[i] = triangles.ax[i]; triangles.cy[i] = triangles.ay[i]; triangles.cz[i] = triangles.az[i];
+    }
+  }
+  // one short of full, so the last lanes are past the end
+  batch.add(triangles, 0, TRIANGLE_BATCH_SIZE - 1);
+  vector<float> points(numPoints * 3);
+  vector<float> dirs(numPoints * 3);
+  for (int p = 0; p < numPoints; p++) {
+    glm::vec3 dir = glm::normalize(glm::vec3(randomUnit(state), randomUnit(state), randomUnit(state)));
+    for (int k = 0; k < 3; k++) {
+      points[3 * p + k] = 2.0f * randomUnit(state);
+      dirs[3 * p + k] = dir[k];
+    }
+  }
+
+  const TriangleQueries *scalar = triangleQueries::get(TRIANGLE_QUERY_SCALAR);
+  int n = batch.count;
+  vector<float> expected(numPoints * 5 * TRIANGLE_BATCH_SIZE);
+  vector<float> actual(numPoints * 5 * TRIANGLE_BATCH_SIZE);
+  double scalarNs = 0.0;
+  for (int path = 0; path < NUM_TRIANGLE_QUERY_PATHS; path++) {
+    const TriangleQueries *queries = triangleQueries::get(path);
+    if (!queries) continue;
+    float *out = path == TRIANGLE_QUERY_SCALAR ? &expected[0] : &actual[0];
+    for (int p = 0; p < numPoints; p++) {
+      float *o = out + p * 5 * TRIANGLE_BATCH_SIZE;
+      queries->intersectRay(batch, &points[3 * p], &dirs[3 * p], o);
+      queries->nearestPoints(batch, &points[3 * p], o + TRIANGLE_BATCH_SIZE, o + 2 * TRIANGLE_BATCH_SIZE,
+        o + 3 * TRIANGLE_BATCH_SIZE, o + 4 * TRIANGLE_BATCH_SIZE);
+    }
+    bool same = true;
+    for (int p = 0; p < numPoints * 5; p++) {
+      same = same && sameFloats(&expected[p * TRIANGLE_BATCH_SIZE], &out[p * TRIANGLE_BATCH_SIZE], n);
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+    for (int r = 0; r < repeats; r++) {
+      for (int p = 0; p < numPoints; p++) {
+        float *o = out + p * 5 * TRIANGLE_BATCH_SIZE;
+        queries->intersectRay(batch, &points[3 * p], &dirs[3 * p], o);
+        queries->nearestPoints(batch, &points[3 * p], o + TRIANGLE_BATCH_SIZE, o + 2 * TRIANGLE_BATCH_SIZE,
+          o + 3 * TRIANGLE_BATCH_SIZE, o + 4 * TRIANGLE_BATCH_SIZE);
+      }
+    }
+    double ns = chrono::duration<double, nano>(chrono::high_resolution_clock::now() - start).count() /
+      ((double)repeats * numPoints * n);
+    if (path == TRIANGLE_QUERY_SCALAR) scalarNs = ns;
+    cout << queries->name << " (" << queries->width << " wide): expected: identical actual: "
+      << (same ? "identical" : "DIFFERENT") << ", " << ns << " ns per triangle (ray + nearest point), "
+      << scalarNs / ns << "x scalar" << endl;
+  }
+}
+
 void runTests() {
   cout << "running some tests..." << endl;
   // tests for nearest point on triangle
@@ -538,6 +815,9 @@ void runTests() {
   cout << "testing case 2: closest point is on an edge." << endl;
   cout << "expected: -1 -1 0 actual: " << nearest.x << " " << nearest.y << " " << nearest.z << endl;
 
-  
+
+  testConstraintTopology();
+  testTriangleQueries();
+
   cout << "done tests!" << endl;
 }
\ No newline at end of file
@@ -11,7 +11,9 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include "utilityCore.hpp"
 #include "glslUtility.hpp"
+#include <map>
 #include "mesh.hpp"
+#include "rbody.hpp"
 
 //====================================
 // GL Stuff
@@ -22,6 +24,14 @@ const char *attributeLocations[] = { "Position" };
 GLuint displayImage;
 GLuint program[2];
 
+// GL drawing state for each mesh, built the first time it's drawn
+struct MeshDrawState {
+  GLuint drawingVAO;
+  GLuint idxbo; // index buffer
+  GLuint positions; // host-side backends copy positions in here to draw
+};
+std::map<Mesh*, MeshDrawState> drawStates;
+
 const unsigned int PROG_CLOTH = 0; // program for rendering cloth
 const unsigned int PROG_WIRE = 1; // program for rendering wireframes, like for raycasting
 
@@ -51,7 +61,8 @@ int main(int argc, char* argv[]);
 // Main loop
 //====================================
 void mainLoop();
-void drawMesh(Mesh *drawMe);
+void drawMesh(Mesh *drawMe, BufferHandle positions, int firstVertex, const glm::mat4 &model);
+MeshDrawState &getDrawState(Mesh *drawMe);
 void errorCallback(int error, const char *description);
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void clickCallback(GLFWwindow* window, int button, int action, int mods);
@@ -0,0 +1,63 @@
+#include "mappedFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+MappedFile::MappedFile(const std::string &path) {
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (handle == INVALID_HANDLE_VALUE) return;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(handle);
+		return;
+	}
+	HANDLE view = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (view == NULL) {
+		CloseHandle(handle);
+		return;
+	}
+	data = (const char *)MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+	if (data == NULL) {
+		CloseHandle(view);
+		CloseHandle(handle);
+		return;
+	}
+	size = (size_t)fileSize.QuadPart;
+	file = handle;
+	mapping = view;
+}
+
+MappedFile::~MappedFile() {
+	if (data) UnmapViewOfFile(data);
+	if (mapping) CloseHandle(mapping);
+	if (file) CloseHandle(file);
+}
+
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+MappedFile::MappedFile(const std::string &path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) return;
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		close(fd);
+		return;
+	}
+	void *mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps the file alive
+	if (mapped == MAP_FAILED) return;
+	madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+	data = (const char *)mapped;
+	size = info.st_size;
+}
+
+MappedFile::~MappedFile() {
+	if (data) munmap((void *)data, size);
+}
+#endif
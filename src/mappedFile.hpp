@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+// a whole file mapped read-only into memory (mmap, or MapViewOfFile on
+// windows). data stays valid until the MappedFile goes away.
+// empty and missing files both come out as !isOpen().
+
+class MappedFile
+{
+public:
+	MappedFile(const std::string &path);
+	~MappedFile();
+
+	bool isOpen() const { return data != NULL; }
+	const char *data = NULL;
+	size_t size = 0;
+
+private:
+	MappedFile(const MappedFile &);
+	MappedFile &operator=(const MappedFile &);
+
+#ifdef _WIN32
+	void *file = NULL;
+	void *mapping = NULL;
+#endif
+};
@@ -1,72 +1,17 @@
 #include "mesh.hpp"
-#include "checkGLError.hpp"
-
-Mesh::Mesh(string filename) {
-  this->filename = filename;
-
-  // compute a randomized, tiny jitter
-  /* initialize random seed: */
-  srand(time(NULL));
-
-  /* generate secret number between 1 and 100: */
-  jitter = glm::vec3(0.0f);
-
-  // load things up
-  buildGeometry();
-
-  color = glm::vec3(0.6f);
-
-  glGenVertexArrays(1, &drawingVAO);
-
-  // build all the gl buffers and stuff
-  glGenBuffers(1, &ssbo_pos);
-  glGenBuffers(1, &idxbo);
-
-  // upload indices
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, idxbo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesTris.size() * sizeof(GLuint),
-	  &indicesTris[0], GL_STATIC_DRAW);
-
-  // Initialize cloth positions on GPU
-
-  GLint bufMask = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
-  int positionCount = initPositions.size();
-
-  glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo_pos);
-  glBufferData(GL_SHADER_STORAGE_BUFFER, positionCount * sizeof(glm::vec4),
-    &initPositions[0], GL_STREAM_COPY);
-
-
-//  // debug buffer
-//  glGenBuffers(1, &ssbo_debug);
-//  glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo_debug);
-//  glBufferData(GL_SHADER_STORAGE_BUFFER, positionCount * sizeof(glm::vec4),
-//	  NULL, GL_STREAM_COPY);
-
-  //glm::vec4 *pos = (glm::vec4 *) glMapBufferRange(GL_SHADER_STORAGE_BUFFER,
-  //  0, positionCount * sizeof(glm::vec4), bufMask);
-  //for (int i = 0; i < positionCount; i++) {
-  //  pos[i] = initPositions[i];
-  //}
-  //glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
-
-  // bind indices to the VAO.
-  glBindVertexArray(drawingVAO);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, idxbo);
-
-  // try to bind the ssbo to the VAO. this doesn't work yet, see drawMesh in main
-  glEnableVertexAttribArray(attr_position);
-  glBindBuffer(GL_ARRAY_BUFFER, ssbo_pos);
-  glVertexAttribPointer((GLuint)attr_position, 4, GL_FLOAT, GL_FALSE, 0, 0);
-
-  // shut off the VAO
-  glBindVertexArray(0);
-
-  checkGLError("init mesh");
+#include "generators.hpp"
+#include "objLoader.hpp"
+#include "asset.hpp"
+#include "topology.hpp"
+#include "threadPool.hpp"
+#include "tracer.hpp"
+
+Mesh::Mesh(Backend *backend, string filename) : Mesh(backend, filename, glm::vec3(0.0f)) {
 }
 
-Mesh::Mesh(string filename, glm::vec3 jitter) {
+Mesh::Mesh(Backend *backend, string filename, glm::vec3 jitter) {
 	this->filename = filename;
+	this->backend = backend;
 
 	// compute a randomized, tiny jitter
 	/* initialize random seed: */
@@ -80,113 +25,126 @@ Mesh::Mesh(string filename, glm::vec3 jitter) {
 
 	color = glm::vec3(0.6f);
 
-	glGenVertexArrays(1, &drawingVAO);
-
-	// build all the gl buffers and stuff
-	glGenBuffers(1, &ssbo_pos);
-	glGenBuffers(1, &idxbo);
-
-	// upload indices
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, idxbo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesTris.size() * sizeof(GLuint),
-		&indicesTris[0], GL_STATIC_DRAW);
-
-	// Initialize cloth positions on GPU
-
-	GLint bufMask = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
-	int positionCount = initPositions.size();
-
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo_pos);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, positionCount * sizeof(glm::vec4),
-		&initPositions[0], GL_STREAM_COPY);
-
-	// bind indices to the VAO.
-	glBindVertexArray(drawingVAO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, idxbo);
-
-	// try to bind the ssbo to the VAO. this doesn't work yet, see drawMesh in main
-	glEnableVertexAttribArray(attr_position);
-	glBindBuffer(GL_ARRAY_BUFFER, ssbo_pos);
-	glVertexAttribPointer((GLuint)attr_position, 4, GL_FLOAT, GL_FALSE, 0, 0);
-
-	// shut off the VAO
-	glBindVertexArray(0);
+	// Initialize positions on the backend
+	ssbo_pos = backend->createBuffer(initPositions.size(), &initPositions[0]);
+}
 
-	checkGLError("init mesh");
+Mesh::Mesh(Backend *backend) {
+	this->backend = backend;
+	ssbo_pos = 0;
+	color = glm::vec3(0.6f);
 }
 
 Mesh::~Mesh() {
+  closeAsset();
+}
 
+void Mesh::closeAsset() {
+  delete asset;
+  asset = NULL;
 }
 
 void Mesh::buildGeometry()
 {
-  // load the file up
-  ifstream myfile(filename);
-  string line;
-  if (myfile.is_open())
-  {
-    while (getline(myfile, line))
-    {
-      placeToken(line, &myfile);
+  if (MeshAsset::isAsset(filename)) {
+    asset = new MeshAsset(filename);
+    if (!asset->isOpen()) exit(EXIT_FAILURE);
+    asset->read(ASSET_POSITIONS, initPositions);
+    asset->read(ASSET_QUADS, indicesQuads);
+    asset->read(ASSET_TRIS, indicesTris);
+    asset->read(ASSET_POLYGON_TRIS, indicesPolygonTris);
+    // already in the order it was saved in
+    asset->read(ASSET_VERTEX_ORDER, fileOrder);
+    fromFile.resize(fileOrder.size());
+    for (int v = 0; v < (int)fileOrder.size(); v++) {
+      fromFile[fileOrder[v]] = v;
+    }
+  } else {
+    if (generators::isGenerated(filename)) {
+      if (!generators::generate(filename, initPositions, indicesQuads, indicesTris, indicesPolygonTris)) {
+        cout << "unknown generated mesh " << filename << endl;
+        exit(EXIT_FAILURE);
+      }
+    } else if (!obj::load(filename, initPositions, indicesQuads, indicesTris, indicesPolygonTris)) {
+      exit(EXIT_FAILURE);
     }
-    myfile.close();
+    if (REORDER_VERTICES) reorderVertices();
   }
-  return;
-}
 
-glm::vec3 parseOneVec3(string token) {
-  float x, y, z;
-  sscanf_s(token.c_str(), "%f %f %f\n", &x, &y, &z);
-  return glm::vec3(x, y, z);
+  for (int i = 0; i < (int)initPositions.size(); i++) {
+    initPositions[i] += glm::vec4(jitter, 0.0f);
+  }
 }
 
-glm::ivec4 parseOneivec4(string token) {
-  int x, y, z, w;
-  sscanf_s(token.c_str(), "%i %i %i %i\n", &x, &y, &z, &w);
-  return glm::ivec4(x, y, z, w);
+// bits of v spread out to every third bit, for up to 21 bits
+static unsigned long long spreadBits(unsigned int v) {
+  unsigned long long x = v;
+  x = (x | x << 32) & 0x1f00000000ffffULL;
+  x = (x | x << 16) & 0x1f0000ff0000ffULL;
+  x = (x | x << 8) & 0x100f00f00f00f00fULL;
+  x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+  x = (x | x << 2) & 0x1249249249249249ULL;
+  return x;
 }
 
-void Mesh::placeToken(string token, ifstream *myfile) {
-    if (token.length() == 0)
-    {
-      ////std::cout << "newline maybe" << std::endl;
-      return;
-    }
+// sorts the vertices on their Morton code in the mesh's bounds (same scale
+// on every axis) and renumbers the faces to match. vertices in the same
+// cell keep their file order, so this is a no-op on a mesh it already did.
+void Mesh::reorderVertices() {
+  TRACE_ZONE("reorder vertices");
+  int numVertices = initPositions.size();
+  if (numVertices == 0) return;
+  ThreadPool *pool = NULL;
+  if (numVertices >= TOPOLOGY_PARALLEL_MIN_EDGES) {
+    pool = new ThreadPool();
+    pool->minParallelCount = 1;
+  }
 
-    // case of a vertex
-    if (token.compare(0, 1, "v") == 0)
-    {
-      token.erase(0, 2); // we'll assume v x y z, so erase v and whitespace space
-	  initPositions.push_back(glm::vec4(parseOneVec3(token) + jitter, 1.0));
-      return;
+  glm::vec3 boundsMin = glm::vec3(initPositions[0]);
+  glm::vec3 boundsMax = boundsMin;
+  for (int i = 1; i < numVertices; i++) {
+    boundsMin = glm::min(boundsMin, glm::vec3(initPositions[i]));
+    boundsMax = glm::max(boundsMax, glm::vec3(initPositions[i]));
+  }
+  glm::vec3 extent = boundsMax - boundsMin;
+  float size = glm::max(glm::max(extent.x, extent.y), extent.z);
+  float cells = (float)((1 << REORDER_CURVE_BITS) - 1);
+  float scale = size > 0.0f ? cells / size : 0.0f;
+
+  std::vector<unsigned long long> keys(numVertices);
+  fileOrder.resize(numVertices);
+  topology::forChunks(pool, numVertices, [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      glm::vec3 cell = glm::clamp((glm::vec3(initPositions[i]) - boundsMin) * scale, glm::vec3(0.0f), glm::vec3(cells));
+      keys[i] = spreadBits((unsigned int)cell.x) | spreadBits((unsigned int)cell.y) << 1 |
+        spreadBits((unsigned int)cell.z) << 2;
+      fileOrder[i] = i;
     }
+  });
+  topology::radixSort(keys, fileOrder, 3 * REORDER_CURVE_BITS, pool);
+
+  fromFile.resize(numVertices);
+  std::vector<glm::vec4> positions(numVertices);
+  topology::forChunks(pool, numVertices, [&](int begin, int end) {
+    for (int v = begin; v < end; v++) {
+      fromFile[fileOrder[v]] = v;
+      positions[v] = initPositions[fileOrder[v]];
+    }
+  });
+  initPositions.swap(positions);
 
-    // case of a face index. expects quad faces
-    if (token.compare(0, 1, "f") == 0)
-    {
-      token.erase(0, 2); // we'll assume f x y z, so erase f and whitespace space
-        glm::ivec4 face_indices = parseOneivec4(token);
-		// slight jitter to avoid extreme edge cases
-
-        // objs are 1 indexed
-        face_indices -= glm::ivec4(1);
-        indicesQuads.push_back(face_indices);
-
-        // compute triangular indices. quad indices assumed to be cclockwise
-        // 0 3
-        // 1 2
-        glm::ivec3 tri1 = glm::ivec3(face_indices[0], face_indices[1], face_indices[2]);
-        glm::ivec3 tri2 = glm::ivec3(face_indices[0], face_indices[2], face_indices[3]);
-        indicesTris.push_back(tri1.x);
-        indicesTris.push_back(tri1.y);
-        indicesTris.push_back(tri1.z);
-        indicesTris.push_back(tri2.x);
-        indicesTris.push_back(tri2.y);
-        indicesTris.push_back(tri2.z);
-      return;
+  topology::forChunks(pool, indicesQuads.size(), [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      for (int j = 0; j < 4; j++) indicesQuads[i][j] = fromFile[indicesQuads[i][j]];
+    }
+  });
+  topology::forChunks(pool, indicesTris.size(), [&](int begin, int end) {
+    for (int i = begin; i < end; i++) indicesTris[i] = fromFile[indicesTris[i]];
+  });
+  topology::forChunks(pool, indicesPolygonTris.size(), [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      for (int j = 0; j < 3; j++) indicesPolygonTris[i][j] = fromFile[indicesPolygonTris[i][j]];
     }
-    return;
+  });
+  delete pool;
 }
-
-
@@ -2,7 +2,7 @@
 #include <glm/glm.hpp>
 #include <cstdlib>
 #include <cstdio>
-#include "glslUtility.hpp"
+#include "backend.hpp"
 #include <vector>
 #include <iostream>
 #include <fstream>
@@ -10,36 +10,62 @@
 #include <time.h>
 
 // holds pointers to everything that can be rendered from a mesh
-// - GL buffer for positions
-// - index buffer to help with rendering
-// - obj loader -> expects quads
+// - backend buffer for positions
+// - indices to help with rendering
+// - obj loader -> quads, plus triangles and fanned n-gons (see objLoader.hpp)
+// - or a generated mesh, see generators.hpp
+// - or a precompiled asset, see asset.hpp
+// drawing state (VAO, index buffer) lives with the renderer in main
+
+// renumber vertices along a Morton curve through the mesh's bounds at load,
+// so vertices close in space sit close together in every per-vertex buffer
+// and the gathers in the solver and collision kernels stay cache friendly.
+// faces keep their order, only their indices change.
+#define REORDER_VERTICES 1
+#define REORDER_CURVE_BITS 10 // per axis
 
 using namespace std;
 
+class MeshAsset;
+
 class Mesh
 {
 public:
   string filename;
-  GLuint attr_position = 0;
-  GLuint drawingVAO;
-  GLuint ssbo_pos; // shader storage buffer object -> holds positions
-  GLuint idxbo; // index buffer
-  //GLuint ssbo_debug; // ssbo for storing debug info
+  Backend *backend;
+  BufferHandle ssbo_pos; // shader storage buffer object -> holds positions
 
   vector<glm::vec4> initPositions;
   vector<glm::ivec4> indicesQuads;
   vector<int> indicesTris;
+  vector<glm::ivec3> indicesPolygonTris; // triangles of faces that weren't quads
 
   glm::vec3 color;
 
-  Mesh(string filename);
-  Mesh(string filename, glm::vec3 jitter);
-  ~Mesh();
+  // vertex v was vertex fileOrder[v] in the mesh file. empty if the vertices
+  // weren't reordered. anything that names vertices by their index in the
+  // file (pins in the scenes, obj output) goes through these.
+  vector<int> fileOrder;
+  int vertexFromFile(int fileIndex) const { return fromFile.empty() ? fileIndex : fromFile.at(fileIndex); }
+  int fileVertex(int vertex) const { return fileOrder.empty() ? vertex : fileOrder.at(vertex); }
+
+  Mesh(Backend *backend, string filename);
+  Mesh(Backend *backend, string filename, glm::vec3 jitter);
+  virtual ~Mesh();
+
+protected:
+  Mesh(Backend *backend); // empty, for meshes put together from others
 
-private:
 	glm::vec3 jitter;
 
+  // open while the constructors copy out of it, if the mesh came from an asset
+  MeshAsset *asset = NULL;
+  void closeAsset();
+
+private:
+  vector<int> fromFile; // the inverse of fileOrder
+
   void buildGeometry();
-  void placeToken(string token, ifstream *myfile);
+  void reorderVertices();
 
 };
\ No newline at end of file
@@ -0,0 +1,397 @@
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <locale.h>
+#if defined(__APPLE__)
+#include <xlocale.h>
+#endif
+#include "objLoader.hpp"
+#include "mappedFile.hpp"
+#include "threadPool.hpp"
+#include "tracer.hpp"
+
+/******************************************************************************
+ numbers
+******************************************************************************/
+
+static const float floatPowers[11] = {
+	1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+static const double doublePowers[23] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static bool isDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+static bool isSpace(char c) {
+	return c == ' ' || c == '\t';
+}
+
+static bool isLineEnd(char c) {
+	return c == '\n' || c == '\r';
+}
+
+// strtof in the C locale, whatever the program's is, so '.' stays the point
+static float strtofClassic(const char *s, char **after) {
+#if defined(_WIN32)
+	static _locale_t classic = _create_locale(LC_ALL, "C");
+	return _strtof_l(s, after, classic);
+#else
+	static locale_t classic = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+	return strtof_l(s, after, classic);
+#endif
+}
+
+// the rare number the fast paths can't round exactly (ex: more than 19
+// digits, huge exponents, inf, nan). strtof itself, so it can't round any
+// differently. out of range values come out as inf or 0, like strtof's.
+static bool parseFloatSlow(const char *begin, const char *end, float &value) {
+	std::string token(begin, end);
+	char *after;
+	value = strtofClassic(token.c_str(), &after);
+	return after != token.c_str() && after == token.c_str() + token.size();
+}
+
+const char *obj::parseFloat(const char *p, const char *end, float &value) {
+	const char *start = p;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+
+	// up to 19 significant digits fit in the mantissa
+	unsigned long long mantissa = 0;
+	int exponent = 0;
+	int numDigits = 0;
+	int numSignificant = 0;
+	bool truncated = false;
+	for (; p < end && isDigit(*p); p++, numDigits++) {
+		if (numSignificant < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa > 0) numSignificant++;
+		} else {
+			exponent++;
+			truncated = true;
+		}
+	}
+	if (p < end && *p == '.') {
+		p++;
+		for (; p < end && isDigit(*p); p++, numDigits++) {
+			if (numSignificant < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa > 0) numSignificant++;
+				exponent--;
+			} else {
+				truncated = true;
+			}
+		}
+	}
+	if (numDigits == 0) {
+		// inf, nan, or not a number at all
+		const char *tokenEnd = p;
+		while (tokenEnd < end && !isSpace(*tokenEnd) && !isLineEnd(*tokenEnd)) tokenEnd++;
+		if (tokenEnd == p || !parseFloatSlow(start, tokenEnd, value)) return NULL;
+		return tokenEnd;
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		const char *exponentStart = p;
+		p++;
+		bool negativeExponent = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negativeExponent = *p == '-';
+			p++;
+		}
+		if (p < end && isDigit(*p)) {
+			int written = 0;
+			for (; p < end && isDigit(*p); p++) {
+				if (written < 100000) written = written * 10 + (*p - '0');
+			}
+			exponent += negativeExponent ? -written : written;
+		} else {
+			p = exponentStart; // "1e" is just 1
+		}
+	}
+
+	if (mantissa == 0) {
+		value = negative ? -0.0f : 0.0f;
+		return p;
+	}
+	if (!truncated) {
+		// both operands exact in float, so one correctly rounded operation
+		if (mantissa <= (1ull << 24) && exponent >= -10 && exponent <= 10) {
+			float f = (float)mantissa;
+			f = exponent < 0 ? f / floatPowers[-exponent] : f * floatPowers[exponent];
+			value = negative ? -f : f;
+			return p;
+		}
+		// same in double. rounding that to float again only goes wrong if the
+		// double landed exactly halfway between two floats, so those go slow
+		if (mantissa < (1ull << 53) && exponent >= -22 && exponent <= 22) {
+			double d = (double)mantissa;
+			d = exponent < 0 ? d / doublePowers[-exponent] : d * doublePowers[exponent];
+			unsigned long long bits;
+			memcpy(&bits, &d, sizeof(bits));
+			bool halfway = (bits & ((1ull << 29) - 1)) == (1ull << 28);
+			if (!halfway && d >= FLT_MIN && d <= FLT_MAX) {
+				value = negative ? -(float)d : (float)d;
+				return p;
+			}
+		}
+	}
+	if (!parseFloatSlow(start, p, value)) return NULL;
+	return p;
+}
+
+/******************************************************************************
+ lines
+******************************************************************************/
+
+#define INVALID_INDEX INT_MIN
+
+// what one range of lines contributed
+struct ObjChunk
+{
+	const char *begin;
+	const char *end;
+	std::vector<glm::vec4> positions;
+	std::vector<int> faceIndices; // 0-based, relative ones still local to the chunk
+	std::vector<int> faceSizes;
+	std::vector<int> relative; // entries of faceIndices that need the chunk's vertex offset
+	int numQuads = 0;
+	int numPolygonTris = 0;
+	int numBadVertices = 0; // lines with a coordinate that isn't a number, or too few
+	const char *firstBadVertex = NULL;
+
+	// where this chunk's output starts
+	int firstVertex = 0;
+	int firstQuad = 0;
+	int firstTri = 0;
+	int firstPolygonTri = 0;
+};
+
+static const char *skipSpaces(const char *p, const char *end) {
+	while (p < end && isSpace(*p)) p++;
+	return p;
+}
+
+static const char *nextLine(const char *p, const char *end) {
+	const char *newline = (const char *)memchr(p, '\n', end - p);
+	return newline ? newline + 1 : end;
+}
+
+static void parseVertex(ObjChunk &chunk, const char *line, const char *p, const char *end) {
+	glm::vec4 position(0.0f, 0.0f, 0.0f, 1.0f);
+	for (int i = 0; i < 3; i++) {
+		p = skipSpaces(p, end);
+		float value;
+		const char *after = obj::parseFloat(p, end, value);
+		if (after == NULL) {
+			if (chunk.numBadVertices++ == 0) chunk.firstBadVertex = line;
+			break;
+		}
+		position[i] = value;
+		p = after;
+	}
+	chunk.positions.push_back(position);
+}
+
+static void parseFace(ObjChunk &chunk, const char *p, const char *end) {
+	int firstCorner = chunk.faceIndices.size();
+	int firstRelative = chunk.relative.size();
+	int numCorners = 0;
+	while (true) {
+		p = skipSpaces(p, end);
+		if (p >= end || isLineEnd(*p) || *p == '#') break;
+
+		// v, v/vt, v//vn or v/vt/vn. only v matters
+		bool negative = false;
+		if (*p == '-' || *p == '+') {
+			negative = *p == '-';
+			p++;
+		}
+		long long index = 0;
+		bool any = false;
+		for (; p < end && isDigit(*p); p++) {
+			if (index < INT_MAX) index = index * 10 + (*p - '0');
+			any = true;
+		}
+		while (p < end && !isSpace(*p) && !isLineEnd(*p)) p++;
+
+		int corner;
+		if (!any || index == 0 || index > INT_MAX) {
+			corner = INVALID_INDEX;
+		} else if (negative) {
+			corner = (int)chunk.positions.size() - (int)index;
+			chunk.relative.push_back(chunk.faceIndices.size());
+		} else {
+			corner = (int)index - 1;
+		}
+		chunk.faceIndices.push_back(corner);
+		numCorners++;
+	}
+	if (numCorners < 3) {
+		// points and lines aren't faces
+		chunk.faceIndices.resize(firstCorner);
+		chunk.relative.resize(firstRelative);
+		return;
+	}
+	chunk.faceSizes.push_back(numCorners);
+	if (numCorners == 4) chunk.numQuads++;
+	else chunk.numPolygonTris += numCorners - 2;
+}
+
+static void parseChunk(ObjChunk &chunk) {
+	const char *p = chunk.begin;
+	const char *end = chunk.end;
+	while (p < end) {
+		const char *line = skipSpaces(p, end);
+		p = nextLine(line, end);
+		if (line + 1 >= end || !isSpace(line[1])) continue; // vt, vn, usemtl, blank...
+		if (line[0] == 'v') parseVertex(chunk, line, line + 1, p);
+		else if (line[0] == 'f') parseFace(chunk, line + 1, p);
+	}
+}
+
+// writes a chunk's faces into the shared arrays. returns the number of bad indices
+static int emitChunk(ObjChunk &chunk, int numVertices, std::vector<glm::ivec4> &quads,
+	std::vector<int> &tris, std::vector<glm::ivec3> &polygonTris) {
+	for (int i = 0; i < (int)chunk.relative.size(); i++) {
+		chunk.faceIndices[chunk.relative[i]] += chunk.firstVertex;
+	}
+	int numBad = 0;
+	for (int i = 0; i < (int)chunk.faceIndices.size(); i++) {
+		int &index = chunk.faceIndices[i];
+		if (index < 0 || index >= numVertices) {
+			index = 0;
+			numBad++;
+		}
+	}
+
+	int quad = chunk.firstQuad;
+	int tri = chunk.firstTri;
+	int polygonTri = chunk.firstPolygonTri;
+	const int *corners = chunk.faceIndices.empty() ? NULL : &chunk.faceIndices[0];
+	for (int f = 0; f < (int)chunk.faceSizes.size(); f++) {
+		int numCorners = chunk.faceSizes[f];
+		if (numCorners == 4) {
+			quads[quad++] = glm::ivec4(corners[0], corners[1], corners[2], corners[3]);
+		}
+		// a fan from corner 0, so quads split along 0-2 like they always have
+		for (int c = 1; c + 1 < numCorners; c++) {
+			tris[3 * tri + 0] = corners[0];
+			tris[3 * tri + 1] = corners[c];
+			tris[3 * tri + 2] = corners[c + 1];
+			if (numCorners != 4) {
+				polygonTris[polygonTri++] = glm::ivec3(corners[0], corners[c], corners[c + 1]);
+			}
+			tri++;
+		}
+		corners += numCorners;
+	}
+	return numBad;
+}
+
+bool obj::load(const std::string &path, std::vector<glm::vec4> &positions, std::vector<glm::ivec4> &quads,
+	std::vector<int> &tris, std::vector<glm::ivec3> &polygonTris) {
+	TRACE_ZONE("parse mesh");
+	positions.clear();
+	quads.clear();
+	tris.clear();
+	polygonTris.clear();
+	MappedFile file(path);
+	if (!file.isOpen()) {
+		std::cout << "could not read " << path << std::endl;
+		return false;
+	}
+	const char *data = file.data;
+	const char *end = data + file.size;
+
+	// line ranges of about OBJ_CHUNK_BYTES each
+	int numChunks = 1;
+	if (file.size >= OBJ_PARALLEL_MIN_BYTES) numChunks = (int)(file.size / OBJ_CHUNK_BYTES) + 1;
+	std::vector<ObjChunk> chunks(numChunks);
+	const char *begin = data;
+	for (int c = 0; c < numChunks; c++) {
+		const char *split = c + 1 == numChunks ? end : data + file.size / numChunks * (c + 1);
+		if (split < begin) split = begin;
+		if (split < end) split = nextLine(split, end);
+		chunks[c].begin = begin;
+		chunks[c].end = split;
+		begin = split;
+	}
+
+	ThreadPool *pool = NULL;
+	if (numChunks > 1) {
+		pool = new ThreadPool();
+		pool->minParallelCount = 1;
+	}
+	std::function<void(int, int)> parse = [&](int first, int last) {
+		for (int c = first; c < last; c++) parseChunk(chunks[c]);
+	};
+	if (pool) pool->parallelFor(numChunks, parse);
+	else parse(0, numChunks);
+
+	// where every chunk's output goes
+	int numVertices = 0;
+	int numQuads = 0;
+	int numTris = 0;
+	int numPolygonTris = 0;
+	for (int c = 0; c < numChunks; c++) {
+		ObjChunk &chunk = chunks[c];
+		chunk.firstVertex = numVertices;
+		chunk.firstQuad = numQuads;
+		chunk.firstTri = numTris;
+		chunk.firstPolygonTri = numPolygonTris;
+		numVertices += chunk.positions.size();
+		numQuads += chunk.numQuads;
+		numTris += 2 * chunk.numQuads + chunk.numPolygonTris;
+		numPolygonTris += chunk.numPolygonTris;
+	}
+	positions.resize(numVertices);
+	quads.resize(numQuads);
+	tris.resize(3 * numTris);
+	polygonTris.resize(numPolygonTris);
+
+	std::vector<int> numBad(numChunks, 0);
+	std::function<void(int, int)> emit = [&](int first, int last) {
+		for (int c = first; c < last; c++) {
+			ObjChunk &chunk = chunks[c];
+			if (!chunk.positions.empty()) {
+				std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.firstVertex);
+			}
+			numBad[c] = emitChunk(chunk, numVertices, quads, tris, polygonTris);
+		}
+	};
+	if (pool) pool->parallelFor(numChunks, emit);
+	else emit(0, numChunks);
+	delete pool;
+
+	int badVertices = 0;
+	const char *firstBadVertex = NULL;
+	for (int c = 0; c < numChunks; c++) {
+		if (!firstBadVertex) firstBadVertex = chunks[c].firstBadVertex;
+		badVertices += chunks[c].numBadVertices;
+	}
+	if (badVertices > 0) {
+		const char *lineEnd = firstBadVertex;
+		while (lineEnd < end && !isLineEnd(*lineEnd)) lineEnd++;
+		std::cout << path << ": " << badVertices << " vertices don't have three numbers, the first is \"" <<
+			std::string(firstBadVertex, lineEnd) << "\"" << std::endl;
+		return false;
+	}
+
+	int totalBad = 0;
+	for (int c = 0; c < numChunks; c++) totalBad += numBad[c];
+	if (totalBad > 0) {
+		std::cout << path << ": " << totalBad << " face corners refer to vertices that don't exist" << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <glm/glm.hpp>
+
+// wavefront obj geometry: vertex positions and faces, nothing else.
+// the file is memory mapped and parsed in place, split into line ranges
+// that get parsed in parallel once it's big enough to be worth the threads.
+// faces can be triangles, quads or larger polygons, and vertices can be
+// given as v, v/vt, v//vn or v/vt/vn (only v is kept). negative indices
+// count back from the last vertex so far, like the spec says.
+// other statements (vt, vn, groups, materials, smoothing) are skipped.
+
+#define OBJ_PARALLEL_MIN_BYTES (1 << 20) // smaller files parse on one thread
+#define OBJ_CHUNK_BYTES (1 << 18) // roughly, per parallel range
+
+namespace obj {
+// replaces whatever was in the arrays. positions get w = 1. every quad goes
+// into quads and, as two triangles (0, 1, 2) and (0, 2, 3), into tris.
+// other faces are fanned into tris the same way and also listed in
+// polygonTris, since they have no quad.
+// returns false (and says why) if the file can't be read, a vertex doesn't
+// have three numbers, or a face refers to a vertex that doesn't exist.
+bool load(const std::string &path, std::vector<glm::vec4> &positions, std::vector<glm::ivec4> &quads,
+	std::vector<int> &tris, std::vector<glm::ivec3> &polygonTris);
+
+// parses a number at p (no leading whitespace), returning where it ends,
+// or NULL if there isn't one. always '.' as the decimal point, whatever the
+// locale, and rounded exactly like strtof, inf, nan and out of range
+// values included.
+const char *parseFloat(const char *p, const char *end, float &value);
+}
@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <cmath>
+#include "primitive.hpp"
+#include "tracer.hpp"
+
+static const char *typeNames[NUM_PRIMITIVE_TYPES] = { "none", "plane", "sphere", "capsule", "box", "heightfield" };
+
+Primitive Primitive::plane(glm::vec3 point, glm::vec3 normal) {
+	Primitive p;
+	p.type = PRIMITIVE_PLANE;
+	p.center = point;
+	p.extent = glm::normalize(normal);
+	return p;
+}
+
+Primitive Primitive::sphere(glm::vec3 center, float radius) {
+	Primitive p;
+	p.type = PRIMITIVE_SPHERE;
+	p.center = center;
+	p.radius = radius;
+	return p;
+}
+
+Primitive Primitive::capsule(glm::vec3 a, glm::vec3 b, float radius) {
+	Primitive p;
+	p.type = PRIMITIVE_CAPSULE;
+	p.center = a;
+	p.extent = b;
+	p.radius = radius;
+	return p;
+}
+
+Primitive Primitive::box(glm::vec3 center, glm::vec3 halfSize, glm::mat3 axes) {
+	Primitive p;
+	p.type = PRIMITIVE_BOX;
+	p.center = center;
+	p.extent = halfSize;
+	p.axes = axes;
+	return p;
+}
+
+Primitive Primitive::heightfield(glm::vec2 origin, glm::vec2 spacing, glm::ivec2 dims,
+	const std::vector<float> &heights) {
+	Primitive p;
+	p.type = PRIMITIVE_HEIGHTFIELD;
+	p.center = glm::vec3(origin, 0.0f);
+	p.extent = glm::vec3(spacing, 0.0f);
+	p.dims = dims;
+	p.heights = heights;
+	return p;
+}
+
+// the highest point of the triangles over every sample. each triangle only
+// visits the samples under its own bounds.
+static void sampleTopSurface(const std::vector<glm::vec4> &positions, const std::vector<int> &indicesTris,
+	glm::vec2 origin, glm::vec2 spacing, glm::ivec2 dims, std::vector<float> &heights) {
+	heights.assign(dims.x * dims.y, PRIMITIVE_HOLE);
+	// a sample right on an edge or corner belongs to every triangle there
+	const float edgeEpsilon = 1e-5f;
+	for (int t = 0; t + 2 < (int)indicesTris.size(); t += 3) {
+		glm::vec3 a = glm::vec3(positions[indicesTris[t]]);
+		glm::vec3 b = glm::vec3(positions[indicesTris[t + 1]]);
+		glm::vec3 c = glm::vec3(positions[indicesTris[t + 2]]);
+		float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+		if (std::abs(area) < 1e-12f) continue; // on its side, seen from above
+
+		glm::vec2 lo = (glm::min(glm::vec2(a), glm::min(glm::vec2(b), glm::vec2(c))) - origin) / spacing;
+		glm::vec2 hi = (glm::max(glm::vec2(a), glm::max(glm::vec2(b), glm::vec2(c))) - origin) / spacing;
+		int i0 = std::max(0, (int)std::ceil(lo.x - edgeEpsilon));
+		int j0 = std::max(0, (int)std::ceil(lo.y - edgeEpsilon));
+		int i1 = std::min(dims.x - 1, (int)std::floor(hi.x + edgeEpsilon));
+		int j1 = std::min(dims.y - 1, (int)std::floor(hi.y + edgeEpsilon));
+		for (int j = j0; j <= j1; j++) {
+			for (int i = i0; i <= i1; i++) {
+				glm::vec2 s = origin + glm::vec2(i, j) * spacing;
+				// barycentric coordinates in the xy plane
+				float u = ((b.x - s.x) * (c.y - s.y) - (c.x - s.x) * (b.y - s.y)) / area;
+				float v = ((c.x - s.x) * (a.y - s.y) - (a.x - s.x) * (c.y - s.y)) / area;
+				float w = 1.0f - u - v;
+				if (u < -edgeEpsilon || v < -edgeEpsilon || w < -edgeEpsilon) continue;
+				float z = u * a.z + v * b.z + w * c.z;
+				float &height = heights[j * dims.x + i];
+				height = std::max(height, z);
+			}
+		}
+	}
+}
+
+Primitive Primitive::fit(int type, const std::vector<glm::vec4> &positions,
+	const std::vector<int> &indicesTris, int resolution) {
+	TRACE_ZONE("fit primitive");
+	if (positions.empty()) return Primitive();
+	glm::vec3 boundsMin = glm::vec3(positions[0]);
+	glm::vec3 boundsMax = boundsMin;
+	for (int i = 1; i < (int)positions.size(); i++) {
+		boundsMin = glm::min(boundsMin, glm::vec3(positions[i]));
+		boundsMax = glm::max(boundsMax, glm::vec3(positions[i]));
+	}
+	glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	glm::vec3 size = boundsMax - boundsMin;
+
+	switch (type) {
+	case PRIMITIVE_PLANE:
+		return plane(glm::vec3(center.x, center.y, boundsMax.z), glm::vec3(0.0f, 0.0f, 1.0f));
+	case PRIMITIVE_SPHERE: {
+		float radius = 0.0f;
+		for (int i = 0; i < (int)positions.size(); i++) {
+			radius = std::max(radius, glm::length(glm::vec3(positions[i]) - center));
+		}
+		return sphere(center, radius);
+	}
+	case PRIMITIVE_CAPSULE: {
+		int longest = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+		glm::vec3 axis = glm::vec3(0.0f);
+		axis[longest] = 1.0f;
+		float radius = 0.0f;
+		for (int i = 0; i < (int)positions.size(); i++) {
+			glm::vec3 offset = glm::vec3(positions[i]) - center;
+			offset[longest] = 0.0f;
+			radius = std::max(radius, glm::length(offset));
+		}
+		float halfLength = std::max(0.0f, size[longest] * 0.5f - radius);
+		return capsule(center - axis * halfLength, center + axis * halfLength, radius);
+	}
+	case PRIMITIVE_BOX:
+		return box(center, size * 0.5f);
+	case PRIMITIVE_HEIGHTFIELD: {
+		float longer = std::max(size.x, size.y);
+		if (resolution < 2 || longer <= 0.0f) return Primitive();
+		float spacing = longer / (resolution - 1);
+		glm::ivec2 dims = glm::ivec2(
+			std::max(2, (int)std::ceil(size.x / spacing - 1e-4f) + 1),
+			std::max(2, (int)std::ceil(size.y / spacing - 1e-4f) + 1));
+		Primitive p = heightfield(glm::vec2(boundsMin), glm::vec2(spacing), dims, std::vector<float>());
+		sampleTopSurface(positions, indicesTris, glm::vec2(boundsMin), glm::vec2(spacing), dims, p.heights);
+		return p;
+	}
+	}
+	return Primitive();
+}
+
+void Primitive::pack(std::vector<glm::vec4> &out) const {
+	out.assign(PRIMITIVE_HEADER_VEC4S + (heights.size() + 3) / 4, glm::vec4(0.0f));
+	out[0] = glm::vec4(type, radius, dims.x, dims.y);
+	out[1] = glm::vec4(center, 0.0f);
+	out[2] = glm::vec4(extent, 0.0f);
+	for (int i = 0; i < 3; i++) out[3 + i] = glm::vec4(axes[i], 0.0f);
+	for (int i = 0; i < (int)heights.size(); i++) {
+		out[PRIMITIVE_HEADER_VEC4S + i / 4][i % 4] = heights[i];
+	}
+}
+
+const char *Primitive::typeName(int type) {
+	return type >= 0 && type < NUM_PRIMITIVE_TYPES ? typeNames[type] : "unknown";
+}
+
+int Primitive::typeFromName(const std::string &name) {
+	for (int i = 0; i < NUM_PRIMITIVE_TYPES; i++) {
+		if (name == typeNames[i]) return i;
+	}
+	return -1;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <glm/glm.hpp>
+
+// analytic collider shapes: a closed form signed distance and normal per
+// cloth vertex instead of a BVH walk over the body's triangles. a rigidbody
+// with one collides as the shape and still draws (and takes pins) as its
+// mesh. shapes are in the body's rest space and move with its modelMatrix,
+// like the SDFs (see sdf.hpp), and go through the same constraint logic.
+//   plane        everything below it is inside. infinite, so nothing tunnels
+//   sphere
+//   capsule      a segment with a radius
+//   box          oriented by its axes
+//   heightfield  a regular grid of heights over x and y, split into
+//                triangles like the generated terrain. everything under the
+//                surface is inside, nothing off the grid is
+//
+// packed into a buffer as vec4s (see pack):
+//   0: type, radius, heightfield samples along x and y
+//   1: center
+//   2: extent
+//   3, 4, 5: box axes
+//   6 on: heightfield heights, four to a vec4
+
+#define PRIMITIVE_HEADER_VEC4S 6
+#define PRIMITIVE_HOLE -1e30f // heightfield sample with nothing under it
+#define PRIMITIVE_HEIGHTFIELD_RESOLUTION 64 // samples along the longer side when fitting
+
+enum PrimitiveType {
+	PRIMITIVE_NONE, // collide against the triangles
+	PRIMITIVE_PLANE,
+	PRIMITIVE_SPHERE,
+	PRIMITIVE_CAPSULE,
+	PRIMITIVE_BOX,
+	PRIMITIVE_HEIGHTFIELD,
+	NUM_PRIMITIVE_TYPES
+};
+
+class Primitive
+{
+public:
+	int type = PRIMITIVE_NONE;
+	glm::vec3 center = glm::vec3(0.0f); // plane: a point on it. sphere, box: the center. capsule: one end. heightfield: sample (0, 0), z unused
+	glm::vec3 extent = glm::vec3(0.0f); // plane: unit normal. capsule: the other end. box: half size along its axes. heightfield: sample spacing, z unused
+	float radius = 0.0f; // sphere, capsule
+	glm::mat3 axes = glm::mat3(1.0f); // box: its axes, as columns
+	glm::ivec2 dims = glm::ivec2(0); // heightfield: samples along x and y
+	std::vector<float> heights; // heightfield: x fastest, PRIMITIVE_HOLE where nothing is under
+
+	static Primitive plane(glm::vec3 point, glm::vec3 normal);
+	static Primitive sphere(glm::vec3 center, float radius);
+	static Primitive capsule(glm::vec3 a, glm::vec3 b, float radius);
+	static Primitive box(glm::vec3 center, glm::vec3 halfSize, glm::mat3 axes = glm::mat3(1.0f));
+	static Primitive heightfield(glm::vec2 origin, glm::vec2 spacing, glm::ivec2 dims, const std::vector<float> &heights);
+
+	// the shape of a type that best covers a mesh, from its bounds: a plane
+	// on top (z is up), the bounding sphere around the center, a capsule
+	// along the longest side, the box itself, or the mesh's top surface
+	// sampled resolution times along its longer side. NONE for an empty mesh.
+	static Primitive fit(int type, const std::vector<glm::vec4> &positions,
+		const std::vector<int> &indicesTris, int resolution = PRIMITIVE_HEIGHTFIELD_RESOLUTION);
+
+	void pack(std::vector<glm::vec4> &out) const;
+
+	static const char *typeName(int type); // "plane", "sphere", ...
+	static int typeFromName(const std::string &name); // -1 if it isn't one
+};
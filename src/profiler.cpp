@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include "profiler.hpp"
+
+using namespace std;
+
+const char *kernelNames[NUM_KERNELS] = {
+	"externalForces",
+	"dampVelocities",
+	"predictPositions",
+	"updateInverseMasses",
+	"projectClothConstraints",
+	"updatePositionsVelocities",
+	"copyBuffer",
+	"genCollisions",
+	"projectCollisions",
+	"rigidbodyAnimate",
+	"rigidbodyRefitBVH",
+	"genCollisionsSDF",
+	"projectClothConstraintsCSR",
+	"projectClothConstraintsColored",
+	"integrate",
+	"gatherPinTargets",
+	"projectPins",
+	"genCollisionsCandidates",
+	"genCollisionsPrimitive"
+};
+
+Profiler::Profiler(Backend *backend) {
+	this->backend = backend;
+}
+
+int Profiler::nextTimestamp() {
+	Frame &frame = frames[currentSlot];
+	if (frame.numTimestamps >= PROFILER_MAX_TIMESTAMPS) return -1;
+	int timestamp = frame.numTimestamps++;
+	backend->writeTimestamp(currentSlot * PROFILER_MAX_TIMESTAMPS + timestamp);
+	return timestamp;
+}
+
+void Profiler::beginFrame() {
+	if (!enabled) return;
+	if (!clockSynced) {
+		clockOffset = (long long)Tracer::now() - (long long)backend->currentTimestamp();
+		clockSynced = true;
+	}
+	int slot = frameNumber % PROFILER_FRAMES_IN_FLIGHT;
+	Frame &frame = frames[slot];
+	if (frame.pending && !resolve(slot, false)) {
+		numFramesDropped++; // still not done, reuse the slot anyway
+	}
+	frame.pending = false;
+	frame.number = frameNumber++;
+	frame.numTimestamps = 0;
+	frame.zones.clear();
+	openZones.clear();
+	currentSlot = slot;
+}
+
+void Profiler::endFrame() {
+	if (currentSlot < 0) return;
+	while (!openZones.empty()) endZone();
+	frames[currentSlot].pending = true;
+	currentSlot = -1;
+
+	// oldest first, so the trace stays in order
+	for (int i = 0; i < PROFILER_FRAMES_IN_FLIGHT; i++) {
+		int slot = (frameNumber + i) % PROFILER_FRAMES_IN_FLIGHT;
+		if (frames[slot].pending && !resolve(slot, false)) break;
+	}
+}
+
+void Profiler::beginZone(const char *label) {
+	if (currentSlot < 0) return;
+	Zone zone;
+	zone.label = label;
+	zone.begin = nextTimestamp();
+	zone.end = -1;
+	openZones.push_back(frames[currentSlot].zones.size());
+	frames[currentSlot].zones.push_back(zone);
+}
+
+void Profiler::endZone() {
+	if (currentSlot < 0 || openZones.empty()) return;
+	Zone &zone = frames[currentSlot].zones[openZones.back()];
+	openZones.pop_back();
+	if (zone.begin >= 0) zone.end = nextTimestamp();
+}
+
+void Profiler::beginDispatch(ComputeKernel kernel) {
+	beginZone(kernelNames[kernel]);
+}
+
+void Profiler::endDispatch() {
+	endZone();
+}
+
+bool Profiler::resolve(int slot, bool wait) {
+	Frame &frame = frames[slot];
+	int first = slot * PROFILER_MAX_TIMESTAMPS;
+	vector<unsigned long long> timestamps(frame.numTimestamps);
+	for (int i = 0; i < frame.numTimestamps; i++) {
+		while (!backend->readTimestamp(first + i, timestamps[i])) {
+			if (!wait) return false;
+		}
+	}
+
+	for (int i = 0; i < (int)frame.zones.size(); i++) {
+		Zone &zone = frame.zones[i];
+		if (zone.begin < 0 || zone.end < 0) continue; // ran out of timestamps
+		unsigned long long start = timestamps[zone.begin];
+		unsigned long long duration = timestamps[zone.end] - start;
+		samples[zone.label].push_back(duration / 1000.0f);
+		if (trace.size() < PROFILER_MAX_TRACE_EVENTS) {
+			TraceEvent event;
+			event.label = zone.label;
+			event.pid = TRACE_PID_GPU;
+			event.tid = 0;
+			event.frame = frame.number;
+			event.start = start + clockOffset;
+			event.duration = duration;
+			for (int c = 0; c < NUM_TRACE_COUNTERS; c++) event.counters[c] = -1;
+			trace.push_back(event);
+		}
+	}
+	frame.pending = false;
+	numFramesResolved++;
+	return true;
+}
+
+void Profiler::flush() {
+	if (currentSlot >= 0) endFrame();
+	for (int i = 0; i < PROFILER_FRAMES_IN_FLIGHT; i++) {
+		int slot = (frameNumber + i) % PROFILER_FRAMES_IN_FLIGHT;
+		if (frames[slot].pending) resolve(slot, true);
+	}
+}
+
+void Profiler::clear() {
+	samples.clear();
+	trace.clear();
+	numFramesResolved = 0;
+	numFramesDropped = 0;
+}
+
+map<string, ProfileStats> Profiler::stats() {
+	map<string, ProfileStats> result;
+	map<string, vector<float> >::iterator it;
+	for (it = samples.begin(); it != samples.end(); it++) {
+		vector<float> sorted = it->second;
+		std::sort(sorted.begin(), sorted.end());
+		double total = 0.0;
+		for (int i = 0; i < (int)sorted.size(); i++) total += sorted[i];
+		ProfileStats &stat = result[it->first];
+		stat.count = sorted.size();
+		stat.mean = total / sorted.size();
+		stat.p50 = tracePercentile(sorted, 50.0f);
+		stat.p95 = tracePercentile(sorted, 95.0f);
+		stat.p99 = tracePercentile(sorted, 99.0f);
+	}
+	return result;
+}
+
+void Profiler::report(ostream &out) {
+	out << "profiled frames:  " << numFramesResolved;
+	if (numFramesDropped > 0) out << " (" << numFramesDropped << " dropped)";
+	out << endl;
+	if (samples.empty()) return;
+
+	out << "times in microseconds" << endl;
+	out << left << setw(32) << "stage" << right << setw(8) << "count" << setw(10) << "mean" <<
+		setw(10) << "p50" << setw(10) << "p95" << setw(10) << "p99" << endl;
+	map<string, ProfileStats> all = stats();
+	map<string, ProfileStats>::iterator it;
+	for (it = all.begin(); it != all.end(); it++) {
+		ProfileStats &stat = it->second;
+		out << left << setw(32) << it->first << right << setw(8) << stat.count << fixed << setprecision(1) <<
+			setw(10) << stat.mean << setw(10) << stat.p50 << setw(10) << stat.p95 << setw(10) << stat.p99 << endl;
+		out.unsetf(ios::fixed);
+	}
+}
+
+bool Profiler::writeChromeTrace(const string &path) {
+	vector<TraceEvent> events = trace;
+	Tracer::collectEvents(events);
+	map<int, string> processNames;
+	processNames[TRACE_PID_GPU] = string(backend->name()) + " backend";
+	processNames[TRACE_PID_HOST] = "host";
+	return ::writeChromeTrace(path, events, processNames);
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <string>
+#include <ostream>
+#include "backend.hpp"
+#include "tracer.hpp"
+
+// per stage and per dispatch timings that never wait on the backend.
+// every zone (and, while attached to a backend, every dispatch) gets a pair
+// of backend timestamps. each frame records into its own slot of a ring of
+// PROFILER_FRAMES_IN_FLIGHT slots and is read back once all of its
+// timestamps are available, which on the GPU is usually a frame or two
+// later. a frame that still isn't done when its slot comes around again is
+// dropped rather than waited on.
+
+#define PROFILER_FRAMES_IN_FLIGHT 4
+#define PROFILER_MAX_TIMESTAMPS 4096 // per frame. zones past this aren't recorded
+#define PROFILER_MAX_TRACE_EVENTS 1000000 // trace stops growing after this, stats don't
+
+// one label's timings, in microseconds
+struct ProfileStats
+{
+	int count;
+	float mean;
+	float p50;
+	float p95;
+	float p99;
+};
+
+class Profiler
+{
+public:
+	Profiler(Backend *backend);
+
+	bool enabled = false;
+	int numFramesResolved = 0;
+	int numFramesDropped = 0;
+
+	void beginFrame();
+	void endFrame(); // reads back whichever earlier frames are done
+
+	// labels must outlive the profiler (string literals)
+	void beginZone(const char *label);
+	void endZone();
+
+	// called by the backends around every dispatch, labeled with the kernel
+	void beginDispatch(ComputeKernel kernel);
+	void endDispatch();
+
+	void flush(); // waits for the frames in flight. only at the end of a run
+	void clear(); // forget all results so far
+
+	// count, mean, p50, p95 and p99 per label, in microseconds
+	std::map<std::string, ProfileStats> stats();
+	void report(std::ostream &out);
+	// chrome://tracing or perfetto. zones show up nested on one row, next to
+	// whatever the host Tracer recorded over the same time.
+	bool writeChromeTrace(const std::string &path);
+
+private:
+	struct Zone {
+		const char *label;
+		int begin; // timestamps within the frame's slot
+		int end;
+	};
+
+	struct Frame {
+		bool pending = false;
+		long long number = 0;
+		int numTimestamps = 0;
+		std::vector<Zone> zones;
+	};
+
+	Backend *backend;
+	Frame frames[PROFILER_FRAMES_IN_FLIGHT];
+	int currentSlot = -1; // -1 between frames
+	long long frameNumber = 0;
+	std::vector<int> openZones; // indices into the current frame's zones
+
+	std::map<std::string, std::vector<float> > samples; // microseconds
+	std::vector<TraceEvent> trace; // already moved to the host clock
+	bool clockSynced = false;
+	long long clockOffset = 0; // host clock minus backend clock, ns
+
+	int nextTimestamp(); // -1 if the frame is out of timestamps
+	bool resolve(int slot, bool wait);
+};
+
+// label for each ComputeKernel, in enum order
+extern const char *kernelNames[NUM_KERNELS];
@@ -0,0 +1,386 @@
+#include <algorithm>
+#include <fstream>
+#include <queue>
+#include <iterator>
+#include <cstring>
+#include <cmath>
+#include "proxy.hpp"
+#include "tracer.hpp"
+
+// a collapse that turns any of the triangles around it further than this
+// (cosine between the old and new normal) is skipped, flips included
+#define PROXY_MIN_TURN_COSINE 0.2
+
+namespace {
+
+// a sum of plane quadrics, the symmetric 4x4 Q with the summed squared
+// distances of p to the planes as (p, 1) Q (p, 1)
+struct Quadric
+{
+	double q[10]; // xx xy xz xw yy yz yw zz zw ww
+
+	Quadric() { memset(q, 0, sizeof(q)); }
+
+	// plane dot(n, p) + d = 0, n unit
+	static Quadric plane(glm::dvec3 n, double d) {
+		Quadric p;
+		p.q[0] = n.x * n.x; p.q[1] = n.x * n.y; p.q[2] = n.x * n.z; p.q[3] = n.x * d;
+		p.q[4] = n.y * n.y; p.q[5] = n.y * n.z; p.q[6] = n.y * d;
+		p.q[7] = n.z * n.z; p.q[8] = n.z * d;
+		p.q[9] = d * d;
+		return p;
+	}
+
+	void add(const Quadric &other) {
+		for (int i = 0; i < 10; i++) q[i] += other.q[i];
+	}
+
+	double cost(glm::dvec3 p) const {
+		return q[0] * p.x * p.x + 2.0 * q[1] * p.x * p.y + 2.0 * q[2] * p.x * p.z + 2.0 * q[3] * p.x +
+			q[4] * p.y * p.y + 2.0 * q[5] * p.y * p.z + 2.0 * q[6] * p.y +
+			q[7] * p.z * p.z + 2.0 * q[8] * p.z + q[9];
+	}
+
+	// the point with the least cost, if there's just the one. there isn't
+	// on flat or evenly curved patches
+	bool minimum(glm::dvec3 &p) const {
+		glm::dmat3 A(q[0], q[1], q[2], q[1], q[4], q[5], q[2], q[5], q[7]);
+		if (std::abs(glm::determinant(A)) < 1e-10) return false;
+		p = glm::inverse(A) * -glm::dvec3(q[3], q[6], q[8]);
+		return true;
+	}
+};
+
+struct Collapse
+{
+	double cost;
+	int a, b; // b goes into a
+	int stampA, stampB; // the vertices' stamps when this was worked out
+	glm::dvec3 target;
+
+	bool operator>(const Collapse &other) const {
+		if (cost != other.cost) return cost > other.cost;
+		if (a != other.a) return a > other.a;
+		return b > other.b;
+	}
+};
+
+unsigned long long edgeKey(int u, int v) {
+	if (u > v) std::swap(u, v);
+	return ((unsigned long long)u << 32) | (unsigned int)v;
+}
+
+class Decimator
+{
+public:
+	std::vector<glm::dvec3> pos;
+	std::vector<float> w;
+	std::vector<Quadric> quadrics;
+	std::vector<bool> border; // on an open edge
+	std::vector<int> stamp; // bumped every time a vertex moves, -1 once it's collapsed away
+	std::vector<glm::ivec3> tris;
+	std::vector<bool> deadTris;
+	std::vector<std::vector<int> > vertexTris; // can still list dead triangles
+	int liveTris = 0;
+	double maxCost = 0.0;
+
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse> > heap;
+
+	void weld(const std::vector<glm::vec4> &positions, const std::vector<int> &indicesTris) {
+		int numVertices = positions.size();
+		std::vector<int> order(numVertices);
+		for (int i = 0; i < numVertices; i++) order[i] = i;
+		std::sort(order.begin(), order.end(), [&](int i, int j) {
+			const glm::vec4 &p = positions[i];
+			const glm::vec4 &q = positions[j];
+			if (p.x != q.x) return p.x < q.x;
+			if (p.y != q.y) return p.y < q.y;
+			if (p.z != q.z) return p.z < q.z;
+			return i < j;
+		});
+		std::vector<int> welded(numVertices);
+		for (int i = 0; i < numVertices; i++) {
+			const glm::vec4 &p = positions[order[i]];
+			if (i == 0 || glm::vec3(p) != glm::vec3(positions[order[i - 1]])) {
+				pos.push_back(glm::dvec3(glm::vec3(p)));
+				w.push_back(p.w);
+			}
+			welded[order[i]] = pos.size() - 1;
+		}
+		for (int t = 0; t + 2 < (int)indicesTris.size(); t += 3) {
+			glm::ivec3 tri(welded[indicesTris[t]], welded[indicesTris[t + 1]], welded[indicesTris[t + 2]]);
+			if (tri.x == tri.y || tri.y == tri.z || tri.z == tri.x) continue;
+			tris.push_back(tri);
+		}
+	}
+
+	void setup() {
+		int numVertices = pos.size();
+		int numTris = tris.size();
+		quadrics.assign(numVertices, Quadric());
+		border.assign(numVertices, false);
+		stamp.assign(numVertices, 0);
+		deadTris.assign(numTris, false);
+		vertexTris.assign(numVertices, std::vector<int>());
+		liveTris = numTris;
+
+		std::vector<unsigned long long> edges;
+		edges.reserve(numTris * 3);
+		for (int t = 0; t < numTris; t++) {
+			for (int i = 0; i < 3; i++) {
+				vertexTris[tris[t][i]].push_back(t);
+				edges.push_back(edgeKey(tris[t][i], tris[t][(i + 1) % 3]));
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+
+		for (int t = 0; t < numTris; t++) {
+			glm::dvec3 n = glm::cross(pos[tris[t].y] - pos[tris[t].x], pos[tris[t].z] - pos[tris[t].x]);
+			double length = glm::length(n);
+			if (length < 1e-20) continue;
+			n /= length;
+			Quadric plane = Quadric::plane(n, -glm::dot(n, pos[tris[t].x]));
+			for (int i = 0; i < 3; i++) {
+				int u = tris[t][i];
+				int v = tris[t][(i + 1) % 3];
+				quadrics[u].add(plane);
+				unsigned long long key = edgeKey(u, v);
+				std::pair<std::vector<unsigned long long>::iterator, std::vector<unsigned long long>::iterator> run =
+					std::equal_range(edges.begin(), edges.end(), key);
+				if (run.second - run.first != 1) continue;
+				// an open edge: a plane along it, upright to the triangle
+				glm::dvec3 across = glm::cross(pos[v] - pos[u], n);
+				double acrossLength = glm::length(across);
+				if (acrossLength < 1e-20) continue;
+				across /= acrossLength;
+				Quadric side = Quadric::plane(across, -glm::dot(across, pos[u]));
+				quadrics[u].add(side);
+				quadrics[v].add(side);
+				border[u] = true;
+				border[v] = true;
+			}
+		}
+
+		edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+		for (int i = 0; i < (int)edges.size(); i++) {
+			push((int)(edges[i] >> 32), (int)(edges[i] & 0xFFFFFFFFu));
+		}
+	}
+
+	void push(int a, int b) {
+		Quadric sum = quadrics[a];
+		sum.add(quadrics[b]);
+		glm::dvec3 mid = (pos[a] + pos[b]) * 0.5;
+		Collapse c;
+		c.a = a;
+		c.b = b;
+		c.stampA = stamp[a];
+		c.stampB = stamp[b];
+		c.target = mid;
+		c.cost = sum.cost(mid);
+		// the optimum, unless it's off somewhere past the edge
+		glm::dvec3 candidates[3] = { pos[a], pos[b], mid };
+		glm::dvec3 optimum;
+		if (sum.minimum(optimum) && glm::length(optimum - mid) <= glm::length(pos[a] - pos[b])) {
+			candidates[2] = optimum;
+		}
+		for (int i = 0; i < 3; i++) {
+			double cost = sum.cost(candidates[i]);
+			if (cost < c.cost) {
+				c.cost = cost;
+				c.target = candidates[i];
+			}
+		}
+		c.cost = std::max(0.0, c.cost);
+		heap.push(c);
+	}
+
+	bool has(int t, int v) const {
+		return tris[t].x == v || tris[t].y == v || tris[t].z == v;
+	}
+
+	// every vertex sharing a live triangle with v, once each
+	void neighbors(int v, std::vector<int> &out) const {
+		out.clear();
+		for (int i = 0; i < (int)vertexTris[v].size(); i++) {
+			int t = vertexTris[v][i];
+			if (deadTris[t]) continue;
+			for (int j = 0; j < 3; j++) {
+				if (tris[t][j] != v) out.push_back(tris[t][j]);
+			}
+		}
+		std::sort(out.begin(), out.end());
+		out.erase(std::unique(out.begin(), out.end()), out.end());
+	}
+
+	bool allowed(const Collapse &c) {
+		int shared = 0;
+		for (int i = 0; i < (int)vertexTris[c.a].size(); i++) {
+			int t = vertexTris[c.a][i];
+			if (!deadTris[t] && has(t, c.b)) shared++;
+		}
+		// gone, or on more than two triangles
+		if (shared < 1 || shared > 2) return false;
+		// two open edges joined across the inside would pinch into a bowtie
+		if (shared == 2 && border[c.a] && border[c.b]) return false;
+
+		// the link condition: the only vertices next to both are the ones
+		// across the edge, or the collapse folds the surface onto itself
+		std::vector<int> aNeighbors, bNeighbors, common;
+		neighbors(c.a, aNeighbors);
+		neighbors(c.b, bNeighbors);
+		std::set_intersection(aNeighbors.begin(), aNeighbors.end(), bNeighbors.begin(), bNeighbors.end(),
+			std::back_inserter(common));
+		if ((int)common.size() != shared) return false;
+
+		for (int end = 0; end < 2; end++) {
+			int v = end == 0 ? c.a : c.b;
+			for (int i = 0; i < (int)vertexTris[v].size(); i++) {
+				int t = vertexTris[v][i];
+				if (deadTris[t] || (has(t, c.a) && has(t, c.b))) continue;
+				glm::dvec3 corners[3];
+				for (int j = 0; j < 3; j++) corners[j] = pos[tris[t][j]];
+				glm::dvec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+				for (int j = 0; j < 3; j++) {
+					if (tris[t][j] == v) corners[j] = c.target;
+				}
+				glm::dvec3 after = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+				double lengths = glm::length(before) * glm::length(after);
+				if (lengths < 1e-30 || glm::dot(before, after) < PROXY_MIN_TURN_COSINE * lengths) return false;
+			}
+		}
+		return true;
+	}
+
+	void collapse(const Collapse &c) {
+		int a = c.a;
+		int b = c.b;
+		pos[a] = c.target;
+		quadrics[a].add(quadrics[b]);
+		border[a] = border[a] || border[b];
+		for (int i = 0; i < (int)vertexTris[b].size(); i++) {
+			int t = vertexTris[b][i];
+			if (deadTris[t]) continue;
+			if (has(t, a)) {
+				deadTris[t] = true;
+				liveTris--;
+				continue;
+			}
+			for (int j = 0; j < 3; j++) {
+				if (tris[t][j] == b) tris[t][j] = a;
+			}
+			vertexTris[a].push_back(t);
+		}
+		vertexTris[b].clear();
+		std::vector<int> &aTris = vertexTris[a];
+		aTris.erase(std::remove_if(aTris.begin(), aTris.end(), [&](int t) { return (bool)deadTris[t]; }), aTris.end());
+		stamp[b] = -1;
+		stamp[a]++;
+		maxCost = std::max(maxCost, c.cost);
+
+		std::vector<int> around;
+		neighbors(a, around);
+		for (int i = 0; i < (int)around.size(); i++) push(a, around[i]);
+	}
+
+	void run(int targetTriangles, float tolerance) {
+		double maxAllowed = (double)tolerance * tolerance;
+		while (liveTris > targetTriangles && !heap.empty()) {
+			Collapse c = heap.top();
+			heap.pop();
+			if (stamp[c.a] != c.stampA || stamp[c.b] != c.stampB) continue; // out of date
+			if (tolerance > 0.0f && c.cost > maxAllowed) break;
+			if (allowed(c)) collapse(c);
+		}
+	}
+
+	void output(CollisionProxy &proxy) {
+		std::vector<int> remap(pos.size(), -1);
+		proxy.positions.clear();
+		proxy.indicesTris.clear();
+		for (int t = 0; t < (int)tris.size(); t++) {
+			if (deadTris[t]) continue;
+			for (int j = 0; j < 3; j++) {
+				int v = tris[t][j];
+				if (remap[v] < 0) {
+					remap[v] = proxy.positions.size();
+					proxy.positions.push_back(glm::vec4(glm::vec3(pos[v]), w[v]));
+				}
+				proxy.indicesTris.push_back(remap[v]);
+			}
+		}
+		proxy.error = (float)std::sqrt(maxCost);
+	}
+};
+
+}
+
+void CollisionProxy::build(const std::vector<glm::vec4> &meshPositions, const std::vector<int> &meshTris,
+	int targetTriangles, float tolerance) {
+	TRACE_ZONE("build collision proxy");
+	Decimator decimator;
+	decimator.weld(meshPositions, meshTris);
+	decimator.setup();
+	decimator.run(targetTriangles, tolerance);
+	decimator.output(*this);
+}
+
+bool CollisionProxy::load(const std::string &path, unsigned long long meshHash, int targetTriangles, float tolerance) {
+	TRACE_ZONE("load collision proxy");
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file.is_open()) return false;
+
+	char magic[4];
+	int version, fileTriangles;
+	float fileTolerance;
+	unsigned long long fileHash;
+	file.read(magic, 4);
+	file.read((char *)&version, sizeof(int));
+	file.read((char *)&fileHash, sizeof(unsigned long long));
+	file.read((char *)&fileTriangles, sizeof(int));
+	file.read((char *)&fileTolerance, sizeof(float));
+	if (!file || memcmp(magic, "PRXY", 4) != 0 || version != PROXY_FILE_VERSION ||
+		fileHash != meshHash || fileTriangles != targetTriangles || fileTolerance != tolerance) {
+		return false;
+	}
+
+	int numVertices, numIndices;
+	file.read((char *)&numVertices, sizeof(int));
+	file.read((char *)&numIndices, sizeof(int));
+	file.read((char *)&error, sizeof(float));
+	if (!file || numVertices < 3 || numIndices < 3 || numIndices % 3 != 0) return false;
+	positions.resize(numVertices);
+	indicesTris.resize(numIndices);
+	file.read((char *)&positions[0], positions.size() * sizeof(glm::vec4));
+	file.read((char *)&indicesTris[0], indicesTris.size() * sizeof(int));
+	bool valid = (bool)file;
+	for (int i = 0; valid && i < numIndices; i++) {
+		valid = indicesTris[i] >= 0 && indicesTris[i] < numVertices;
+	}
+	if (!valid) {
+		positions.clear();
+		indicesTris.clear();
+	}
+	return valid;
+}
+
+bool CollisionProxy::save(const std::string &path, unsigned long long meshHash, int targetTriangles, float tolerance) const {
+	if (empty()) return false;
+	std::ofstream file(path.c_str(), std::ios::binary);
+	if (!file.is_open()) return false;
+
+	int version = PROXY_FILE_VERSION;
+	int numVertices = positions.size();
+	int numIndices = indicesTris.size();
+	file.write("PRXY", 4);
+	file.write((const char *)&version, sizeof(int));
+	file.write((const char *)&meshHash, sizeof(unsigned long long));
+	file.write((const char *)&targetTriangles, sizeof(int));
+	file.write((const char *)&tolerance, sizeof(float));
+	file.write((const char *)&numVertices, sizeof(int));
+	file.write((const char *)&numIndices, sizeof(int));
+	file.write((const char *)&error, sizeof(float));
+	file.write((const char *)&positions[0], positions.size() * sizeof(glm::vec4));
+	file.write((const char *)&indicesTris[0], indicesTris.size() * sizeof(int));
+	return (bool)file;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <glm/glm.hpp>
+
+// a simplified copy of a collider mesh for collisions to run against while
+// the body keeps drawing (and taking pins) as its full mesh. made by quadric
+// error edge collapses (Garland and Heckbert 1997): every vertex carries the
+// sum of the squared distances to the planes of the original triangles
+// around it, and the edge whose collapse adds the least goes first, until
+// the mesh is down to its triangle budget or the next collapse would move
+// the surface more than the tolerance. open edges get planes across them,
+// so borders shrink no faster than the rest. collapses that would flip or
+// fold a triangle, or pinch the surface into a non-manifold, are skipped.
+// the proxy can cut inside the mesh by up to the tolerance, so cloth may
+// sink into the drawn body by that much.
+//
+// vertices at the same position are welded first, so seams in the obj
+// don't stop collapses from crossing them.
+
+#define PROXY_TRIANGLES 1000 // budget per collider
+#define PROXY_TOLERANCE 0.02f // how far the proxy may stray from the mesh, in mesh units. <= 0: no limit
+#define PROXY_FILE_VERSION 1
+
+class CollisionProxy
+{
+public:
+	std::vector<glm::vec4> positions;
+	std::vector<int> indicesTris; // counterclockwise, like the mesh's
+	float error = 0.0f; // how far the costliest collapse made may have moved the surface
+
+	bool empty() const { return indicesTris.empty(); }
+
+	// simplify a mesh down to targetTriangles. the result can have more if
+	// the tolerance stops it first, and is the welded mesh itself if it was
+	// within budget already.
+	void build(const std::vector<glm::vec4> &meshPositions, const std::vector<int> &meshTris,
+		int targetTriangles, float tolerance);
+
+	// disk cache, next to the mesh. load fails (returns false) if the file is
+	// missing, from an older version, or was made from a different mesh or
+	// with different settings. meshHash is SDF::hashMesh of the full mesh.
+	bool load(const std::string &path, unsigned long long meshHash, int targetTriangles, float tolerance);
+	bool save(const std::string &path, unsigned long long meshHash, int targetTriangles, float tolerance) const;
+};
@@ -1,44 +1,125 @@
 #include "rbody.hpp"
+#include "generators.hpp"
+#include "asset.hpp"
 
-Rbody::Rbody(string filename) : Mesh(filename) {
+Rbody::Rbody(Backend *backend, string filename) : Mesh(backend, filename) {
 	// animation state
 	translation = glm::vec3(0.0);
 	scale = glm::vec3(1.0);
 	eulerRotation = glm::vec3(0.0);
 
-	GLint bufMask = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+	// set up the BVH, then the triangle buffer in BVH leaf order. an asset
+	// has both ready to go.
+	if (asset && asset->has(ASSET_BVH_NODES)) {
+		asset->read(ASSET_BVH_NODES, bvh.nodes);
+		asset->read(ASSET_BVH_TRIANGLE_ORDER, bvh.triangleOrder);
+		bvh.depth = asset->bvhDepth;
+		int numTriangles = asset->count(ASSET_TRIANGLES);
+		ssbo_triangles = backend->createBuffer(numTriangles,
+			numTriangles > 0 ? (const glm::vec4 *)asset->data(ASSET_TRIANGLES) : NULL);
+		const glm::vec4 *nodes = bvh.nodes.empty() ? NULL : &bvh.nodes[0];
+		ssbo_bvhRestNodes = backend->createBuffer(bvh.nodes.size(), nodes);
+		ssbo_bvhNodes = backend->createBuffer(bvh.nodes.size(), nodes);
+	} else {
+		buildCollisionBuffers();
+	}
+
+	// set up the animated positions buffer
+	int numVertices = this->initPositions.size();
+	ssbo_initPos = backend->createBuffer(numVertices, &initPositions[0]);
+	ssbo_collisionInitPos = ssbo_initPos;
+	ssbo_collisionPos = ssbo_pos;
+	closeAsset();
+}
+
+void Rbody::buildCollisionBuffers() {
+	bvh.build(collisionPositions(), collisionTris());
+	std::vector<glm::vec4> tri;
+	leafTriangles(tri);
+	ssbo_triangles = backend->createBuffer(tri.size(), tri.empty() ? NULL : &tri[0]);
+
+	// rest pose bounds are refit to the animated pose every frame
+	const glm::vec4 *nodes = bvh.nodes.empty() ? NULL : &bvh.nodes[0];
+	ssbo_bvhRestNodes = backend->createBuffer(bvh.nodes.size(), nodes);
+	ssbo_bvhNodes = backend->createBuffer(bvh.nodes.size(), nodes);
+}
+
+void Rbody::useProxy(int targetTriangles, float tolerance) {
+	if (!proxy.empty() || (int)indicesTris.size() / 3 <= targetTriangles) return;
+	// generated meshes have no file to put the cache next to
+	bool cached = !generators::isGenerated(filename);
+	string cachePath = proxyPath(filename);
+	unsigned long long meshHash = SDF::hashMesh(initPositions, indicesTris);
+	if (!cached || !proxy.load(cachePath, meshHash, targetTriangles, tolerance)) {
+		proxy.build(initPositions, indicesTris, targetTriangles, tolerance);
+		if (proxy.empty()) {
+			cout << "could not simplify " << filename << ", it keeps colliding as itself" << endl;
+			return;
+		}
+		if (cached && !proxy.save(cachePath, meshHash, targetTriangles, tolerance)) {
+			cout << "could not cache the collision proxy for " << filename << " in " << cachePath << endl;
+		}
+	}
+
+	// the proxy gets its own positions, animated alongside the mesh's
+	ssbo_collisionInitPos = backend->createBuffer(proxy.positions.size(), &proxy.positions[0]);
+	ssbo_collisionPos = backend->createBuffer(proxy.positions.size(), &proxy.positions[0]);
+	backend->deleteBuffer(ssbo_triangles);
+	backend->deleteBuffer(ssbo_bvhRestNodes);
+	backend->deleteBuffer(ssbo_bvhNodes);
+	buildCollisionBuffers();
 
-	// set up triangles and triangle buffer
-	int numTriangles = indicesTris.size() / 3;
-	glGenBuffers(1, &ssbo_triangles);
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo_triangles);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, numTriangles * sizeof(glm::vec4),
-		NULL, GL_STREAM_COPY);
-	glm::vec4 *tri = (glm::vec4 *) glMapBufferRange(GL_SHADER_STORAGE_BUFFER,
-		0, numTriangles * sizeof(glm::vec4), bufMask);
+	// a field baked around the full mesh goes, one around the proxy replaces it
+	if (ssbo_sdf) {
+		backend->deleteBuffer(ssbo_sdf);
+		ssbo_sdf = 0;
+		bakeSDF(sdf.dims.x);
+	}
+}
+
+void Rbody::leafTriangles(std::vector<glm::vec4> &tri) const {
+	const vector<int> &tris = collisionTris();
+	int numTriangles = tris.size() / 3;
+	tri.resize(numTriangles);
 	for (int i = 0; i < numTriangles; i++) {
+		int original = bvh.triangleOrder[i];
 		glm::vec4 triangle;
-		triangle.x = indicesTris.at(i * 3 + 0);
-		triangle.y = indicesTris.at(i * 3 + 1);
-		triangle.z = indicesTris.at(i * 3 + 2);
+		triangle.x = tris.at(original * 3 + 0);
+		triangle.y = tris.at(original * 3 + 1);
+		triangle.z = tris.at(original * 3 + 2);
+		triangle.w = original; // ties go to the lowest original index, like a linear scan
 
 		tri[i] = triangle;
 	}
-	glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
-
-	int numVertices = this->initPositions.size();
+}
 
-	// set up the animated positions buffer
-	glGenBuffers(1, &ssbo_initPos);
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo_initPos);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, numVertices * sizeof(glm::vec4),
-		NULL, GL_STREAM_COPY);
-	glm::vec4 *pos = (glm::vec4 *) glMapBufferRange(GL_SHADER_STORAGE_BUFFER,
-		0, numVertices * sizeof(glm::vec4), bufMask);
-	for (int i = 0; i < numVertices; i++) {
-		pos[i] = initPositions[i];
+void Rbody::bakeSDF(int resolution) {
+	if (ssbo_sdf) return;
+	// generated meshes have no file to put the cache next to
+	bool cached = !generators::isGenerated(filename);
+	string cachePath = filename + ".sdf";
+	unsigned long long meshHash = SDF::hashMesh(collisionPositions(), collisionTris());
+	if (!cached || !sdf.load(cachePath, meshHash, resolution)) {
+		sdf.bake(collisionPositions(), collisionTris(), bvh, resolution);
+		if (cached && !sdf.save(cachePath, meshHash, resolution)) {
+			cout << "could not cache the SDF for " << filename << " in " << cachePath << endl;
+		}
 	}
-	glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+	ssbo_sdf = backend->createBuffer(sdf.samples.size(), &sdf.samples[0]);
+}
+
+void Rbody::setPrimitive(const Primitive &shape) {
+	primitive = shape;
+	if (ssbo_primitive) backend->deleteBuffer(ssbo_primitive);
+	ssbo_primitive = 0;
+	if (primitive.type == PRIMITIVE_NONE) return;
+	std::vector<glm::vec4> packed;
+	primitive.pack(packed);
+	ssbo_primitive = backend->createBuffer(packed.size(), &packed[0]);
+}
+
+void Rbody::fitPrimitive(int type, int resolution) {
+	setPrimitive(Primitive::fit(type, initPositions, indicesTris, resolution));
 }
 
 Rbody::~Rbody() {
@@ -1,11 +1,16 @@
+#pragma once
 #include "mesh.hpp"
+#include "bvh.hpp"
+#include "sdf.hpp"
+#include "primitive.hpp"
+#include "proxy.hpp"
 #include <glm/gtx/transform.hpp>
 #include <glm/gtx/euler_angles.hpp> 
 
 class Rbody : public Mesh
 {
 public:
-  Rbody(string filename);
+  Rbody(Backend *backend, string filename);
   ~Rbody();
 
   glm::vec3 translation;
@@ -16,13 +21,45 @@ public:
   //vector<float> keyframe_times;
   //vector<glm::mat4> keyframe_transforms;
 
-  GLuint ssbo_initPos; // buffer of initial positions. vec4s.
-  GLuint ssbo_triangles; // buffer of triangles as vec4s
+  BufferHandle ssbo_initPos; // buffer of initial positions. vec4s.
+
+  // what collisions run against: the mesh itself, or its proxy after useProxy.
+  // the BVH, triangle and SDF buffers below are all over this mesh.
+  const vector<glm::vec4> &collisionPositions() const { return proxy.empty() ? initPositions : proxy.positions; }
+  const vector<int> &collisionTris() const { return proxy.empty() ? indicesTris : proxy.indicesTris; }
+  BufferHandle ssbo_collisionInitPos; // ssbo_initPos, or the proxy's rest positions
+  BufferHandle ssbo_collisionPos; // ssbo_pos, or the proxy's animated positions
+
+  CollisionProxy proxy; // empty until useProxy
+  // collide against a simplified copy of the mesh from now on (see proxy.hpp),
+  // loaded from <filename>.proxy if one was made with the same settings.
+  // meshes already within budget keep colliding as themselves.
+  void useProxy(int targetTriangles, float tolerance);
+  static string proxyPath(const string &meshFilename) { return meshFilename + ".proxy"; }
+
+  BufferHandle ssbo_triangles; // buffer of triangles as vec4s, in BVH leaf order
+  void leafTriangles(vector<glm::vec4> &tri) const; // what goes in ssbo_triangles
+
+  BVH bvh; // over the rest pose
+  BufferHandle ssbo_bvhRestNodes; // BVH nodes around initial positions
+  BufferHandle ssbo_bvhNodes; // BVH nodes around animated positions
+
+  SDF sdf; // over the rest pose, empty until bakeSDF
+  BufferHandle ssbo_sdf = 0;
+  void bakeSDF(int resolution); // loads <filename>.sdf if it matches, bakes and saves it if not
+
+  Primitive primitive; // over the rest pose. NONE: collide against the triangles
+  BufferHandle ssbo_primitive = 0;
+  void setPrimitive(const Primitive &shape); // collide as shape from now on, NONE goes back to the triangles
+  void fitPrimitive(int type, int resolution = PRIMITIVE_HEIGHTFIELD_RESOLUTION); // see Primitive::fit
 
   glm::mat4 getTransformationAtTime(float dt);
   bool animated = false;
+  glm::mat4 modelMatrix; // transformation for the current frame
 
 private:
+	void buildCollisionBuffers(); // BVH, triangles and node buffers over the collision mesh
+
 	// two basic "dances"
 	glm::mat4 twirl(float t);
 	glm::mat4 sineHop(float t);
@@ -0,0 +1,176 @@
+#include <cstdlib>
+#include "scenes.hpp"
+#include "tracer.hpp"
+#include "generators.hpp"
+#include "asset.hpp"
+
+std::string scenes::meshRoot = "";
+bool scenes::useAssets = false;
+bool scenes::usePrimitives = false;
+int scenes::forcedPrimitive = PRIMITIVE_NONE;
+
+std::string scenes::meshFile(const std::string &objName) {
+	std::string objPath = meshRoot + objName;
+	if (!useAssets) return objPath;
+	std::string assetPath = MeshAsset::pathFor(objPath);
+	if (MeshAsset::fileSize(assetPath) < 0) return objPath;
+	// mapping it just for the header is cheap, and it says why if it's unusable
+	MeshAsset asset(assetPath);
+	if (!asset.isOpen()) {
+		std::cout << "using " << objPath << " instead" << std::endl;
+		return objPath;
+	}
+	long long objSize = MeshAsset::fileSize(objPath);
+	if (objSize >= 0 && (objSize != asset.sourceSize || MeshAsset::hashFile(objPath) != asset.sourceHash)) {
+		std::cout << objPath << " changed since " << assetPath << " was made, using the obj" << std::endl;
+		return objPath;
+	}
+	return assetPath;
+}
+
+// the shape a collider gets with usePrimitives, going by its file name
+static int primitiveFor(const std::string &filename, int &resolution) {
+	resolution = PRIMITIVE_HEIGHTFIELD_RESOLUTION;
+	if (scenes::forcedPrimitive != PRIMITIVE_NONE) return scenes::forcedPrimitive;
+	if (filename.find("floor") != std::string::npos) return PRIMITIVE_PLANE;
+	if (filename.find("ball_") != std::string::npos || filename.find("gen:icosphere") == 0) return PRIMITIVE_SPHERE;
+	if (filename.find("gen:capsule") == 0) return PRIMITIVE_CAPSULE;
+	if (filename.find("gen:terrain:") == 0) {
+		// one sample per vertex, so the heightfield is the terrain's own triangles
+		resolution = atoi(filename.c_str() + sizeof("gen:terrain:") - 1);
+		return PRIMITIVE_HEIGHTFIELD;
+	}
+	return PRIMITIVE_NONE;
+}
+
+static Simulation *withPrimitives(Simulation *sim) {
+	if (!scenes::usePrimitives) return sim;
+	for (int i = 0; i < sim->numRigids; i++) {
+		Rbody *body = sim->rigids.at(i);
+		int resolution;
+		int type = primitiveFor(body->filename, resolution);
+		if (type == PRIMITIVE_NONE) continue;
+		body->fitPrimitive(type, resolution);
+		std::cout << body->filename << " collides as a " << Primitive::typeName(type) << std::endl;
+	}
+	return sim;
+}
+
+Simulation *scenes::loadDancingBear(Backend *backend) {
+	std::vector<string> colliders;
+	std::vector<string> cloths;
+	// Initialize a fun simulation
+	colliders.push_back(meshFile("meshes/low_poly_bear.obj"));
+	colliders.push_back(meshFile("meshes/floor.obj"));
+
+	cloths.push_back(meshFile("meshes/cape.obj"));
+	cloths.push_back(meshFile("meshes/dress.obj"));
+	cloths.push_back(meshFile("meshes/bear_cloth.obj"));
+
+	Simulation *sim = new Simulation(backend, colliders, cloths);
+
+	// let's generate some clothespins! vertex numbers are the ones in the
+	// obj files, the meshes renumber their vertices when they load
+	Rbody *bear = sim->rigids.at(0);
+	int bearLeftShoulder = bear->vertexFromFile(779);
+	int bearRightShoulder = bear->vertexFromFile(1578);
+	BufferHandle bearSSBO = bear->ssbo_pos;
+	bear->color = glm::vec3(1.0f);
+	bear->animated = true;
+
+	// SSBOs for cape
+	Cloth *cape = sim->cloths.at(0);
+	int capeLeftShoulder = cape->vertexFromFile(1);
+	int capeRightShoulder = cape->vertexFromFile(0);
+	cape->addPinConstraint(capeLeftShoulder, bearLeftShoulder, bearSSBO);
+	cape->addPinConstraint(capeRightShoulder, bearRightShoulder, bearSSBO);
+	cape->color = glm::vec3(0.5f, 1.0f, 1.0f);
+
+	// SSBOs for dress
+	Cloth *dress = sim->cloths.at(1);
+	int dressLeftShoulder = dress->vertexFromFile(14);
+	int dressRightShoulder = dress->vertexFromFile(13);
+	dress->addPinConstraint(dressLeftShoulder, bearLeftShoulder, bearSSBO);
+	dress->addPinConstraint(dressRightShoulder, bearRightShoulder, bearSSBO);
+	sim->cloths.at(1)->color = glm::vec3(1.0f, 0.5f, 0.5f);
+	return withPrimitives(sim);
+}
+
+Simulation *scenes::loadPerformanceTests(Backend *backend) {
+	return loadPerformanceTest(backend, "cloth_256", "ball_98");
+}
+
+Simulation *scenes::loadPerformanceTest(Backend *backend, const std::string &cloth, const std::string &collider) {
+	std::vector<string> colliders;
+	std::vector<string> cloths;
+	cloths.push_back(perfMeshPath(cloth));
+	colliders.push_back(perfMeshPath(collider));
+	for (int i = 0; i < 2; i++) {
+		const std::string &path = i == 0 ? cloths[0] : colliders[0];
+		if (generators::isGenerated(path)) continue;
+		std::ifstream file(path.c_str());
+		if (!file.is_open()) {
+			std::cout << "no mesh " << path << std::endl;
+			return NULL;
+		}
+	}
+	return withPrimitives(new Simulation(backend, colliders, cloths));
+}
+
+std::string scenes::perfMeshPath(const std::string &name) {
+	if (generators::isGenerated(name)) return name;
+	return meshFile("meshes/perf/" + name + ".obj");
+}
+
+Simulation *scenes::loadStaticCollDetectDebug(Backend *backend) {
+	std::vector<string> colliders;
+	std::vector<string> cloths;
+	cloths.push_back(meshFile("meshes/perf/cloth_121.obj"));
+	colliders.push_back(meshFile("meshes/perf/ball_98.obj"));
+	return withPrimitives(new Simulation(backend, colliders, cloths));
+}
+
+Simulation *scenes::loadStaticCollResolveDebug(Backend *backend) {
+	std::vector<string> colliders;
+	std::vector<string> cloths;
+	colliders.push_back(meshFile("meshes/low_poly_bear.obj"));
+	colliders.push_back(meshFile("meshes/floor.obj"));
+
+	cloths.push_back(meshFile("meshes/bear_cloth.obj"));
+
+	Simulation *sim = new Simulation(backend, colliders, cloths);
+	sim->rigids.at(0)->animated = false;
+	return withPrimitives(sim);
+}
+
+Simulation *scenes::loadScene(Backend *backend, const std::string &name) {
+	TRACE_ZONE("load scene");
+	if (name == "bear") return loadDancingBear(backend);
+	if (name == "perf") return loadPerformanceTests(backend);
+	if (name == "detect") return loadStaticCollDetectDebug(backend);
+	if (name == "resolve") return loadStaticCollResolveDebug(backend);
+	size_t plus = name.find('+');
+	if (plus != std::string::npos) {
+		return loadPerformanceTest(backend, name.substr(0, plus), name.substr(plus + 1));
+	}
+	return NULL;
+}
+
+std::vector<std::string> scenes::sceneNames() {
+	std::vector<std::string> names;
+	names.push_back("bear");
+	names.push_back("perf");
+	names.push_back("detect");
+	names.push_back("resolve");
+	return names;
+}
+
+std::vector<std::string> scenes::perfCloths() {
+	const char *names[] = { "cloth_121", "cloth_256", "cloth_529", "cloth_1296" };
+	return std::vector<std::string>(names, names + 4);
+}
+
+std::vector<std::string> scenes::perfBalls() {
+	const char *names[] = { "ball_98", "ball_386", "ball_1538", "ball_6156" };
+	return std::vector<std::string>(names, names + 4);
+}
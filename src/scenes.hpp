@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "simulation.hpp"
+
+// the built-in simulation setups, shared by the viewer and the headless tools.
+// mesh paths are relative to meshRoot (default: the working directory).
+// with useAssets, every mesh that has a precompiled asset next to it (see
+// asset.hpp) loads from that instead, unless the obj's size has changed since.
+// with usePrimitives, colliders that have an obvious analytic shape collide
+// as that (see primitive.hpp): floors as planes, balls as spheres, generated
+// capsules and terrain as capsules and heightfields. the bear stays a mesh.
+// forcedPrimitive fits that type to every collider instead.
+
+namespace scenes {
+extern std::string meshRoot;
+extern bool useAssets;
+extern bool usePrimitives;
+extern int forcedPrimitive; // PRIMITIVE_NONE: pick by collider
+std::string meshFile(const std::string &objName); // ex: "meshes/cape.obj"
+
+Simulation *loadDancingBear(Backend *backend); // the default sim
+Simulation *loadPerformanceTests(Backend *backend);
+// one cloth over one collider. each is either a mesh from meshes/perf
+// without the extension ("cloth_256", "ball_98") or a generator spec
+// ("gen:grid:1000", "gen:icosphere:7", see generators.hpp). NULL if a
+// mesh file is missing.
+Simulation *loadPerformanceTest(Backend *backend, const std::string &cloth, const std::string &collider);
+std::string perfMeshPath(const std::string &name);
+Simulation *loadStaticCollDetectDebug(Backend *backend); // ball and cloth. debugging.
+Simulation *loadStaticCollResolveDebug(Backend *backend); // floor and cloth. debugging.
+
+// look a scene up by name: "bear", "perf", "detect", "resolve", or
+// "<cloth>+<collider>" for loadPerformanceTest, ex: "gen:grid:1000+ball_98".
+// returns NULL for unknown names.
+Simulation *loadScene(Backend *backend, const std::string &name);
+std::vector<std::string> sceneNames();
+
+// the meshes in meshes/perf, smallest first
+std::vector<std::string> perfCloths();
+std::vector<std::string> perfBalls();
+}
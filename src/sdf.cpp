@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include "sdf.hpp"
+#include "threadPool.hpp"
+#include "tracer.hpp"
+
+// Ericson, Real-Time Collision Detection 5.1.5. exact, unlike the shaders'
+// nearestPointOnTriangle, which only has to be good enough per frame.
+static glm::vec3 closestPointOnTriangle(glm::vec3 p, glm::vec3 a, glm::vec3 b, glm::vec3 c) {
+	glm::vec3 ab = b - a;
+	glm::vec3 ac = c - a;
+	glm::vec3 ap = p - a;
+	float d1 = glm::dot(ab, ap);
+	float d2 = glm::dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+	glm::vec3 bp = p - b;
+	float d3 = glm::dot(ab, bp);
+	float d4 = glm::dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3) return b;
+
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+
+	glm::vec3 cp = p - c;
+	float d5 = glm::dot(ab, cp);
+	float d6 = glm::dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6) return c;
+
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+		return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	}
+
+	float denom = 1.0f / (va + vb + vc);
+	return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+static float distanceToBox(glm::vec3 p, glm::vec3 boxMin, glm::vec3 boxMax) {
+	return glm::length(glm::max(glm::max(boxMin - p, glm::vec3(0.0f)), p - boxMax));
+}
+
+// signed distance from p to the mesh. the sign comes from the normal of the
+// closest triangle. when several triangles share the closest point (an edge
+// or a corner), the one whose normal lines up best with p decides.
+static float signedDistance(glm::vec3 p, const std::vector<glm::vec4> &positions,
+	const std::vector<int> &indicesTris, const BVH &bvh, float tieEpsilon) {
+	float nearestDistance = 1e30f;
+	float nearestAlignment = 0.0f; // dot of the unit offset and the face normal
+
+	int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	if (bvh.numNodes() > 0) stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		int node = stack[--stackSize];
+		glm::vec4 boxMin = bvh.nodes[2 * node];
+		glm::vec4 boxMax = bvh.nodes[2 * node + 1];
+		if (distanceToBox(p, glm::vec3(boxMin), glm::vec3(boxMax)) > nearestDistance + tieEpsilon) continue;
+
+		int first = (int)boxMin.w;
+		int count = (int)boxMax.w;
+		if (count == 0) {
+			stack[stackSize++] = first;
+			stack[stackSize++] = first + 1;
+			continue;
+		}
+
+		for (int i = first; i < first + count; i++) {
+			int tri = bvh.triangleOrder[i];
+			glm::vec3 v0 = glm::vec3(positions[indicesTris[tri * 3 + 0]]);
+			glm::vec3 v1 = glm::vec3(positions[indicesTris[tri * 3 + 1]]);
+			glm::vec3 v2 = glm::vec3(positions[indicesTris[tri * 3 + 2]]);
+			glm::vec3 offset = p - closestPointOnTriangle(p, v0, v1, v2);
+			float distance = glm::length(offset);
+
+			glm::vec3 normal = glm::cross(v1 - v0, v2 - v0);
+			float normalLength = glm::length(normal);
+			float alignment = 0.0f;
+			if (normalLength > 0.0f && distance > 0.0f) {
+				alignment = glm::dot(offset, normal) / (normalLength * distance);
+			}
+
+			if (distance < nearestDistance - tieEpsilon) {
+				nearestDistance = distance;
+				nearestAlignment = alignment;
+			} else if (distance <= nearestDistance + tieEpsilon &&
+				std::abs(alignment) > std::abs(nearestAlignment)) {
+				nearestDistance = std::min(nearestDistance, distance);
+				nearestAlignment = alignment;
+			}
+		}
+	}
+	return nearestAlignment < 0.0f ? -nearestDistance : nearestDistance;
+}
+
+void SDF::bake(const std::vector<glm::vec4> &positions, const std::vector<int> &indicesTris,
+	const BVH &bvh, int resolution) {
+	TRACE_ZONE("bake sdf");
+	resolution = std::max(resolution, 2);
+	glm::vec3 boundsMin = glm::vec3(1e30f);
+	glm::vec3 boundsMax = glm::vec3(-1e30f);
+	for (int i = 0; i < (int)indicesTris.size(); i++) {
+		boundsMin = glm::min(boundsMin, glm::vec3(positions[indicesTris[i]]));
+		boundsMax = glm::max(boundsMax, glm::vec3(positions[indicesTris[i]]));
+	}
+	if (indicesTris.empty()) {
+		boundsMin = glm::vec3(0.0f);
+		boundsMax = glm::vec3(0.0f);
+	}
+	glm::vec3 extent = boundsMax - boundsMin;
+	float margin = SDF_MARGIN * std::max(std::max(extent.x, extent.y), std::max(extent.z, 0.0001f));
+
+	dims = glm::ivec3(resolution);
+	origin = boundsMin - glm::vec3(margin);
+	cellSize = (extent + glm::vec3(2.0f * margin)) / (float)(resolution - 1);
+	float tieEpsilon = 0.0001f * std::min(std::min(cellSize.x, cellSize.y), cellSize.z);
+
+	// distances first
+	int numSamples = dims.x * dims.y * dims.z;
+	samples.resize(numSamples);
+	ThreadPool pool;
+	pool.minParallelCount = 1;
+	pool.parallelFor(numSamples, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			glm::ivec3 cell = glm::ivec3(i % dims.x, (i / dims.x) % dims.y, i / (dims.x * dims.y));
+			glm::vec3 p = origin + glm::vec3(cell) * cellSize;
+			samples[i] = glm::vec4(0.0f, 0.0f, 0.0f, signedDistance(p, positions, indicesTris, bvh, tieEpsilon));
+		}
+	});
+
+	// then gradients from central differences (one sided at the borders)
+	pool.parallelFor(numSamples, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			glm::ivec3 cell = glm::ivec3(i % dims.x, (i / dims.x) % dims.y, i / (dims.x * dims.y));
+			glm::vec3 gradient;
+			for (int axis = 0; axis < 3; axis++) {
+				glm::ivec3 lo = cell;
+				glm::ivec3 hi = cell;
+				lo[axis] = std::max(cell[axis] - 1, 0);
+				hi[axis] = std::min(cell[axis] + 1, dims[axis] - 1);
+				float dLo = samples[(lo.z * dims.y + lo.y) * dims.x + lo.x].w;
+				float dHi = samples[(hi.z * dims.y + hi.y) * dims.x + hi.x].w;
+				gradient[axis] = (dHi - dLo) / ((hi[axis] - lo[axis]) * cellSize[axis]);
+			}
+			float length = glm::length(gradient);
+			if (length > 0.0f) gradient /= length;
+			samples[i].x = gradient.x;
+			samples[i].y = gradient.y;
+			samples[i].z = gradient.z;
+		}
+	});
+}
+
+glm::vec4 SDF::sample(glm::vec3 p) const {
+	glm::vec3 g = (p - origin) / cellSize;
+	if (g.x < 0.0f || g.y < 0.0f || g.z < 0.0f ||
+		g.x >= dims.x - 1 || g.y >= dims.y - 1 || g.z >= dims.z - 1) {
+		return glm::vec4(0.0f, 0.0f, 0.0f, 1e30f); // off the grid: outside the body
+	}
+	glm::ivec3 c = glm::ivec3(g);
+	glm::vec3 f = g - glm::vec3(c);
+	int i = (c.z * dims.y + c.y) * dims.x + c.x;
+	int dy = dims.x;
+	int dz = dims.x * dims.y;
+	glm::vec4 x00 = glm::mix(samples[i], samples[i + 1], f.x);
+	glm::vec4 x10 = glm::mix(samples[i + dy], samples[i + dy + 1], f.x);
+	glm::vec4 x01 = glm::mix(samples[i + dz], samples[i + dz + 1], f.x);
+	glm::vec4 x11 = glm::mix(samples[i + dz + dy], samples[i + dz + dy + 1], f.x);
+	return glm::mix(glm::mix(x00, x10, f.y), glm::mix(x01, x11, f.y), f.z);
+}
+
+unsigned long long SDF::hashMesh(const std::vector<glm::vec4> &positions,
+	const std::vector<int> &indicesTris) {
+	// FNV-1a over the raw vertex and index data
+	unsigned long long hash = 14695981039346656037ULL;
+	const unsigned char *bytes = (const unsigned char *)positions.data();
+	for (size_t i = 0; i < positions.size() * sizeof(glm::vec4); i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	}
+	bytes = (const unsigned char *)indicesTris.data();
+	for (size_t i = 0; i < indicesTris.size() * sizeof(int); i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+bool SDF::load(const std::string &path, unsigned long long meshHash, int resolution) {
+	TRACE_ZONE("load sdf");
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file.is_open()) return false;
+
+	char magic[4];
+	int version, fileResolution;
+	unsigned long long fileHash;
+	file.read(magic, 4);
+	file.read((char *)&version, sizeof(int));
+	file.read((char *)&fileHash, sizeof(unsigned long long));
+	file.read((char *)&fileResolution, sizeof(int));
+	if (!file || memcmp(magic, "SDF ", 4) != 0 || version != SDF_FILE_VERSION ||
+		fileHash != meshHash || fileResolution != resolution) {
+		return false;
+	}
+
+	file.read((char *)&dims, sizeof(glm::ivec3));
+	file.read((char *)&origin, sizeof(glm::vec3));
+	file.read((char *)&cellSize, sizeof(glm::vec3));
+	if (!file || dims.x < 1 || dims.y < 1 || dims.z < 1) return false;
+	samples.resize(dims.x * dims.y * dims.z);
+	file.read((char *)&samples[0], samples.size() * sizeof(glm::vec4));
+	if (!file) {
+		samples.clear();
+		return false;
+	}
+	return true;
+}
+
+bool SDF::save(const std::string &path, unsigned long long meshHash, int resolution) const {
+	std::ofstream file(path.c_str(), std::ios::binary);
+	if (!file.is_open()) return false;
+
+	int version = SDF_FILE_VERSION;
+	file.write("SDF ", 4);
+	file.write((const char *)&version, sizeof(int));
+	file.write((const char *)&meshHash, sizeof(unsigned long long));
+	file.write((const char *)&resolution, sizeof(int));
+	file.write((const char *)&dims, sizeof(glm::ivec3));
+	file.write((const char *)&origin, sizeof(glm::vec3));
+	file.write((const char *)&cellSize, sizeof(glm::vec3));
+	file.write((const char *)&samples[0], samples.size() * sizeof(glm::vec4));
+	return (bool)file;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <glm/glm.hpp>
+#include "bvh.hpp"
+
+// signed distance field around a mesh, sampled on a regular grid.
+// every sample is a vec4: (gradient x, y, z, signed distance), negative inside.
+// the grid has the same number of samples along each axis, so cells stretch
+// with the mesh's bounds and thin colliders (like the floor slab) still get
+// samples inside them.
+// assumes closed meshes with outward facing (counterclockwise) triangles.
+
+#define SDF_RESOLUTION 64 // samples along each axis
+#define SDF_MARGIN 0.05f // padding around the mesh, fraction of its longest side
+#define SDF_FILE_VERSION 1
+
+class SDF
+{
+public:
+	glm::vec3 origin; // position of sample (0, 0, 0)
+	glm::vec3 cellSize;
+	glm::ivec3 dims;
+	std::vector<glm::vec4> samples; // x fastest, then y, then z
+
+	void bake(const std::vector<glm::vec4> &positions, const std::vector<int> &indicesTris,
+		const BVH &bvh, int resolution);
+
+	// disk cache. load fails (returns false) if the file is missing, from an
+	// older version, or was baked from a different mesh or resolution.
+	bool load(const std::string &path, unsigned long long meshHash, int resolution);
+	bool save(const std::string &path, unsigned long long meshHash, int resolution) const;
+
+	// trilinear lookup, same as sampleSDF in cloth_genCollisionsSDF.comp.glsl
+	glm::vec4 sample(glm::vec3 p) const;
+
+	static unsigned long long hashMesh(const std::vector<glm::vec4> &positions,
+		const std::vector<int> &indicesTris);
+};
@@ -1,20 +1,12 @@
+#include <algorithm>
 #include "simulation.hpp"
-#include "checkGLError.hpp"
-
-// for varying shader work group size.
-// this gets injected into the shaders when they are loaded.
-#define WORK_GROUP_SIZE 32
 
 #define DEBUG_VERBOSE 0
 
-#define QUERY_PERFORMANCE 0
-
-#define PROJ_CONSTRAINTS 0
-#define GENER_COLLISIONS 1
-#define RESOL_COLLISIONS 2
-
-Simulation::Simulation(vector<string> &body_filenames,
-	vector<string> &cloth_filenames) {
+Simulation::Simulation(Backend *backend, vector<string> &body_filenames,
+	vector<string> &cloth_filenames) : profiler(backend) {
+	TRACE_ZONE("set up simulation");
+	this->backend = backend;
 	initComputeProgs();
 	glm::vec3 jitter;
 	int iSecret;
@@ -27,14 +19,13 @@ Simulation::Simulation(vector<string> &body_filenames,
 
 	numRigids = body_filenames.size();
 	for (int i = 0; i < numRigids; i++) {
-		Rbody *newCollider = new Rbody(body_filenames.at(i));
+		Rbody *newCollider = new Rbody(backend, body_filenames.at(i));
 		rigids.push_back(newCollider);
-		checkGLError("init rbodies");
 	}
 
 	numCloths = cloth_filenames.size();
 	for (int i = 0; i < numCloths; i++) {
-		Cloth *newCloth = new Cloth(cloth_filenames.at(i), jitter);
+		Cloth *newCloth = new Cloth(backend, cloth_filenames.at(i), jitter);
 		iSecret = rand() % 100 + 1;
 		jitter.x = (float)iSecret / 100000.0f;
 		iSecret = rand() % 100 + 1;
@@ -43,276 +34,326 @@ Simulation::Simulation(vector<string> &body_filenames,
 		jitter.z = (float)iSecret / 100000.0f;
 		newCloth->uploadExternalConstraints();
 		cloths.push_back(newCloth);
-		checkGLError("init cloths");
 	}
 
-#if QUERY_PERFORMANCE
-	glGenQueries(1, &time_query);
-	elapsed_time = 0;
-	frameCount = 0;
-	timeStagesTotal[PROJ_CONSTRAINTS] = 0;
-	timeStagesTotal[GENER_COLLISIONS] = 0;
-	timeStagesTotal[RESOL_COLLISIONS] = 0;
-	timeStagesAVG[PROJ_CONSTRAINTS] = 0.0f;
-	timeStagesAVG[GENER_COLLISIONS] = 0.0f;
-	timeStagesAVG[RESOL_COLLISIONS] = 0.0f;
-	timeStagesMin[PROJ_CONSTRAINTS] = HUGE_VAL;
-	timeStagesMin[GENER_COLLISIONS] = HUGE_VAL;
-	timeStagesMin[RESOL_COLLISIONS] = HUGE_VAL;
-	timeStagesMax[PROJ_CONSTRAINTS] = 0;
-	timeStagesMax[GENER_COLLISIONS] = 0;
-	timeStagesMax[RESOL_COLLISIONS] = 0;
+#if COLLISION_PROXIES
+	enableCollisionProxies();
+#endif
+#if SDF_COLLIDERS
+	enableSDFColliders();
 #endif
-
 }
 
 Simulation::~Simulation() {
+	setProfiling(false);
+	delete batch;
 	// delete all the meshes and rigidbodies
 	for (int i = 0; i < numRigids; i++) {
-		delete(&rigids.at(i));
+		delete rigids.at(i);
 	}
 	for (int i = 0; i < numCloths; i++) {
-		delete(&cloths.at(i));
+		delete cloths.at(i);
 	}
 }
 
-//http://stackoverflow.com/questions/3418231/replace-part-of-a-string-with-another-string
-bool replace(std::string& str, const std::string& from, const std::string& to) {
-	size_t start_pos = str.find(from);
-	if (start_pos == std::string::npos)
-		return false;
-	str.replace(start_pos, from.length(), to);
-	return true;
-}
-
-GLuint initComputeProg(const char *path) {
-    GLuint prog = glCreateProgram();
-    GLuint cs = glCreateShader(GL_COMPUTE_SHADER);
-
-    int cs_len;
-    const char *cs_str;
-    cs_str = glslUtility::loadFile(path, cs_len);
-
-	// check and edit the shader so the workgroup size is correct
-	string str_shader = string(cs_str);
-	str_shader.resize(cs_len);
-	replace(str_shader, "WORK_GROUP_SIZE XX", "WORK_GROUP_SIZE " + std::to_string(WORK_GROUP_SIZE));
-
-	cs_len = str_shader.length();
-
-	char *cs_str_edited = new char[str_shader.length() + 1];
-	strcpy(cs_str_edited, str_shader.c_str());
+void Simulation::initComputeProgs() {
+	// uniforms that stay the same for the whole simulation
+	backend->useKernel(KERNEL_EXTERNAL_FORCES);
+	backend->setUniform(1, Gravity);
+	backend->setUniform(0, timeStep);
 
-	//cs_str = str_shader->c_str();
+	backend->useKernel(KERNEL_PREDICT_POSITIONS);
+	backend->setUniform(0, timeStep);
 
-	glShaderSource(cs, 1, &cs_str_edited, &cs_len);
+	backend->useKernel(KERNEL_INTEGRATE);
+	backend->setUniform(0, timeStep);
+	backend->setUniform(1, Gravity);
 
-    GLint status;
+	backend->useKernel(KERNEL_PROJECT_CLOTH_CONSTRAINTS);
+	backend->setUniform(0, (float) projectTimes);
+	backend->setUniform(4, glm::mat4()); // pin influencer transform
 
-    glCompileShader(cs);
-    glGetShaderiv(cs, GL_COMPILE_STATUS, &status);
-    if (!status) {
-        printf("Error compiling compute shader: %s\n", path);
-        glslUtility::printShaderInfoLog(cs);
-		printf(cs_str_edited);
-		cout << endl;
-        exit(EXIT_FAILURE);
-    }
+	backend->useKernel(KERNEL_PROJECT_CLOTH_CONSTRAINTS_CSR);
+	backend->setUniform(0, (float) projectTimes);
 
-    glAttachShader(prog, cs);
-    glLinkProgram(prog);
-    glGetProgramiv(prog, GL_LINK_STATUS, &status);
-    if (!status) {
-        printf("Error linking compute shader: %s\n", path);
-        glslUtility::printLinkInfoLog(prog);
-		printf(cs_str_edited);
-		cout << endl;
-        exit(EXIT_FAILURE);
-    }
+	backend->useKernel(KERNEL_PROJECT_CLOTH_CONSTRAINTS_COLORED);
+	backend->setUniform(0, (float) projectTimes);
 
-	delete[] cs_str;
-	delete[] cs_str_edited;
+	backend->useKernel(KERNEL_UPDATE_POSITIONS_VELOCITIES);
+	backend->setUniform(0, timeStep);
 
-	return prog;
+	backend->useKernel(KERNEL_PROJECT_COLLISIONS);
+	backend->setUniform(1, collisionBounceFactor);
 }
 
-void Simulation::updateStat(int stat) {
-	glEndQuery(GL_TIME_ELAPSED);
-
-	// wait until the query is available and return.
-	// if this takes too long, alert and continue.
-	// TODO: see if the double buffering version works with compute shaders.
-	int done = 0;
-	while (!done) {
-		glGetQueryObjectiv(time_query,
-			GL_QUERY_RESULT_AVAILABLE,
-			&done);
+void Simulation::genCollisionConstraints(Cloth *cloth, Rbody *rbody) {
+	if (rbody->ssbo_primitive) {
+		genCollisionConstraintsPrimitive(cloth, rbody);
+		return;
+	}
+	if (sdfColliders && rbody->ssbo_sdf) {
+		genCollisionConstraintsSDF(cloth, rbody);
+		return;
+	}
+	int numVertices = cloth->initPositions.size();
+	bool candidates = collisionCandidates && localSpaceColliders;
+	backend->useKernel(candidates ? KERNEL_GEN_COLLISIONS_CANDIDATES : KERNEL_GEN_COLLISIONS);
+	backend->setUniform(0, rbody->bvh.numNodes());
+	backend->setUniform(1, numVertices);
+	backend->bindBuffer(0, cloth->ssbo_pos);
+	backend->bindBuffer(1, cloth->ssbo_pos_pred2);
+	backend->bindBuffer(3, rbody->ssbo_triangles);
+	backend->bindBuffer(4, cloth->ssbo_collisionConstraints);
+	backend->bindBuffer(5, cloth->ssbo_clothParams); // also which cloth each vertex is from
+	if (localSpaceColliders) {
+		// query the rest pose, cloth positions get moved into body space
+		backend->setUniform(3, rbody->modelMatrix);
+		backend->setUniform(4, glm::inverse(rbody->modelMatrix));
+		backend->bindBuffer(2, rbody->ssbo_collisionInitPos);
+		backend->bindBuffer(6, rbody->ssbo_bvhRestNodes);
+		if (candidates) {
+			backend->setUniform(2, collisionSkin);
+			backend->bindBuffer(7, candidateLists(cloth, rbody));
+		}
+	} else {
+		backend->setUniform(3, glm::mat4());
+		backend->setUniform(4, glm::mat4());
+		backend->bindBuffer(2, rbody->ssbo_collisionPos);
+		backend->bindBuffer(6, rbody->ssbo_bvhNodes);
 	}
-	glGetQueryObjectui64v(time_query, GL_QUERY_RESULT, &elapsed_time);
-	timeStagesTotal[stat] += elapsed_time;
-	timeStagesAVG[stat] = (float)timeStagesTotal[stat] / (float)frameCount;
 
-	timeStagesMin[stat] = glm::min(timeStagesMin[stat], elapsed_time);
-	timeStagesMax[stat] = glm::max(timeStagesMax[stat], elapsed_time);
+	backend->dispatch(numVertices);
+	backend->barrier();
 }
 
-void Simulation::initComputeProgs() {
-	prog_ppd1_externalForces = initComputeProg("../shaders/cloth_pbd1_externalForces.comp.glsl");
-	glUseProgram(prog_ppd1_externalForces);
-	glUniform3fv(1, 1, &Gravity[0]);
-	glUniform1f(0, timeStep);
-
-	prog_ppd2_dampVelocity = initComputeProg("../shaders/cloth_pbd2_dampVelocities.comp.glsl");
-
-	prog_ppd3_predictPositions = initComputeProg("../shaders/cloth_pbd3_predictPositions.comp.glsl");
-	glUseProgram(prog_ppd3_predictPositions);
-	glUniform1f(0, timeStep);
-
-	prog_ppd4_updateInvMass = initComputeProg("../shaders/cloth_pbd4_updateInverseMasses.comp.glsl");
-
-	prog_ppd6_projectClothConstraints = initComputeProg("../shaders/cloth_pbd5_projectClothConstraints.comp.glsl");
-	glUseProgram(prog_ppd6_projectClothConstraints);
-	glUniform1f(0, (float) projectTimes);
-
-	prog_ppd7_updateVelPos = initComputeProg("../shaders/cloth_pbd6_updatePositionsVelocities.comp.glsl");
-	glUseProgram(prog_ppd7_updateVelPos);
-	glUniform1f(0, timeStep);
+BufferHandle Simulation::candidateLists(Cloth *cloth, Rbody *rbody) {
+	int r = find(rigids.begin(), rigids.end(), rbody) - rigids.begin();
+	if ((int)cloth->ssbo_collisionCandidates.size() <= r) cloth->ssbo_collisionCandidates.resize(r + 1, 0);
+	BufferHandle &lists = cloth->ssbo_collisionCandidates[r];
+	if (!lists) {
+		// all zero: no vertex has a list yet
+		vector<glm::vec4> empty(cloth->initPositions.size() * CANDIDATE_VEC4S, glm::vec4(0.0f));
+		lists = backend->createBuffer(empty.size(), empty.empty() ? NULL : &empty[0]);
+	}
+	return lists;
+}
 
-	
-	prog_copyBuffer = initComputeProg("../shaders/copy.comp.glsl");
+void Simulation::genCollisionConstraintsSDF(Cloth *cloth, Rbody *rbody) {
+	// the field is baked around the rest pose, so this always works in body
+	// space, whether or not the body's positions buffer is being animated
+	int numVertices = cloth->initPositions.size();
+	SDF &sdf = rbody->sdf;
+	backend->useKernel(KERNEL_GEN_COLLISIONS_SDF);
+	backend->setUniform(1, numVertices);
+	backend->setUniform(3, rbody->modelMatrix);
+	backend->setUniform(4, glm::inverse(rbody->modelMatrix));
+	backend->setUniform(5, sdf.origin);
+	backend->setUniform(6, sdf.cellSize);
+	backend->setUniform(7, glm::vec3(sdf.dims));
+	backend->bindBuffer(0, cloth->ssbo_pos);
+	backend->bindBuffer(1, cloth->ssbo_pos_pred2);
+	backend->bindBuffer(2, rbody->ssbo_sdf);
+	backend->bindBuffer(4, cloth->ssbo_collisionConstraints);
+	backend->bindBuffer(5, cloth->ssbo_clothParams);
+	backend->dispatch(numVertices);
+	backend->barrier();
+}
 
-	prog_genCollisionConstraints = initComputeProg("../shaders/cloth_genCollisions.comp.glsl");
+void Simulation::genCollisionConstraintsPrimitive(Cloth *cloth, Rbody *rbody) {
+	// shapes are in the rest pose too, see genCollisionConstraintsSDF
+	int numVertices = cloth->initPositions.size();
+	backend->useKernel(KERNEL_GEN_COLLISIONS_PRIMITIVE);
+	backend->setUniform(1, numVertices);
+	backend->setUniform(3, rbody->modelMatrix);
+	backend->setUniform(4, glm::inverse(rbody->modelMatrix));
+	backend->bindBuffer(0, cloth->ssbo_pos);
+	backend->bindBuffer(1, cloth->ssbo_pos_pred2);
+	backend->bindBuffer(2, rbody->ssbo_primitive);
+	backend->bindBuffer(4, cloth->ssbo_collisionConstraints);
+	backend->bindBuffer(5, cloth->ssbo_clothParams);
+	backend->dispatch(numVertices);
+	backend->barrier();
+}
 
-	prog_projectCollisionConstraints = initComputeProg("../shaders/cloth_projectCollisions.comp.glsl");
-	glUseProgram(prog_projectCollisionConstraints);
-	glUniform1f(1, collisionBounceFactor);
+void Simulation::enableSDFColliders() {
+	for (int i = 0; i < numRigids; i++) {
+		rigids.at(i)->bakeSDF(sdfResolution);
+	}
+	sdfColliders = true;
+}
 
-	prog_rigidbodyAnimate = initComputeProg("../shaders/rigidbody_animate.comp.glsl");
+void Simulation::enableCollisionProxies() {
+	for (int i = 0; i < numRigids; i++) {
+		rigids.at(i)->useProxy(proxyTriangles, proxyTolerance);
+	}
+	collisionProxies = true;
 }
 
-void Simulation::genCollisionConstraints(Cloth *cloth, Rbody *rbody) {
-	int numVertices = cloth->initPositions.size();
-	glUseProgram(prog_genCollisionConstraints);
-	glUniform1i(0, rbody->indicesTris.size() / 3);
-	glUniform1i(1, numVertices);
-	glUniform1f(2, cloth->default_static_constraint_bounce);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, cloth->ssbo_pos);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, cloth->ssbo_pos_pred2);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, rbody->ssbo_pos);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, rbody->ssbo_triangles);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, cloth->ssbo_collisionConstraints);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, cloth->ssbo_debug);
-
-	int workGroupCount_vertices = (numVertices - 1) / WORK_GROUP_SIZE + 1;
-	glDispatchCompute(workGroupCount_vertices, 1, 1);
-	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-
-	//retrieveBuffer(cloth->ssbo_debug, 121);
+void Simulation::gatherPinTargets(Cloth *cloth) {
+	// the pinned bodies don't move while the constraints are projected,
+	// so look up where every pin wants to be once per frame
+	backend->useKernel(KERNEL_GATHER_PIN_TARGETS);
+	backend->bindBuffer(1, cloth->ssbo_externalConstraints);
+	backend->bindBuffer(2, cloth->ssbo_pinTargets);
+	int numPinnedSSBOs = cloth->pinnedSSBOs.size();
+	for (int i = 0; i < numPinnedSSBOs; i++) {
+		// bodies in local space don't update their positions buffer.
+		// pin to the rest pose and move the pin targets instead.
+		Rbody *pinnedBody = localSpaceColliders ? findRbody(cloth->pinnedSSBOs.at(i)) : NULL;
+		if (pinnedBody) {
+			backend->bindBuffer(0, pinnedBody->ssbo_initPos);
+			backend->setUniform(2, pinnedBody->modelMatrix);
+		} else {
+			backend->bindBuffer(0, cloth->pinnedSSBOs.at(i)); // init positions, not pred 1
+			backend->setUniform(2, glm::mat4());
+		}
+		int numPins = cloth->pinOffsets[i + 1] - cloth->pinOffsets[i];
+		backend->setUniform(0, cloth->pinOffsets[i]);
+		backend->setUniform(1, numPins);
+		backend->dispatch(numPins);
+	}
+	backend->barrier();
 }
 
 void Simulation::stepSingleCloth(Cloth *cloth) {
+	TRACE_ZONE("step cloth");
 	int numVertices = cloth->initPositions.size();
-	int workGroupCount_vertices = (numVertices - 1) / WORK_GROUP_SIZE + 1;
-
-	/* compute new velocities with external forces */
-	glUseProgram(prog_ppd1_externalForces);
-	glUniform1i(2, numVertices);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, cloth->ssbo_vel);
-	glDispatchCompute(workGroupCount_vertices, 1, 1);
-	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT); // emulate ssbo memory coherence
-
-	/* damp velocities */
-	glUseProgram(prog_ppd2_dampVelocity);
-	glUniform1i(0, numVertices);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, cloth->ssbo_vel);
-	glDispatchCompute(workGroupCount_vertices, 1, 1);
-	
-	/* predict new positions */
-	glUseProgram(prog_ppd3_predictPositions);
-	glUniform1i(1, numVertices);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, cloth->ssbo_vel);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, cloth->ssbo_pos);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, cloth->ssbo_pos_pred1);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, cloth->ssbo_pos_pred2);
-	glDispatchCompute(workGroupCount_vertices, 1, 1);
-	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	if (fusedIntegration) {
+		/* external forces, damping and prediction in one pass */
+		backend->useKernel(KERNEL_INTEGRATE);
+		backend->setUniform(2, numVertices);
+		backend->bindBuffer(0, cloth->ssbo_vel);
+		backend->bindBuffer(1, cloth->ssbo_pos);
+		backend->bindBuffer(2, cloth->ssbo_pos_pred1);
+		backend->bindBuffer(3, cloth->ssbo_pos_pred2);
+		backend->dispatch(numVertices);
+		backend->barrier();
+	} else {
+		/* compute new velocities with external forces */
+		backend->useKernel(KERNEL_EXTERNAL_FORCES);
+		backend->setUniform(2, numVertices);
+		backend->bindBuffer(0, cloth->ssbo_vel);
+		backend->dispatch(numVertices);
+		backend->barrier();
+
+		/* damp velocities */
+		backend->useKernel(KERNEL_DAMP_VELOCITIES);
+		backend->setUniform(0, numVertices);
+		backend->bindBuffer(0, cloth->ssbo_vel);
+		backend->dispatch(numVertices);
+
+		/* predict new positions */
+		backend->useKernel(KERNEL_PREDICT_POSITIONS);
+		backend->setUniform(1, numVertices);
+		backend->bindBuffer(0, cloth->ssbo_vel);
+		backend->bindBuffer(1, cloth->ssbo_pos);
+		backend->bindBuffer(2, cloth->ssbo_pos_pred1);
+		backend->bindBuffer(3, cloth->ssbo_pos_pred2);
+		backend->dispatch(numVertices);
+		backend->barrier();
+	}
 
 	/* update inverse masses */
 	int numPinConstraints = cloth->externalConstraints.size();
-	int workGroupCountPinConstraints = (numPinConstraints - 1) / WORK_GROUP_SIZE + 1;
-	glUseProgram(prog_ppd4_updateInvMass);
-	glUniform1i(0, numPinConstraints);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, cloth->ssbo_pos_pred1);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, cloth->ssbo_pos_pred2);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, cloth->ssbo_externalConstraints);
-	glDispatchCompute(workGroupCountPinConstraints, 1, 1);
-	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-
-#if QUERY_PERFORMANCE
-	glBeginQuery(GL_TIME_ELAPSED, time_query);
-#endif
+	if (numPinConstraints > 0) {
+		profiler.beginZone("pins");
+		backend->useKernel(KERNEL_UPDATE_INVERSE_MASSES);
+		backend->setUniform(0, numPinConstraints);
+		backend->bindBuffer(0, cloth->ssbo_pos_pred1);
+		backend->bindBuffer(1, cloth->ssbo_pos_pred2);
+		backend->bindBuffer(2, cloth->ssbo_externalConstraints);
+		backend->dispatch(numPinConstraints);
+		backend->barrier();
+
+		gatherPinTargets(cloth);
+		profiler.endZone();
+	}
 
 	/* project cloth constraints N times */
+	profiler.beginZone("solver");
 	for (int i = 0; i < projectTimes; i++) {
-		glUseProgram(prog_ppd6_projectClothConstraints);
-		// project each of the 4 internal constraints
-		// bind predicted positions input/output
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, cloth->ssbo_pos_pred1);
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, cloth->ssbo_pos_pred2);
-		glUniform1f(2, cloth->default_internal_K); // uniform K
-		glUniform1i(3, cloth->ssbo_pos_pred1); // send the identity of the influencing SSBO
-
-		for (int j = 0; j < cloth->numInternalConstraintBuffers; j++) {
-			// bind inner constraints
-			int workGroupCountInnerConstraints = 
-				(cloth->internalConstraints[j].size() - 1) / WORK_GROUP_SIZE + 1;
-			glUniform1i(1, cloth->internalConstraints[j].size());
-
-			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, cloth->ssbo_internalConstraints[j]);
-			// project this set of constraints
-			glDispatchCompute(workGroupCountInnerConstraints, 1, 1);
-			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		// the csr solver rewrites every vertex, so instead of copying pred2
+		// back into pred1 the two just trade places. swapping before (not
+		// after) each iteration leaves the result in pred2 for collisions.
+		if (constraintSolver == SOLVER_CSR && i > 0) {
+			std::swap(cloth->ssbo_pos_pred1, cloth->ssbo_pos_pred2);
+		}
 
+		if (constraintSolver == SOLVER_COLORED) {
+			// in place, one color at a time
+			backend->useKernel(KERNEL_PROJECT_CLOTH_CONSTRAINTS_COLORED);
+			backend->bindBuffer(1, cloth->ssbo_pos_pred2);
+			backend->bindBuffer(2, cloth->ssbo_coloredConstraints);
+			backend->bindBuffer(4, cloth->ssbo_clothParams);
+			int numColors = (int)cloth->colorOffsets.size() - 1;
+			for (int c = 0; c < numColors; c++) {
+				int numColorConstraints = cloth->colorOffsets[c + 1] - cloth->colorOffsets[c];
+				backend->setUniform(1, numColorConstraints);
+				backend->setUniform(3, cloth->colorOffsets[c]);
+				backend->dispatch(numColorConstraints);
+				backend->barrier();
+			}
+		} else if (constraintSolver == SOLVER_CSR) {
+			// every vertex gathers all of its constraints at once
+			backend->useKernel(KERNEL_PROJECT_CLOTH_CONSTRAINTS_CSR);
+			backend->bindBuffer(0, cloth->ssbo_pos_pred1);
+			backend->bindBuffer(1, cloth->ssbo_pos_pred2);
+			backend->bindBuffer(2, cloth->ssbo_constraintRows);
+			backend->bindBuffer(3, cloth->ssbo_constraintNeighbors);
+			backend->bindBuffer(4, cloth->ssbo_clothParams);
+			backend->setUniform(1, numVertices);
+			backend->dispatch(numVertices);
+			backend->barrier();
+		} else {
+			backend->useKernel(KERNEL_PROJECT_CLOTH_CONSTRAINTS);
+			// project each of the 4 internal constraints
+			// bind predicted positions input/output
+			backend->bindBuffer(0, cloth->ssbo_pos_pred1);
+			backend->bindBuffer(1, cloth->ssbo_pos_pred2);
+			backend->setUniform(2, cloth->default_internal_K); // uniform K
+
+			for (int j = 0; j < cloth->numInternalConstraintBuffers; j++) {
+				// bind inner constraints
+				int numInnerConstraints = cloth->internalConstraints[j].size();
+				backend->setUniform(1, (int) cloth->internalConstraints[j].size());
+
+				backend->bindBuffer(2, cloth->ssbo_internalConstraints[j]);
+				// project this set of constraints
+				backend->dispatch(numInnerConstraints);
+				backend->barrier();
+
+			}
 		}
 
 		// project pin constraints
-		int numPinnedSSBOs = cloth->pinnedSSBOs.size();
-		for (int i = 0; i < numPinnedSSBOs; i++) {
-			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, cloth->pinnedSSBOs.at(i)); // init positions, not pred 1
-			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, cloth->ssbo_pos_pred2); // update this
-			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, cloth->ssbo_externalConstraints);
-			glUniform1i(1, cloth->externalConstraints.size());
-			glUniform1f(2, cloth->default_pin_K); // uniform K
-			glUniform1i(3, (int)cloth->pinnedSSBOs.at(i)); // send the identity of the influencing SSBO
-			glDispatchCompute(workGroupCountPinConstraints, 1, 1);
-			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		if (numPinConstraints > 0) {
+			backend->useKernel(KERNEL_PROJECT_PINS);
+			backend->bindBuffer(1, cloth->ssbo_pos_pred2); // update this
+			backend->bindBuffer(2, cloth->ssbo_pinTargets);
+			backend->setUniform(0, numPinConstraints);
+			backend->dispatch(numPinConstraints);
+			backend->barrier();
 		}
 
-		// ffwd pred1 to match pred2
-		glUseProgram(prog_copyBuffer); // TODO: lol... THIS IS DUMB DO SOMETHING BETTER
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, cloth->ssbo_pos_pred2);
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, cloth->ssbo_pos_pred1);
-		glDispatchCompute(workGroupCount_vertices, 1, 1);
-		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		// ffwd pred1 to match pred2. the colored solver only ever uses pred2
+		// and the csr solver swaps them instead
+		if (constraintSolver != SOLVER_CONSTRAINT_BUFFERS) continue;
+		backend->useKernel(KERNEL_COPY_BUFFER); // the buffers accumulate into pred2, so they still need this
+		backend->bindBuffer(0, cloth->ssbo_pos_pred2);
+		backend->bindBuffer(1, cloth->ssbo_pos_pred1);
+		backend->dispatch(numVertices);
+		backend->barrier();
 
 	}
-
-#if QUERY_PERFORMANCE
-	updateStat(PROJ_CONSTRAINTS);
-#endif
-
-#if QUERY_PERFORMANCE
-	glBeginQuery(GL_TIME_ELAPSED, time_query);
-#endif
+	profiler.endZone();
 
 	/* generate and resolve collision constraints */
+	profiler.beginZone("generate collisions");
 	for (int i = 0; i < numRigids; i++) {
 		genCollisionConstraints(cloth, rigids.at(i));
 	}
-
-#if QUERY_PERFORMANCE
-	updateStat(GENER_COLLISIONS);
-#endif
+	profiler.endZone();
 
 #if DEBUG_VERBOSE
 	cout << "init ";
@@ -321,21 +362,15 @@ void Simulation::stepSingleCloth(Cloth *cloth) {
 	retrieveBuffer(cloth->ssbo_pos_pred2, 1);
 #endif
 
-#if QUERY_PERFORMANCE
-	glBeginQuery(GL_TIME_ELAPSED, time_query);
-#endif
-
-	glUseProgram(prog_projectCollisionConstraints);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, cloth->ssbo_pos);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, cloth->ssbo_pos_pred2);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, cloth->ssbo_collisionConstraints);
-	glUniform1i(0, numVertices);
-	glDispatchCompute(workGroupCount_vertices, 1, 1);
-	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-
-#if QUERY_PERFORMANCE
-	updateStat(RESOL_COLLISIONS);
-#endif
+	profiler.beginZone("resolve collisions");
+	backend->useKernel(KERNEL_PROJECT_COLLISIONS);
+	backend->bindBuffer(0, cloth->ssbo_pos);
+	backend->bindBuffer(1, cloth->ssbo_pos_pred2);
+	backend->bindBuffer(2, cloth->ssbo_collisionConstraints);
+	backend->setUniform(0, numVertices);
+	backend->dispatch(numVertices);
+	backend->barrier();
+	profiler.endZone();
 
 #if DEBUG_VERBOSE
 	cout << "pred after ";
@@ -346,15 +381,15 @@ void Simulation::stepSingleCloth(Cloth *cloth) {
 	//retrieveBuffer(cloth->ssbo_collisionConstraints, 1);
 	/* update positions and velocities, reset collision constraints */
 
-	glUseProgram(prog_ppd7_updateVelPos);
-	glUniform1i(1, numVertices);
+	backend->useKernel(KERNEL_UPDATE_POSITIONS_VELOCITIES);
+	backend->setUniform(1, numVertices);
 
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, cloth->ssbo_vel);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, cloth->ssbo_pos);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, cloth->ssbo_pos_pred2);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, cloth->ssbo_collisionConstraints);
-	glDispatchCompute(workGroupCount_vertices, 1, 1);
-	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	backend->bindBuffer(0, cloth->ssbo_vel);
+	backend->bindBuffer(1, cloth->ssbo_pos);
+	backend->bindBuffer(2, cloth->ssbo_pos_pred2);
+	backend->bindBuffer(3, cloth->ssbo_collisionConstraints);
+	backend->dispatch(numVertices);
+	backend->barrier();
 
 #if DEBUG_VERBOSE
 	cout << "vel ";
@@ -363,82 +398,134 @@ void Simulation::stepSingleCloth(Cloth *cloth) {
 #endif
 }
 
-void Simulation::retrieveBuffer(GLuint ssbo, int numItems) {
-	// test getting something back from the GPU. can we even do this?!
-	GLint bufMask = GL_MAP_READ_BIT;
-	
-	std::vector<glm::vec4> positions;
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
-	glm::vec4 *constraintsMapped = (glm::vec4 *) glMapBufferRange(GL_SHADER_STORAGE_BUFFER,
-		0, numItems * sizeof(glm::vec4), bufMask);
-	for (int i = 0; i < numItems; i++) {
-		positions.push_back(glm::vec4(constraintsMapped[i]));
-	}
-	checkGLError("backcopy");
+void Simulation::retrieveBuffer(BufferHandle ssbo, int numItems) {
+	// test getting something back from the backend. can we even do this?!
+	std::vector<glm::vec4> positions(numItems);
+	backend->readBuffer(ssbo, numItems, &positions[0]);
  	for (int i = 0; i < numItems; i++) {
 		if (positions.at(i).w > 0.0001f && ((int)positions.at(i).w % 2 || positions.at(i).w > 2.0f))
 			cout << positions.at(i).x << " " << positions.at(i).y << " " << positions.at(i).z << " " << positions.at(i).w << endl;
 	}
-	glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+}
+
+Rbody *Simulation::findRbody(BufferHandle ssbo_pos) {
+	for (int i = 0; i < numRigids; i++) {
+		if (rigids.at(i)->ssbo_pos == ssbo_pos) return rigids.at(i);
+	}
+	return NULL;
 }
 
 void Simulation::animateRbody(Rbody *rbody) {
 	if (rbody->animated == false) return;
 	glm::mat4 tf = rbody->getTransformationAtTime(currentTime);
+	rbody->modelMatrix = tf;
+	if (localSpaceColliders) return; // nothing to rewrite, see genCollisionConstraints
 	int numVertices = rbody->initPositions.size();
-	int workGroupCount_vertices = (numVertices - 1) / WORK_GROUP_SIZE + 1;
 
-	glUseProgram(prog_rigidbodyAnimate);
-	glUniform1i(0, numVertices);
-	glUniformMatrix4fv(1, 1, GL_FALSE, &tf[0][0]);
+	backend->useKernel(KERNEL_RIGIDBODY_ANIMATE);
+	backend->setUniform(0, numVertices);
+	backend->setUniform(1, tf);
+
+	backend->bindBuffer(0, rbody->ssbo_initPos);
+	backend->bindBuffer(1, rbody->ssbo_pos);
+	backend->dispatch(numVertices);
+	if (rbody->ssbo_collisionPos != rbody->ssbo_pos) {
+		// the proxy moves too, it's what gets collided against
+		int numProxyVertices = rbody->proxy.positions.size();
+		backend->setUniform(0, numProxyVertices);
+		backend->bindBuffer(0, rbody->ssbo_collisionInitPos);
+		backend->bindBuffer(1, rbody->ssbo_collisionPos);
+		backend->dispatch(numProxyVertices);
+	}
+
+	// move the collision BVH along with the body
+	int numNodes = rbody->bvh.numNodes();
+	backend->useKernel(KERNEL_RIGIDBODY_REFIT_BVH);
+	backend->setUniform(0, numNodes);
+	backend->setUniform(1, tf);
 
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, rbody->ssbo_initPos);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, rbody->ssbo_pos);
-	glDispatchCompute(workGroupCount_vertices, 1, 1);
-	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	backend->bindBuffer(0, rbody->ssbo_bvhRestNodes);
+	backend->bindBuffer(1, rbody->ssbo_bvhNodes);
+	backend->dispatch(numNodes);
+	backend->barrier();
 }
 
 void Simulation::stepSimulation() {
+	TRACE_ZONE("frame");
 	frameCount++;
+	profiler.beginFrame();
+	profiler.beginZone("frame");
+	profiler.beginZone("animate bodies");
 	for (int i = 0; i < numRigids; i++) {
 		animateRbody(rigids.at(i));
 	}
-
-	for (int i = 0; i < numCloths; i++) {
-		stepSingleCloth(cloths.at(i));
+	profiler.endZone();
+
+	bool useBatch = batchCloths && numCloths > 1 &&
+		constraintSolver != SOLVER_CONSTRAINT_BUFFERS;
+	if (useBatch) {
+		if (batch == NULL) batch = new ClothBatch(backend, cloths);
+		batch->packPins();
+		batch->uploadParameters();
+		stepSingleCloth(batch);
+	} else {
+		if (batch) {
+			// hand the state back to the cloths' own buffers
+			batch->unpack();
+			delete batch;
+			batch = NULL;
+		}
+		for (int i = 0; i < numCloths; i++) {
+			cloths.at(i)->uploadParameters();
+			stepSingleCloth(cloths.at(i));
+		}
 	}
 	currentTime += timeStep;
+	profiler.endZone();
+	profiler.endFrame();
+}
+
+void Simulation::setProfiling(bool enabled) {
+	if (!enabled) profiler.flush();
+	profiler.enabled = enabled;
+	backend->profiler = enabled ? &profiler : NULL;
+}
 
-#if QUERY_PERFORMANCE
-	// report performance every 600 frames
-	if (frameCount % 600 == 0) {
-		cout << "performance as of frame " << frameCount << endl;
-		cout << "average times (microseconds)" << endl;
-		cout << "solving internal constraints:     " <<
-			(float)timeStagesAVG[PROJ_CONSTRAINTS] / 1000.0f << endl;
-		cout << "generating collision constraints: " <<
-			(float)timeStagesAVG[GENER_COLLISIONS] / 1000.0f << endl;
-		cout << "resolving collision constraints:  " <<
-			(float)timeStagesAVG[RESOL_COLLISIONS] / 1000.0f << endl;
-
-		cout << "max times (microseconds)" << endl;
-		cout << "solving internal constraints:     " <<
-			(float)timeStagesMax[PROJ_CONSTRAINTS] / 1000.0f << endl;
-		cout << "generating collision constraints: " <<
-			(float)timeStagesMax[GENER_COLLISIONS] / 1000.0f << endl;
-		cout << "resolving collision constraints:  " <<
-			(float)timeStagesMax[RESOL_COLLISIONS] / 1000.0f << endl;
-
-		cout << "min times (microseconds)" << endl;
-		cout << "solving internal constraints:     " <<
-			(float)timeStagesMin[PROJ_CONSTRAINTS] / 1000.0f << endl;
-		cout << "generating collision constraints: " <<
-			(float)timeStagesMin[GENER_COLLISIONS] / 1000.0f << endl;
-		cout << "resolving collision constraints:  " <<
-			(float)timeStagesMin[RESOL_COLLISIONS] / 1000.0f << endl;
+void Simulation::stepSimulation(int numFrames) {
+	for (int i = 0; i < numFrames; i++) {
+		stepSimulation();
 	}
-#endif
+}
 
+void Simulation::readClothPositions(int clothIndex, vector<glm::vec4> &positions) {
+	Cloth *cloth = cloths.at(clothIndex);
+	positions.resize(cloth->initPositions.size());
+	if (positions.empty()) return;
+	int firstVertex;
+	BufferHandle buffer = clothPositions(clothIndex, firstVertex);
+	backend->readBufferRange(buffer, firstVertex, positions.size(), &positions[0]);
+}
+
+BufferHandle Simulation::clothPositions(int clothIndex, int &firstVertex) {
+	if (batch) {
+		firstVertex = batch->firstVertex.at(clothIndex);
+		return batch->ssbo_pos;
+	}
+	firstVertex = 0;
+	return cloths.at(clothIndex)->ssbo_pos;
+}
+
+void Simulation::readRigidPositions(int rigidIndex, vector<glm::vec4> &positions) {
+	Rbody *rbody = rigids.at(rigidIndex);
+	positions.resize(rbody->initPositions.size());
+	if (positions.empty()) return;
+	if (localSpaceColliders) {
+		for (int i = 0; i < (int)positions.size(); i++) {
+			positions[i] = rbody->modelMatrix * rbody->initPositions[i];
+		}
+		return;
+	}
+	backend->readBuffer(rbody->ssbo_pos, positions.size(), &positions[0]);
 }
 
 void Simulation::selectByRaycast(glm::vec3 eye, glm::vec3 dir) {
@@ -2,28 +2,57 @@
 #include <vector>
 #include "mesh.hpp"
 #include "cloth.hpp"
+#include "clothBatch.hpp"
 #include "rbody.hpp"
-#include "glslUtility.hpp"
+#include "backend.hpp"
+#include "profiler.hpp"
 
 using namespace std;
 
+// keep rigidbodies (and their BVHs) in their rest pose and bring cloth
+// positions into each body's space for collision queries instead of
+// rewriting every body vertex each frame. 0 animates bodies in world space.
+#define LOCAL_SPACE_COLLIDERS 1
+
+// step all cloths as one packed batch (see clothBatch.hpp): one dispatch per
+// stage for the whole scene instead of one per cloth. not used with the
+// constraint buffer solver. 0 steps every cloth on its own.
+#define BATCH_CLOTHS 1
+
+// run external forces, damping and position prediction as one kernel that
+// touches every velocity once. 0 runs them as three separate stages.
+#define FUSED_INTEGRATION 1
+
+// collide against signed distance fields baked around each rigidbody's rest
+// pose (one trilinear lookup per vertex) instead of walking its BVH.
+// fields are cached next to the meshes as <mesh>.obj.sdf.
+#define SDF_COLLIDERS 0
+
+// collide against simplified proxies of the rigidbodies' meshes (see
+// proxy.hpp) while still drawing the full ones: down to PROXY_TRIANGLES
+// each, as long as the surface moves no more than PROXY_TOLERANCE.
+// proxies are cached next to the meshes as <mesh>.obj.proxy.
+#define COLLISION_PROXIES 0
+
+// keep a list per cloth vertex of the collider triangles within
+// COLLISION_SKIN of it, and only walk a body's BVH again for vertices that
+// have moved out of theirs (see cloth_genCollisionsCandidates.comp.glsl).
+// local space colliders only: the lists hold on to the body's rest pose.
+#define COLLISION_CANDIDATES 1
+#define COLLISION_SKIN 0.05f
+
 class Simulation
 {
 private:
-	GLuint time_query;
-	GLuint64 elapsed_time;
-	GLuint64 frameCount;
-	GLuint64 timeStagesTotal[3]; // ns
-	float timeStagesAVG[3]; // ns
-	GLuint64 timeStagesMin[3]; // ns
-	GLuint64 timeStagesMax[3]; // ns
-
-	void updateStat(int stat);
+	unsigned long long frameCount = 0;
 
 public:
-	Simulation(vector<string> &body_filenames, vector<string> &cloth_filenames);
+	Simulation(Backend *backend, vector<string> &body_filenames, vector<string> &cloth_filenames);
 	~Simulation();
 
+	Backend *backend; // owns all buffers and runs all the compute stages
+	Profiler profiler; // see setProfiling
+
 	vector<Rbody*> rigids;
 	vector<Cloth*> cloths;
 	int numRigids;
@@ -35,29 +64,44 @@ public:
 	glm::vec3 Gravity = glm::vec3(0.0f, 0.0f, -0.98f);
 
 	float collisionBounceFactor = 0.2f;
-
-	GLuint prog_ppd1_externalForces;
-	GLuint prog_ppd2_dampVelocity;
-	GLuint prog_ppd3_predictPositions;
-	GLuint prog_ppd4_updateInvMass; // updates inverse masses for pinned vertices
-
-	GLuint prog_ppd6_projectClothConstraints;
-	GLuint prog_ppd7_updateVelPos;
-	GLuint prog_copyBuffer; // TODO: lol
-	
-	GLuint prog_genCollisionConstraints;
-	GLuint prog_projectCollisionConstraints;
-
-	GLuint prog_rigidbodyAnimate;
+	bool localSpaceColliders = LOCAL_SPACE_COLLIDERS;
+	int constraintSolver = CONSTRAINT_SOLVER; // see cloth.hpp
+	bool fusedIntegration = FUSED_INTEGRATION;
+	bool batchCloths = BATCH_CLOTHS;
+	ClothBatch *batch = NULL; // packed copy of cloths while batching
+	bool sdfColliders = false; // see enableSDFColliders
+	int sdfResolution = SDF_RESOLUTION;
+	bool collisionProxies = false; // see enableCollisionProxies
+	int proxyTriangles = PROXY_TRIANGLES;
+	float proxyTolerance = PROXY_TOLERANCE;
+	bool collisionCandidates = COLLISION_CANDIDATES;
+	float collisionSkin = COLLISION_SKIN; // lists made before changing it keep their old reach
 
 	void initComputeProgs();
 	void genCollisionConstraints(Cloth *cloth, Rbody *rbody);
+	void genCollisionConstraintsSDF(Cloth *cloth, Rbody *rbody);
+	void genCollisionConstraintsPrimitive(Cloth *cloth, Rbody *rbody); // bodies with a primitive, see primitive.hpp
+	BufferHandle candidateLists(Cloth *cloth, Rbody *rbody); // made empty the first time it's asked for
+	void enableSDFColliders(); // bakes (or loads) every rigidbody's SDF
+	void enableCollisionProxies(); // simplifies (or loads) every rigidbody's proxy. before the SDFs, or they get rebaked
+	void gatherPinTargets(Cloth *cloth);
 	void stepSingleCloth(Cloth *cloth);
 	void stepSimulation();
+	void stepSimulation(int numFrames); // for batch runs, no drawing in between
+	// time every stage and dispatch from now on. costs a few timestamps per
+	// dispatch but never waits on the backend. see profiler.hpp
+	void setProfiling(bool enabled);
+
+	// read back the current positions of a cloth (x, y, z, inverse mass)
+	void readClothPositions(int clothIndex, vector<glm::vec4> &positions);
+	// the buffer currently holding a cloth's positions, and where they start
+	BufferHandle clothPositions(int clothIndex, int &firstVertex);
+	void readRigidPositions(int rigidIndex, vector<glm::vec4> &positions);
 
 	void animateRbody(Rbody *rbody);
+	Rbody *findRbody(BufferHandle ssbo_pos); // NULL if it's not a rigidbody's
 
 	void selectByRaycast(glm::vec3 eye, glm::vec3 dir);
 
-	void retrieveBuffer(GLuint ssbo, int numItems);
-};
\ No newline at end of file
+	void retrieveBuffer(BufferHandle ssbo, int numItems);
+};
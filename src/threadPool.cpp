@@ -0,0 +1,91 @@
+#include "threadPool.hpp"
+#include "tracer.hpp"
+
+ThreadPool::ThreadPool(int numThreads) {
+	if (numThreads < 1) {
+		numThreads = (int)std::thread::hardware_concurrency();
+		if (numThreads < 1) numThreads = 1;
+	}
+	this->numThreads = numThreads;
+	nextChunk = 0;
+
+	// the calling thread counts as one of the workers
+	for (int i = 1; i < numThreads; i++) {
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		quit = true;
+	}
+	wake.notify_all();
+	for (int i = 0; i < (int)workers.size(); i++) {
+		workers.at(i).join();
+	}
+}
+
+void ThreadPool::runChunks() {
+	// grab chunks until the range is used up
+	while (true) {
+		int begin = nextChunk.fetch_add(jobChunkSize);
+		if (begin >= jobCount) return;
+		int end = begin + jobChunkSize;
+		if (end > jobCount) end = jobCount;
+		TRACE_ZONE("chunk");
+		(*job)(begin, end);
+	}
+}
+
+void ThreadPool::workerLoop() {
+	unsigned int seenGeneration = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			while (!quit && generation == seenGeneration) {
+				wake.wait(guard);
+			}
+			if (quit) return;
+			seenGeneration = generation;
+		}
+
+		runChunks();
+
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			busyWorkers--;
+			if (busyWorkers == 0) done.notify_one();
+		}
+	}
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int, int)> &body) {
+	if (count <= 0) return;
+	if (workers.size() == 0 || count < minParallelCount) {
+		body(0, count);
+		return;
+	}
+
+	// a few chunks per thread so uneven work (ex: collision checks) balances out
+	int chunkSize = (count - 1) / (numThreads * 4) + 1;
+
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		job = &body;
+		jobCount = count;
+		jobChunkSize = chunkSize;
+		nextChunk = 0;
+		busyWorkers = workers.size();
+		generation++;
+	}
+	wake.notify_all();
+
+	runChunks();
+
+	std::unique_lock<std::mutex> guard(lock);
+	while (busyWorkers > 0) {
+		done.wait(guard);
+	}
+	job = NULL;
+}
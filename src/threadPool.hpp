@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// a small persistent pool of worker threads for the CPU solver.
+// parallelFor hands out contiguous [begin, end) chunks of an index range so
+// each thread streams through its own slice of the structure-of-arrays data.
+// the calling thread also works on chunks and returns once all are done.
+
+class ThreadPool
+{
+public:
+	ThreadPool(int numThreads = 0); // 0 -> one thread per hardware thread
+	~ThreadPool();
+
+	int numThreads; // including the calling thread
+
+	void parallelFor(int count, const std::function<void(int, int)> &body);
+
+	// ranges smaller than this just run on the calling thread
+	int minParallelCount = 256;
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	// current job
+	const std::function<void(int, int)> *job = NULL;
+	int jobCount = 0;
+	int jobChunkSize = 0;
+	std::atomic<int> nextChunk;
+	int busyWorkers = 0;
+	unsigned int generation = 0;
+	bool quit = false;
+
+	void workerLoop();
+	void runChunks();
+};
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include "topology.hpp"
+#include "threadPool.hpp"
+#include "tracer.hpp"
+
+void topology::forChunks(ThreadPool *pool, int count, const std::function<void(int, int)> &body) {
+	int numChunks = (count + TOPOLOGY_CHUNK_ITEMS - 1) / TOPOLOGY_CHUNK_ITEMS;
+	std::function<void(int, int)> chunks = [&](int first, int last) {
+		for (int c = first; c < last; c++) {
+			body(c * TOPOLOGY_CHUNK_ITEMS, std::min(count, (c + 1) * TOPOLOGY_CHUNK_ITEMS));
+		}
+	};
+	if (pool && numChunks > 1) pool->parallelFor(numChunks, chunks);
+	else chunks(0, numChunks);
+}
+
+void topology::radixSort(std::vector<unsigned long long> &keys, std::vector<int> &values, int keyBits, ThreadPool *pool) {
+	TRACE_ZONE("radix sort");
+	// as few passes as TOPOLOGY_RADIX_BITS allows, with the bits spread evenly
+	// over them: fewer buckets are easier on the cache
+	int numPasses = (keyBits + TOPOLOGY_RADIX_BITS - 1) / TOPOLOGY_RADIX_BITS;
+	int digitBits = numPasses > 0 ? (keyBits + numPasses - 1) / numPasses : 0;
+	int numBuckets = 1 << digitBits;
+	int count = keys.size();
+	int numChunks = (count + TOPOLOGY_CHUNK_ITEMS - 1) / TOPOLOGY_CHUNK_ITEMS;
+	std::vector<unsigned long long> keysOut(count);
+	std::vector<int> valuesOut(count);
+	std::vector<int> offsets(numChunks * numBuckets);
+
+	for (int shift = 0; shift < keyBits; shift += digitBits) {
+		// how many of each digit every chunk has
+		std::fill(offsets.begin(), offsets.end(), 0);
+		forChunks(pool, count, [&](int begin, int end) {
+			int *histogram = &offsets[begin / TOPOLOGY_CHUNK_ITEMS * numBuckets];
+			for (int i = begin; i < end; i++) {
+				histogram[(keys[i] >> shift) & (numBuckets - 1)]++;
+			}
+		});
+
+		// where each chunk's run of each digit starts: digits in order, and
+		// chunks in order inside a digit, so equal digits keep their order
+		int total = 0;
+		bool sorted = false;
+		for (int d = 0; d < numBuckets; d++) {
+			for (int c = 0; c < numChunks; c++) {
+				int n = offsets[c * numBuckets + d];
+				if (n == count) sorted = true; // everything has this digit
+				offsets[c * numBuckets + d] = total;
+				total += n;
+			}
+		}
+		if (sorted) continue;
+
+		forChunks(pool, count, [&](int begin, int end) {
+			int *next = &offsets[begin / TOPOLOGY_CHUNK_ITEMS * numBuckets];
+			for (int i = begin; i < end; i++) {
+				int to = next[(keys[i] >> shift) & (numBuckets - 1)]++;
+				keysOut[to] = keys[i];
+				valuesOut[to] = values[i];
+			}
+		});
+		keys.swap(keysOut);
+		values.swap(valuesOut);
+	}
+}
+
+static int bitsFor(int count) {
+	int bits = 1;
+	while (bits < 31 && (1 << bits) < count) bits++;
+	return bits;
+}
+
+void topology::buildAdjacency(int numVertices, const std::vector<glm::ivec4> &quads, bool quadDiagonals,
+	const std::vector<glm::ivec3> &polygonTris, std::vector<int> &rowStart, std::vector<int> &neighbors,
+	ThreadPool *pool) {
+	TRACE_ZONE("build adjacency");
+	int vertexBits = bitsFor(numVertices);
+	unsigned long long vertexMask = (1ULL << vertexBits) - 1;
+
+	// 1. every edge as (low vertex, high vertex), in face order. the low
+	// vertex goes in the low bits, since it's the part that gets sorted on
+	int edgesPerQuad = quadDiagonals ? 6 : 4;
+	int numQuads = quads.size();
+	int numPolygonTris = polygonTris.size();
+	int numEdges = numQuads * edgesPerQuad + numPolygonTris * 3;
+	std::vector<unsigned long long> edges(numEdges);
+	forChunks(pool, numQuads, [&](int begin, int end) {
+		static const int quadEdges[6][2] = { { 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 0 }, { 0, 2 }, { 1, 3 } };
+		for (int q = begin; q < end; q++) {
+			for (int e = 0; e < edgesPerQuad; e++) {
+				unsigned long long a = quads[q][quadEdges[e][0]];
+				unsigned long long b = quads[q][quadEdges[e][1]];
+				edges[q * edgesPerQuad + e] = a < b ? a | (b << vertexBits) : b | (a << vertexBits);
+			}
+		}
+	});
+	forChunks(pool, numPolygonTris, [&](int begin, int end) {
+		for (int t = begin; t < end; t++) {
+			for (int e = 0; e < 3; e++) {
+				unsigned long long a = polygonTris[t][e];
+				unsigned long long b = polygonTris[t][(e + 1) % 3];
+				edges[numQuads * edgesPerQuad + t * 3 + e] = a < b ? a | (b << vertexBits) : b | (a << vertexBits);
+			}
+		}
+	});
+
+	// 2. sorted on the low vertex, repeats of an edge end up in the same
+	// (short) run, still in face order. the first of each is the one to keep.
+	std::vector<unsigned long long> sortedEdges(edges);
+	std::vector<int> order(numEdges);
+	for (int i = 0; i < numEdges; i++) order[i] = i;
+	radixSort(sortedEdges, order, vertexBits, pool);
+	std::vector<char> keep(numEdges, 0);
+	forChunks(pool, numEdges, [&](int begin, int end) {
+		std::vector<std::pair<unsigned long long, int> > longRun;
+		for (int first = begin; first < end; first++) {
+			// runs belong to the chunk they start in
+			unsigned long long low = sortedEdges[first] & vertexMask;
+			if (first > 0 && (sortedEdges[first - 1] & vertexMask) == low) continue;
+			int last = first + 1;
+			while (last < numEdges && (sortedEdges[last] & vertexMask) == low) last++;
+
+			if (last - first <= TOPOLOGY_SHORT_RUN) {
+				for (int i = first; i < last; i++) {
+					unsigned long long edge = sortedEdges[i];
+					if ((edge >> vertexBits) == low) continue; // degenerate
+					int j = first;
+					while (j < i && sortedEdges[j] != edge) j++;
+					if (j == i) keep[order[i]] = 1;
+				}
+			} else {
+				// a vertex on a lot of faces (the middle of a fan): sort its run
+				longRun.clear();
+				for (int i = first; i < last; i++) longRun.push_back(std::make_pair(sortedEdges[i], order[i]));
+				std::sort(longRun.begin(), longRun.end());
+				for (int i = 0; i < (int)longRun.size(); i++) {
+					if ((longRun[i].first >> vertexBits) == low) continue;
+					if (i > 0 && longRun[i - 1].first == longRun[i].first) continue;
+					keep[longRun[i].second] = 1;
+				}
+			}
+		}
+	});
+	sortedEdges.clear();
+	sortedEdges.shrink_to_fit();
+	order.clear();
+	order.shrink_to_fit();
+
+	// kept edges packed down in face order, each chunk after the ones before it
+	int numChunks = (numEdges + TOPOLOGY_CHUNK_ITEMS - 1) / TOPOLOGY_CHUNK_ITEMS;
+	std::vector<int> chunkStart(numChunks + 1, 0);
+	forChunks(pool, numEdges, [&](int begin, int end) {
+		int kept = 0;
+		for (int i = begin; i < end; i++) kept += keep[i];
+		chunkStart[begin / TOPOLOGY_CHUNK_ITEMS + 1] = kept;
+	});
+	for (int c = 0; c < numChunks; c++) chunkStart[c + 1] += chunkStart[c];
+	int numUnique = chunkStart[numChunks];
+
+	// 3. both directions of each, sorted on the vertex they start from. a
+	// vertex's neighbors stay in the order their edges were kept in.
+	std::vector<unsigned long long> from(2 * numUnique);
+	neighbors.resize(2 * numUnique);
+	forChunks(pool, numEdges, [&](int begin, int end) {
+		int next = chunkStart[begin / TOPOLOGY_CHUNK_ITEMS];
+		for (int i = begin; i < end; i++) {
+			if (!keep[i]) continue;
+			int a = (int)(edges[i] & vertexMask);
+			int b = (int)(edges[i] >> vertexBits);
+			from[2 * next] = a;
+			neighbors[2 * next] = b;
+			from[2 * next + 1] = b;
+			neighbors[2 * next + 1] = a;
+			next++;
+		}
+	});
+	edges.clear();
+	edges.shrink_to_fit();
+	radixSort(from, neighbors, vertexBits, pool);
+
+	// rows start where their vertex first shows up. vertices without
+	// neighbors get an empty row where theirs would have been.
+	int numEntries = from.size();
+	rowStart.resize(numVertices + 1);
+	forChunks(pool, numEntries, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			int previous = i > 0 ? (int)from[i - 1] : -1;
+			for (int v = previous + 1; v <= (int)from[i]; v++) rowStart[v] = i;
+		}
+	});
+	int last = numEntries > 0 ? (int)from[numEntries - 1] : -1;
+	for (int v = last + 1; v <= numVertices; v++) rowStart[v] = numEntries;
+}
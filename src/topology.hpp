@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <glm/glm.hpp>
+
+// cloth constraint topology from faces, in a few linear passes that split
+// into chunks over a thread pool once the mesh is big enough:
+//   1. every face writes out its edges: quad sides (and diagonals), then the
+//      sides of the triangles of faces that weren't quads
+//   2. a radix sort on the lower vertex of every edge puts repeats of an edge
+//      in the same short run. the first of each is kept, in face order
+//   3. both directions of every kept edge, radix sorted on their vertex, are
+//      the compressed sparse rows
+// every vertex's neighbors come out in the order their edge was first seen,
+// the order Cloth used to find them in one face at a time, so the rows and
+// constraint buffers built from them are the same as they always were.
+
+#define TOPOLOGY_PARALLEL_MIN_EDGES (1 << 18) // fewer edges than this stay on one thread
+#define TOPOLOGY_CHUNK_ITEMS (1 << 16) // edges or vertices per parallel chunk
+#define TOPOLOGY_RADIX_BITS 11 // bits sorted per pass
+#define TOPOLOGY_SHORT_RUN 32 // longer runs of edges from one vertex get sorted to find repeats
+
+class ThreadPool;
+
+namespace topology {
+// stable LSD radix sort of keys, and values along with them, on the low
+// keyBits bits of the keys. pool may be NULL.
+void radixSort(std::vector<unsigned long long> &keys, std::vector<int> &values, int keyBits, ThreadPool *pool);
+
+// vertex v's neighbors are neighbors[rowStart[v], rowStart[v + 1]), so
+// rowStart has numVertices + 1 entries. edges from a vertex to itself
+// (degenerate faces) are dropped. pool may be NULL.
+void buildAdjacency(int numVertices, const std::vector<glm::ivec4> &quads, bool quadDiagonals,
+	const std::vector<glm::ivec3> &polygonTris, std::vector<int> &rowStart, std::vector<int> &neighbors,
+	ThreadPool *pool);
+
+// runs body(begin, end) over [0, count) in TOPOLOGY_CHUNK_ITEMS chunks, on
+// the pool if there is one
+void forChunks(ThreadPool *pool, int count, const std::function<void(int, int)> &body);
+}
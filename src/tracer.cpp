@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <cstring>
+#include <cerrno>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "tracer.hpp"
+
+using namespace std;
+
+static const char *counterNames[NUM_TRACE_COUNTERS] = {
+	"cycles",
+	"instructions",
+	"cache misses"
+};
+
+// everything one thread has recorded
+struct ThreadTrace
+{
+	int tid;
+	vector<TraceEvent> events;
+	int numDropped = 0;
+	int counterGroup = -1; // perf_event group leader, -1 if not open
+};
+
+static atomic<bool> tracing(false);
+static atomic<bool> countersWanted(false);
+static atomic<bool> countersFailed(false);
+static mutex threadsLock;
+static vector<unique_ptr<ThreadTrace> > threads;
+static thread_local ThreadTrace *thisThread = NULL;
+
+static ThreadTrace *threadTrace() {
+	if (thisThread == NULL) {
+		lock_guard<mutex> guard(threadsLock);
+		thisThread = new ThreadTrace();
+		thisThread->tid = threads.size();
+		threads.push_back(unique_ptr<ThreadTrace>(thisThread));
+	}
+	return thisThread;
+}
+
+/******************************************************************************
+ hardware counters
+******************************************************************************/
+
+#ifdef __linux__
+static int openCounter(unsigned long long config, int group) {
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config;
+	attr.read_format = PERF_FORMAT_GROUP;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.disabled = group < 0 ? 1 : 0; // the leader starts the whole group
+	// this thread, any cpu
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+static bool openCounters(ThreadTrace *thread) {
+	static const unsigned long long configs[NUM_TRACE_COUNTERS] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES
+	};
+	int group = -1;
+	for (int i = 0; i < NUM_TRACE_COUNTERS; i++) {
+		int fd = openCounter(configs[i], group);
+		if (fd < 0) {
+			if (!countersFailed.exchange(true)) {
+				cout << "tracer: perf counters unavailable (" << strerror(errno) << "), timing only" << endl;
+			}
+			if (group >= 0) close(group); // closes the rest of the group with it
+			return false;
+		}
+		if (group < 0) group = fd;
+	}
+	ioctl(group, PERF_EVENT_IOC_ENABLE, 0);
+	thread->counterGroup = group;
+	return true;
+}
+
+static bool readCounters(ThreadTrace *thread, long long *values) {
+	if (!countersWanted.load(memory_order_relaxed) || countersFailed.load(memory_order_relaxed)) return false;
+	if (thread->counterGroup < 0 && !openCounters(thread)) return false;
+	unsigned long long data[1 + NUM_TRACE_COUNTERS]; // count, then one value per counter
+	if (read(thread->counterGroup, data, sizeof(data)) != sizeof(data)) return false;
+	for (int i = 0; i < NUM_TRACE_COUNTERS; i++) {
+		values[i] = (long long)data[1 + i];
+	}
+	return true;
+}
+#else
+static bool readCounters(ThreadTrace *thread, long long *values) {
+	if (countersWanted.load(memory_order_relaxed) && !countersFailed.exchange(true)) {
+		cout << "tracer: perf counters are only supported on linux, timing only" << endl;
+	}
+	return false;
+}
+#endif
+
+/******************************************************************************
+ zones
+******************************************************************************/
+
+TraceZone::TraceZone(const char *label) {
+	active = tracing.load(memory_order_relaxed);
+	if (!active) return;
+	this->label = label;
+	if (!readCounters(threadTrace(), counters)) counters[0] = -1;
+	start = Tracer::now(); // last, so reading the counters isn't timed
+}
+
+TraceZone::~TraceZone() {
+	if (!active) return;
+	unsigned long long end = Tracer::now();
+	ThreadTrace *thread = threadTrace();
+
+	TraceEvent event;
+	event.label = label;
+	event.pid = TRACE_PID_HOST;
+	event.tid = thread->tid;
+	event.frame = -1;
+	event.start = start;
+	event.duration = end - start;
+	long long endCounters[NUM_TRACE_COUNTERS];
+	bool counted = counters[0] >= 0 && readCounters(thread, endCounters);
+	for (int i = 0; i < NUM_TRACE_COUNTERS; i++) {
+		event.counters[i] = counted ? endCounters[i] - counters[i] : -1;
+	}
+
+	if (thread->events.size() < TRACER_MAX_EVENTS) {
+		thread->events.push_back(event);
+	} else {
+		thread->numDropped++;
+	}
+}
+
+/******************************************************************************
+ tracer
+******************************************************************************/
+
+void Tracer::enable(bool perfCounters) {
+	countersWanted = perfCounters;
+	tracing = true;
+}
+
+void Tracer::disable() {
+	tracing = false;
+}
+
+bool Tracer::isEnabled() {
+	return tracing;
+}
+
+void Tracer::clear() {
+	lock_guard<mutex> guard(threadsLock);
+	for (int i = 0; i < (int)threads.size(); i++) {
+		threads[i]->events.clear();
+		threads[i]->numDropped = 0;
+	}
+}
+
+unsigned long long Tracer::now() {
+	chrono::steady_clock::duration now = chrono::steady_clock::now().time_since_epoch();
+	return chrono::duration_cast<chrono::nanoseconds>(now).count();
+}
+
+void Tracer::collectEvents(vector<TraceEvent> &events) {
+	lock_guard<mutex> guard(threadsLock);
+	for (int i = 0; i < (int)threads.size(); i++) {
+		events.insert(events.end(), threads[i]->events.begin(), threads[i]->events.end());
+	}
+}
+
+void Tracer::report(ostream &out) {
+	vector<TraceEvent> events;
+	collectEvents(events);
+	int numDropped = 0;
+	{
+		lock_guard<mutex> guard(threadsLock);
+		for (int i = 0; i < (int)threads.size(); i++) numDropped += threads[i]->numDropped;
+	}
+
+	out << "host zones:       " << events.size();
+	if (numDropped > 0) out << " (" << numDropped << " dropped)";
+	out << endl;
+	if (events.empty()) return;
+
+	// microseconds and counter totals per label
+	map<string, vector<float> > times;
+	map<string, vector<long long> > totals;
+	map<string, int> numCounted;
+	for (int i = 0; i < (int)events.size(); i++) {
+		TraceEvent &event = events[i];
+		times[event.label].push_back(event.duration / 1000.0f);
+		vector<long long> &total = totals[event.label];
+		total.resize(NUM_TRACE_COUNTERS, 0);
+		if (event.counters[0] < 0) continue;
+		numCounted[event.label]++;
+		for (int c = 0; c < NUM_TRACE_COUNTERS; c++) total[c] += event.counters[c];
+	}
+	bool anyCounted = !numCounted.empty();
+
+	out << "times in microseconds" << (anyCounted ? ", counters are means per zone" : "") << endl;
+	out << left << setw(32) << "zone" << right << setw(8) << "count" << setw(12) << "total" <<
+		setw(10) << "mean" << setw(10) << "p50" << setw(10) << "p95" << setw(10) << "p99";
+	if (anyCounted) out << setw(14) << "instructions" << setw(14) << "cache misses" << setw(8) << "ipc";
+	out << endl;
+
+	map<string, vector<float> >::iterator it;
+	for (it = times.begin(); it != times.end(); it++) {
+		vector<float> sorted = it->second;
+		std::sort(sorted.begin(), sorted.end());
+		double total = 0.0;
+		for (int i = 0; i < (int)sorted.size(); i++) total += sorted[i];
+		out << left << setw(32) << it->first << right << setw(8) << sorted.size() << fixed << setprecision(1) <<
+			setw(12) << total << setw(10) << total / sorted.size() << setw(10) << tracePercentile(sorted, 50.0f) <<
+			setw(10) << tracePercentile(sorted, 95.0f) << setw(10) << tracePercentile(sorted, 99.0f);
+		int counted = numCounted.count(it->first) ? numCounted[it->first] : 0;
+		if (counted > 0) {
+			vector<long long> &counters = totals[it->first];
+			out << setprecision(0) << setw(14) << (double)counters[COUNTER_INSTRUCTIONS] / counted <<
+				setw(14) << (double)counters[COUNTER_CACHE_MISSES] / counted << setprecision(2) << setw(8) <<
+				(counters[COUNTER_CYCLES] > 0 ? (double)counters[COUNTER_INSTRUCTIONS] / counters[COUNTER_CYCLES] : 0.0);
+		}
+		out << endl;
+		out.unsetf(ios::fixed);
+	}
+}
+
+bool Tracer::writeChromeTrace(const string &path) {
+	vector<TraceEvent> events;
+	collectEvents(events);
+	map<int, string> processNames;
+	processNames[TRACE_PID_HOST] = "host";
+	return ::writeChromeTrace(path, events, processNames);
+}
+
+/******************************************************************************
+ shared
+******************************************************************************/
+
+float tracePercentile(const vector<float> &sorted, float p) {
+	int rank = (int)(p / 100.0f * sorted.size() + 0.5f);
+	rank = std::min(std::max(rank, 1), (int)sorted.size());
+	return sorted[rank - 1];
+}
+
+bool writeChromeTrace(const string &path, const vector<TraceEvent> &events,
+	const map<int, string> &processNames) {
+	ofstream out(path.c_str());
+	if (!out.is_open()) return false;
+
+	unsigned long long origin = 0;
+	for (int i = 0; i < (int)events.size(); i++) {
+		if (i == 0 || events[i].start < origin) origin = events[i].start;
+	}
+
+	// complete ("X") events in microseconds, after one name per process
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	map<int, string>::const_iterator it;
+	for (it = processNames.begin(); it != processNames.end(); it++) {
+		out << (first ? "" : ",") << endl << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << it->first <<
+			",\"tid\":0,\"args\":{\"name\":\"" << it->second << "\"}}";
+		first = false;
+	}
+	out << fixed << setprecision(3);
+	for (int i = 0; i < (int)events.size(); i++) {
+		const TraceEvent &event = events[i];
+		out << (first ? "" : ",") << endl << "{\"name\":\"" << event.label << "\",\"ph\":\"X\",\"pid\":" <<
+			event.pid << ",\"tid\":" << event.tid << ",\"ts\":" << (event.start - origin) / 1000.0 <<
+			",\"dur\":" << event.duration / 1000.0 << ",\"args\":{";
+		bool firstArg = true;
+		if (event.frame >= 0) {
+			out << "\"frame\":" << event.frame;
+			firstArg = false;
+		}
+		for (int c = 0; c < NUM_TRACE_COUNTERS; c++) {
+			if (event.counters[c] < 0) continue;
+			out << (firstArg ? "" : ",") << "\"" << counterNames[c] << "\":" << event.counters[c];
+			firstArg = false;
+		}
+		out << "}}";
+		first = false;
+	}
+	out << endl << "]}" << endl;
+	return (bool)out;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <string>
+#include <ostream>
+
+// scoped timing zones for host work: mesh loading, constraint building,
+// uploads, shader compilation and the CPU backend's kernels.
+//   void Cloth::generateConstraints() {
+//     TRACE_ZONE("generate constraints");
+// every thread records into its own buffer, so zones cost two clock reads
+// and a push_back while tracing and one flag check when it's off.
+// optionally each zone also reads hardware counters through perf_event
+// (linux only): cycles, instructions and cache misses.
+// zones come out in the same chrome trace format as the GPU profiler, and
+// Profiler::writeChromeTrace puts both on one timeline.
+
+// 0 compiles every TRACE_ZONE out
+#define HOST_TRACING 1
+
+#define TRACER_MAX_EVENTS 1000000 // per thread. later zones are counted, not kept
+
+enum TraceCounter {
+	COUNTER_CYCLES,
+	COUNTER_INSTRUCTIONS,
+	COUNTER_CACHE_MISSES,
+	NUM_TRACE_COUNTERS
+};
+
+// one finished zone, host or GPU
+struct TraceEvent
+{
+	const char *label;
+	int pid; // TRACE_PID_*
+	int tid;
+	long long frame; // -1 if it isn't part of a frame
+	unsigned long long start; // ns, Tracer::now's clock
+	unsigned long long duration;
+	long long counters[NUM_TRACE_COUNTERS]; // -1 if not measured
+};
+
+#define TRACE_PID_GPU 0
+#define TRACE_PID_HOST 1
+
+class Tracer
+{
+public:
+	// counters fall back to off (with a message) if perf_event isn't usable,
+	// ex: in containers or with kernel.perf_event_paranoid > 2
+	static void enable(bool perfCounters = false);
+	static void disable();
+	static bool isEnabled();
+	static void clear();
+
+	static unsigned long long now(); // ns, steady clock
+
+	// these read every thread's buffer: only call while no zones are open
+	static void collectEvents(std::vector<TraceEvent> &events);
+	static void report(std::ostream &out);
+	static bool writeChromeTrace(const std::string &path);
+};
+
+class TraceZone
+{
+public:
+	TraceZone(const char *label);
+	~TraceZone();
+
+private:
+	const char *label;
+	bool active;
+	unsigned long long start;
+	long long counters[NUM_TRACE_COUNTERS];
+};
+
+#if HOST_TRACING
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_ZONE(label) TraceZone TRACE_CONCAT(traceZone, __LINE__)(label)
+#else
+#define TRACE_ZONE(label)
+#endif
+
+// shared by both profilers
+float tracePercentile(const std::vector<float> &sorted, float p); // nearest rank
+bool writeChromeTrace(const std::string &path, const std::vector<TraceEvent> &events,
+	const std::map<int, std::string> &processNames);
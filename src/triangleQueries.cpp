@@ -0,0 +1,227 @@
+#include <cstring>
+#include "triangleQueries.hpp"
+#include "triangleQueriesWide.hpp"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void TriangleSoA::resize(int n) {
+	ax.resize(n);
+	ay.resize(n);
+	az.resize(n);
+	bx.resize(n);
+	by.resize(n);
+	bz.resize(n);
+	cx.resize(n);
+	cy.resize(n);
+	cz.resize(n);
+}
+
+TriangleBatch::TriangleBatch() {
+	memset(this, 0, sizeof(TriangleBatch));
+}
+
+void TriangleBatch::add(const TriangleSoA &triangles, int first, int n) {
+	for (int i = 0; i < n; i++) {
+		int from = first + i;
+		int to = count + i;
+		ax[to] = triangles.ax[from];
+		ay[to] = triangles.ay[from];
+		az[to] = triangles.az[from];
+		bx[to] = triangles.bx[from];
+		by[to] = triangles.by[from];
+		bz[to] = triangles.bz[from];
+		cx[to] = triangles.cx[from];
+		cy[to] = triangles.cy[from];
+		cz[to] = triangles.cz[from];
+		slot[to] = from;
+	}
+	count += n;
+}
+
+/******************************************************************************
+ scalar path, one triangle at a time. what the wide paths have to match.
+******************************************************************************/
+
+// nearestPointOnTriangle in cloth_genCollisions.comp.glsl
+static glm::vec3 nearestPointOnTriangle(glm::vec3 P, glm::vec3 A, glm::vec3 B, glm::vec3 C) {
+	glm::vec3 v0 = C - A;
+	glm::vec3 v1 = B - A;
+	glm::vec3 N = glm::normalize(glm::cross(v1, v0));
+
+	// case 1: it's in the triangle
+	glm::vec3 projP = P + glm::dot(N, A - P) * N;
+	glm::vec3 v2 = projP - A;
+	float dot00 = glm::dot(v0, v0);
+	float dot01 = glm::dot(v0, v1);
+	float dot02 = glm::dot(v0, v2);
+	float dot11 = glm::dot(v1, v1);
+	float dot12 = glm::dot(v1, v2);
+
+	float invDenom = 1.0f / (dot00 * dot11 - dot01 * dot01);
+	float u = (dot11 * dot02 - dot01 * dot12) * invDenom;
+	float v = (dot00 * dot12 - dot01 * dot02) * invDenom;
+	if (u >= 0.0f && v >= 0.0f && (u + v) <= 1.0f) {
+		return projP;
+	}
+
+	// case 2 and 3: it's on an edge or a vertex
+	float tAB = glm::clamp(-glm::dot(A - P, B - A) / glm::dot(B - A, B - A), 0.0f, 1.0f);
+	float tBC = glm::clamp(-glm::dot(B - P, C - B) / glm::dot(C - B, C - B), 0.0f, 1.0f);
+	float tCA = glm::clamp(-glm::dot(C - P, A - C) / glm::dot(A - C, A - C), 0.0f, 1.0f);
+
+	float minDistance = glm::length(glm::cross(P - A, P - B)) / glm::length(B - A);
+	glm::vec3 e0 = A;
+	glm::vec3 e1 = B;
+	float t = tAB;
+
+	float candidate = glm::length(glm::cross(P - B, P - C)) / glm::length(B - C);
+	if (candidate < minDistance) {
+		minDistance = candidate;
+		e0 = B;
+		e1 = C;
+		t = tBC;
+	}
+	candidate = glm::length(glm::cross(P - C, P - A)) / glm::length(C - A);
+	if (candidate < minDistance) {
+		minDistance = candidate;
+		e0 = C;
+		e1 = A;
+		t = tCA;
+	}
+	return t * (e1 - e0) + e0;
+}
+
+// mollerTrumboreIntersectTriangle in cloth_genCollisions.comp.glsl
+static float mollerTrumboreIntersectTriangle(glm::vec3 orig, glm::vec3 dir,
+	glm::vec3 v0, glm::vec3 v1, glm::vec3 v2) {
+	glm::vec3 e1 = v1 - v0;
+	glm::vec3 e2 = v2 - v0;
+	glm::vec3 P = glm::cross(dir, e2);
+	float det = glm::dot(e1, P);
+	// NOT culling
+	if (det > -COLLISION_EPSILON && det < COLLISION_EPSILON) return -1.0f;
+	float inv_det = 1.0f / det;
+
+	glm::vec3 T = orig - v0;
+	float u = glm::dot(T, P) * inv_det;
+	if (u < 0.0f || u > 1.0f) return -1.0f;
+
+	glm::vec3 Q = glm::cross(T, e1);
+	float v = glm::dot(dir, Q) * inv_det;
+	if (v < 0.0f || (u + v) > 1.0f) return -1.0f;
+
+	float t = glm::dot(e2, Q) * inv_det;
+	if (t > 0.0f) return t;
+	return -1.0f;
+}
+
+static void intersectRayScalar(const TriangleBatch &batch, const float orig[3], const float dir[3], float *t) {
+	glm::vec3 origin(orig[0], orig[1], orig[2]);
+	glm::vec3 direction(dir[0], dir[1], dir[2]);
+	for (int i = 0; i < batch.count; i++) {
+		t[i] = mollerTrumboreIntersectTriangle(origin, direction,
+			glm::vec3(batch.ax[i], batch.ay[i], batch.az[i]),
+			glm::vec3(batch.bx[i], batch.by[i], batch.bz[i]),
+			glm::vec3(batch.cx[i], batch.cy[i], batch.cz[i]));
+	}
+}
+
+static void nearestPointsScalar(const TriangleBatch &batch, const float point[3],
+	float *x, float *y, float *z, float *distance) {
+	glm::vec3 P(point[0], point[1], point[2]);
+	for (int i = 0; i < batch.count; i++) {
+		glm::vec3 nearest = nearestPointOnTriangle(P,
+			glm::vec3(batch.ax[i], batch.ay[i], batch.az[i]),
+			glm::vec3(batch.bx[i], batch.by[i], batch.bz[i]),
+			glm::vec3(batch.cx[i], batch.cy[i], batch.cz[i]));
+		x[i] = nearest.x;
+		y[i] = nearest.y;
+		z[i] = nearest.z;
+		distance[i] = glm::length(nearest - P);
+	}
+}
+
+/******************************************************************************
+ SSE path. SSE2 is part of every x86-64, so it builds with everything else.
+******************************************************************************/
+
+#if defined(__SSE2__)
+namespace {
+struct SSELanes
+{
+	typedef __m128 F;
+	typedef __m128 M;
+	static const int width = 4;
+
+	static F load(const float *p) { return _mm_loadu_ps(p); }
+	static void store(float *p, F a) { _mm_storeu_ps(p, a); }
+	static F set1(float a) { return _mm_set1_ps(a); }
+	static F add(F a, F b) { return _mm_add_ps(a, b); }
+	static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+	static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+	static F div(F a, F b) { return _mm_div_ps(a, b); }
+	static F sqrt(F a) { return _mm_sqrt_ps(a); }
+	static F neg(F a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+	static F min(F a, F b) { return _mm_min_ps(a, b); }
+	static F max(F a, F b) { return _mm_max_ps(a, b); }
+	static M lt(F a, F b) { return _mm_cmplt_ps(a, b); }
+	static M le(F a, F b) { return _mm_cmple_ps(a, b); }
+	static M gt(F a, F b) { return _mm_cmpgt_ps(a, b); }
+	static M ge(F a, F b) { return _mm_cmpge_ps(a, b); }
+	static M both(M a, M b) { return _mm_and_ps(a, b); }
+	static M either(M a, M b) { return _mm_or_ps(a, b); }
+	static F select(M m, F a, F b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+};
+}
+
+const TriangleQueries *triangleQueriesSSE() {
+	static const TriangleQueries queries = { "sse", SSELanes::width,
+		intersectRayWide<SSELanes>, nearestPointsWide<SSELanes> };
+	return &queries;
+}
+#else
+const TriangleQueries *triangleQueriesSSE() { return NULL; }
+#endif
+
+/******************************************************************************
+ picking one
+******************************************************************************/
+
+static bool cpuSupports(int path) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	switch (path) {
+	case TRIANGLE_QUERY_SSE: return __builtin_cpu_supports("sse2");
+	case TRIANGLE_QUERY_AVX2: return __builtin_cpu_supports("avx2");
+	case TRIANGLE_QUERY_AVX512: return __builtin_cpu_supports("avx512f");
+	}
+#endif
+	return false;
+}
+
+const TriangleQueries *triangleQueries::get(int path) {
+	static const TriangleQueries scalar = { "scalar", 1, intersectRayScalar, nearestPointsScalar };
+	const TriangleQueries *queries = NULL;
+	switch (path) {
+	case TRIANGLE_QUERY_SCALAR: return &scalar;
+	case TRIANGLE_QUERY_SSE: queries = triangleQueriesSSE(); break;
+	case TRIANGLE_QUERY_AVX2: queries = triangleQueriesAVX2(); break;
+	case TRIANGLE_QUERY_AVX512: queries = triangleQueriesAVX512(); break;
+	default: return NULL;
+	}
+	return queries && cpuSupports(path) ? queries : NULL;
+}
+
+static const TriangleQueries *widest() {
+#if TRIANGLE_QUERY_SIMD
+	for (int path = NUM_TRIANGLE_QUERY_PATHS - 1; path > TRIANGLE_QUERY_SCALAR; path--) {
+		if (triangleQueries::get(path)) return triangleQueries::get(path);
+	}
+#endif
+	return triangleQueries::get(TRIANGLE_QUERY_SCALAR);
+}
+
+const TriangleQueries &triangleQueries::best() {
+	static const TriangleQueries *chosen = widest();
+	return *chosen;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+// one point (or ray) against a batch of collider triangles at a time: the
+// cpu backend's twins of nearestPointOnTriangle and
+// mollerTrumboreIntersectTriangle in cloth_genCollisions.comp.glsl.
+// the triangles are structure of arrays, so SSE, AVX2 and AVX-512 do 4, 8
+// and 16 of them per instruction. the widest one the cpu has is picked at
+// runtime. every width does the same float operations in the same order as
+// the scalar versions, and none of them fuse multiply-adds, so they all
+// give the same bits and collisions don't depend on the machine.
+
+#define TRIANGLE_QUERY_SIMD 1 // 0: always use the scalar versions
+#define TRIANGLE_BATCH_SIZE 64 // triangles per batch, a multiple of the widest path
+#define COLLISION_EPSILON 0.0001f // the EPSILON in cloth_genCollisions.comp.glsl
+
+// corners a, b and c of every triangle of a body, in BVH leaf order (the
+// order of Rbody::ssbo_triangles), so a leaf is a contiguous range
+struct TriangleSoA
+{
+	std::vector<float> ax, ay, az, bx, by, bz, cx, cy, cz;
+
+	int size() const { return ax.size(); }
+	void resize(int n);
+};
+
+// triangles gathered from a few leaves for one query. lanes past count are
+// kept as harmless numbers, since the wide paths run over them too.
+struct TriangleBatch
+{
+	alignas(64) float ax[TRIANGLE_BATCH_SIZE];
+	alignas(64) float ay[TRIANGLE_BATCH_SIZE];
+	alignas(64) float az[TRIANGLE_BATCH_SIZE];
+	alignas(64) float bx[TRIANGLE_BATCH_SIZE];
+	alignas(64) float by[TRIANGLE_BATCH_SIZE];
+	alignas(64) float bz[TRIANGLE_BATCH_SIZE];
+	alignas(64) float cx[TRIANGLE_BATCH_SIZE];
+	alignas(64) float cy[TRIANGLE_BATCH_SIZE];
+	alignas(64) float cz[TRIANGLE_BATCH_SIZE];
+	int slot[TRIANGLE_BATCH_SIZE]; // where each triangle is in the TriangleSoA
+	int count;
+
+	TriangleBatch();
+	void clear() { count = 0; }
+	bool hasRoom(int n) const { return count + n <= TRIANGLE_BATCH_SIZE; }
+	void add(const TriangleSoA &triangles, int first, int n); // triangles [first, first + n)
+};
+
+enum TriangleQueryPath {
+	TRIANGLE_QUERY_SCALAR,
+	TRIANGLE_QUERY_SSE,
+	TRIANGLE_QUERY_AVX2,
+	TRIANGLE_QUERY_AVX512,
+	NUM_TRIANGLE_QUERY_PATHS
+};
+
+// one path's kernels. both write TRIANGLE_BATCH_SIZE outputs, of which the
+// first batch.count mean something.
+struct TriangleQueries
+{
+	const char *name;
+	int width; // triangles per instruction
+
+	// mollerTrumboreIntersectTriangle against every triangle: t along the
+	// (unit) ray, or -1 if it misses
+	void (*intersectRay)(const TriangleBatch &batch, const float orig[3], const float dir[3], float *t);
+
+	// nearestPointOnTriangle for every triangle: the point, and how far it is from P
+	void (*nearestPoints)(const TriangleBatch &batch, const float P[3],
+		float *x, float *y, float *z, float *distance);
+};
+
+namespace triangleQueries {
+// NULL if this build or this cpu can't run the path
+const TriangleQueries *get(int path);
+
+// the widest path there is, chosen once
+const TriangleQueries &best();
+}
@@ -0,0 +1,42 @@
+// the AVX2 path of triangleQueries.hpp. built with -mavx2 (see
+// CMakeLists.txt) and only called on cpus that have it.
+#include "triangleQueriesWide.hpp"
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace {
+struct AVX2Lanes
+{
+	typedef __m256 F;
+	typedef __m256 M;
+	static const int width = 8;
+
+	static F load(const float *p) { return _mm256_loadu_ps(p); }
+	static void store(float *p, F a) { _mm256_storeu_ps(p, a); }
+	static F set1(float a) { return _mm256_set1_ps(a); }
+	static F add(F a, F b) { return _mm256_add_ps(a, b); }
+	static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+	static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+	static F div(F a, F b) { return _mm256_div_ps(a, b); }
+	static F sqrt(F a) { return _mm256_sqrt_ps(a); }
+	static F neg(F a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+	static F min(F a, F b) { return _mm256_min_ps(a, b); }
+	static F max(F a, F b) { return _mm256_max_ps(a, b); }
+	static M lt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static M le(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	static M gt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	static M ge(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+	static M both(M a, M b) { return _mm256_and_ps(a, b); }
+	static M either(M a, M b) { return _mm256_or_ps(a, b); }
+	static F select(M m, F a, F b) { return _mm256_blendv_ps(b, a, m); }
+};
+}
+
+const TriangleQueries *triangleQueriesAVX2() {
+	static const TriangleQueries queries = { "avx2", AVX2Lanes::width,
+		intersectRayWide<AVX2Lanes>, nearestPointsWide<AVX2Lanes> };
+	return &queries;
+}
+#else
+const TriangleQueries *triangleQueriesAVX2() { return NULL; }
+#endif
@@ -0,0 +1,45 @@
+// the AVX-512 path of triangleQueries.hpp. built with -mavx512f (see
+// CMakeLists.txt) and only called on cpus that have it.
+#include "triangleQueriesWide.hpp"
+#if defined(__AVX512F__)
+#include <immintrin.h>
+
+namespace {
+struct AVX512Lanes
+{
+	typedef __m512 F;
+	typedef __mmask16 M;
+	static const int width = 16;
+
+	static F load(const float *p) { return _mm512_loadu_ps(p); }
+	static void store(float *p, F a) { _mm512_storeu_ps(p, a); }
+	static F set1(float a) { return _mm512_set1_ps(a); }
+	static F add(F a, F b) { return _mm512_add_ps(a, b); }
+	static F sub(F a, F b) { return _mm512_sub_ps(a, b); }
+	static F mul(F a, F b) { return _mm512_mul_ps(a, b); }
+	static F div(F a, F b) { return _mm512_div_ps(a, b); }
+	static F sqrt(F a) { return _mm512_sqrt_ps(a); }
+	// float xor is AVX512DQ, the integer one is in AVX512F
+	static F neg(F a) {
+		return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x80000000)));
+	}
+	static F min(F a, F b) { return _mm512_min_ps(a, b); }
+	static F max(F a, F b) { return _mm512_max_ps(a, b); }
+	static M lt(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+	static M le(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+	static M gt(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+	static M ge(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+	static M both(M a, M b) { return a & b; }
+	static M either(M a, M b) { return a | b; }
+	static F select(M m, F a, F b) { return _mm512_mask_blend_ps(m, b, a); }
+};
+}
+
+const TriangleQueries *triangleQueriesAVX512() {
+	static const TriangleQueries queries = { "avx512", AVX512Lanes::width,
+		intersectRayWide<AVX512Lanes>, nearestPointsWide<AVX512Lanes> };
+	return &queries;
+}
+#else
+const TriangleQueries *triangleQueriesAVX512() { return NULL; }
+#endif
@@ -0,0 +1,191 @@
+#pragma once
+#include "triangleQueries.hpp"
+
+// the SIMD paths of triangleQueries.hpp, written once over a lane type L:
+//   L::F, L::M         a register of floats, and a comparison mask
+//   L::width           floats in an F
+//   load, store, set1  and add, sub, mul, div, sqrt, neg, min, max, which
+//                      round exactly like the scalar float operations.
+//                      min(a, b) is a < b ? a : b and max(a, b) is
+//                      a > b ? a : b, glm's (and the SSE instructions') way.
+//   lt, le, gt, ge     ordered comparisons, false if either is NaN
+//   both, either       and, or of masks
+//   select(m, a, b)    m ? a : b
+// each expression follows glm's order of operations: dot(a, b) is
+// (a.x * b.x + a.y * b.y) + a.z * b.z, length is sqrt(dot), normalize is
+// x * (1 / sqrt(dot)), clamp is min(max(x, lo), hi).
+//
+// only the file that defines a lane type includes this, and is built with
+// its instruction set. everything in here stays local to that file, so none
+// of it gets shared with code that has to run on any cpu.
+
+// the paths each file provides, NULL if it was built without the instructions
+const TriangleQueries *triangleQueriesSSE();
+const TriangleQueries *triangleQueriesAVX2();
+const TriangleQueries *triangleQueriesAVX512();
+
+namespace {
+
+template<class L> struct Vec3Lanes
+{
+	typename L::F x, y, z;
+};
+
+template<class L> inline Vec3Lanes<L> loadLanes(const float *x, const float *y, const float *z, int i) {
+	Vec3Lanes<L> v = { L::load(x + i), L::load(y + i), L::load(z + i) };
+	return v;
+}
+
+template<class L> inline Vec3Lanes<L> splat(const float v[3]) {
+	Vec3Lanes<L> s = { L::set1(v[0]), L::set1(v[1]), L::set1(v[2]) };
+	return s;
+}
+
+template<class L> inline Vec3Lanes<L> sub(const Vec3Lanes<L> &a, const Vec3Lanes<L> &b) {
+	Vec3Lanes<L> d = { L::sub(a.x, b.x), L::sub(a.y, b.y), L::sub(a.z, b.z) };
+	return d;
+}
+
+template<class L> inline typename L::F dot(const Vec3Lanes<L> &a, const Vec3Lanes<L> &b) {
+	return L::add(L::add(L::mul(a.x, b.x), L::mul(a.y, b.y)), L::mul(a.z, b.z));
+}
+
+template<class L> inline Vec3Lanes<L> cross(const Vec3Lanes<L> &a, const Vec3Lanes<L> &b) {
+	Vec3Lanes<L> c = {
+		L::sub(L::mul(a.y, b.z), L::mul(b.y, a.z)),
+		L::sub(L::mul(a.z, b.x), L::mul(b.z, a.x)),
+		L::sub(L::mul(a.x, b.y), L::mul(b.x, a.y)) };
+	return c;
+}
+
+template<class L> inline typename L::F length(const Vec3Lanes<L> &a) {
+	return L::sqrt(dot(a, a));
+}
+
+template<class L> inline Vec3Lanes<L> selectLanes(typename L::M m, const Vec3Lanes<L> &a, const Vec3Lanes<L> &b) {
+	Vec3Lanes<L> s = { L::select(m, a.x, b.x), L::select(m, a.y, b.y), L::select(m, a.z, b.z) };
+	return s;
+}
+
+// t * (e1 - e0) + e0
+template<class L> inline Vec3Lanes<L> alongEdge(typename L::F t, const Vec3Lanes<L> &e0, const Vec3Lanes<L> &e1) {
+	Vec3Lanes<L> p = {
+		L::add(L::mul(t, L::sub(e1.x, e0.x)), e0.x),
+		L::add(L::mul(t, L::sub(e1.y, e0.y)), e0.y),
+		L::add(L::mul(t, L::sub(e1.z, e0.z)), e0.z) };
+	return p;
+}
+
+template<class L> void intersectRayWide(const TriangleBatch &batch, const float origin[3], const float direction[3], float *t) {
+	typedef typename L::F F;
+	typedef typename L::M M;
+	const F zero = L::set1(0.0f);
+	const F one = L::set1(1.0f);
+	const F miss = L::set1(-1.0f);
+	const F epsilon = L::set1(COLLISION_EPSILON);
+	const F negEpsilon = L::set1(-COLLISION_EPSILON);
+	Vec3Lanes<L> orig = splat<L>(origin);
+	Vec3Lanes<L> dir = splat<L>(direction);
+
+	for (int i = 0; i < batch.count; i += L::width) {
+		Vec3Lanes<L> v0 = loadLanes<L>(batch.ax, batch.ay, batch.az, i);
+		Vec3Lanes<L> v1 = loadLanes<L>(batch.bx, batch.by, batch.bz, i);
+		Vec3Lanes<L> v2 = loadLanes<L>(batch.cx, batch.cy, batch.cz, i);
+
+		Vec3Lanes<L> e1 = sub(v1, v0);
+		Vec3Lanes<L> e2 = sub(v2, v0);
+		Vec3Lanes<L> P = cross(dir, e2);
+		F det = dot(e1, P);
+		// NOT culling
+		M missed = L::both(L::gt(det, negEpsilon), L::lt(det, epsilon));
+		F invDet = L::div(one, det);
+
+		Vec3Lanes<L> T = sub(orig, v0);
+		F u = L::mul(dot(T, P), invDet);
+		missed = L::either(missed, L::either(L::lt(u, zero), L::gt(u, one)));
+
+		Vec3Lanes<L> Q = cross(T, e1);
+		F v = L::mul(dot(dir, Q), invDet);
+		missed = L::either(missed, L::either(L::lt(v, zero), L::gt(L::add(u, v), one)));
+
+		F hitT = L::mul(dot(e2, Q), invDet);
+		F result = L::select(L::gt(hitT, zero), hitT, miss);
+		L::store(t + i, L::select(missed, miss, result));
+	}
+}
+
+template<class L> void nearestPointsWide(const TriangleBatch &batch, const float point[3],
+	float *x, float *y, float *z, float *distance) {
+	typedef typename L::F F;
+	typedef typename L::M M;
+	const F zero = L::set1(0.0f);
+	const F one = L::set1(1.0f);
+	Vec3Lanes<L> P = splat<L>(point);
+
+	for (int i = 0; i < batch.count; i += L::width) {
+		Vec3Lanes<L> A = loadLanes<L>(batch.ax, batch.ay, batch.az, i);
+		Vec3Lanes<L> B = loadLanes<L>(batch.bx, batch.by, batch.bz, i);
+		Vec3Lanes<L> C = loadLanes<L>(batch.cx, batch.cy, batch.cz, i);
+
+		Vec3Lanes<L> v0 = sub(C, A);
+		Vec3Lanes<L> v1 = sub(B, A);
+		Vec3Lanes<L> n = cross(v1, v0);
+		F invLength = L::div(one, length(n));
+		Vec3Lanes<L> N = { L::mul(n.x, invLength), L::mul(n.y, invLength), L::mul(n.z, invLength) };
+
+		// case 1: it's in the triangle
+		F signedDistance = dot(N, sub(A, P));
+		Vec3Lanes<L> projP = {
+			L::add(P.x, L::mul(signedDistance, N.x)),
+			L::add(P.y, L::mul(signedDistance, N.y)),
+			L::add(P.z, L::mul(signedDistance, N.z)) };
+		Vec3Lanes<L> v2 = sub(projP, A);
+		F dot00 = dot(v0, v0);
+		F dot01 = dot(v0, v1);
+		F dot02 = dot(v0, v2);
+		F dot11 = dot(v1, v1);
+		F dot12 = dot(v1, v2);
+
+		F invDenom = L::div(one, L::sub(L::mul(dot00, dot11), L::mul(dot01, dot01)));
+		F u = L::mul(L::sub(L::mul(dot11, dot02), L::mul(dot01, dot12)), invDenom);
+		F v = L::mul(L::sub(L::mul(dot00, dot12), L::mul(dot01, dot02)), invDenom);
+		M inside = L::both(L::both(L::ge(u, zero), L::ge(v, zero)), L::le(L::add(u, v), one));
+
+		// case 2 and 3: it's on an edge or a vertex
+		Vec3Lanes<L> AB = sub(B, A);
+		Vec3Lanes<L> BC = sub(C, B);
+		Vec3Lanes<L> CA = sub(A, C);
+		F tAB = L::min(L::max(L::div(L::neg(dot(sub(A, P), AB)), dot(AB, AB)), zero), one);
+		F tBC = L::min(L::max(L::div(L::neg(dot(sub(B, P), BC)), dot(BC, BC)), zero), one);
+		F tCA = L::min(L::max(L::div(L::neg(dot(sub(C, P), CA)), dot(CA, CA)), zero), one);
+
+		Vec3Lanes<L> PA = sub(P, A);
+		Vec3Lanes<L> PB = sub(P, B);
+		Vec3Lanes<L> PC = sub(P, C);
+		F minDistance = L::div(length(cross(PA, PB)), length(AB));
+		Vec3Lanes<L> e0 = A;
+		Vec3Lanes<L> e1 = B;
+		F t = tAB;
+
+		F candidate = L::div(length(cross(PB, PC)), length(sub(B, C)));
+		M closer = L::lt(candidate, minDistance);
+		minDistance = L::select(closer, candidate, minDistance);
+		e0 = selectLanes<L>(closer, B, e0);
+		e1 = selectLanes<L>(closer, C, e1);
+		t = L::select(closer, tBC, t);
+
+		candidate = L::div(length(cross(PC, PA)), length(sub(C, A)));
+		closer = L::lt(candidate, minDistance);
+		e0 = selectLanes<L>(closer, C, e0);
+		e1 = selectLanes<L>(closer, A, e1);
+		t = L::select(closer, tCA, t);
+
+		Vec3Lanes<L> nearest = selectLanes<L>(inside, projP, alongEdge<L>(t, e0, e1));
+		L::store(x + i, nearest.x);
+		L::store(y + i, nearest.y);
+		L::store(z + i, nearest.z);
+		L::store(distance + i, length(sub(nearest, P)));
+	}
+}
+
+}